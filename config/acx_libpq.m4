@@ -339,6 +339,12 @@ if test $have_pqsetnoticereceiver = yes; then
 	 AC_DEFINE(HAVE_PQSETNOTICERECEIVER,1,[Postgresql PQsetNoticeReceiver()])
 fi
 
+have_pqenterpipelinemode=no
+AC_CHECK_LIB(pq, [PQenterPipelineMode], [have_pqenterpipelinemode=yes])
+if test $have_pqenterpipelinemode = yes; then
+	AC_DEFINE(HAVE_PQENTERPIPELINEMODE,1,[Postgresql PQenterPipelineMode()])
+fi
+
 have_pqfreemem=no
 AC_CHECK_LIB(pq, [PQfreemem], [have_pqfreemem=yes])
 if test $have_pqfreemem = yes; then
@@ -111,6 +111,7 @@ create table @NAMESPACE@.sl_table (
 	tab_idxname			name NOT NULL,
 	tab_altered			boolean NOT NULL,
 	tab_comment			text,
+	tab_columns			text[],
 
 	CONSTRAINT "sl_table-pkey"
 		PRIMARY KEY (tab_id),
@@ -127,6 +128,28 @@ comment on column @NAMESPACE@.sl_table.tab_set is 'ID of the replication set the
 comment on column @NAMESPACE@.sl_table.tab_idxname is 'The name of the primary index of the table';
 comment on column @NAMESPACE@.sl_table.tab_altered is 'Has the table been modified for replication?';
 comment on column @NAMESPACE@.sl_table.tab_comment is 'Human-oriented description of the table';
+comment on column @NAMESPACE@.sl_table.tab_columns is 'Names of the columns that are replicated in addition to the key columns, NULL to replicate all columns';
+
+
+-- ----------------------------------------------------------------------
+-- TABLE sl_table_filter
+-- ----------------------------------------------------------------------
+create table @NAMESPACE@.sl_table_filter (
+	tf_tab_id			int4,
+	tf_receiver			int4,
+	tf_set				int4 NOT NULL,
+	tf_filter			text NOT NULL,
+	tf_logfilter		text NOT NULL,
+
+	CONSTRAINT "sl_table_filter-pkey"
+		PRIMARY KEY (tf_tab_id, tf_receiver)
+) WITHOUT OIDS;
+comment on table @NAMESPACE@.sl_table_filter is 'Row filters of replicated tables, per subscriber.  Exists on all nodes, also those that do not replicate the table.';
+comment on column @NAMESPACE@.sl_table_filter.tf_tab_id is 'ID of the filtered table (sl_table.tab_id)';
+comment on column @NAMESPACE@.sl_table_filter.tf_receiver is 'Node ID of the subscriber that only receives the matching rows';
+comment on column @NAMESPACE@.sl_table_filter.tf_set is 'ID of the replication set the table is in';
+comment on column @NAMESPACE@.sl_table_filter.tf_filter is 'The filter, a boolean expression over the columns of the table, used for the initial copy';
+comment on column @NAMESPACE@.sl_table_filter.tf_logfilter is 'The filter rewritten to an expression over log_cmdargs, used when selecting sl_log rows on the provider';
 
 
 -- ----------------------------------------------------------------------
@@ -270,6 +293,7 @@ comment on column @NAMESPACE@.sl_event.ev_type is 'The type of event this record
 				DROP_SET			=
 				MERGE_SET			=
 				SET_ADD_TABLE		=
+				SET_ADD_TABLES		=
 				SET_ADD_SEQUENCE	=
 				STORE_TRIGGER		=
 				DROP_TRIGGER		=
@@ -279,6 +303,7 @@ comment on column @NAMESPACE@.sl_event.ev_type is 'The type of event this record
 				SET_DROP_SEQUENCE		=
 				SET_MOVE_TABLE			=
 				SET_MOVE_SEQUENCE		=
+				SET_TABLE_FILTER		=
 				FAILOVER_SET		=
 				SUBSCRIBE_SET		=
 				ENABLE_SUBSCRIPTION	=
@@ -374,10 +399,13 @@ create table @NAMESPACE@.sl_log_1 (
 	log_tablerelname	text,
 	log_cmdtype			"char",
 	log_cmdupdncols		int4,
-	log_cmdargs			text[]
+	log_cmdargs			text[],
+	log_setid			int4
 ) WITHOUT OIDS;
 create index sl_log_1_idx1 on @NAMESPACE@.sl_log_1
 	(log_origin, log_txid, log_actionseq);
+create index sl_log_1_idx3 on @NAMESPACE@.sl_log_1
+	(log_origin, log_setid, log_txid);
 
 -- Add in an additional index as sometimes log_origin isn't a useful discriminant
 -- create index sl_log_1_idx2 on @NAMESPACE@.sl_log_1
@@ -388,11 +416,12 @@ comment on column @NAMESPACE@.sl_log_1.log_origin is 'Origin node from which the
 comment on column @NAMESPACE@.sl_log_1.log_txid is 'Transaction ID on the origin node';
 comment on column @NAMESPACE@.sl_log_1.log_tableid is 'The table ID (from sl_table.tab_id) that this log entry is to affect';
 comment on column @NAMESPACE@.sl_log_1.log_actionseq is 'The sequence number in which actions will be applied on replicas';
-comment on column @NAMESPACE@.sl_log_1.log_tablenspname is 'The schema name of the table affected';
-comment on column @NAMESPACE@.sl_log_1.log_tablerelname is 'The table name of the table affected';
-comment on column @NAMESPACE@.sl_log_1.log_cmdtype is 'Replication action to take. U = Update, I = Insert, D = DELETE, T = TRUNCATE';
-comment on column @NAMESPACE@.sl_log_1.log_cmdupdncols is 'For cmdtype=U the number of updated columns in cmdargs';
-comment on column @NAMESPACE@.sl_log_1.log_cmdargs is 'The data needed to perform the log action on the replica';
+comment on column @NAMESPACE@.sl_log_1.log_tablenspname is 'Unused, NULL.  Kept for compatibility; the schema name of the table is looked up in sl_table by log_tableid';
+comment on column @NAMESPACE@.sl_log_1.log_tablerelname is 'Unused, NULL.  Kept for compatibility; the table name is looked up in sl_table by log_tableid';
+comment on column @NAMESPACE@.sl_log_1.log_cmdtype is 'Replication action to take. U = Update, I = Insert, D = DELETE, T = TRUNCATE, M = latency trace marker, B = bulk load chunk';
+comment on column @NAMESPACE@.sl_log_1.log_cmdupdncols is 'For cmdtype=U the number of updated columns in cmdargs, for cmdtype=B the number of rows';
+comment on column @NAMESPACE@.sl_log_1.log_cmdargs is 'The data needed to perform the log action on the replica.  For cmdtype=B the column names followed by the rows in COPY text format';
+comment on column @NAMESPACE@.sl_log_1.log_setid is 'The set ID (from sl_table.tab_set) of the table at the time of the change, used by providers to select the rows of a set';
 
 -- ----------------------------------------------------------------------
 -- TABLE sl_log_2
@@ -406,10 +435,13 @@ create table @NAMESPACE@.sl_log_2 (
 	log_tablerelname	text,
 	log_cmdtype			"char",
 	log_cmdupdncols		int4,
-	log_cmdargs			text[]
+	log_cmdargs			text[],
+	log_setid			int4
 ) WITHOUT OIDS;
 create index sl_log_2_idx1 on @NAMESPACE@.sl_log_2
 	(log_origin, log_txid, log_actionseq);
+create index sl_log_2_idx3 on @NAMESPACE@.sl_log_2
+	(log_origin, log_setid, log_txid);
 
 -- Add in an additional index as sometimes log_origin isn't a useful discriminant
 -- create index sl_log_2_idx2 on @NAMESPACE@.sl_log_2
@@ -420,11 +452,12 @@ comment on column @NAMESPACE@.sl_log_2.log_origin is 'Origin node from which the
 comment on column @NAMESPACE@.sl_log_2.log_txid is 'Transaction ID on the origin node';
 comment on column @NAMESPACE@.sl_log_2.log_tableid is 'The table ID (from sl_table.tab_id) that this log entry is to affect';
 comment on column @NAMESPACE@.sl_log_2.log_actionseq is 'The sequence number in which actions will be applied on replicas';
-comment on column @NAMESPACE@.sl_log_2.log_tablenspname is 'The schema name of the table affected';
-comment on column @NAMESPACE@.sl_log_2.log_tablerelname is 'The table name of the table affected';
-comment on column @NAMESPACE@.sl_log_2.log_cmdtype is 'Replication action to take. U = Update, I = Insert, D = DELETE, T = TRUNCATE';
-comment on column @NAMESPACE@.sl_log_2.log_cmdupdncols is 'For cmdtype=U the number of updated columns in cmdargs';
-comment on column @NAMESPACE@.sl_log_2.log_cmdargs is 'The data needed to perform the log action on the replica';
+comment on column @NAMESPACE@.sl_log_2.log_tablenspname is 'Unused, NULL.  Kept for compatibility; the schema name of the table is looked up in sl_table by log_tableid';
+comment on column @NAMESPACE@.sl_log_2.log_tablerelname is 'Unused, NULL.  Kept for compatibility; the table name is looked up in sl_table by log_tableid';
+comment on column @NAMESPACE@.sl_log_2.log_cmdtype is 'Replication action to take. U = Update, I = Insert, D = DELETE, T = TRUNCATE, M = latency trace marker, B = bulk load chunk';
+comment on column @NAMESPACE@.sl_log_2.log_cmdupdncols is 'For cmdtype=U the number of updated columns in cmdargs, for cmdtype=B the number of rows';
+comment on column @NAMESPACE@.sl_log_2.log_cmdargs is 'The data needed to perform the log action on the replica.  For cmdtype=B the column names followed by the rows in COPY text format';
+comment on column @NAMESPACE@.sl_log_2.log_setid is 'The set ID (from sl_table.tab_set) of the table at the time of the change, used by providers to select the rows of a set';
 
 -- ----------------------------------------------------------------------
 -- TABLE sl_log_script
@@ -500,6 +533,104 @@ comment on column @NAMESPACE@.sl_apply_stats.as_cache_evict is 'Number of apply
 comment on column @NAMESPACE@.sl_apply_stats.as_cache_prepare_max is 'Maximum number of apply queries prepared in one SYNC group';
 
 
+-- ----------------------------------------------------------------------
+-- TABLE sl_sync_perf
+-- ----------------------------------------------------------------------
+create table @NAMESPACE@.sl_sync_perf (
+	sp_origin			int4,
+	sp_seqno_first		int8,
+	sp_seqno_last		int8,
+	sp_num_syncs		int4,
+	sp_apply_time		timestamptz,
+	sp_num_rows			int8,
+	sp_num_bytes		int8,
+	sp_num_insert		int8,
+	sp_num_update		int8,
+	sp_num_delete		int8,
+	sp_num_truncate		int8,
+	sp_num_script		int8,
+	sp_duration			interval,
+	sp_provider_time	interval,
+	sp_subscriber_time	interval,
+	sp_first_row_delay	interval,
+	sp_cache_prepare	int8,
+	sp_cache_hit		int8,
+	sp_cache_evict		int8
+) WITHOUT OIDS;
+
+create index sl_sync_perf_idx1 on @NAMESPACE@.sl_sync_perf
+	(sp_origin, sp_seqno_last);
+
+comment on table @NAMESPACE@.sl_sync_perf is 'Per SYNC group apply statistics, kept as a ring buffer of the most recent groups per origin (slon option sync_perf_history)';
+comment on column @NAMESPACE@.sl_sync_perf.sp_origin is 'Origin of the SYNCs';
+comment on column @NAMESPACE@.sl_sync_perf.sp_seqno_first is 'Event seqno of the first SYNC in the group';
+comment on column @NAMESPACE@.sl_sync_perf.sp_seqno_last is 'Event seqno of the last SYNC in the group';
+comment on column @NAMESPACE@.sl_sync_perf.sp_num_syncs is 'Number of SYNC events applied in the group';
+comment on column @NAMESPACE@.sl_sync_perf.sp_apply_time is 'Timestamp when the group was applied';
+comment on column @NAMESPACE@.sl_sync_perf.sp_num_rows is 'Number of sl_log rows copied from the providers';
+comment on column @NAMESPACE@.sl_sync_perf.sp_num_bytes is 'Number of bytes of COPY data received from the providers';
+comment on column @NAMESPACE@.sl_sync_perf.sp_num_insert is 'Number of INSERT operations performed';
+comment on column @NAMESPACE@.sl_sync_perf.sp_num_update is 'Number of UPDATE operations performed';
+comment on column @NAMESPACE@.sl_sync_perf.sp_num_delete is 'Number of DELETE operations performed';
+comment on column @NAMESPACE@.sl_sync_perf.sp_num_truncate is 'Number of TRUNCATE operations performed';
+comment on column @NAMESPACE@.sl_sync_perf.sp_num_script is 'Number of DDL operations performed';
+comment on column @NAMESPACE@.sl_sync_perf.sp_duration is 'Total processing time of the group';
+comment on column @NAMESPACE@.sl_sync_perf.sp_provider_time is 'Time spent in queries against the providers';
+comment on column @NAMESPACE@.sl_sync_perf.sp_subscriber_time is 'Time spent in queries against the local node';
+comment on column @NAMESPACE@.sl_sync_perf.sp_first_row_delay is 'Time until the first log row arrived from the providers';
+comment on column @NAMESPACE@.sl_sync_perf.sp_cache_prepare is 'Number of apply queries prepared';
+comment on column @NAMESPACE@.sl_sync_perf.sp_cache_hit is 'Number of apply query cache hits';
+comment on column @NAMESPACE@.sl_sync_perf.sp_cache_evict is 'Number of apply query cache evict operations';
+
+
+-- ----------------------------------------------------------------------
+-- TABLE sl_latency_sample
+-- ----------------------------------------------------------------------
+create table @NAMESPACE@.sl_latency_sample (
+	ls_origin			int4,
+	ls_tableid			int4,
+	ls_txid				bigint,
+	ls_origin_time		timestamptz,
+	ls_apply_time		timestamptz
+) WITHOUT OIDS;
+
+create index sl_latency_sample_idx1 on @NAMESPACE@.sl_latency_sample
+	(ls_origin);
+
+comment on table @NAMESPACE@.sl_latency_sample is 'Latency trace markers applied in the current SYNC group, turned into sl_latency_hist entries by logApplyLatency()';
+comment on column @NAMESPACE@.sl_latency_sample.ls_origin is 'Origin of the traced transaction';
+comment on column @NAMESPACE@.sl_latency_sample.ls_tableid is 'Table of the first change of the traced transaction';
+comment on column @NAMESPACE@.sl_latency_sample.ls_txid is 'Transaction ID on the origin node';
+comment on column @NAMESPACE@.sl_latency_sample.ls_origin_time is 'Origin wall clock time of the first change of the transaction';
+comment on column @NAMESPACE@.sl_latency_sample.ls_apply_time is 'Local wall clock time at which the marker was applied';
+
+
+-- ----------------------------------------------------------------------
+-- TABLE sl_latency_hist
+-- ----------------------------------------------------------------------
+create table @NAMESPACE@.sl_latency_hist (
+	lh_origin			int4,
+	lh_set				int4,
+	lh_stage			text,
+	lh_bucket			int4,
+	lh_count			int8,
+	lh_sum_ms			float8,
+	lh_last				timestamptz
+) WITHOUT OIDS;
+
+create unique index sl_latency_hist_idx1 on @NAMESPACE@.sl_latency_hist
+	(lh_origin, lh_set, lh_stage, lh_bucket);
+
+comment on table @NAMESPACE@.sl_latency_hist is 'Histogram of sampled commit to apply latency, per origin, set and stage';
+comment on column @NAMESPACE@.sl_latency_hist.lh_origin is 'Origin of the traced transactions';
+comment on column @NAMESPACE@.sl_latency_hist.lh_set is 'Set of the traced transactions';
+comment on column @NAMESPACE@.sl_latency_hist.lh_stage is 'sync = change to SYNC creation, queue = SYNC creation to start of the local SYNC group, fetch = start of group to apply of the transaction, apply = apply of the transaction to local commit, total = change to local commit';
+comment on column @NAMESPACE@.sl_latency_hist.lh_bucket is 'Histogram bucket; counts latencies of up to 2^lh_bucket milliseconds';
+comment on column @NAMESPACE@.sl_latency_hist.lh_count is 'Number of samples in this bucket';
+comment on column @NAMESPACE@.sl_latency_hist.lh_sum_ms is 'Sum of the latencies in this bucket in milliseconds';
+comment on column @NAMESPACE@.sl_latency_hist.lh_last is 'Timestamp of the most recent sample in this bucket';
+
+
 -- **********************************************************************
 -- * Views
 -- **********************************************************************
@@ -570,6 +701,19 @@ FROM
 	    where subs3.sub_receiver is null
 	    );
 
+-- ----------------------------------------------------------------------
+-- VIEW sl_latency_stats
+-- ----------------------------------------------------------------------
+create view @NAMESPACE@.sl_latency_stats as
+	select lh_origin as lat_origin, lh_set as lat_set, lh_stage as lat_stage,
+			sum(lh_count) as lat_samples,
+			sum(lh_sum_ms) / sum(lh_count) as lat_avg_ms,
+			2 ^ max(lh_bucket) as lat_max_ms,
+			max(lh_last) as lat_last_sample
+		from @NAMESPACE@.sl_latency_hist
+		group by lh_origin, lh_set, lh_stage;
+comment on view @NAMESPACE@.sl_latency_stats is 'Summary of sl_latency_hist per origin, set and stage; lat_max_ms is the upper bound of the highest populated bucket';
+
 		      
 	
 
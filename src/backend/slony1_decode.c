@@ -0,0 +1,482 @@
+/* ----------------------------------------------------------------------
+ * slony1_decode.c
+ *
+ *	  Logical decoding output plugin used by the logical capture mode.
+ *
+ *	This file is included by slony1_funcs.c, so that the output plugin
+ *	lives in the same shared library as the other support functions and
+ *	a replication slot can name that library as its plugin.
+ *
+ *	For every change to a user table the plugin emits one text array
+ *
+ *		{cmdtype, nspname, relname, cmdupdncols, colname, value [, ...]}
+ *
+ *	whose cmdargs part has the same layout logTrigger() produces. Changes
+ *	to tables in the skip_namespace (the cluster schema) are suppressed,
+ *	except that the first write to sl_log_1 or sl_log_2 of a transaction
+ *	is reported as a single "L". Such a transaction was captured by the
+ *	log trigger and logicalCaptureDrain() ignores its decoded changes.
+ *
+ *	With the trace_interval option, about one in that many transactions
+ *	gets a latency trace marker {M, nspname, relname, 0, origin_time,
+ *	epoch} ahead of its first change, like logTrigger() logs it. The time
+ *	is the commit time of the transaction.
+ *
+ *	Copyright (c) 2003-2009, PostgreSQL Global Development Group
+ *
+ *
+ * ----------------------------------------------------------------------
+ */
+
+#if PG_VERSION_MAJOR >= 11
+
+#include "access/htup_details.h"
+#include "access/xlog.h"
+#include "replication/logical.h"
+#include "replication/output_plugin.h"
+
+/*
+ * The tuple representation in ReorderBufferChange lost its wrapper
+ * struct in 17.
+ */
+#if PG_VERSION_MAJOR >= 17
+#define SlonyChangeTuple(t)		(t)
+#else
+#define SlonyChangeTuple(t)		((t) == NULL ? NULL : &((t)->tuple))
+#endif
+
+/*
+ * The commit time moved into a union in 15.
+ */
+#if PG_VERSION_MAJOR >= 15
+#define SlonyCommitTime(txn)	((txn)->xact_time.commit_time)
+#else
+#define SlonyCommitTime(txn)	((txn)->commit_time)
+#endif
+
+typedef struct slony_I_decode_data
+{
+	MemoryContext context;
+	char	   *skip_namespace;
+	TransactionId logged_xid;
+	int			trace_interval;
+	TransactionId traced_xid;
+}	SlonyDecodeData;
+
+extern void _PG_output_plugin_init(OutputPluginCallbacks *cb);
+
+static void slonyDecodeStartup(LogicalDecodingContext *ctx,
+				   OutputPluginOptions *opt, bool is_init);
+static void slonyDecodeShutdown(LogicalDecodingContext *ctx);
+static void slonyDecodeBegin(LogicalDecodingContext *ctx,
+				 ReorderBufferTXN *txn);
+static void slonyDecodeCommit(LogicalDecodingContext *ctx,
+				  ReorderBufferTXN *txn, XLogRecPtr commit_lsn);
+static void slonyDecodeChange(LogicalDecodingContext *ctx,
+				  ReorderBufferTXN *txn, Relation relation,
+				  ReorderBufferChange *change);
+static void slonyDecodeTruncate(LogicalDecodingContext *ctx,
+					ReorderBufferTXN *txn, int nrelations,
+					Relation relations[], ReorderBufferChange *change);
+static bool slonyDecodeSkip(LogicalDecodingContext *ctx,
+				ReorderBufferTXN *txn, Relation relation);
+static void slonyDecodeTrace(LogicalDecodingContext *ctx,
+				 ReorderBufferTXN *txn, Relation relation);
+static void slonyDecodeAppendElem(StringInfo out, const char *value);
+static void slonyDecodeAppendHeader(StringInfo out, char cmdtype,
+						Relation relation, int cmdupdncols);
+static int slonyDecodeAppendColumns(StringInfo out, Relation relation,
+						 HeapTuple tuple, Bitmapset *keyattrs,
+						 bool keys_only);
+
+
+void
+_PG_output_plugin_init(OutputPluginCallbacks *cb)
+{
+	cb->startup_cb = slonyDecodeStartup;
+	cb->begin_cb = slonyDecodeBegin;
+	cb->change_cb = slonyDecodeChange;
+	cb->truncate_cb = slonyDecodeTruncate;
+	cb->commit_cb = slonyDecodeCommit;
+	cb->shutdown_cb = slonyDecodeShutdown;
+}
+
+
+static void
+slonyDecodeStartup(LogicalDecodingContext *ctx, OutputPluginOptions *opt,
+				   bool is_init)
+{
+	SlonyDecodeData *data;
+	ListCell   *option;
+
+	data = palloc0(sizeof(SlonyDecodeData));
+	data->context = AllocSetContextCreate(ctx->context,
+										  "Slony-I decode context",
+										  ALLOCSET_DEFAULT_SIZES);
+	data->logged_xid = InvalidTransactionId;
+	data->traced_xid = InvalidTransactionId;
+
+	foreach(option, ctx->output_plugin_options)
+	{
+		DefElem    *elem = lfirst(option);
+
+		if (strcmp(elem->defname, "skip_namespace") == 0 && elem->arg != NULL)
+			data->skip_namespace = pstrdup(strVal(elem->arg));
+		else if (strcmp(elem->defname, "trace_interval") == 0 &&
+				 elem->arg != NULL)
+			data->trace_interval = atoi(strVal(elem->arg));
+		else
+			elog(ERROR, "Slony-I: unknown decoding option \"%s\"",
+				 elem->defname);
+	}
+
+	opt->output_type = OUTPUT_PLUGIN_TEXTUAL_OUTPUT;
+	ctx->output_plugin_private = data;
+}
+
+
+static void
+slonyDecodeShutdown(LogicalDecodingContext *ctx)
+{
+	SlonyDecodeData *data = ctx->output_plugin_private;
+
+	MemoryContextDelete(data->context);
+}
+
+
+/*
+ * Transaction boundaries produce no output. Rows are ordered by commit
+ * already and the caller knows the xid of every row.
+ */
+static void
+slonyDecodeBegin(LogicalDecodingContext *ctx, ReorderBufferTXN *txn)
+{
+}
+
+
+static void
+slonyDecodeCommit(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+				  XLogRecPtr commit_lsn)
+{
+}
+
+
+static void
+slonyDecodeChange(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+				  Relation relation, ReorderBufferChange *change)
+{
+	SlonyDecodeData *data = ctx->output_plugin_private;
+	MemoryContext oldcontext;
+	HeapTuple	newtuple;
+	HeapTuple	oldtuple;
+	Bitmapset  *keyattrs;
+	StringInfoData cols;
+	int			cmdupdncols;
+
+	oldcontext = MemoryContextSwitchTo(data->context);
+
+	if (slonyDecodeSkip(ctx, txn, relation))
+	{
+		MemoryContextSwitchTo(oldcontext);
+		MemoryContextReset(data->context);
+		return;
+	}
+	slonyDecodeTrace(ctx, txn, relation);
+
+	keyattrs = RelationGetIndexAttrBitmap(relation,
+										  INDEX_ATTR_BITMAP_IDENTITY_KEY);
+	newtuple = SlonyChangeTuple(change->data.tp.newtuple);
+	oldtuple = SlonyChangeTuple(change->data.tp.oldtuple);
+
+	switch (change->action)
+	{
+		case REORDER_BUFFER_CHANGE_INSERT:
+			/*
+			 * cmdtype = 'I' cmdargs = colname, newval [, ...]
+			 */
+			OutputPluginPrepareWrite(ctx, true);
+			slonyDecodeAppendHeader(ctx->out, 'I', relation, 0);
+			slonyDecodeAppendColumns(ctx->out, relation, newtuple,
+									 NULL, false);
+			appendStringInfoChar(ctx->out, '}');
+			OutputPluginWrite(ctx, true);
+			break;
+
+		case REORDER_BUFFER_CHANGE_UPDATE:
+			/*
+			 * cmdtype = 'U' cmdargs = colname, newval [, ...] pkcolname,
+			 * oldval [, ...]
+			 *
+			 * The old row is not available, so all columns count as
+			 * changed except unchanged TOASTed values, which the WAL does
+			 * not carry. The old key is only logged if it was changed.
+			 */
+			initStringInfo(&cols);
+			cmdupdncols = slonyDecodeAppendColumns(&cols, relation, newtuple,
+												   NULL, false);
+
+			OutputPluginPrepareWrite(ctx, true);
+			slonyDecodeAppendHeader(ctx->out, 'U', relation, cmdupdncols);
+			appendBinaryStringInfo(ctx->out, cols.data, cols.len);
+			slonyDecodeAppendColumns(ctx->out, relation,
+									 oldtuple != NULL ? oldtuple : newtuple,
+									 keyattrs, true);
+			appendStringInfoChar(ctx->out, '}');
+			OutputPluginWrite(ctx, true);
+			break;
+
+		case REORDER_BUFFER_CHANGE_DELETE:
+			/*
+			 * cmdtype = 'D' cmdargs = pkcolname, oldval [, ...]
+			 *
+			 * Without a replica identity the old key is missing and the
+			 * row goes out without key columns, which the drain rejects.
+			 */
+			OutputPluginPrepareWrite(ctx, true);
+			slonyDecodeAppendHeader(ctx->out, 'D', relation, 0);
+			if (oldtuple != NULL)
+				slonyDecodeAppendColumns(ctx->out, relation, oldtuple,
+										 keyattrs, true);
+			appendStringInfoChar(ctx->out, '}');
+			OutputPluginWrite(ctx, true);
+			break;
+
+		default:
+			break;
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextReset(data->context);
+}
+
+
+static void
+slonyDecodeTruncate(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+					int nrelations, Relation relations[],
+					ReorderBufferChange *change)
+{
+	SlonyDecodeData *data = ctx->output_plugin_private;
+	MemoryContext oldcontext;
+	int			i;
+
+	oldcontext = MemoryContextSwitchTo(data->context);
+
+	for (i = 0; i < nrelations; i++)
+	{
+		if (slonyDecodeSkip(ctx, txn, relations[i]))
+			continue;
+		slonyDecodeTrace(ctx, txn, relations[i]);
+
+		/*
+		 * cmdtype = 'T' cmdargs = (empty)
+		 */
+		OutputPluginPrepareWrite(ctx, true);
+		slonyDecodeAppendHeader(ctx->out, 'T', relations[i], 0);
+		appendStringInfoChar(ctx->out, '}');
+		OutputPluginWrite(ctx, true);
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextReset(data->context);
+}
+
+
+/*
+ * slonyDecodeSkip
+ *
+ *	Suppress changes to the cluster schema. The first sl_log_1/sl_log_2
+ *	write of a transaction is turned into the "L" marker row.
+ */
+static bool
+slonyDecodeSkip(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+				Relation relation)
+{
+	SlonyDecodeData *data = ctx->output_plugin_private;
+	char	   *nspname;
+	char	   *relname;
+
+	if (data->skip_namespace == NULL)
+		return false;
+
+	nspname = get_namespace_name(RelationGetNamespace(relation));
+	if (nspname == NULL || strcmp(nspname, data->skip_namespace) != 0)
+		return false;
+
+	relname = RelationGetRelationName(relation);
+	if (!TransactionIdEquals(data->logged_xid, txn->xid) &&
+		(strcmp(relname, "sl_log_1") == 0 || strcmp(relname, "sl_log_2") == 0))
+	{
+		OutputPluginPrepareWrite(ctx, true);
+		appendStringInfoChar(ctx->out, 'L');
+		OutputPluginWrite(ctx, true);
+		data->logged_xid = txn->xid;
+	}
+	return true;
+}
+
+
+/*
+ * slonyDecodeTrace
+ *
+ *	At the first change of a transaction, decide if it is traced and
+ *	emit the latency trace marker for it.
+ */
+static void
+slonyDecodeTrace(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+				 Relation relation)
+{
+	SlonyDecodeData *data = ctx->output_plugin_private;
+	TimestampTz commit_time;
+	char		epochbuf[64];
+
+	if (data->trace_interval <= 0 ||
+		TransactionIdEquals(data->traced_xid, txn->xid))
+		return;
+	data->traced_xid = txn->xid;
+	if ((random() % data->trace_interval) != 0)
+		return;
+
+	commit_time = SlonyCommitTime(txn);
+	snprintf(epochbuf, sizeof(epochbuf), "%ld.%06ld",
+			 (long) timestamptz_to_time_t(commit_time),
+			 (long) (commit_time % USECS_PER_SEC));
+
+	OutputPluginPrepareWrite(ctx, true);
+	slonyDecodeAppendHeader(ctx->out, 'M', relation, 0);
+	appendStringInfoChar(ctx->out, ',');
+	slonyDecodeAppendElem(ctx->out, "origin_time");
+	appendStringInfoChar(ctx->out, ',');
+	slonyDecodeAppendElem(ctx->out, epochbuf);
+	appendStringInfoChar(ctx->out, '}');
+	OutputPluginWrite(ctx, true);
+}
+
+
+/*
+ * slonyDecodeAppendElem
+ *
+ *	Append one element to a text array literal, NULL for a NULL value.
+ */
+static void
+slonyDecodeAppendElem(StringInfo out, const char *value)
+{
+	const char *cp;
+
+	if (value == NULL)
+	{
+		appendStringInfoString(out, "NULL");
+		return;
+	}
+
+	appendStringInfoChar(out, '"');
+	for (cp = value; *cp; cp++)
+	{
+		if (*cp == '"' || *cp == '\\')
+			appendStringInfoChar(out, '\\');
+		appendStringInfoChar(out, *cp);
+	}
+	appendStringInfoChar(out, '"');
+}
+
+
+static void
+slonyDecodeAppendHeader(StringInfo out, char cmdtype, Relation relation,
+						int cmdupdncols)
+{
+	char		buf[32];
+
+	appendStringInfoChar(out, '{');
+	buf[0] = cmdtype;
+	buf[1] = '\0';
+	slonyDecodeAppendElem(out, buf);
+	appendStringInfoChar(out, ',');
+	slonyDecodeAppendElem(out,
+					 get_namespace_name(RelationGetNamespace(relation)));
+	appendStringInfoChar(out, ',');
+	slonyDecodeAppendElem(out, RelationGetRelationName(relation));
+	appendStringInfoChar(out, ',');
+	snprintf(buf, sizeof(buf), "%d", cmdupdncols);
+	slonyDecodeAppendElem(out, buf);
+}
+
+
+/*
+ * slonyDecodeAppendColumns
+ *
+ *	Append ",colname,value" pairs for the columns of a tuple and return
+ *	their number. With keys_only, only the replica identity columns are
+ *	added. Unchanged TOASTed values are not in the WAL and left out.
+ */
+static int
+slonyDecodeAppendColumns(StringInfo out, Relation relation, HeapTuple tuple,
+						 Bitmapset *keyattrs, bool keys_only)
+{
+	TupleDesc	tupdesc = RelationGetDescr(relation);
+	int			ncols = 0;
+	int			i;
+
+	if (tuple == NULL)
+		return 0;
+
+	for (i = 0; i < tupdesc->natts; i++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+		Datum		value;
+		bool		isnull;
+		Oid			typoutput;
+		bool		typisvarlena;
+
+		if (isDropped(relation, i))
+			continue;
+		if (keys_only &&
+			!bms_is_member(attr->attnum - FirstLowInvalidHeapAttributeNumber,
+						   keyattrs))
+			continue;
+
+		value = heap_getattr(tuple, i + 1, tupdesc, &isnull);
+		if (!isnull && attr->attlen == -1 &&
+			VARATT_IS_EXTERNAL_ONDISK(DatumGetPointer(value)))
+			continue;
+
+		ncols++;
+		appendStringInfoChar(out, ',');
+		slonyDecodeAppendElem(out, NameStr(attr->attname));
+		appendStringInfoChar(out, ',');
+		if (isnull)
+		{
+			slonyDecodeAppendElem(out, NULL);
+			continue;
+		}
+		getTypeOutputInfo(attr->atttypid, &typoutput, &typisvarlena);
+		slonyDecodeAppendElem(out, OidOutputFunctionCall(typoutput, value));
+	}
+
+	return ncols;
+}
+#endif   /* PG_VERSION_MAJOR >= 11 */
+
+
+/*
+ * logicalCaptureFlush()
+ *
+ *	Flush the WAL up to the current insert position and return that
+ *	position as text. Logical decoding only reads flushed WAL, and commits
+ *	done with synchronous_commit = off may not be flushed yet.
+ */
+Datum
+versionFunc(logicalCaptureFlush) (PG_FUNCTION_ARGS)
+{
+#if PG_VERSION_MAJOR >= 11
+	XLogRecPtr	insert_lsn;
+
+	insert_lsn = GetXLogInsertRecPtr();
+	XLogFlush(insert_lsn);
+
+	PG_RETURN_TEXT_P(cstring_to_text(psprintf("%X/%X",
+											  (uint32) (insert_lsn >> 32),
+											  (uint32) insert_lsn)));
+#else
+	elog(ERROR, "Slony-I: logical capture requires PostgreSQL 11 or later");
+	PG_RETURN_NULL();
+#endif
+}
@@ -24,6 +24,7 @@
 #include "nodes/makefuncs.h"
 #include "parser/parse_type.h"
 #include "executor/spi.h"
+#include "funcapi.h"
 #include "commands/trigger.h"
 #include "commands/async.h"
 #include "catalog/pg_operator.h"
@@ -31,6 +32,15 @@
 #include "catalog/namespace.h"
 #if PG_VERSION_MAJOR >= 12
 #include "catalog/pg_collation_d.h"
+#include "catalog/index.h"
+#include "access/genam.h"
+#include "access/heapam.h"
+#include "access/table.h"
+#include "utils/acl.h"
+#endif
+#if PG_VERSION_MAJOR >= 14
+#include "commands/copy.h"
+#include "parser/parse_relation.h"
 #endif
 #include "access/xact.h"
 #include "access/transam.h"
@@ -59,6 +69,9 @@
 
 #include <signal.h>
 #include <errno.h>
+#ifndef WIN32
+#include <sys/time.h>
+#endif
 /*@+matchanyintegral@*/
 /*@-compmempass@*/
 /*@-immediatetrans@*/
@@ -74,6 +87,7 @@ PG_MODULE_MAGIC;
 #define versionFunc(funcName) versionFunc2(funcName,SLONY_I_FUNC_VERSION_STRING)
 
 PG_FUNCTION_INFO_V1(versionFunc(createEvent));
+PG_FUNCTION_INFO_V1(versionFunc(createEventNotify));
 PG_FUNCTION_INFO_V1(versionFunc(getLocalNodeId));
 PG_FUNCTION_INFO_V1(versionFunc(getModuleVersion));
 
@@ -82,6 +96,9 @@ PG_FUNCTION_INFO_V1(versionFunc(denyAccess));
 PG_FUNCTION_INFO_V1(versionFunc(logApply));
 PG_FUNCTION_INFO_V1(versionFunc(logApplySetCacheSize));
 PG_FUNCTION_INFO_V1(versionFunc(logApplySaveStats));
+PG_FUNCTION_INFO_V1(versionFunc(logApplySyncPerf));
+PG_FUNCTION_INFO_V1(versionFunc(logicalCaptureFlush));
+PG_FUNCTION_INFO_V1(versionFunc(logTriggerToastStats));
 PG_FUNCTION_INFO_V1(versionFunc(lockedSet));
 PG_FUNCTION_INFO_V1(versionFunc(killBackend));
 PG_FUNCTION_INFO_V1(versionFunc(seqtrack));
@@ -93,6 +110,7 @@ PG_FUNCTION_INFO_V1(versionFunc(slon_decode_tgargs));
 
 
 Datum		versionFunc(createEvent) (PG_FUNCTION_ARGS);
+Datum		versionFunc(createEventNotify) (PG_FUNCTION_ARGS);
 Datum		versionFunc(getLocalNodeId) (PG_FUNCTION_ARGS);
 Datum		versionFunc(getModuleVersion) (PG_FUNCTION_ARGS);
 
@@ -101,6 +119,9 @@ Datum		versionFunc(denyAccess) (PG_FUNCTION_ARGS);
 Datum		versionFunc(logApply) (PG_FUNCTION_ARGS);
 Datum		versionFunc(logApplySetCacheSize) (PG_FUNCTION_ARGS);
 Datum		versionFunc(logApplySaveStats) (PG_FUNCTION_ARGS);
+Datum		versionFunc(logApplySyncPerf) (PG_FUNCTION_ARGS);
+Datum		versionFunc(logicalCaptureFlush) (PG_FUNCTION_ARGS);
+Datum		versionFunc(logTriggerToastStats) (PG_FUNCTION_ARGS);
 Datum		versionFunc(lockedSet) (PG_FUNCTION_ARGS);
 Datum		versionFunc(killBackend) (PG_FUNCTION_ARGS);
 Datum		versionFunc(seqtrack) (PG_FUNCTION_ARGS);
@@ -118,6 +139,8 @@ extern DLLIMPORT Node *newNodeMacroHolder;
 #define PLAN_INSERT_EVENT	(1 << 1)
 #define PLAN_INSERT_LOG_STATUS (1 << 2)
 #define PLAN_APPLY_QUERIES	(1 << 3)
+#define PLAN_SYNC_PERF		(1 << 4)
+#define PLAN_LATENCY_SAMPLE	(1 << 5)
 
 /*
  * This OID definition is missing in 8.3, although the data type
@@ -156,13 +179,33 @@ typedef struct slony_I_cluster_status
 	void	   *plan_table_info;
 	void	   *plan_apply_stats_update;
 	void	   *plan_apply_stats_insert;
+	void	   *plan_sync_perf_insert;
+	void	   *plan_latency_sample;
+	void	   *plan_filter_key_check;
+
+	Oid			active_log_relid;
+	Oid			action_seq_relid;
+	Oid		   *log_index_oids;
+	IndexInfo **log_index_info;
+	int			log_index_n;
 
 	text	   *cmdtype_I;
 	text	   *cmdtype_U;
 	text	   *cmdtype_D;
+	text	   *cmdtype_M;
 	bool		event_txn;
+	bool		trace_xact;
+	bool		capture_logical;
 	bool		apply_init;
 	bool		log_init;
+
+	int32	   *locked_tabs;
+	int			locked_tabs_n;
+	int			locked_tabs_size;
+
+	int32	   *filtered_tabs;
+	int			filtered_tabs_n;
+	int			filtered_tabs_size;
 	
 	struct slony_I_cluster_status *next;
 }	Slony_I_ClusterStatus;
@@ -201,6 +244,12 @@ static HTAB *applyCacheHash = NULL;
 static ApplyCacheEntry *applyCacheHead = NULL;
 static ApplyCacheEntry *applyCacheTail = NULL;
 static int	applyCacheSize = 100;
+
+/*
+ * Set by createEventNotify(). If true, createEvent() sends a NOTIFY
+ * for every new event.
+ */
+static bool eventNotify = false;
 static int	applyCacheUsed = 0;
 
 static uint32 applyCache_hash(const void *kp, Size ksize);
@@ -222,6 +271,16 @@ static int64 apply_num_prepare;
 static int64 apply_num_hit;
 static int64 apply_num_evict;
 
+/*
+ * Unchanged varlena columns recognized by logTrigger() on UPDATE without
+ * detoasting: identical TOAST pointers and byte-identical compressed
+ * values. toast_num_detoast counts the comparisons that still had to
+ * detoast an out of line or compressed value.
+ */
+static int64 toast_num_pointer_equal;
+static int64 toast_num_raw_equal;
+static int64 toast_num_detoast;
+
 
 /*@null@*/
 static Slony_I_ClusterStatus *clusterStatusList = NULL;
@@ -229,11 +288,46 @@ static Slony_I_ClusterStatus *
 getClusterStatus(Name cluster_name,
 				 int need_plan_mask);
 static const char *slon_quote_identifier(const char *ident);
+static void loadTableIds(Datum dat, int32 **tabs, int *tabs_n,
+			 int *tabs_size);
+static bool hasTableId(int32 *tabs, int tabs_n, int32 tab_id);
 static int prepareLogPlan(Slony_I_ClusterStatus * cs,
 			   int log_status);
 
+static void logInsertRow(Slony_I_ClusterStatus * cs, Datum *log_param);
+#if PG_VERSION_MAJOR >= 12
+static void logInsertDirect(Slony_I_ClusterStatus * cs, Datum *log_param);
+
+/*
+ * slony1.direct_log_insert - form sl_log rows in logTrigger() and insert
+ * them with heap_insert() instead of going through SPI and the executor.
+ */
+static bool direct_log_insert = false;
+
+/*
+ * slony1.bulk_load_table - set by logBulkLoad() while it inserts the rows
+ * of a bulk load. The log trigger skips rows of this table, they are
+ * logged as COPY payload chunks instead.
+ */
+static int	bulk_load_tabid = 0;
+
+void		_PG_init(void);
+#endif
+
+#if PG_VERSION_MAJOR >= 14
+static const char *bulk_load_data = NULL;
+static int	bulk_load_len = 0;
+
+static int	bulkLoadRead(void *outbuf, int minread, int maxread);
+#else
+static uint64 bulkLoadInsert(const char *nspname, const char *relname,
+			   Datum *colnames, bool *colnamenulls, int ncols,
+			   const char *payload);
+#endif
+
 static bool isDropped(Relation rel,int att_num);
 static int  typeMod(Relation rel, int att_num);
+static int  typeLen(Relation rel, int att_num);
 
 
 #if PG_VERSION_MAJOR < 12
@@ -266,6 +360,7 @@ versionFunc(createEvent) (PG_FUNCTION_ARGS)
 	int			i;
 	int64		retval;
 	bool		isnull;
+	char		notify_channel[NAMEDATALEN];
 
 #ifdef HAVE_GETACTIVESNAPSHOT
 	if (GetActiveSnapshot() == NULL)
@@ -338,6 +433,23 @@ versionFunc(createEvent) (PG_FUNCTION_ARGS)
 	retval = DatumGetInt64(SPI_getbinval(SPI_tuptable->vals[0],
 										 SPI_tuptable->tupdesc, 1, &isnull));
 
+	/*
+	 * Wake up multiplexed remote listeners of other nodes. The clustername
+	 * already has the leading underscore of the "_<cluster>_Event" channel
+	 * they LISTEN on. The channel name is truncated the same way the parser
+	 * truncates their LISTEN argument.
+	 */
+	if (eventNotify)
+	{
+		snprintf(notify_channel, sizeof(notify_channel), "%s_Event",
+				 NameStr(cs->clustername));
+#if PG_VERSION_MAJOR >= 9
+		Async_Notify(notify_channel, "");
+#else
+		Async_Notify(notify_channel);
+#endif
+	}
+
 	/*
 	 * For SYNC and ENABLE_SUBSCRIPTION events, we also remember all current
 	 * sequence values.
@@ -418,14 +530,17 @@ versionFunc(logTrigger) (PG_FUNCTION_ARGS)
 	TransactionId newXid = GetTopTransactionId();
 	Slony_I_ClusterStatus *cs;
 	TriggerData *tg;
-	Datum		log_param[6];
+	Datum		log_param[5];
 	text	   *cmdtype = NULL;
 	int32		cmdupdncols = 0;
 	int			rc;
 	Name		cluster_name;
 	int32		tab_id;
+	int32		set_id;
 	char	   *attkind;
 	int			attkind_idx;
+	int			attkind_len;
+	bool		projected;
 
 	char	   *olddatestyle = NULL;
 	Datum	   *cmdargs = NULL;
@@ -455,8 +570,8 @@ versionFunc(logTrigger) (PG_FUNCTION_ARGS)
 		elog(ERROR, "Slony-I: logTrigger() must be fired AFTER");
 	if (!TRIGGER_FIRED_FOR_ROW(tg->tg_event))
 		elog(ERROR, "Slony-I: logTrigger() must be fired FOR EACH ROW");
-	if (tg->tg_trigger->tgnargs != 3)
-		elog(ERROR, "Slony-I: logTrigger() must be defined with 3 args");
+	if (tg->tg_trigger->tgnargs != 4)
+		elog(ERROR, "Slony-I: logTrigger() must be defined with 4 args");
 
 	/*
 	 * Connect to the SPI manager
@@ -471,6 +586,14 @@ versionFunc(logTrigger) (PG_FUNCTION_ARGS)
 								CStringGetDatum(tg->tg_trigger->tgargs[0])));
 	tab_id = strtol(tg->tg_trigger->tgargs[1], NULL, 10);
 	attkind = tg->tg_trigger->tgargs[2];
+	set_id = strtol(tg->tg_trigger->tgargs[3], NULL, 10);
+
+	/*
+	 * Columns marked 'i' in attkind are not replicated (SET ADD TABLE with
+	 * a column list). Columns past the end of attkind are values.
+	 */
+	attkind_len = strlen(attkind);
+	projected = (strchr(attkind, 'i') != NULL);
 
 	/*
 	 * Get or create the cluster status information and make sure it has the
@@ -502,18 +625,60 @@ versionFunc(logTrigger) (PG_FUNCTION_ARGS)
 	if (initRequired)
 	{
 		int32		log_status;
+		int32		trace_interval;
+		Datum		dat;
 		bool		isnull;
 
 		/*
-		 * Determine the currently active log table
+		 * Determine the currently active log table. This uses the latest
+		 * snapshot so that even a serializable transaction sees a set lock
+		 * committed after it started (see lockSet()).
 		 */
-		if (SPI_execp(cs->plan_get_logstatus, NULL, NULL, 0) < 0)
+		if (SPI_execute_snapshot(cs->plan_get_logstatus, NULL, NULL,
+								 GetLatestSnapshot(), InvalidSnapshot,
+								 false, false, 0) < 0)
 			elog(ERROR, "Slony-I: cannot determine log status");
 		if (SPI_processed != 1)
 			elog(ERROR, "Slony-I: cannot determine log status");
 
 		log_status = DatumGetInt32(SPI_getbinval(SPI_tuptable->vals[0],
 										 SPI_tuptable->tupdesc, 1, &isnull));
+
+		/*
+		 * Decide if this transaction gets a latency trace marker. The
+		 * sample interval is the registry value latency_trace_interval,
+		 * tracing about one in that many transactions.
+		 */
+		trace_interval = DatumGetInt32(SPI_getbinval(SPI_tuptable->vals[0],
+										 SPI_tuptable->tupdesc, 2, &isnull));
+		cs->trace_xact = (!isnull && trace_interval > 0 &&
+						  (random() % trace_interval) == 0);
+
+		/*
+		 * With logical capture active, the changes of this transaction are
+		 * picked up from the WAL by logicalCaptureDrain() instead.
+		 */
+		cs->capture_logical = DatumGetInt32(SPI_getbinval(SPI_tuptable->vals[0],
+										SPI_tuptable->tupdesc, 3, &isnull)) == 1;
+		if (isnull)
+			cs->capture_logical = false;
+
+		/*
+		 * Remember the tables of sets locked by lockSet() for MOVE SET,
+		 * and the tables with a row filter.
+		 */
+		cs->locked_tabs_n = 0;
+		dat = SPI_getbinval(SPI_tuptable->vals[0],
+							SPI_tuptable->tupdesc, 4, &isnull);
+		if (!isnull)
+			loadTableIds(dat, &(cs->locked_tabs), &(cs->locked_tabs_n),
+						 &(cs->locked_tabs_size));
+		cs->filtered_tabs_n = 0;
+		dat = SPI_getbinval(SPI_tuptable->vals[0],
+							SPI_tuptable->tupdesc, 5, &isnull);
+		if (!isnull)
+			loadTableIds(dat, &(cs->filtered_tabs), &(cs->filtered_tabs_n),
+						 &(cs->filtered_tabs_size));
 		SPI_freetuptable(SPI_tuptable);
 		prepareLogPlan(cs, log_status);
 		switch (log_status)
@@ -533,11 +698,142 @@ versionFunc(logTrigger) (PG_FUNCTION_ARGS)
 				break;
 		}
 
+#if PG_VERSION_MAJOR >= 12
+		/*
+		 * Look up the relations for the direct insert path. Without
+		 * INSERT permission we use SPI, which reports the error.
+		 */
+		cs->active_log_relid = InvalidOid;
+		cs->log_index_n = -1;
+		if (direct_log_insert)
+		{
+			Oid			nspoid = get_namespace_oid(NameStr(cs->clustername),
+												   false);
+
+			cs->active_log_relid = get_relname_relid(
+							   (log_status == 0 || log_status == 2) ?
+							   "sl_log_1" : "sl_log_2", nspoid);
+			cs->action_seq_relid = get_relname_relid("sl_action_seq", nspoid);
+			if (!OidIsValid(cs->action_seq_relid) ||
+				pg_class_aclcheck(cs->active_log_relid, GetUserId(),
+								  ACL_INSERT) != ACLCHECK_OK)
+				cs->active_log_relid = InvalidOid;
+		}
+#endif
+
 		cs->currentXid = newXid;
 		cs->event_txn = false;
 		cs->log_init = true;
 	}
 
+	/*
+	 * Reject the change if the set of this table is locked.
+	 */
+	if (hasTableId(cs->locked_tabs, cs->locked_tabs_n, tab_id))
+		elog(ERROR,
+			 "Slony-I: Table %s is currently locked against updates "
+			 "because of MOVE_SET operation in progress",
+			 NameStr(tg->tg_relation->rd_rel->relname));
+
+#if PG_VERSION_MAJOR >= 12
+	/*
+	 * Rows inserted by logBulkLoad() are logged by it in chunks. They are
+	 * only skipped here, after the locked set check, which needs the xid
+	 * the insert assigned and the latest snapshot.
+	 */
+	if (bulk_load_tabid != 0 && bulk_load_tabid == tab_id)
+	{
+		SPI_finish();
+		return PointerGetDatum(NULL);
+	}
+#endif
+
+	/*
+	 * Row filters select UPDATE log rows by the old key. An UPDATE that
+	 * changes the key of a filtered table must therefore not move the row
+	 * into or out of any filter, checkFilterKeyUpdate() rejects that. This
+	 * is checked before the logical capture exit, because the decoded
+	 * rows are filtered the same way.
+	 */
+	if (TRIGGER_FIRED_BY_UPDATE(tg->tg_event) &&
+		hasTableId(cs->filtered_tabs, cs->filtered_tabs_n, tab_id))
+	{
+		HeapTuple	old_row = tg->tg_trigtuple;
+		HeapTuple	new_row = tg->tg_newtuple;
+		TupleDesc	tupdesc = tg->tg_relation->rd_att;
+		Datum	   *oldargs;
+		Datum	   *newargs;
+		bool	   *oldnulls;
+		bool	   *newnulls;
+		int			nargs = 0;
+		bool		key_changed = false;
+		int			i;
+
+		/*
+		 * Collect the name/value pairs of the old and the new key.
+		 */
+		oldargs = (Datum *) palloc(sizeof(Datum) * tupdesc->natts * 2);
+		newargs = (Datum *) palloc(sizeof(Datum) * tupdesc->natts * 2);
+		oldnulls = (bool *) palloc(sizeof(bool) * tupdesc->natts * 2);
+		newnulls = (bool *) palloc(sizeof(bool) * tupdesc->natts * 2);
+		for (i = 0, attkind_idx = -1; i < tupdesc->natts; i++)
+		{
+			char	   *old_value;
+			char	   *new_value;
+
+			if (isDropped(tg->tg_relation, i))
+				continue;
+
+			attkind_idx++;
+			if (!attkind[attkind_idx])
+				break;
+			if (attkind[attkind_idx] != 'k')
+				continue;
+
+			old_value = SPI_getvalue(old_row, tupdesc, i + 1);
+			new_value = SPI_getvalue(new_row, tupdesc, i + 1);
+			if (old_value == NULL || new_value == NULL ||
+				strcmp(old_value, new_value) != 0)
+				key_changed = true;
+
+			oldargs[nargs] = newargs[nargs] = SlonDirectFunctionCall1(textin,
+								 CStringGetDatum(SPI_fname(tupdesc, i + 1)));
+			oldnulls[nargs] = newnulls[nargs] = false;
+			nargs++;
+			oldnulls[nargs] = (old_value == NULL);
+			if (old_value != NULL)
+				oldargs[nargs] = SlonDirectFunctionCall1(textin,
+												 CStringGetDatum(old_value));
+			newnulls[nargs] = (new_value == NULL);
+			if (new_value != NULL)
+				newargs[nargs] = SlonDirectFunctionCall1(textin,
+												 CStringGetDatum(new_value));
+			nargs++;
+		}
+
+		if (key_changed)
+		{
+			Datum		check_args[3];
+			int			dims[1];
+			int			lbs[1];
+
+			dims[0] = nargs;
+			lbs[0] = 1;
+			check_args[0] = Int32GetDatum(tab_id);
+			check_args[1] = PointerGetDatum(construct_md_array(oldargs,
+							  oldnulls, 1, dims, lbs, TEXTOID, -1, false, 'i'));
+			check_args[2] = PointerGetDatum(construct_md_array(newargs,
+							  newnulls, 1, dims, lbs, TEXTOID, -1, false, 'i'));
+			if (SPI_execp(cs->plan_filter_key_check, check_args, NULL, 0) < 0)
+				elog(ERROR, "Slony-I: SPI_execp() failed for checkFilterKeyUpdate()");
+		}
+	}
+
+	if (cs->capture_logical)
+	{
+		SPI_finish();
+		return PointerGetDatum(NULL);
+	}
 
 	/*
 	 * Save the current datestyle setting and switch to ISO (if not already)
@@ -588,9 +884,9 @@ versionFunc(logTrigger) (PG_FUNCTION_ARGS)
 								 ((tg->tg_relation->rd_att->natts * 2) + 2));
 
 		/*
-		 * Specify all the columns
+		 * Specify all the replicated columns
 		 */
-		for (i = 0; i < tg->tg_relation->rd_att->natts; i++)
+		for (i = 0, attkind_idx = -1; i < tg->tg_relation->rd_att->natts; i++)
 		{
 			/*
 			 * Skip dropped columns
@@ -598,6 +894,10 @@ versionFunc(logTrigger) (PG_FUNCTION_ARGS)
 			if (isDropped(tg->tg_relation,i))
 				continue;
 
+			attkind_idx++;
+			if (attkind_idx < attkind_len && attkind[attkind_idx] == 'i')
+				continue;
+
 			/*
 			 * Add the column name
 			 */
@@ -652,7 +952,7 @@ versionFunc(logTrigger) (PG_FUNCTION_ARGS)
 		/*
 		 * For all changed columns, add name+value pairs and count them.
 		 */
-		for (i = 0; i < tg->tg_relation->rd_att->natts; i++)
+		for (i = 0, attkind_idx = -1; i < tg->tg_relation->rd_att->natts; i++)
 		{
 			/*
 			 * Ignore dropped columns
@@ -660,6 +960,14 @@ versionFunc(logTrigger) (PG_FUNCTION_ARGS)
 			if (isDropped(tg->tg_relation,i))
 				continue;
 
+			/*
+			 * Columns that are not replicated are not even compared, so
+			 * their values are never detoasted.
+			 */
+			attkind_idx++;
+			if (attkind_idx < attkind_len && attkind[attkind_idx] == 'i')
+				continue;
+
 			old_value = SPI_getbinval(old_row, tupdesc, i + 1, &old_isnull);
 			new_value = SPI_getbinval(new_row, tupdesc, i + 1, &new_isnull);
 
@@ -678,6 +986,36 @@ versionFunc(logTrigger) (PG_FUNCTION_ARGS)
 				Oid			opr_oid;
 				FmgrInfo   *opr_finfo_p;
 
+				/*
+				 * A varlena that is byte for byte identical is unchanged.
+				 * This catches unchanged out of line values, whose TOAST
+				 * pointer the UPDATE copies, and compressed inline values
+				 * before anything gets detoasted.
+				 */
+				if (typeLen(tg->tg_relation, i) == -1)
+				{
+					char	   *old_ptr = DatumGetPointer(old_value);
+					char	   *new_ptr = DatumGetPointer(new_value);
+					bool		toasted;
+
+					if (VARSIZE_ANY(old_ptr) == VARSIZE_ANY(new_ptr) &&
+						memcmp(old_ptr, new_ptr, VARSIZE_ANY(old_ptr)) == 0)
+					{
+						if (VARATT_IS_EXTERNAL(old_ptr))
+							toast_num_pointer_equal++;
+						else if (VARATT_IS_COMPRESSED(old_ptr))
+							toast_num_raw_equal++;
+						continue;
+					}
+
+					toasted = (VARATT_IS_EXTENDED(old_ptr) &&
+							   !VARATT_IS_SHORT(old_ptr)) ||
+						(VARATT_IS_EXTENDED(new_ptr) &&
+						 !VARATT_IS_SHORT(new_ptr));
+					if (toasted)
+						toast_num_detoast++;
+				}
+
 				/*
 				 * Lookup the equal operators function call info using the
 				 * typecache if available
@@ -844,23 +1182,66 @@ versionFunc(logTrigger) (PG_FUNCTION_ARGS)
 	}
 
 	/*
-	 * Construct the parameter array and insert the log row.
+	 * An UPDATE of a table with a column list that changed none of the
+	 * replicated columns has nothing to log.
+	 */
+	if (projected && cmdtype == cs->cmdtype_U && cmdupdncols == 0)
+	{
+		SPI_finish();
+		return PointerGetDatum(NULL);
+	}
+
+	/*
+	 * Construct the parameter array and insert the log row. The row only
+	 * identifies the table by its id, subscribers look up the name in
+	 * sl_table.
 	 */
 	cmddims[0] = cmdargselem - cmdargs;
 	cmdlbs[0] = 1;
 
 	log_param[0] = Int32GetDatum(tab_id);
-	log_param[1] = SlonDirectFunctionCall1(textin,
-									   CStringGetDatum(get_namespace_name(
-									RelationGetNamespace(tg->tg_relation))));
-	log_param[2] = SlonDirectFunctionCall1(textin,
-				  CStringGetDatum(RelationGetRelationName(tg->tg_relation)));
-	log_param[3] = PointerGetDatum(cmdtype);
-	log_param[4] = Int32GetDatum(cmdupdncols);
-	log_param[5] = PointerGetDatum(construct_md_array(cmdargs, cmdnulls, 1,
+	log_param[1] = PointerGetDatum(cmdtype);
+	log_param[2] = Int32GetDatum(cmdupdncols);
+	log_param[3] = PointerGetDatum(construct_md_array(cmdargs, cmdnulls, 1,
 								  cmddims, cmdlbs, TEXTOID, -1, false, 'i'));
+	log_param[4] = Int32GetDatum(set_id);
 
-	SPI_execp(cs->plan_active_log, log_param, NULL, 0);
+	/*
+	 * If this transaction is traced, log the marker row ahead of its first
+	 * data row. It carries the origin wall clock time as epoch seconds, so
+	 * that it does not depend on DateStyle or time zone settings.
+	 */
+	if (cs->trace_xact)
+	{
+		Datum		marker_param[5];
+		Datum		marker_args[2];
+		int			marker_dims[1];
+		int			marker_lbs[1];
+		char		epochbuf[64];
+		struct timeval tv;
+
+		gettimeofday(&tv, NULL);
+		snprintf(epochbuf, sizeof(epochbuf), "%ld.%06ld",
+				 (long) tv.tv_sec, (long) tv.tv_usec);
+		marker_args[0] = SlonDirectFunctionCall1(textin,
+											 CStringGetDatum("origin_time"));
+		marker_args[1] = SlonDirectFunctionCall1(textin,
+												 CStringGetDatum(epochbuf));
+		marker_dims[0] = 2;
+		marker_lbs[0] = 1;
+
+		marker_param[0] = log_param[0];
+		marker_param[1] = PointerGetDatum(cs->cmdtype_M);
+		marker_param[2] = Int32GetDatum(0);
+		marker_param[3] = PointerGetDatum(construct_md_array(marker_args, NULL, 1,
+						  marker_dims, marker_lbs, TEXTOID, -1, false, 'i'));
+		marker_param[4] = log_param[4];
+
+		logInsertRow(cs, marker_param);
+		cs->trace_xact = false;
+	}
+
+	logInsertRow(cs, log_param);
 
 	SPI_finish();
 	return PointerGetDatum(NULL);
@@ -1371,6 +1752,161 @@ versionFunc(logApply) (PG_FUNCTION_ARGS)
 		return PointerGetDatum(NULL);
 	}
 
+	/*
+	 * Process a latency trace marker. Remember when it arrived here so that
+	 * logApplyLatency() can add it to the histogram at the end of the SYNC
+	 * group, and keep the row if we forward the table's set.
+	 */
+	if (cmdtype == 'M')
+	{
+		Datum		sample_args[4];
+		Datum		table_args[2];
+		bool		forward;
+
+		cs = getClusterStatus(cluster_name, PLAN_LATENCY_SAMPLE);
+
+		dat = SPI_getbinval(new_row, tupdesc,
+							SPI_fnumber(tupdesc, "log_cmdargs"), &isnull);
+		if (isnull)
+			elog(ERROR, "Slony-I: log_cmdargs is NULL");
+		deconstruct_array(DatumGetArrayTypeP(dat),
+						  TEXTOID, -1, false, 'i',
+						  &cmdargs, &cmdargsnulls, &cmdargsn);
+		if (cmdargsn < 2 || cmdargsnulls[1])
+			elog(ERROR, "Slony-I: latency trace marker without origin_time");
+
+		sample_args[0] = SPI_getbinval(new_row, tupdesc,
+								SPI_fnumber(tupdesc, "log_origin"), &isnull);
+		sample_args[1] = SPI_getbinval(new_row, tupdesc,
+							   SPI_fnumber(tupdesc, "log_tableid"), &isnull);
+		sample_args[2] = SPI_getbinval(new_row, tupdesc,
+								  SPI_fnumber(tupdesc, "log_txid"), &isnull);
+		sample_args[3] = cmdargs[1];
+		if (SPI_execp(cs->plan_latency_sample, sample_args, NULL, 0) < 0)
+			elog(ERROR, "Slony-I: SPI_execp() to insert latency sample failed");
+
+		table_args[0] = sample_args[1];
+		table_args[1] = Int32GetDatum(cs->localNodeId);
+		if (SPI_execp(cs->plan_table_info, table_args, NULL, 0) < 0)
+			elog(ERROR, "SPI_execp() failed for table forward lookup");
+		if (SPI_processed == 0)
+		{
+			/* table was dropped from replication, see below */
+			SPI_finish();
+			return PointerGetDatum(NULL);
+		}
+		if (SPI_processed != 1)
+			elog(ERROR, "forwarding lookup for table %d failed",
+				 DatumGetInt32(table_args[0]));
+		forward = DatumGetBool(
+				  SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc,
+				SPI_fnumber(SPI_tuptable->tupdesc, "sub_forward"), &isnull));
+
+		SPI_finish();
+		if (forward)
+			return PointerGetDatum(tg->tg_trigtuple);
+		else
+			return PointerGetDatum(NULL);
+	}
+
+	/*
+	 * Process a bulk load chunk written by logBulkLoad(). The log_cmdargs
+	 * are the column names followed by the rows in COPY text format, which
+	 * are loaded with COPY FROM. Before 14 COPY FROM cannot read from
+	 * memory, and the rows are inserted with one multi-row INSERT instead.
+	 */
+	if (cmdtype == 'B')
+	{
+		Datum		table_args[2];
+		bool		forward;
+		char	   *payload;
+		uint64		processed = 0;
+
+		dat = SPI_getbinval(new_row, tupdesc,
+							SPI_fnumber(tupdesc, "log_cmdargs"), &isnull);
+		if (isnull)
+			elog(ERROR, "Slony-I: log_cmdargs is NULL");
+		deconstruct_array(DatumGetArrayTypeP(dat),
+						  TEXTOID, -1, false, 'i',
+						  &cmdargs, &cmdargsnulls, &cmdargsn);
+		if (cmdargsn < 2 || cmdargsnulls[cmdargsn - 1])
+			elog(ERROR, "Slony-I: bulk load log row without data");
+
+		table_args[0] = SPI_getbinval(new_row, tupdesc,
+							   SPI_fnumber(tupdesc, "log_tableid"), &isnull);
+		table_args[1] = Int32GetDatum(cs->localNodeId);
+		if (SPI_execp(cs->plan_table_info, table_args, NULL, 0) < 0)
+			elog(ERROR, "SPI_execp() failed for table forward lookup");
+		if (SPI_processed == 0)
+		{
+			/* table was dropped from replication, see below */
+			SPI_finish();
+			return PointerGetDatum(NULL);
+		}
+		if (SPI_processed != 1)
+			elog(ERROR, "forwarding lookup for table %d failed",
+				 DatumGetInt32(table_args[0]));
+		forward = DatumGetBool(
+				  SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc,
+				SPI_fnumber(SPI_tuptable->tupdesc, "sub_forward"), &isnull));
+		nspname = SPI_getvalue(SPI_tuptable->vals[0], SPI_tuptable->tupdesc,
+				   SPI_fnumber(SPI_tuptable->tupdesc, "tab_nspname"));
+		relname = SPI_getvalue(SPI_tuptable->vals[0], SPI_tuptable->tupdesc,
+				   SPI_fnumber(SPI_tuptable->tupdesc, "tab_relname"));
+		payload = DatumGetCString(SlonDirectFunctionCall1(textout,
+														cmdargs[cmdargsn - 1]));
+
+#if PG_VERSION_MAJOR >= 14
+		{
+			ParseState *pstate;
+			CopyFromState cstate;
+			List	   *attnamelist = NIL;
+
+			target_rel = table_open(get_relname_relid(relname,
+									LookupExplicitNamespace(nspname, false)),
+									RowExclusiveLock);
+			for (i = 0; i < cmdargsn - 1; i++)
+			{
+				if (cmdargsnulls[i])
+					elog(ERROR, "Slony-I: column name in log_cmdargs is NULL");
+				attnamelist = lappend(attnamelist, makeString(
+							DatumGetCString(SlonDirectFunctionCall1(textout,
+																cmdargs[i]))));
+			}
+
+			/*
+			 * Set up the range table entry like DoCopy() does, CopyFrom()
+			 * builds its executor state from it.
+			 */
+			pstate = make_parsestate(NULL);
+			addRangeTableEntryForRelation(pstate, target_rel, RowExclusiveLock,
+										  NULL, false, false);
+
+			bulk_load_data = payload;
+			bulk_load_len = strlen(payload);
+			cstate = BeginCopyFrom(pstate, target_rel, NULL, NULL, false,
+								   bulkLoadRead, attnamelist, NIL);
+			processed = CopyFrom(cstate);
+			EndCopyFrom(cstate);
+			bulk_load_data = NULL;
+			bulk_load_len = 0;
+
+			free_parsestate(pstate);
+			table_close(target_rel, NoLock);
+		}
+#else
+		processed = bulkLoadInsert(nspname, relname, cmdargs, cmdargsnulls,
+								   cmdargsn - 1, payload);
+#endif
+		apply_num_insert += processed;
+
+		SPI_finish();
+		if (forward)
+			return PointerGetDatum(tg->tg_trigtuple);
+		else
+			return PointerGetDatum(NULL);
+	}
+
 	/*
 	 * Normal data log row. Get all the relevant data from the log row.
 	 */
@@ -1379,15 +1915,6 @@ versionFunc(logApply) (PG_FUNCTION_ARGS)
 	if (isnull)
 		elog(ERROR, "Slony-I: log_tableid is NULL");
 	tableid = DatumGetInt32(dat);
-	nspname = SPI_getvalue(new_row, tupdesc,
-						   SPI_fnumber(tupdesc, "log_tablenspname"));
-	if (nspname == NULL)
-		elog(ERROR, "Slony-I: log_tablenspname is NULL on INSERT/UPDATE/DELETE");
-
-	relname = SPI_getvalue(new_row, tupdesc,
-						   SPI_fnumber(tupdesc, "log_tablerelname"));
-	if (relname == NULL)
-		elog(ERROR, "Slony-I: log_tablerelname is NULL on INSERT/UPDATE/DELETE");
 
 	dat = SPI_getbinval(new_row, tupdesc,
 						SPI_fnumber(tupdesc, "log_cmdupdncols"), &isnull);
@@ -1510,6 +2037,43 @@ versionFunc(logApply) (PG_FUNCTION_ARGS)
 
 		/* elog(NOTICE, "cache entry for %s NOT found", cacheKey); */
 
+		/*
+		 * The log row only carries the table id. Look up the table name in
+		 * sl_table, together with whether this table belongs to a set that
+		 * we are a forwarder of.
+		 */
+		query_args[0] = Int32GetDatum(tableid);
+		query_args[1] = Int32GetDatum(cs->localNodeId);
+
+		if (SPI_execp(cs->plan_table_info, query_args, NULL, 0) < 0)
+			elog(ERROR, "SPI_execp() failed for table forward lookup");
+
+		/*
+		 * The providers select log rows by set only. Rows that were logged
+		 * before a SET DROP TABLE can therefore still arrive after this node
+		 * removed the table from sl_table. Skip them, like the old provider
+		 * query did by not selecting them, and forget the cache entry.
+		 */
+		if (SPI_processed == 0)
+		{
+			hash_search(applyCacheHash, &cacheKey, HASH_REMOVE, NULL);
+			oldContext = MemoryContextSwitchTo(applyCacheContext);
+			pfree(cacheKey);
+			MemoryContextSwitchTo(oldContext);
+			SPI_finish();
+			return PointerGetDatum(NULL);
+		}
+		if (SPI_processed != 1)
+			elog(ERROR, "forwarding lookup for table %d failed", tableid);
+
+		cacheEnt->forward = DatumGetBool(
+				  SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc,
+				SPI_fnumber(SPI_tuptable->tupdesc, "sub_forward"), &isnull));
+		nspname = SPI_getvalue(SPI_tuptable->vals[0], SPI_tuptable->tupdesc,
+				   SPI_fnumber(SPI_tuptable->tupdesc, "tab_nspname"));
+		relname = SPI_getvalue(SPI_tuptable->vals[0], SPI_tuptable->tupdesc,
+				   SPI_fnumber(SPI_tuptable->tupdesc, "tab_relname"));
+
 		/*
 		 * Allocate memory for the function call info to cast all datums from
 		 * TEXT to the required Datum type.
@@ -1911,25 +2475,6 @@ versionFunc(logApply) (PG_FUNCTION_ARGS)
 
 			applyCacheUsed--;
 		}
-
-		/*
-		 * We also need to determine if this table belongs to a set, that we
-		 * are a forwarder of.
-		 */
-		query_args[0] = SPI_getbinval(new_row, tupdesc,
-							   SPI_fnumber(tupdesc, "log_tableid"), &isnull);
-		query_args[1] = Int32GetDatum(cs->localNodeId);
-
-		if (SPI_execp(cs->plan_table_info, query_args, NULL, 0) < 0)
-			elog(ERROR, "SPI_execp() failed for table forward lookup");
-
-		if (SPI_processed != 1)
-			elog(ERROR, "forwarding lookup for table %d failed",
-				 DatumGetInt32(query_args[1]));
-
-		cacheEnt->forward = DatumGetBool(
-				  SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc,
-				SPI_fnumber(SPI_tuptable->tupdesc, "sub_forward"), &isnull));
 	}
 
 	/*
@@ -2029,6 +2574,198 @@ versionFunc(logApply) (PG_FUNCTION_ARGS)
 }
 
 
+#if PG_VERSION_MAJOR >= 14
+/*
+ * bulkLoadRead
+ *
+ *	COPY FROM data source callback for bulk load chunks in logApply().
+ */
+static int
+bulkLoadRead(void *outbuf, int minread, int maxread)
+{
+	int			len = Min(maxread, bulk_load_len);
+
+	memcpy(outbuf, bulk_load_data, len);
+	bulk_load_data += len;
+	bulk_load_len -= len;
+
+	return len;
+}
+#else
+/*
+ * Value of a hex digit as in COPY text format, or -1.
+ */
+static int
+hexval(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+/*
+ * bulkLoadInsert
+ *
+ *	Insert the rows of a bulk load chunk with a single multi-row INSERT,
+ *	the values given as literals so that they take the column types.
+ *	Returns the number of rows.
+ */
+static uint64
+bulkLoadInsert(const char *nspname, const char *relname,
+			   Datum *colnames, bool *colnamenulls, int ncols,
+			   const char *payload)
+{
+	StringInfoData query;
+	const char *cp = payload;
+	uint64		nrows = 0;
+	int			col;
+	int			val;
+	char		c;
+
+	initStringInfo(&query);
+	appendStringInfo(&query, "insert into %s.",
+					 slon_quote_identifier(nspname));
+	appendStringInfo(&query, "%s (", slon_quote_identifier(relname));
+	for (col = 0; col < ncols; col++)
+	{
+		if (colnamenulls[col])
+			elog(ERROR, "Slony-I: column name in log_cmdargs is NULL");
+		appendStringInfo(&query, "%s%s", (col > 0) ? ", " : "",
+						 slon_quote_identifier(DatumGetCString(
+						 SlonDirectFunctionCall1(textout, colnames[col]))));
+	}
+	appendStringInfoString(&query, ") values ");
+
+	while (*cp != '\0')
+	{
+		appendStringInfoString(&query, (nrows > 0) ? ", (" : "(");
+		for (col = 0;; col++)
+		{
+			if (col > 0)
+				appendStringInfoString(&query, ", ");
+			if (cp[0] == '\\' && cp[1] == 'N' &&
+				(cp[2] == '\t' || cp[2] == '\n' || cp[2] == '\0'))
+			{
+				appendStringInfoString(&query, "NULL");
+				cp += 2;
+			}
+			else
+			{
+				/*
+				 * Undo the COPY text escapes and write the value as an E''
+				 * literal, which does not depend on
+				 * standard_conforming_strings.
+				 */
+				appendStringInfoString(&query, "E'");
+				while (*cp != '\0' && *cp != '\t' && *cp != '\n')
+				{
+					c = *cp++;
+					if (c == '\\' && *cp != '\0')
+					{
+						c = *cp++;
+						switch (c)
+						{
+							case 'b':
+								c = '\b';
+								break;
+							case 'f':
+								c = '\f';
+								break;
+							case 'n':
+								c = '\n';
+								break;
+							case 'r':
+								c = '\r';
+								break;
+							case 't':
+								c = '\t';
+								break;
+							case 'v':
+								c = '\v';
+								break;
+							case '0':
+							case '1':
+							case '2':
+							case '3':
+							case '4':
+							case '5':
+							case '6':
+							case '7':
+								val = c - '0';
+								if (*cp >= '0' && *cp <= '7')
+								{
+									val = (val << 3) + (*cp++ - '0');
+									if (*cp >= '0' && *cp <= '7')
+										val = (val << 3) + (*cp++ - '0');
+								}
+								c = (char) val;
+								break;
+							case 'x':
+								if ((val = hexval(*cp)) >= 0)
+								{
+									cp++;
+									if (hexval(*cp) >= 0)
+										val = (val << 4) + hexval(*cp++);
+									c = (char) val;
+								}
+								break;
+							default:
+								break;
+						}
+					}
+					if (c == '\'' || c == '\\')
+						appendStringInfoChar(&query, c);
+					appendStringInfoChar(&query, c);
+				}
+				appendStringInfoChar(&query, '\'');
+			}
+
+			if (*cp != '\t')
+				break;
+			cp++;
+		}
+		if (col + 1 != ncols)
+			elog(ERROR, "Slony-I: bulk load row of table %s.%s has %d "
+				 "columns, expected %d",
+				 slon_quote_identifier(nspname),
+				 slon_quote_identifier(relname), col + 1, ncols);
+		appendStringInfoChar(&query, ')');
+		if (*cp == '\n')
+			cp++;
+		nrows++;
+	}
+
+	if (nrows > 0 && SPI_exec(query.data, 0) != SPI_OK_INSERT)
+		elog(ERROR, "Slony-I: bulk load INSERT into %s.%s failed",
+			 slon_quote_identifier(nspname), slon_quote_identifier(relname));
+	pfree(query.data);
+
+	return nrows;
+}
+#endif
+
+
+/*
+ * versionFunc(createEventNotify)()
+ *
+ *	Called by slon with remote_listen_multiplex on to have createEvent()
+ *	notify the listeners of other nodes in this session. Returns the
+ *	previous setting.
+ */
+Datum
+versionFunc(createEventNotify) (PG_FUNCTION_ARGS)
+{
+	bool		oldNotify = eventNotify;
+
+	eventNotify = PG_GETARG_BOOL(0);
+	PG_RETURN_BOOL(oldNotify);
+}
+
+
 /*
  * versionFunc(logApplySetCacheSize)()
  *
@@ -2144,6 +2881,66 @@ versionFunc(logApplySaveStats) (PG_FUNCTION_ARGS)
 }
 
 
+/*
+ * versionFunc(logApplySyncPerf)()
+ *
+ *	Record one row in sl_sync_perf for the SYNC group applied in the
+ *	current transaction. The apply counters are reset at the start of
+ *	every apply transaction, so this must be called before
+ *	logApplySaveStats() resets them.
+ */
+Datum
+versionFunc(logApplySyncPerf) (PG_FUNCTION_ARGS)
+{
+	Slony_I_ClusterStatus *cs;
+	Datum		params[18];
+	char	   *nulls = "                  ";
+	int			spi_rc;
+
+	if (!superuser())
+		elog(ERROR, "Slony-I: insufficient privilege logApplySyncPerf");
+
+	/*
+	 * Connect to the SPI manager
+	 */
+	if (SPI_connect() < 0)
+		elog(ERROR, "Slony-I: SPI_connect() failed in logApplySyncPerf()");
+
+	cs = getClusterStatus(PG_GETARG_NAME(0), PLAN_SYNC_PERF);
+
+	/*
+	 * origin, first and last seqno, number of SYNCs, rows and bytes
+	 * and the timings come from the remote worker, the operation and
+	 * cache counters from our own apply statistics.
+	 */
+	params[0] = Int32GetDatum(PG_GETARG_INT32(1));
+	params[1] = Int64GetDatum(PG_GETARG_INT64(2));
+	params[2] = Int64GetDatum(PG_GETARG_INT64(3));
+	params[3] = Int32GetDatum(PG_GETARG_INT32(4));
+	params[4] = Int64GetDatum(PG_GETARG_INT64(5));
+	params[5] = Int64GetDatum(PG_GETARG_INT64(6));
+	params[6] = Int64GetDatum(apply_num_insert);
+	params[7] = Int64GetDatum(apply_num_update);
+	params[8] = Int64GetDatum(apply_num_delete);
+	params[9] = Int64GetDatum(apply_num_truncate);
+	params[10] = Int64GetDatum(apply_num_script);
+	params[11] = PointerGetDatum(PG_GETARG_INTERVAL_P(7));
+	params[12] = PointerGetDatum(PG_GETARG_INTERVAL_P(8));
+	params[13] = PointerGetDatum(PG_GETARG_INTERVAL_P(9));
+	params[14] = PointerGetDatum(PG_GETARG_INTERVAL_P(10));
+	params[15] = Int64GetDatum(apply_num_prepare);
+	params[16] = Int64GetDatum(apply_num_hit);
+	params[17] = Int64GetDatum(apply_num_evict);
+
+	if ((spi_rc = SPI_execp(cs->plan_sync_perf_insert, params, nulls, 0)) < 0)
+		elog(ERROR, "Slony-I: SPI_execp() to insert sync perf failed"
+			 " - rc=%d", spi_rc);
+
+	SPI_finish();
+	PG_RETURN_INT32(1);
+}
+
+
 static uint32
 applyCache_hash(const void *kp, Size ksize)
 {
@@ -2455,7 +3252,7 @@ getClusterStatus(Name cluster_name, int need_plan_mask)
 	int			rc;
 	char		query[1024];
 	bool		isnull;
-	Oid			plan_types[16];
+	Oid			plan_types[18];
 	TypeName   *txid_snapshot_typname;
 
 	/*
@@ -2616,16 +3413,45 @@ getClusterStatus(Name cluster_name, int need_plan_mask)
 		cs->cmdtype_D = malloc(VARHDRSZ + 1);
 		SET_VARSIZE(cs->cmdtype_D, VARHDRSZ + 1);
 		*VARDATA(cs->cmdtype_D) = 'D';
+		cs->cmdtype_M = malloc(VARHDRSZ + 1);
+		SET_VARSIZE(cs->cmdtype_M, VARHDRSZ + 1);
+		*VARDATA(cs->cmdtype_M) = 'M';
 
 		/*
-		 * And the plan to read the current log_status.
+		 * And the plan to read the current log_status together with the
+		 * latency trace sample interval, the logical capture flag and the
+		 * tables of locked sets. An ARRAY() subquery rather than array_agg()
+		 * keeps this working on 8.3.
 		 */
-		sprintf(query, "SELECT last_value::int4 FROM %s.sl_log_status",
-				cs->clusterident);
+		sprintf(query, "SELECT last_value::int4, "
+				"(SELECT reg_int4 FROM %s.sl_registry "
+				" WHERE reg_key = 'latency_trace_interval'), "
+				"(SELECT reg_int4 FROM %s.sl_registry "
+				" WHERE reg_key = 'logical_capture'), "
+				"ARRAY(SELECT T.tab_id "
+				" FROM %s.sl_table T, %s.sl_set S "
+				" WHERE T.tab_set = S.set_id AND S.set_locked IS NOT NULL), "
+				"ARRAY(SELECT DISTINCT tf_tab_id FROM %s.sl_table_filter) "
+				"FROM %s.sl_log_status",
+				cs->clusterident, cs->clusterident, cs->clusterident,
+				cs->clusterident, cs->clusterident, cs->clusterident);
 		cs->plan_get_logstatus = SPI_saveplan(SPI_prepare(query, 0, NULL));
 		if (cs->plan_get_logstatus == NULL)
 			elog(ERROR, "Slony-I: SPI_prepare() failed");
 
+		/*
+		 * The plan to check a key changing UPDATE of a filtered table.
+		 */
+		sprintf(query, "SELECT %s.checkFilterKeyUpdate($1, $2, $3)",
+				cs->clusterident);
+		plan_types[0] = INT4OID;
+		plan_types[1] = TEXTARRAYOID;
+		plan_types[2] = TEXTARRAYOID;
+		cs->plan_filter_key_check = SPI_saveplan(SPI_prepare(query, 3,
+															 plan_types));
+		if (cs->plan_filter_key_check == NULL)
+			elog(ERROR, "Slony-I: SPI_prepare() failed");
+
 		cs->have_plan |= PLAN_INSERT_LOG_STATUS;
 	}
 
@@ -2659,7 +3485,7 @@ getClusterStatus(Name cluster_name, int need_plan_mask)
 		 * The plan to lookup table forwarding info
 		 */
 		sprintf(query,
-				"select sub_forward from "
+				"select sub_forward, tab_nspname, tab_relname from "
 				" %s.sl_subscribe, %s.sl_table "
 				" where tab_id = $1 and tab_set = sub_set "
 				" and sub_receiver = $2;",
@@ -2750,10 +3576,126 @@ getClusterStatus(Name cluster_name, int need_plan_mask)
 		cs->have_plan |= PLAN_APPLY_QUERIES;
 	}
 
+	/*
+	 * Prepare and save the PLAN_SYNC_PERF
+	 */
+	if ((need_plan_mask & PLAN_SYNC_PERF) != 0 &&
+		(cs->have_plan & PLAN_SYNC_PERF) == 0)
+	{
+		sprintf(query,
+				"insert into %s.sl_sync_perf ("
+				" sp_origin, sp_seqno_first, sp_seqno_last, sp_num_syncs, "
+				" sp_num_rows, sp_num_bytes, sp_num_insert, sp_num_update, "
+				" sp_num_delete, sp_num_truncate, sp_num_script, "
+				" sp_duration, sp_provider_time, sp_subscriber_time, "
+				" sp_first_row_delay, sp_cache_prepare, sp_cache_hit, "
+				" sp_cache_evict, sp_apply_time) "
+				"values "
+				"($1, $2, $3, $4, $5, $6, $7, $8, $9, $10, $11, $12, $13, "
+				"$14, $15, $16, $17, $18, "
+				"\"pg_catalog\".timeofday()::timestamptz);",
+				slon_quote_identifier(NameStr(*cluster_name)));
+
+		plan_types[0] = INT4OID;
+		plan_types[1] = INT8OID;
+		plan_types[2] = INT8OID;
+		plan_types[3] = INT4OID;
+		plan_types[4] = INT8OID;
+		plan_types[5] = INT8OID;
+		plan_types[6] = INT8OID;
+		plan_types[7] = INT8OID;
+		plan_types[8] = INT8OID;
+		plan_types[9] = INT8OID;
+		plan_types[10] = INT8OID;
+		plan_types[11] = INTERVALOID;
+		plan_types[12] = INTERVALOID;
+		plan_types[13] = INTERVALOID;
+		plan_types[14] = INTERVALOID;
+		plan_types[15] = INT8OID;
+		plan_types[16] = INT8OID;
+		plan_types[17] = INT8OID;
+
+		cs->plan_sync_perf_insert = SPI_saveplan(
+										 SPI_prepare(query, 18, plan_types));
+		if (cs->plan_sync_perf_insert == NULL)
+			elog(ERROR, "Slony-I: SPI_prepare() failed");
+
+		cs->have_plan |= PLAN_SYNC_PERF;
+	}
+
+	/*
+	 * Prepare and save the PLAN_LATENCY_SAMPLE
+	 */
+	if ((need_plan_mask & PLAN_LATENCY_SAMPLE) != 0 &&
+		(cs->have_plan & PLAN_LATENCY_SAMPLE) == 0)
+	{
+		sprintf(query,
+				"insert into %s.sl_latency_sample ("
+				" ls_origin, ls_tableid, ls_txid, ls_origin_time, "
+				" ls_apply_time) "
+				"values ($1, $2, $3, "
+				"\"pg_catalog\".to_timestamp($4::float8), "
+				"\"pg_catalog\".clock_timestamp());",
+				slon_quote_identifier(NameStr(*cluster_name)));
+
+		plan_types[0] = INT4OID;
+		plan_types[1] = INT4OID;
+		plan_types[2] = INT8OID;
+		plan_types[3] = TEXTOID;
+
+		cs->plan_latency_sample = SPI_saveplan(
+										   SPI_prepare(query, 4, plan_types));
+		if (cs->plan_latency_sample == NULL)
+			elog(ERROR, "Slony-I: SPI_prepare() failed");
+
+		cs->have_plan |= PLAN_LATENCY_SAMPLE;
+	}
+
 	return cs;
 	/* @+nullderef@ */
 }
 
+/*
+ * loadTableIds
+ *
+ *	Copy an int4[] of table ids into a realloc'ed array of the cluster
+ *	status, which outlives the transaction.
+ */
+static void
+loadTableIds(Datum dat, int32 **tabs, int *tabs_n, int *tabs_size)
+{
+	Datum	   *tabids;
+	int			ntabids;
+	int			i;
+
+	deconstruct_array(DatumGetArrayTypeP(dat),
+					  INT4OID, sizeof(int32), true, 'i',
+					  &tabids, NULL, &ntabids);
+	if (ntabids > *tabs_size)
+	{
+		*tabs = realloc(*tabs, sizeof(int32) * ntabids);
+		if (*tabs == NULL)
+			elog(ERROR, "Slony-I: out of memory");
+		*tabs_size = ntabids;
+	}
+	for (i = 0; i < ntabids; i++)
+		(*tabs)[i] = DatumGetInt32(tabids[i]);
+	*tabs_n = ntabids;
+}
+
+static bool
+hasTableId(int32 *tabs, int tabs_n, int32 tab_id)
+{
+	int			i;
+
+	for (i = 0; i < tabs_n; i++)
+	{
+		if (tabs[i] == tab_id)
+			return true;
+	}
+	return false;
+}
+
 /**
  * prepare the plan for the curren sl_log_x insert query.
  *
@@ -2775,19 +3717,17 @@ prepareLogPlan(Slony_I_ClusterStatus * cs,
 		 */
 		sprintf(query, "INSERT INTO %s.sl_log_1 "
 				"(log_origin, log_txid, log_tableid, log_actionseq,"
-				" log_tablenspname, log_tablerelname, "
-				" log_cmdtype, log_cmdupdncols, log_cmdargs) "
+				" log_cmdtype, log_cmdupdncols, log_cmdargs, log_setid) "
 				"VALUES (%d, \"pg_catalog\".txid_current(), $1, "
-				"nextval('%s.sl_action_seq'), $2, $3, $4, $5, $6); ",
+				"nextval('%s.sl_action_seq'), $2, $3, $4, $5); ",
 				cs->clusterident, cs->localNodeId, cs->clusterident);
 		plan_types[0] = INT4OID;
 		plan_types[1] = TEXTOID;
-		plan_types[2] = TEXTOID;
-		plan_types[3] = TEXTOID;
+		plan_types[2] = INT4OID;
+		plan_types[3] = TEXTARRAYOID;
 		plan_types[4] = INT4OID;
-		plan_types[5] = TEXTARRAYOID;
 
-		cs->plan_insert_log_1 = SPI_saveplan(SPI_prepare(query, 6, plan_types));
+		cs->plan_insert_log_1 = SPI_saveplan(SPI_prepare(query, 5, plan_types));
 		if (cs->plan_insert_log_1 == NULL)
 			elog(ERROR, "Slony-I: SPI_prepare() failed");
 	}
@@ -2797,19 +3737,17 @@ prepareLogPlan(Slony_I_ClusterStatus * cs,
 	{
 		sprintf(query, "INSERT INTO %s.sl_log_2 "
 				"(log_origin, log_txid, log_tableid, log_actionseq,"
-				" log_tablenspname, log_tablerelname, "
-				" log_cmdtype, log_cmdupdncols, log_cmdargs) "
+				" log_cmdtype, log_cmdupdncols, log_cmdargs, log_setid) "
 				"VALUES (%d, \"pg_catalog\".txid_current(), $1, "
-				"nextval('%s.sl_action_seq'), $2, $3, $4, $5, $6); ",
+				"nextval('%s.sl_action_seq'), $2, $3, $4, $5); ",
 				cs->clusterident, cs->localNodeId, cs->clusterident);
 		plan_types[0] = INT4OID;
 		plan_types[1] = TEXTOID;
-		plan_types[2] = TEXTOID;
-		plan_types[3] = TEXTOID;
+		plan_types[2] = INT4OID;
+		plan_types[3] = TEXTARRAYOID;
 		plan_types[4] = INT4OID;
-		plan_types[5] = TEXTARRAYOID;
 
-		cs->plan_insert_log_2 = SPI_saveplan(SPI_prepare(query, 6, plan_types));
+		cs->plan_insert_log_2 = SPI_saveplan(SPI_prepare(query, 5, plan_types));
 		if (cs->plan_insert_log_2 == NULL)
 			elog(ERROR, "Slony-I: SPI_prepare() failed");
 	}
@@ -2817,6 +3755,201 @@ prepareLogPlan(Slony_I_ClusterStatus * cs,
 	return 0;
 }
 
+/*
+ * logTriggerToastStats()
+ *
+ *	Return the counters of unchanged varlena columns that logTrigger()
+ *	recognized in this session without detoasting them, and of the
+ *	comparisons that had to detoast.
+ */
+Datum
+versionFunc(logTriggerToastStats) (PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Datum		values[3];
+	bool		nulls[3];
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "Slony-I: logTriggerToastStats() must return a record");
+	tupdesc = BlessTupleDesc(tupdesc);
+
+	values[0] = Int64GetDatum(toast_num_pointer_equal);
+	values[1] = Int64GetDatum(toast_num_raw_equal);
+	values[2] = Int64GetDatum(toast_num_detoast);
+	memset(nulls, 0, sizeof(nulls));
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc,
+													  values, nulls)));
+}
+
+
+/*
+ * logInsertRow
+ *
+ *	Insert one row into the active log table. log_param holds the
+ *	parameters of the plan_active_log plan.
+ */
+static void
+logInsertRow(Slony_I_ClusterStatus * cs, Datum *log_param)
+{
+#if PG_VERSION_MAJOR >= 12
+	if (OidIsValid(cs->active_log_relid))
+	{
+		logInsertDirect(cs, log_param);
+		return;
+	}
+#endif
+	SPI_execp(cs->plan_active_log, log_param, NULL, 0);
+}
+
+#if PG_VERSION_MAJOR >= 12
+/*
+ * logInsertDirect
+ *
+ *	The slony1.direct_log_insert version of logInsertRow(). Forms the
+ *	sl_log tuple with the same values the INSERT of prepareLogPlan()
+ *	computes and inserts it together with its index entries.
+ */
+static void
+logInsertDirect(Slony_I_ClusterStatus * cs, Datum *log_param)
+{
+	Relation	rel;
+	TupleDesc	tupdesc;
+	HeapTuple	tuple;
+	Datum		values[10];
+	bool		nulls[10];
+	int			n;
+
+	rel = table_open(cs->active_log_relid, RowExclusiveLock);
+	tupdesc = RelationGetDescr(rel);
+	if (tupdesc->natts != 10)
+		elog(ERROR, "Slony-I: unexpected column count in %s",
+			 RelationGetRelationName(rel));
+
+	/*
+	 * Look up the indexes of the log table once per transaction. The
+	 * IndexInfo lives in TopTransactionContext.
+	 */
+	if (cs->log_index_n < 0)
+	{
+		MemoryContext oldcontext;
+		List	   *indexoidlist;
+		ListCell   *lc;
+
+		oldcontext = MemoryContextSwitchTo(TopTransactionContext);
+		indexoidlist = RelationGetIndexList(rel);
+		cs->log_index_oids = palloc(sizeof(Oid) *
+									(list_length(indexoidlist) + 1));
+		cs->log_index_info = palloc(sizeof(IndexInfo *) *
+									(list_length(indexoidlist) + 1));
+		n = 0;
+		foreach(lc, indexoidlist)
+		{
+			Relation	index;
+			IndexInfo  *indexInfo;
+
+			index = index_open(lfirst_oid(lc), RowExclusiveLock);
+			indexInfo = BuildIndexInfo(index);
+			if (indexInfo->ii_Expressions != NIL ||
+				indexInfo->ii_Predicate != NIL)
+				elog(ERROR, "Slony-I: expression or partial index %s on %s "
+					 "not supported with slony1.direct_log_insert",
+					 RelationGetRelationName(index),
+					 RelationGetRelationName(rel));
+			index_close(index, NoLock);
+			cs->log_index_oids[n] = lfirst_oid(lc);
+			cs->log_index_info[n] = indexInfo;
+			n++;
+		}
+		list_free(indexoidlist);
+		MemoryContextSwitchTo(oldcontext);
+		cs->log_index_n = n;
+	}
+
+	values[0] = Int32GetDatum(cs->localNodeId);
+	values[1] = Int64GetDatum((int64)
+						U64FromFullTransactionId(GetTopFullTransactionId()));
+	values[2] = log_param[0];
+	values[3] = DirectFunctionCall1(nextval_oid,
+									ObjectIdGetDatum(cs->action_seq_relid));
+	values[4] = (Datum) 0;
+	values[5] = (Datum) 0;
+	values[6] = CharGetDatum(*VARDATA(DatumGetPointer(log_param[1])));
+	values[7] = log_param[2];
+	values[8] = log_param[3];
+	values[9] = log_param[4];
+	memset(nulls, 0, sizeof(nulls));
+	nulls[4] = true;
+	nulls[5] = true;
+
+	tuple = heap_form_tuple(tupdesc, values, nulls);
+	simple_heap_insert(rel, tuple);
+
+	/*
+	 * The sl_log indexes are plain column indexes, so the index values
+	 * are taken straight from the heap values.
+	 */
+	for (n = 0; n < cs->log_index_n; n++)
+	{
+		Relation	index;
+		IndexInfo  *indexInfo = cs->log_index_info[n];
+		Datum		ivalues[INDEX_MAX_KEYS];
+		bool		inulls[INDEX_MAX_KEYS];
+		int			i;
+
+		index = index_open(cs->log_index_oids[n], RowExclusiveLock);
+		for (i = 0; i < indexInfo->ii_NumIndexAttrs; i++)
+		{
+			int			attno = indexInfo->ii_IndexAttrNumbers[i];
+
+			ivalues[i] = values[attno - 1];
+			inulls[i] = nulls[attno - 1];
+		}
+		index_insert(index, ivalues, inulls, &(tuple->t_self), rel,
+					 index->rd_index->indisunique ?
+					 UNIQUE_CHECK_YES : UNIQUE_CHECK_NO,
+#if PG_VERSION_MAJOR >= 14
+					 false,
+#endif
+					 indexInfo);
+		index_close(index, RowExclusiveLock);
+	}
+
+	heap_freetuple(tuple);
+	table_close(rel, RowExclusiveLock);
+}
+
+
+void
+_PG_init(void)
+{
+	DefineCustomBoolVariable("slony1.direct_log_insert",
+							 "Insert sl_log rows without SPI.",
+							 "Lets the log trigger insert its rows with "
+							 "heap_insert() instead of an SPI plan.",
+							 &direct_log_insert,
+							 false,
+							 PGC_SUSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+	DefineCustomIntVariable("slony1.bulk_load_table",
+							"Table ID of the running logBulkLoad().",
+							"Set by logBulkLoad() only. The log trigger "
+							"does not log rows of this table.",
+							&bulk_load_tabid,
+							0,
+							0,
+							INT_MAX,
+							PGC_SUSET,
+							GUC_NOT_IN_SAMPLE,
+							NULL,
+							NULL,
+							NULL);
+}
+#endif
+
 /* Provide a way to reset the per-session data structure that stores
    the cluster status in the C functions.
 
@@ -2840,6 +3973,8 @@ versionFunc(resetSession) (PG_FUNCTION_ARGS)
 			free(cs->cmdtype_D);
 		if (cs->cmdtype_U)
 			free(cs->cmdtype_D);
+		if (cs->cmdtype_M)
+			free(cs->cmdtype_M);
 		free(cs->clusterident);
 		if (cs->plan_insert_event)
 			SPI_freeplan(cs->plan_insert_event);
@@ -2851,6 +3986,12 @@ versionFunc(resetSession) (PG_FUNCTION_ARGS)
 			SPI_freeplan(cs->plan_record_sequences);
 		if (cs->plan_get_logstatus)
 			SPI_freeplan(cs->plan_get_logstatus);
+		if (cs->plan_filter_key_check)
+			SPI_freeplan(cs->plan_filter_key_check);
+		if (cs->locked_tabs)
+			free(cs->locked_tabs);
+		if (cs->filtered_tabs)
+			free(cs->filtered_tabs);
 		previous = cs;
 		cs = cs->next;
 		free(previous);
@@ -2944,6 +4085,26 @@ int typeMod(Relation rel, int att_num)
 #endif
 	
 }
+
+
+int typeLen(Relation rel, int att_num)
+{
+#if PG_VERSION_MAJOR >= 11
+	Form_pg_attribute attr = TupleDescAttr(rel->rd_att,
+										   att_num);
+	return attr->attlen;
+
+#else
+	TupleDesc tupdesc = rel->rd_att;
+	return tupdesc->attrs[att_num]->attlen;
+#endif
+}
+
+/*
+ * The logical decoding output plugin of the logical capture mode
+ */
+#include "slony1_decode.c"
+
 /*
  * Local Variables:
  *	tab-width: 4
@@ -184,6 +184,24 @@ create or replace function @NAMESPACE@.resetSession() returns text
 	   as '$libdir/slony1_funcs.@MODULEVERSION@','_Slony_I_@FUNCVERSION@_resetSession'
 	   language C;
 
+-- ----------------------------------------------------------------------
+-- FUNCTION createEventNotify (on)
+--
+--	Make createEvent() send a NOTIFY for every event created in this
+--	session, for multiplexed remote listeners.
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.createEventNotify (p_on boolean)
+returns boolean
+    as '$libdir/slony1_funcs.@MODULEVERSION@', '_Slony_I_@FUNCVERSION@_createEventNotify'
+	language C strict;
+
+comment on function @NAMESPACE@.createEventNotify (p_on boolean) is
+'createEventNotify (on)
+
+If on is true, createEvent() sends a NOTIFY on "_<cluster>_Event" for
+every event created in this session afterwards.  Called by slon with
+remote_listen_multiplex enabled.  Returns the previous setting.';
+
 -- ----------------------------------------------------------------------
 -- FUNCTION logApply ()
 --
@@ -217,6 +235,33 @@ returns int4
     as '$libdir/slony1_funcs.@MODULEVERSION@', '_Slony_I_@FUNCVERSION@_logApplySaveStats'
 	language C;
 
+-- ----------------------------------------------------------------------
+-- FUNCTION logApplySyncPerf ()
+--
+--	A function used by the remote worker to record one row per applied
+--	SYNC group in sl_sync_perf. Must be called before logApplySaveStats().
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.logApplySyncPerf (p_cluster name, p_origin int4, p_seqno_first int8, p_seqno_last int8, p_num_syncs int4, p_num_rows int8, p_num_bytes int8, p_duration interval, p_provider_time interval, p_subscriber_time interval, p_first_row_delay interval) 
+returns int4
+    as '$libdir/slony1_funcs.@MODULEVERSION@', '_Slony_I_@FUNCVERSION@_logApplySyncPerf'
+	language C;
+
+-- ----------------------------------------------------------------------
+-- FUNCTION logTriggerToastStats ()
+--
+--	Per session counters of unchanged varlena columns that the log
+--	trigger recognized on UPDATE without detoasting them.
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.logTriggerToastStats (out pointer_equal int8, out raw_equal int8, out detoasted int8) 
+returns record
+    as '$libdir/slony1_funcs.@MODULEVERSION@', '_Slony_I_@FUNCVERSION@_logTriggerToastStats'
+	language C;
+comment on function @NAMESPACE@.logTriggerToastStats () is
+'Returns, for the current session, the number of UPDATE column comparisons
+in the log trigger that found identical TOAST pointers (pointer_equal) or
+byte-identical compressed values (raw_equal) without detoasting, and the
+number that had to detoast an out of line or compressed value (detoasted).';
+
 
 create or replace function @NAMESPACE@.checkmoduleversion () returns text as $$
 declare
@@ -1098,6 +1143,8 @@ begin
 	if p_no_id <> @NAMESPACE@.getLocalNodeId('_@CLUSTERNAME@') then
 		delete from @NAMESPACE@.sl_subscribe
 				where sub_receiver = p_no_id;
+		delete from @NAMESPACE@.sl_table_filter
+				where tf_receiver = p_no_id;
 		delete from @NAMESPACE@.sl_listen
 				where li_origin = p_no_id
 					or li_provider = p_no_id
@@ -1404,7 +1451,6 @@ create or replace function @NAMESPACE@.failoverSet_int (p_failed_node int4, p_ba
 returns int4
 as $$
 declare
-	v_row				record;
 	v_last_sync			int8;
 	v_set				int4;
 begin
@@ -1456,12 +1502,7 @@ begin
 					   and sub_receiver=receive_node.no_id
 					   and receive_node.no_failed=false;			
 
-			for v_row in select * from @NAMESPACE@.sl_table
-				where tab_set = v_set
-				order by tab_id
-			loop
-				perform @NAMESPACE@.alterTableConfigureTriggers(v_row.tab_id);
-			end loop;
+			perform @NAMESPACE@.alterSetConfigureTriggers(v_set);
 	else
 		raise notice 'deleting from sl_subscribe all rows with receiver %',
 		p_backup_node;
@@ -2125,8 +2166,8 @@ origin node, and human readable comment.';
 -- ----------------------------------------------------------------------
 -- FUNCTION lockSet (set_id)
 --
---	Add a special trigger to all tables of a set that disables
---	access to it.
+--	Mark a set as locked. The log trigger rejects changes to the
+--	tables of a locked set.
 -- ----------------------------------------------------------------------
 create or replace function @NAMESPACE@.lockSet (p_set_id int4)
 returns int4
@@ -2134,7 +2175,6 @@ as $$
 declare
 	v_local_node_id		int4;
 	v_set_row			record;
-	v_tab_row			record;
 begin
 	-- ----
 	-- Grab the central configuration lock
@@ -2161,26 +2201,11 @@ begin
 	end if;
 
 	-- ----
-	-- Place the lockedSet trigger on all tables in the set.
-	-- ----
-	for v_tab_row in select T.tab_id,
-			@NAMESPACE@.slon_quote_brute(PGN.nspname) || '.' ||
-			@NAMESPACE@.slon_quote_brute(PGC.relname) as tab_fqname
-			from @NAMESPACE@.sl_table T,
-				"pg_catalog".pg_class PGC, "pg_catalog".pg_namespace PGN
-			where T.tab_set = p_set_id
-				and T.tab_reloid = PGC.oid
-				and PGC.relnamespace = PGN.oid
-			order by tab_id
-	loop
-		execute 'create trigger "_@CLUSTERNAME@_lockedset" ' || 
-				'before insert or update or delete on ' ||
-				v_tab_row.tab_fqname || ' for each row execute procedure
-				@NAMESPACE@.lockedSet (''_@CLUSTERNAME@'');';
-	end loop;
-
-	-- ----
-	-- Remember our snapshots xmax as for the set locking
+	-- Remember our snapshots xmax as for the set locking. Setting
+	-- set_locked is all it takes to lock the set: the log trigger
+	-- reads the locked tables once per transaction with the latest
+	-- snapshot. Transactions that checked before we commit must be
+	-- waited for by the caller, see slonik's LOCK SET.
 	-- ----
 	update @NAMESPACE@.sl_set
 			set set_locked = "pg_catalog".txid_snapshot_xmax("pg_catalog".txid_current_snapshot())
@@ -2192,15 +2217,14 @@ $$ language plpgsql;
 comment on function @NAMESPACE@.lockSet(p_set_id int4) is 
 'lockSet(set_id)
 
-Add a special trigger to all tables of a set that disables access to
-it.';
+Mark a set as locked, so that the log trigger rejects changes to its
+tables.';
 
 
 -- ----------------------------------------------------------------------
 -- FUNCTION unlockSet (set_id)
 --
---	Remove the special trigger from all tables of a set that disables
---	access to it.
+--	Clear the lock of a set.
 -- ----------------------------------------------------------------------
 create or replace function @NAMESPACE@.unlockSet (p_set_id int4)
 returns int4
@@ -2235,16 +2259,20 @@ begin
 	end if;
 
 	-- ----
-	-- Drop the lockedSet trigger from all tables in the set.
+	-- Drop lockedSet triggers left behind by a lockSet() of an
+	-- older version.
 	-- ----
 	for v_tab_row in select T.tab_id,
 			@NAMESPACE@.slon_quote_brute(PGN.nspname) || '.' ||
 			@NAMESPACE@.slon_quote_brute(PGC.relname) as tab_fqname
 			from @NAMESPACE@.sl_table T,
-				"pg_catalog".pg_class PGC, "pg_catalog".pg_namespace PGN
+				"pg_catalog".pg_class PGC, "pg_catalog".pg_namespace PGN,
+				"pg_catalog".pg_trigger PGT
 			where T.tab_set = p_set_id
 				and T.tab_reloid = PGC.oid
 				and PGC.relnamespace = PGN.oid
+				and PGT.tgrelid = T.tab_reloid
+				and PGT.tgname = '_@CLUSTERNAME@_lockedset'
 			order by tab_id
 	loop
 		execute 'drop trigger "_@CLUSTERNAME@_lockedset" ' || 
@@ -2262,7 +2290,7 @@ begin
 end;
 $$ language plpgsql;
 comment on function @NAMESPACE@.unlockSet(p_set_id int4) is
-'Remove the special trigger from all tables of a set that disables access to it.';
+'Clear the lock of a set, allowing changes to its tables again.';
 
 -- ----------------------------------------------------------------------
 -- FUNCTION moveSet (set_id, new_origin)
@@ -2527,12 +2555,7 @@ begin
 	-- adjust the log and deny access trigger configuration.
 	-- ----
 	if v_local_node_id = p_old_origin or v_local_node_id = p_new_origin then
-		for v_tab_row in select tab_id from @NAMESPACE@.sl_table
-				where tab_set = p_set_id
-				order by tab_id
-		loop
-			perform @NAMESPACE@.alterTableConfigureTriggers(v_tab_row.tab_id);
-		end loop;
+		perform @NAMESPACE@.alterSetConfigureTriggers(p_set_id);
 	end if;
 
 	return p_set_id;
@@ -2616,6 +2639,8 @@ begin
 	-- ----
 	delete from @NAMESPACE@.sl_sequence
 			where seq_set = p_set_id;
+	delete from @NAMESPACE@.sl_table_filter
+			where tf_set = p_set_id;
 	delete from @NAMESPACE@.sl_table
 			where tab_set = p_set_id;
 	delete from @NAMESPACE@.sl_subscribe
@@ -2705,6 +2730,23 @@ begin
 				p_add_id, p_set_id;
 	end if;
 
+	-- ----
+	-- Pending log rows are retagged to the remaining set on every node.
+	-- A receiver must therefore get both sets from the same provider,
+	-- or it could select the retagged rows of one provider and the
+	-- original rows of another one.
+	-- ----
+	if exists (select true from @NAMESPACE@.sl_subscribe SUB1,
+					@NAMESPACE@.sl_subscribe SUB2
+				where SUB1.sub_set = p_set_id
+				and SUB2.sub_set = p_add_id
+				and SUB1.sub_receiver = SUB2.sub_receiver
+				and SUB1.sub_provider <> SUB2.sub_provider)
+	then
+		raise exception 'Slony-I: sets % and % have different providers on some receiver',
+				p_set_id, p_add_id;
+	end if;
+
 	-- ----
 	-- Check that all ENABLE_SUBSCRIPTION events for the set are confirmed
 	-- ----
@@ -2728,7 +2770,7 @@ comment on function @NAMESPACE@.mergeSet(p_set_id int4, p_add_id int4) is
 'Generate MERGE_SET event to request that sets be merged together.
 
 Both sets must exist, and originate on the same node.  They must be
-subscribed by the same set of nodes.';
+subscribed by the same set of nodes, each from the same provider.';
 
 
 create or replace function @NAMESPACE@.isSubscriptionInProgress(p_add_id int4)
@@ -2760,6 +2802,8 @@ Returns true if a subscription is in progress. Otherwise false';
 create or replace function @NAMESPACE@.mergeSet_int (p_set_id int4, p_add_id int4)
 returns int4
 as $$
+declare
+	v_tab_row			record;
 begin
 	-- ----
 	-- Grab the central configuration lock
@@ -2769,9 +2813,23 @@ begin
 	update @NAMESPACE@.sl_sequence
 			set seq_set = p_set_id
 			where seq_set = p_add_id;
-	update @NAMESPACE@.sl_table
+	for v_tab_row in update @NAMESPACE@.sl_table
 			set tab_set = p_set_id
-			where tab_set = p_add_id;
+			where tab_set = p_add_id
+			returning tab_id
+	loop
+		perform @NAMESPACE@.alterTableSetLogTrigger(v_tab_row.tab_id);
+	end loop;
+
+	-- ----
+	-- Retag the log rows of the merged set not replicated yet.
+	-- ----
+	update @NAMESPACE@.sl_log_1 set log_setid = p_set_id
+			where log_setid = p_add_id;
+	update @NAMESPACE@.sl_log_2 set log_setid = p_set_id
+			where log_setid = p_add_id;
+	update @NAMESPACE@.sl_table_filter set tf_set = p_set_id
+			where tf_set = p_add_id;
 	delete from @NAMESPACE@.sl_subscribe
 			where sub_set = p_add_id;
 	delete from @NAMESPACE@.sl_setsync
@@ -2793,6 +2851,27 @@ set add_id into set set_id.';
 create or replace function @NAMESPACE@.setAddTable(p_set_id int4, p_tab_id int4, p_fqname text, p_tab_idxname name, p_tab_comment text)
 returns bigint
 as $$
+begin
+	return @NAMESPACE@.setAddTable(p_set_id, p_tab_id, p_fqname,
+			p_tab_idxname, p_tab_comment, NULL);
+end;
+$$ language plpgsql;
+comment on function @NAMESPACE@.setAddTable(p_set_id int4, p_tab_id int4, p_fqname text, p_tab_idxname name, p_tab_comment text) is
+'setAddTable (set_id, tab_id, tab_fqname, tab_idxname, tab_comment)
+
+Add table tab_fqname with all its columns to replication set on origin
+node, and generate SET_ADD_TABLE event to allow this to propagate to
+other nodes.
+
+Note that the table id, tab_id, must be unique ACROSS ALL SETS.';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION setAddTable (set_id, tab_id, tab_fqname, tab_idxname,
+--					tab_comment, tab_columns)
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.setAddTable(p_set_id int4, p_tab_id int4, p_fqname text, p_tab_idxname name, p_tab_comment text, p_tab_columns text[])
+returns bigint
+as $$
 declare
 	v_set_origin		int4;
 begin
@@ -2825,17 +2904,20 @@ begin
 	-- Add the table to the set and generate the SET_ADD_TABLE event
 	-- ----
 	perform @NAMESPACE@.setAddTable_int(p_set_id, p_tab_id, p_fqname,
-			p_tab_idxname, p_tab_comment);
+			p_tab_idxname, p_tab_comment, p_tab_columns);
 	return  @NAMESPACE@.createEvent('_@CLUSTERNAME@', 'SET_ADD_TABLE',
 			p_set_id::text, p_tab_id::text, p_fqname::text,
-			p_tab_idxname::text, p_tab_comment::text);
+			p_tab_idxname::text, p_tab_comment::text,
+			p_tab_columns::text);
 end;
 $$ language plpgsql;
-comment on function @NAMESPACE@.setAddTable(p_set_id int4, p_tab_id int4, p_fqname text, p_tab_idxname name, p_tab_comment text) is
-'setAddTable (set_id, tab_id, tab_fqname, tab_idxname, tab_comment)
+comment on function @NAMESPACE@.setAddTable(p_set_id int4, p_tab_id int4, p_fqname text, p_tab_idxname name, p_tab_comment text, p_tab_columns text[]) is
+'setAddTable (set_id, tab_id, tab_fqname, tab_idxname, tab_comment, tab_columns)
 
 Add table tab_fqname to replication set on origin node, and generate
-SET_ADD_TABLE event to allow this to propagate to other nodes.
+SET_ADD_TABLE event to allow this to propagate to other nodes.  If
+tab_columns is not NULL, only these columns and the key columns of
+tab_idxname are replicated.
 
 Note that the table id, tab_id, must be unique ACROSS ALL SETS.';
 
@@ -2846,6 +2928,24 @@ Note that the table id, tab_id, must be unique ACROSS ALL SETS.';
 create or replace function @NAMESPACE@.setAddTable_int(p_set_id int4, p_tab_id int4, p_fqname text, p_tab_idxname name, p_tab_comment text) 
 returns int4
 as $$
+begin
+	return @NAMESPACE@.setAddTable_int(p_set_id, p_tab_id, p_fqname,
+			p_tab_idxname, p_tab_comment, NULL);
+end;
+$$ language plpgsql;
+comment on function @NAMESPACE@.setAddTable_int(p_set_id int4, p_tab_id int4, p_fqname text, p_tab_idxname name, p_tab_comment text) is
+'setAddTable_int (set_id, tab_id, tab_fqname, tab_idxname, tab_comment)
+
+Same as setAddTable_int(set_id, tab_id, tab_fqname, tab_idxname,
+tab_comment, NULL), replicating all columns of the table.';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION setAddTable_int (set_id, tab_id, tab_fqname, tab_idxname,
+--						tab_comment, tab_columns)
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.setAddTable_int(p_set_id int4, p_tab_id int4, p_fqname text, p_tab_idxname name, p_tab_comment text, p_tab_columns text[]) 
+returns int4
+as $$
 declare
 	v_tab_relname		name;
 	v_tab_nspname		name;
@@ -2856,6 +2956,8 @@ declare
 	v_tab_reloid		oid;
 	v_pkcand_nn		boolean;
 	v_prec			record;
+	v_tab_columns	text[];
+	v_i				int4;
 begin
 	-- ----
 	-- Grab the central configuration lock
@@ -2939,26 +3041,208 @@ begin
 		raise exception 'Slony-I: setAddTable_int: table id % has already been assigned!', p_tab_id;
 	end if;
 
+	-- ----
+	-- With a column list, check that all listed columns exist and
+	-- that the columns left out can be filled on the subscribers.
+	-- ----
+	if p_tab_columns is not null then
+		v_tab_columns := '{}';
+		for v_i in 1 .. coalesce(array_upper(p_tab_columns, 1), 0) loop
+			v_tab_columns := v_tab_columns || pg_catalog.btrim(p_tab_columns[v_i]);
+			if not exists (select 1 from "pg_catalog".pg_attribute PGA
+					where PGA.attrelid = v_tab_reloid
+						and PGA.attnum > 0
+						and not PGA.attisdropped
+						and PGA.attname = pg_catalog.btrim(p_tab_columns[v_i]))
+			then
+				raise exception 'Slony-I: setAddTable_int(): table % has no column %',
+						p_fqname, pg_catalog.btrim(p_tab_columns[v_i]);
+			end if;
+		end loop;
+		for v_prec in select PGA.attname
+				from "pg_catalog".pg_attribute PGA
+				where PGA.attrelid = v_tab_reloid
+					and PGA.attnum > 0
+					and not PGA.attisdropped
+					and PGA.attnotnull
+					and not PGA.atthasdef
+					and PGA.attname <> all (v_tab_columns)
+					and not exists (select 1
+						from "pg_catalog".pg_index PGX,
+							"pg_catalog".pg_class PGXC
+						where PGX.indrelid = v_tab_reloid
+							and PGX.indexrelid = PGXC.oid
+							and PGXC.relname = p_tab_idxname
+							and PGA.attnum = any (PGX.indkey))
+		loop
+			raise exception 'Slony-I: setAddTable_int(): column %.% is NOT NULL without default and must be replicated',
+					p_fqname, v_prec.attname;
+		end loop;
+	end if;
+
 	-- ----
 	-- Add the table to sl_table and create the trigger on it.
 	-- ----
 	insert into @NAMESPACE@.sl_table
 			(tab_id, tab_reloid, tab_relname, tab_nspname, 
-			tab_set, tab_idxname, tab_altered, tab_comment) 
+			tab_set, tab_idxname, tab_altered, tab_comment,
+			tab_columns) 
 			values
 			(p_tab_id, v_tab_reloid, v_tab_relname, v_tab_nspname,
-			p_set_id, p_tab_idxname, false, p_tab_comment);
+			p_set_id, p_tab_idxname, false, p_tab_comment,
+			v_tab_columns);
 	perform @NAMESPACE@.alterTableAddTriggers(p_tab_id);
 
 	return p_tab_id;
 end;
 $$ language plpgsql;
-comment on function @NAMESPACE@.setAddTable_int(p_set_id int4, p_tab_id int4, p_fqname text, p_tab_idxname name, p_tab_comment text) is
-'setAddTable_int (set_id, tab_id, tab_fqname, tab_idxname, tab_comment)
+comment on function @NAMESPACE@.setAddTable_int(p_set_id int4, p_tab_id int4, p_fqname text, p_tab_idxname name, p_tab_comment text, p_tab_columns text[]) is
+'setAddTable_int (set_id, tab_id, tab_fqname, tab_idxname, tab_comment, tab_columns)
 
 This function processes the SET_ADD_TABLE event on remote nodes,
 adding a table to replication if the remote node is subscribing to its
-replication set.';
+replication set.  tab_columns limits replication to these columns and
+the key columns, NULL replicates all columns.';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION setAddTables (set_id, tab_ids, tab_fqnames, tab_comment)
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.setAddTables(p_set_id int4, p_tab_ids int4[], p_fqnames text[], p_tab_comment text)
+returns bigint
+as $$
+declare
+	v_set_origin		int4;
+	v_ntables			int4;
+	v_tab_rec			record;
+	v_idxname			name;
+	v_idxnames			text[] default '{}';
+	v_pkcand_nn			boolean;
+	v_prec				record;
+begin
+	-- ----
+	-- Grab the central configuration lock
+	-- ----
+	lock table @NAMESPACE@.sl_config_lock;
+
+	-- ----
+	-- Check that we are the origin of the set
+	-- ----
+	select set_origin into v_set_origin
+			from @NAMESPACE@.sl_set
+			where set_id = p_set_id;
+	if not found then
+		raise exception 'Slony-I: setAddTables(): set % not found', p_set_id;
+	end if;
+	if v_set_origin != @NAMESPACE@.getLocalNodeId('_@CLUSTERNAME@') then
+		raise exception 'Slony-I: setAddTables(): set % has remote origin', p_set_id;
+	end if;
+
+	if exists (select true from @NAMESPACE@.sl_subscribe
+			where sub_set = p_set_id)
+	then
+		raise exception 'Slony-I: cannot add table to currently subscribed set % - must attach to an unsubscribed set',
+				p_set_id;
+	end if;
+
+	v_ntables := coalesce(array_upper(p_fqnames, 1), 0);
+	if coalesce(array_upper(p_tab_ids, 1), 0) != v_ntables then
+		raise exception 'Slony-I: setAddTables(): % table ids given for % tables',
+				coalesce(array_upper(p_tab_ids, 1), 0), v_ntables;
+	end if;
+
+	-- ----
+	-- Look up all tables in a single pass over pg_class, rather
+	-- than once per table as setAddTable_int() does.
+	-- ----
+	for v_tab_rec in
+		select T.tab_id, T.fqname, PGC.oid as reloid, PGC.relkind,
+				PGC.relname, PGN.nspname
+			from (select p_tab_ids[i] as tab_id, p_fqnames[i] as fqname,
+						@NAMESPACE@.slon_quote_input(p_fqnames[i]) as fqname_quoted,
+						i as ord
+					from generate_series(1, v_ntables) i) T
+				left join ("pg_catalog".pg_class PGC
+					join "pg_catalog".pg_namespace PGN
+						on PGC.relnamespace = PGN.oid)
+				on @NAMESPACE@.slon_quote_brute(PGN.nspname) || '.' ||
+					@NAMESPACE@.slon_quote_brute(PGC.relname) = T.fqname_quoted
+			order by T.ord
+	loop
+		if v_tab_rec.reloid is null then
+			raise exception 'Slony-I: setAddTables(): table % not found',
+					v_tab_rec.fqname;
+		end if;
+		if v_tab_rec.relkind != 'r' then
+			raise exception 'Slony-I: setAddTables(): % is not a regular table',
+					v_tab_rec.fqname;
+		end if;
+
+		-- ----
+		-- Use the primary key, as SET ADD TABLE does for table patterns
+		-- ----
+		select PGXC.relname into v_idxname
+				from "pg_catalog".pg_index PGX, "pg_catalog".pg_class PGXC
+				where PGX.indrelid = v_tab_rec.reloid
+					and PGX.indexrelid = PGXC.oid
+					and PGX.indisprimary;
+		if not found then
+			raise exception 'Slony-I: table % has no primary key',
+					v_tab_rec.fqname;
+		end if;
+
+		-- ----
+		-- Verify that the columns in the PK are not NULLABLE
+		-- ----
+		v_pkcand_nn := 'f';
+		for v_prec in select PGA.attname
+				from "pg_catalog".pg_index PGX, "pg_catalog".pg_attribute PGA
+				where PGX.indrelid = v_tab_rec.reloid
+					and PGX.indisprimary
+					and PGA.attrelid = v_tab_rec.reloid
+					and PGA.attnum = any (PGX.indkey)
+					and not PGA.attnotnull
+		loop
+			raise notice 'Slony-I: setAddTables: table % PK column % nullable', v_tab_rec.fqname, v_prec.attname;
+			v_pkcand_nn := 't';
+		end loop;
+		if v_pkcand_nn then
+			raise exception 'Slony-I: setAddTables: table % not replicable!', v_tab_rec.fqname;
+		end if;
+
+		if exists (select true from @NAMESPACE@.sl_table
+				where tab_id = v_tab_rec.tab_id) then
+			raise exception 'Slony-I: setAddTables: table id % has already been assigned!', v_tab_rec.tab_id;
+		end if;
+
+		-- ----
+		-- Add the table to sl_table and create the trigger on it.
+		-- ----
+		insert into @NAMESPACE@.sl_table
+				(tab_id, tab_reloid, tab_relname, tab_nspname,
+				tab_set, tab_idxname, tab_altered, tab_comment)
+				values
+				(v_tab_rec.tab_id, v_tab_rec.reloid, v_tab_rec.relname,
+				v_tab_rec.nspname, p_set_id, v_idxname, false, p_tab_comment);
+		perform @NAMESPACE@.alterTableAddTriggers(v_tab_rec.tab_id);
+
+		v_idxnames := v_idxnames || v_idxname::text;
+	end loop;
+
+	-- ----
+	-- Generate a single SET_ADD_TABLES event for all of them
+	-- ----
+	return  @NAMESPACE@.createEvent('_@CLUSTERNAME@', 'SET_ADD_TABLES',
+			p_set_id::text, p_tab_ids::text, p_fqnames::text,
+			v_idxnames::text, p_tab_comment::text);
+end;
+$$ language plpgsql;
+comment on function @NAMESPACE@.setAddTables(p_set_id int4, p_tab_ids int4[], p_fqnames text[], p_tab_comment text) is
+'setAddTables (set_id, tab_ids, tab_fqnames, tab_comment)
+
+Add the tables tab_fqnames, using their primary keys, to replication
+set set_id on the origin node and generate one SET_ADD_TABLES event for
+all of them.  tab_ids[i] is the table id assigned to tab_fqnames[i].
+Used by SET ADD TABLE with a tables pattern.';
 
 -- ----------------------------------------------------------------------
 -- FUNCTION setDropTable (tab_id)
@@ -3033,6 +3317,8 @@ begin
 	-- ----
 	lock table @NAMESPACE@.sl_config_lock;
 
+	delete from @NAMESPACE@.sl_table_filter where tf_tab_id = p_tab_id;
+
     -- ----
 	-- Determine the set_id
     -- ----
@@ -3083,6 +3369,237 @@ This function processes the SET_DROP_TABLE event on remote nodes,
 dropping a table from replication if the remote node is subscribing to
 its replication set.';
 
+-- ----------------------------------------------------------------------
+-- FUNCTION logCmdArg (cmdargs, colname)
+--
+--	Return the value of a column from the log_cmdargs of a log row.
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.logCmdArg(p_cmdargs text[], p_colname text)
+returns text
+as $$
+	select $1[i + 1]
+		from "pg_catalog".generate_series(
+				"pg_catalog".array_upper($1, 1) - 1, 1, -2) as i
+		where $1[i] = $2
+		limit 1;
+$$ language sql immutable;
+comment on function @NAMESPACE@.logCmdArg(p_cmdargs text[], p_colname text) is
+'logCmdArg (cmdargs, colname)
+
+Return the value of column colname from the name/value pairs of a
+log_cmdargs array.  The pairs are searched from the end, so for an
+UPDATE this is the old value of a key column.';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION checkFilterKeyUpdate (tab_id, old_key, new_key)
+--
+--	Called by the log trigger for an UPDATE that changes the key of a
+--	table with row filters.
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.checkFilterKeyUpdate(p_tab_id int4, p_old_key text[], p_new_key text[])
+returns int4
+as $$
+declare
+	v_tf_row			record;
+	v_old_match			boolean;
+	v_new_match			boolean;
+begin
+	for v_tf_row in select tf_receiver, tf_logfilter
+			from @NAMESPACE@.sl_table_filter
+			where tf_tab_id = p_tab_id
+	loop
+		execute 'select ' || v_tf_row.tf_logfilter ||
+				' from (select ' || pg_catalog.quote_literal(p_old_key::text) ||
+				'::text[] as log_cmdargs) as L' into v_old_match;
+		execute 'select ' || v_tf_row.tf_logfilter ||
+				' from (select ' || pg_catalog.quote_literal(p_new_key::text) ||
+				'::text[] as log_cmdargs) as L' into v_new_match;
+		if coalesce(v_old_match, false) <> coalesce(v_new_match, false) then
+			raise exception 'Slony-I: UPDATE of the key of table % moves a row across the row filter of node %',
+					p_tab_id, v_tf_row.tf_receiver;
+		end if;
+	end loop;
+	return p_tab_id;
+end;
+$$ language plpgsql;
+comment on function @NAMESPACE@.checkFilterKeyUpdate(p_tab_id int4, p_old_key text[], p_new_key text[]) is
+'checkFilterKeyUpdate (tab_id, old_key, new_key)
+
+Raise an exception if an UPDATE that changes the key of table tab_id
+from old_key to new_key, both name/value pairs like log_cmdargs, moves
+the row into or out of the row filter of any receiver.  The log rows of
+an UPDATE are filtered by the old key only, so such an UPDATE would
+leave the receiver with a row it should not have, or without one.';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION setTableFilter (tab_id, receiver, filter)
+--
+--	Generate the SET_TABLE_FILTER event.
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.setTableFilter(p_tab_id int4, p_receiver int4, p_filter text)
+returns bigint
+as $$
+declare
+	v_tab_row			record;
+	v_set_origin		int4;
+	v_cols				text default '';
+	v_col_row			record;
+	v_logfilter			text;
+begin
+	-- ----
+	-- Grab the central configuration lock
+	-- ----
+	lock table @NAMESPACE@.sl_config_lock;
+
+	-- ----
+	-- Check that we are the origin of the table's set
+	-- ----
+	select T.tab_set, T.tab_reloid, T.tab_idxname,
+			@NAMESPACE@.slon_quote_brute(T.tab_nspname) || '.' ||
+			@NAMESPACE@.slon_quote_brute(T.tab_relname) as tab_fqname
+			into v_tab_row
+			from @NAMESPACE@.sl_table T
+			where T.tab_id = p_tab_id;
+	if not found then
+		raise exception 'Slony-I: setTableFilter(): table % not found', p_tab_id;
+	end if;
+	select set_origin into v_set_origin
+			from @NAMESPACE@.sl_set
+			where set_id = v_tab_row.tab_set;
+	if v_set_origin != @NAMESPACE@.getLocalNodeId('_@CLUSTERNAME@') then
+		raise exception 'Slony-I: setTableFilter(): set % has remote origin',
+				v_tab_row.tab_set;
+	end if;
+	if not exists (select true from @NAMESPACE@.sl_node
+			where no_id = p_receiver) then
+		raise exception 'Slony-I: setTableFilter(): node % not found', p_receiver;
+	end if;
+
+	-- ----
+	-- The filter applies to the initial copy and to every SYNC after it,
+	-- so it cannot change under an existing subscription. A node with a
+	-- partial copy of the table must not forward it either.
+	-- ----
+	if exists (select true from @NAMESPACE@.sl_subscribe
+			where sub_set = v_tab_row.tab_set
+				and sub_receiver = p_receiver
+				and sub_forward) then
+		raise exception 'Slony-I: setTableFilter(): node % forwards set %',
+				p_receiver, v_tab_row.tab_set;
+	end if;
+	if exists (select true from @NAMESPACE@.sl_subscribe
+			where sub_set = v_tab_row.tab_set
+				and sub_provider = p_receiver) then
+		raise exception 'Slony-I: setTableFilter(): node % is a provider of set %',
+				p_receiver, v_tab_row.tab_set;
+	end if;
+	if exists (select true from @NAMESPACE@.sl_subscribe
+			where sub_set = v_tab_row.tab_set
+				and sub_receiver = p_receiver) then
+		raise exception 'Slony-I: setTableFilter(): node % is already subscribed to set % - unsubscribe it first',
+				p_receiver, v_tab_row.tab_set;
+	end if;
+
+	-- ----
+	-- An empty filter removes the filter.
+	-- ----
+	if pg_catalog.btrim(coalesce(p_filter, '')) = '' then
+		perform @NAMESPACE@.setTableFilter_int(p_tab_id, p_receiver,
+				v_tab_row.tab_set, NULL, NULL);
+		return  @NAMESPACE@.createEvent('_@CLUSTERNAME@', 'SET_TABLE_FILTER',
+				p_tab_id::text, p_receiver::text, v_tab_row.tab_set::text);
+	end if;
+
+	-- ----
+	-- The filter must be a valid condition on the table.
+	-- ----
+	execute 'select 1 from ' || v_tab_row.tab_fqname ||
+			' where (' || p_filter || ') limit 0';
+
+	-- ----
+	-- Log rows only carry all key columns, so the filter is rewritten
+	-- to a condition on the key column values taken from log_cmdargs.
+	-- ----
+	for v_col_row in select PGA.attname,
+				"pg_catalog".format_type(PGA.atttypid, PGA.atttypmod) as atttype
+			from "pg_catalog".pg_index PGX,
+				"pg_catalog".pg_class PGXC,
+				"pg_catalog".pg_attribute PGA
+			where PGX.indrelid = v_tab_row.tab_reloid
+				and PGX.indexrelid = PGXC.oid
+				and PGXC.relname = v_tab_row.tab_idxname
+				and PGA.attrelid = v_tab_row.tab_reloid
+				and PGA.attnum = any (PGX.indkey)
+			order by PGA.attnum
+	loop
+		if v_cols <> '' then
+			v_cols := v_cols || ', ';
+		end if;
+		v_cols := v_cols || '@NAMESPACE@.logCmdArg(log_cmdargs, ' ||
+				pg_catalog.quote_literal(v_col_row.attname) || ')::' ||
+				v_col_row.atttype || ' as ' ||
+				pg_catalog.quote_ident(v_col_row.attname);
+	end loop;
+	v_logfilter := 'exists (select 1 from (select ' || v_cols ||
+			') as R where (' || p_filter || '))';
+
+	begin
+		execute 'select ' || v_logfilter ||
+				' from (select NULL::text[] as log_cmdargs) as L';
+	exception
+		when undefined_column then
+			raise exception 'Slony-I: setTableFilter(): the filter of table % may only use the columns of index %',
+					v_tab_row.tab_fqname, v_tab_row.tab_idxname;
+	end;
+
+	perform @NAMESPACE@.setTableFilter_int(p_tab_id, p_receiver,
+			v_tab_row.tab_set, p_filter, v_logfilter);
+	return  @NAMESPACE@.createEvent('_@CLUSTERNAME@', 'SET_TABLE_FILTER',
+			p_tab_id::text, p_receiver::text, v_tab_row.tab_set::text,
+			p_filter, v_logfilter);
+end;
+$$ language plpgsql;
+comment on function @NAMESPACE@.setTableFilter(p_tab_id int4, p_receiver int4, p_filter text) is
+'setTableFilter (tab_id, receiver, filter)
+
+Limit the rows of table tab_id that node receiver replicates to those
+matching filter, a boolean expression that may only use the key columns
+of the table.  An empty filter removes the filter.  Generates the
+SET_TABLE_FILTER event.  The filter applies to the initial copy of a
+subscription and to the log rows selected for every SYNC afterwards,
+so it can only be changed while receiver is not subscribed to the set.
+A receiver with filters cannot forward the set.';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION setTableFilter_int (tab_id, receiver, set_id, filter,
+--						logfilter)
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.setTableFilter_int(p_tab_id int4, p_receiver int4, p_set_id int4, p_filter text, p_logfilter text)
+returns int4
+as $$
+begin
+	-- ----
+	-- Grab the central configuration lock
+	-- ----
+	lock table @NAMESPACE@.sl_config_lock;
+
+	delete from @NAMESPACE@.sl_table_filter
+			where tf_tab_id = p_tab_id and tf_receiver = p_receiver;
+	if p_filter is not null then
+		insert into @NAMESPACE@.sl_table_filter
+				(tf_tab_id, tf_receiver, tf_set, tf_filter, tf_logfilter)
+				values
+				(p_tab_id, p_receiver, p_set_id, p_filter, p_logfilter);
+	end if;
+	return p_tab_id;
+end;
+$$ language plpgsql;
+comment on function @NAMESPACE@.setTableFilter_int(p_tab_id int4, p_receiver int4, p_set_id int4, p_filter text, p_logfilter text) is
+'setTableFilter_int (tab_id, receiver, set_id, filter, logfilter)
+
+Processes the SET_TABLE_FILTER event.  Stores the row filter of table
+tab_id for node receiver on every node, or removes it if filter is NULL.';
+
 -- ----------------------------------------------------------------------
 -- FUNCTION setAddSequence (set_id, seq_id, seq_fqname, seq_comment)
 -- ----------------------------------------------------------------------
@@ -3440,10 +3957,27 @@ begin
 	end if;
 
 	-- ----
-	-- Change the set the table belongs to
+	-- Pending log rows are retagged to the remaining set on every node.
+	-- A receiver must therefore get both sets from the same provider,
+	-- or it could select the retagged rows of one provider and the
+	-- original rows of another one.
 	-- ----
-	perform @NAMESPACE@.createEvent('_@CLUSTERNAME@', 'SYNC', NULL);
-	perform @NAMESPACE@.setMoveTable_int(p_tab_id, p_new_set_id);
+	if exists (select true from @NAMESPACE@.sl_subscribe SUB1,
+					@NAMESPACE@.sl_subscribe SUB2
+				where SUB1.sub_set = v_old_set_id
+				and SUB2.sub_set = p_new_set_id
+				and SUB1.sub_receiver = SUB2.sub_receiver
+				and SUB1.sub_provider <> SUB2.sub_provider)
+	then
+		raise exception 'Slony-I: sets % and % have different providers on some receiver',
+				v_old_set_id, p_new_set_id;
+	end if;
+
+	-- ----
+	-- Change the set the table belongs to
+	-- ----
+	perform @NAMESPACE@.createEvent('_@CLUSTERNAME@', 'SYNC', NULL);
+	perform @NAMESPACE@.setMoveTable_int(p_tab_id, p_new_set_id);
 	return  @NAMESPACE@.createEvent('_@CLUSTERNAME@', 'SET_MOVE_TABLE', 
 			p_tab_id::text, p_new_set_id::text);
 end;
@@ -3451,8 +3985,8 @@ $$ language plpgsql;
 
 comment on function @NAMESPACE@.setMoveTable(p_tab_id int4, p_new_set_id int4) is
 'This generates the SET_MOVE_TABLE event.  If the set that the table is
-in is identically subscribed to the set that the table is to be moved 
-into, then the SET_MOVE_TABLE event is raised.';
+in is identically subscribed, with the same providers, to the set that
+the table is to be moved into, then the SET_MOVE_TABLE event is raised.';
 
 
 -- ----------------------------------------------------------------------
@@ -3463,6 +3997,8 @@ into, then the SET_MOVE_TABLE event is raised.';
 create or replace function @NAMESPACE@.setMoveTable_int (p_tab_id int4, p_new_set_id int4)
 returns int4
 as $$
+declare
+	v_old_set_id		int4;
 begin
 	-- ----
 	-- Grab the central configuration lock
@@ -3472,9 +4008,24 @@ begin
 	-- ----
 	-- Move the table to the new set
 	-- ----
+	select tab_set into v_old_set_id from @NAMESPACE@.sl_table
+			where tab_id = p_tab_id;
 	update @NAMESPACE@.sl_table
 			set tab_set = p_new_set_id
 			where tab_id = p_tab_id;
+	update @NAMESPACE@.sl_table_filter
+			set tf_set = p_new_set_id
+			where tf_tab_id = p_tab_id;
+
+	-- ----
+	-- The log trigger tags log rows with the set, recreate it and
+	-- retag the log rows not replicated yet.
+	-- ----
+	perform @NAMESPACE@.alterTableSetLogTrigger(p_tab_id);
+	update @NAMESPACE@.sl_log_1 set log_setid = p_new_set_id
+			where log_setid = v_old_set_id and log_tableid = p_tab_id;
+	update @NAMESPACE@.sl_log_2 set log_setid = p_new_set_id
+			where log_setid = v_old_set_id and log_tableid = p_tab_id;
 
 	return p_tab_id;
 end;
@@ -3666,6 +4217,18 @@ declare
 begin
 	c_local_node := @NAMESPACE@.getLocalNodeId('_@CLUSTERNAME@');
 
+	-- ----
+	-- With logical capture, changes committed so far are still in the
+	-- slot. Move them to sl_log first so that they get action sequence
+	-- numbers ahead of the script. The event lock keeps the sync thread
+	-- from draining at the same time.
+	-- ----
+	if @NAMESPACE@.registry_get_text('logical_capture_slot', NULL)
+			is not null then
+		lock table @NAMESPACE@.sl_event_lock;
+		perform @NAMESPACE@.logicalCaptureDrain();
+	end if;
+
 	c_cmdargs = array_append('{}'::text[], p_statement);
 	c_nodeargs = '';
 	if p_nodes is not null then
@@ -3836,7 +4399,7 @@ begin
 	-- ----
 	-- Get the sl_table row and the current origin of the table. 
 	-- ----
-	select T.tab_reloid, T.tab_set, T.tab_idxname, 
+	select T.tab_reloid, T.tab_set, T.tab_idxname, T.tab_columns,
 			S.set_origin, PGX.indexrelid,
 			@NAMESPACE@.slon_quote_brute(PGN.nspname) || '.' ||
 			@NAMESPACE@.slon_quote_brute(PGC.relname) as tab_fqname
@@ -3858,7 +4421,7 @@ begin
 	v_tab_fqname = v_tab_row.tab_fqname;
 
 	v_tab_attkind := @NAMESPACE@.determineAttKindUnique(v_tab_row.tab_fqname, 
-						v_tab_row.tab_idxname);
+						v_tab_row.tab_idxname, v_tab_row.tab_columns);
 
 	execute 'lock table ' || v_tab_fqname || ' in access exclusive mode';
 
@@ -3870,7 +4433,8 @@ begin
 			v_tab_fqname || ' for each row execute procedure @NAMESPACE@.logTrigger (' ||
                                pg_catalog.quote_literal('_@CLUSTERNAME@') || ',' || 
 				pg_catalog.quote_literal(p_tab_id::text) || ',' || 
-				pg_catalog.quote_literal(v_tab_attkind) || ');';
+				pg_catalog.quote_literal(v_tab_attkind) || ',' ||
+				pg_catalog.quote_literal(v_tab_row.tab_set::text) || ');';
 
 	execute 'create trigger "_@CLUSTERNAME@_denyaccess" ' || 
 			'before insert or update or delete on ' ||
@@ -3980,7 +4544,7 @@ begin
 	-- ----
 	-- Get the sl_table row and the current tables origin.
 	-- ----
-	select T.tab_reloid, T.tab_set,
+	select T.tab_reloid, T.tab_set, T.tab_idxname,
 			S.set_origin, PGX.indexrelid,
 			@NAMESPACE@.slon_quote_brute(PGN.nspname) || '.' ||
 			@NAMESPACE@.slon_quote_brute(PGC.relname) as tab_fqname
@@ -4015,6 +4579,16 @@ begin
 				' disable trigger "_@CLUSTERNAME@_denyaccess"';
         perform @NAMESPACE@.alterTableConfigureTruncateTrigger(v_tab_fqname,
 				'enable', 'disable');
+
+		-- ----
+		-- Logical capture needs the old key values in the WAL.
+		-- ----
+		if @NAMESPACE@.registry_get_text('logical_capture_slot', NULL)
+				is not null then
+			execute 'alter table ' || v_tab_fqname ||
+					' replica identity using index ' ||
+					@NAMESPACE@.slon_quote_brute(v_tab_row.tab_idxname);
+		end if;
 	else
 		-- ----
 		-- On a replica the log trigger is disabled and the
@@ -4038,6 +4612,97 @@ comment on function @NAMESPACE@.alterTableConfigureTriggers (p_tab_id int4) is
 Set the enable/disable configuration for the replication triggers
 according to the origin of the set.';
 
+-- ----------------------------------------------------------------------
+-- FUNCTION alterSetConfigureTriggers (set_id)
+--
+--	Same as alterTableConfigureTriggers() for all tables of a set,
+--	with the tables looked up in one catalog query and all trigger
+--	changes of a table done in a single ALTER TABLE.
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.alterSetConfigureTriggers (p_set_id int4)
+returns int4
+as $$
+declare
+	v_no_id				int4;
+	v_set_origin		int4;
+	v_log_stat			text;
+	v_deny_stat			text;
+	v_replident			boolean;
+	v_tab_row			record;
+	v_alter				text;
+	v_n					int4 := 0;
+begin
+	-- ----
+	-- Grab the central configuration lock
+	-- ----
+	lock table @NAMESPACE@.sl_config_lock;
+
+	-- ----
+	-- Get our local node ID and the origin of the set
+	-- ----
+	v_no_id := @NAMESPACE@.getLocalNodeId('_@CLUSTERNAME@');
+	select set_origin into v_set_origin from @NAMESPACE@.sl_set
+			where set_id = p_set_id;
+	if not found then
+		raise exception 'Slony-I: alterSetConfigureTriggers(): set % not found', p_set_id;
+	end if;
+
+	-- ----
+	-- On the origin the log triggers are enabled and the deny access
+	-- triggers disabled, on a replica the other way around.  Logical
+	-- capture needs the old key values in the WAL on the origin.
+	-- ----
+	if v_set_origin = v_no_id then
+		v_log_stat := 'enable';
+		v_deny_stat := 'disable';
+		v_replident := @NAMESPACE@.registry_get_text('logical_capture_slot',
+				NULL) is not null;
+	else
+		v_log_stat := 'disable';
+		v_deny_stat := 'enable';
+		v_replident := false;
+	end if;
+
+	for v_tab_row in select T.tab_id, T.tab_idxname,
+			@NAMESPACE@.slon_quote_brute(PGN.nspname) || '.' ||
+			@NAMESPACE@.slon_quote_brute(PGC.relname) as tab_fqname,
+			exists (select 1 from "pg_catalog".pg_trigger PGT
+					where PGT.tgrelid = T.tab_reloid
+					and PGT.tgname = '_@CLUSTERNAME@_truncatetrigger')
+				as has_truncate
+			from @NAMESPACE@.sl_table T,
+				"pg_catalog".pg_class PGC, "pg_catalog".pg_namespace PGN
+			where T.tab_set = p_set_id
+				and T.tab_reloid = PGC.oid
+				and PGC.relnamespace = PGN.oid
+			order by tab_id
+	loop
+		v_alter := 'alter table ' || v_tab_row.tab_fqname || ' ' ||
+				v_log_stat || ' trigger "_@CLUSTERNAME@_logtrigger", ' ||
+				v_deny_stat || ' trigger "_@CLUSTERNAME@_denyaccess"';
+		if v_tab_row.has_truncate then
+			v_alter := v_alter || ', ' ||
+					v_log_stat || ' trigger "_@CLUSTERNAME@_truncatetrigger", ' ||
+					v_deny_stat || ' trigger "_@CLUSTERNAME@_truncatedeny"';
+		end if;
+		if v_replident then
+			v_alter := v_alter || ', replica identity using index ' ||
+					@NAMESPACE@.slon_quote_brute(v_tab_row.tab_idxname);
+		end if;
+		execute v_alter;
+		v_n := v_n + 1;
+	end loop;
+
+	return v_n;
+end;
+$$ language plpgsql;
+comment on function @NAMESPACE@.alterSetConfigureTriggers (p_set_id int4) is
+'alterSetConfigureTriggers (set_id)
+
+Set the enable/disable configuration for the replication triggers of
+all tables in a set according to the origin of the set, with one
+ALTER TABLE per table.';
+
 
 
 -- ----------------------------------------------------------------------
@@ -4205,6 +4870,31 @@ begin
 		end if;
 	end if;
 
+	-- ----
+	-- With logical capture, changes still in the slot when the copy
+	-- starts would be missing from its snapshot bookkeeping and get
+	-- applied a second time afterwards.
+	-- ----
+	if not p_omit_copy
+			and @NAMESPACE@.registry_get_text('logical_capture_slot', NULL)
+				is not null
+			and not exists (select 1 from @NAMESPACE@.sl_subscribe
+				where sub_set = p_sub_set and sub_receiver = p_sub_receiver) then
+		raise exception 'Slony-I: subscribeSet(): logical capture is active on node % - disable it before subscribing set %',
+				v_set_origin, p_sub_set;
+	end if;
+
+	-- ----
+	-- A receiver with row filters only gets part of the set and
+	-- cannot provide it to others.
+	-- ----
+	if p_sub_forward and exists (select true
+			from @NAMESPACE@.sl_table_filter
+			where tf_set = p_sub_set and tf_receiver = p_sub_receiver) then
+		raise exception 'Slony-I: subscribeSet(): node % has row filters for set % and cannot forward it',
+				p_sub_receiver, p_sub_set;
+	end if;
+
 	-- ---
 	-- Enforce that all sets from one origin are subscribed
 	-- using the same data provider per receiver.
@@ -4799,6 +5489,765 @@ last sl_confirm row per (origin,receiver), and then removes all events
 that are confirmed by all nodes in the whole cluster up to the last
 SYNC.';
 
+-- ----------------------------------------------------------------------
+-- FUNCTION cleanupSyncPerf (keep)
+--
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.cleanupSyncPerf (p_keep int4)
+returns int4
+as $$
+declare
+	v_row		record;
+	v_seqno		int8;
+	v_count		int4;
+	v_total		int4;
+begin
+	v_total := 0;
+	if p_keep <= 0 then
+		delete from @NAMESPACE@.sl_sync_perf;
+		get diagnostics v_total = row_count;
+		return v_total;
+	end if;
+
+	-- ----
+	-- Keep only the p_keep most recent SYNC groups per origin
+	-- ----
+	for v_row in select distinct sp_origin from @NAMESPACE@.sl_sync_perf
+	loop
+		select sp_seqno_last into v_seqno
+				from @NAMESPACE@.sl_sync_perf
+				where sp_origin = v_row.sp_origin
+				order by sp_seqno_last desc
+				offset p_keep limit 1;
+		if found then
+			delete from @NAMESPACE@.sl_sync_perf
+					where sp_origin = v_row.sp_origin
+					and sp_seqno_last <= v_seqno;
+			get diagnostics v_count = row_count;
+			v_total := v_total + v_count;
+		end if;
+	end loop;
+
+	return v_total;
+end;
+$$ language plpgsql;
+comment on function @NAMESPACE@.cleanupSyncPerf (p_keep int4) is 
+'Trims sl_sync_perf down to the p_keep most recent SYNC groups per
+origin.  A p_keep of zero removes all rows.';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION setLatencyTracing (sample_interval)
+--
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.setLatencyTracing (p_sample_interval int4)
+returns int4
+as $$
+begin
+	if p_sample_interval is null or p_sample_interval <= 0 then
+		perform @NAMESPACE@.registry_set_int4('latency_trace_interval', NULL);
+		return 0;
+	end if;
+	return @NAMESPACE@.registry_set_int4('latency_trace_interval',
+			p_sample_interval);
+end;
+$$ language plpgsql;
+comment on function @NAMESPACE@.setLatencyTracing (p_sample_interval int4) is 
+'setLatencyTracing (sample_interval)
+
+Run on an origin node to have the log trigger tag about one in
+sample_interval transactions with a latency trace marker.  Zero or
+NULL turns tracing off.  Subscribers record the markers in
+sl_latency_hist.';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION latencyAddSample (origin, set, stage, latency)
+--
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.latencyAddSample (p_origin int4, p_set int4, p_stage text, p_latency interval)
+returns int4
+as $$
+declare
+	v_ms		float8;
+	v_bucket	int4;
+begin
+	if p_latency is null then
+		return null;
+	end if;
+
+	-- ----
+	-- Buckets are powers of two in milliseconds. Clock skew between
+	-- the nodes can make a stage negative, those go into bucket 0.
+	-- ----
+	v_ms := extract(epoch from p_latency) * 1000.0;
+	if v_ms <= 1.0 then
+		v_bucket := 0;
+	else
+		v_bucket := least(ceil(ln(v_ms) / ln(2.0)), 31)::int4;
+	end if;
+
+	update @NAMESPACE@.sl_latency_hist
+			set lh_count = lh_count + 1,
+				lh_sum_ms = lh_sum_ms + greatest(v_ms, 0.0),
+				lh_last = CURRENT_TIMESTAMP
+			where lh_origin = p_origin
+			and lh_set = p_set
+			and lh_stage = p_stage
+			and lh_bucket = v_bucket;
+	if not found then
+		insert into @NAMESPACE@.sl_latency_hist
+				(lh_origin, lh_set, lh_stage, lh_bucket,
+				 lh_count, lh_sum_ms, lh_last)
+				values (p_origin, p_set, p_stage, v_bucket,
+				 1, greatest(v_ms, 0.0), CURRENT_TIMESTAMP);
+	end if;
+	return v_bucket;
+end;
+$$ language plpgsql;
+comment on function @NAMESPACE@.latencyAddSample (p_origin int4, p_set int4, p_stage text, p_latency interval) is 
+'Adds one latency value to the sl_latency_hist bucket of the given
+origin, set and stage.';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION logApplyLatency (origin, seqno_first, seqno_last)
+--
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.logApplyLatency (p_origin int4, p_seqno_first int8, p_seqno_last int8)
+returns int4
+as $$
+declare
+	v_row		record;
+	v_sync_time	timestamptz;
+	v_start		timestamptz;
+	v_commit	timestamptz;
+	v_num		int4;
+begin
+	-- ----
+	-- now() is the start of this SYNC group's transaction. The commit
+	-- follows right after this function.
+	-- ----
+	v_num := 0;
+	v_start := now();
+	v_commit := "pg_catalog".clock_timestamp();
+
+	for v_row in select S.ls_txid, S.ls_origin_time, S.ls_apply_time,
+				T.tab_set
+			from @NAMESPACE@.sl_latency_sample S, @NAMESPACE@.sl_table T
+			where S.ls_origin = p_origin
+			and T.tab_id = S.ls_tableid
+	loop
+		-- ----
+		-- The SYNC that first covered the traced transaction is the
+		-- earliest one of this group whose snapshot sees it committed.
+		-- ----
+		select ev_timestamp into v_sync_time
+				from @NAMESPACE@.sl_event
+				where ev_origin = p_origin
+				and ev_seqno between p_seqno_first and p_seqno_last
+				and ev_type = 'SYNC'
+				and "pg_catalog".txid_visible_in_snapshot(v_row.ls_txid, ev_snapshot)
+				order by ev_seqno limit 1;
+		if not found then
+			v_sync_time := NULL;
+		end if;
+
+		perform @NAMESPACE@.latencyAddSample(p_origin, v_row.tab_set, 'sync',
+				v_sync_time - v_row.ls_origin_time);
+		perform @NAMESPACE@.latencyAddSample(p_origin, v_row.tab_set, 'queue',
+				v_start - v_sync_time);
+		perform @NAMESPACE@.latencyAddSample(p_origin, v_row.tab_set, 'fetch',
+				v_row.ls_apply_time - v_start);
+		perform @NAMESPACE@.latencyAddSample(p_origin, v_row.tab_set, 'apply',
+				v_commit - v_row.ls_apply_time);
+		perform @NAMESPACE@.latencyAddSample(p_origin, v_row.tab_set, 'total',
+				v_commit - v_row.ls_origin_time);
+		v_num := v_num + 1;
+	end loop;
+
+	delete from @NAMESPACE@.sl_latency_sample where ls_origin = p_origin;
+	return v_num;
+end;
+$$ language plpgsql;
+comment on function @NAMESPACE@.logApplyLatency (p_origin int4, p_seqno_first int8, p_seqno_last int8) is 
+'Called by the remote worker at the end of every SYNC group from
+p_origin.  Turns the latency trace markers applied in this group into
+sl_latency_hist entries and removes them from sl_latency_sample.';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION logCompactRows (local_node)
+--
+--	Return the log rows of pg_temp.sl_log_compact with the changes to
+--	each row of a table collapsed into their net effect.
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.logCompactRows (p_local_node int4)
+returns setof @NAMESPACE@.sl_log_1
+as $$
+declare
+	v_row			@NAMESPACE@.sl_log_1%rowtype;
+begin
+	-- ----
+	-- DDL may change what the rows of a table mean, so a group with
+	-- EXECUTE SCRIPT in it is applied as is.
+	-- ----
+	if exists (select 1 from pg_temp.sl_log_compact
+			where log_cmdtype in ('S', 's')) then
+		return query select * from pg_temp.sl_log_compact;
+		return;
+	end if;
+
+	-- ----
+	-- The query needs PostgreSQL 9.4, and runs with EXECUTE so that the
+	-- function can be created on older versions, which get the rows
+	-- unchanged.
+	-- ----
+	if pg_catalog.current_setting('server_version_num')::int4 < 90400 then
+		return query select * from pg_temp.sl_log_compact;
+		return;
+	end if;
+
+	for v_row in execute 'with CT0 as (
+		-- ----
+		-- Tables that may be compacted: not forwarded, no replica or
+		-- always triggers, no unique or exclusion constraint other than
+		-- the key, and no TRUNCATE or bulk load in this group.
+		-- ----
+		select T.tab_id as ct_tab_id,
+				array(select PGA.attname::text
+					from "pg_catalog".pg_attribute PGA
+					where PGA.attrelid = T.tab_reloid
+						and PGA.attnum = any (PGX.indkey)
+					order by PGA.attnum) as ct_keycols
+			from @NAMESPACE@.sl_table T,
+				"pg_catalog".pg_index PGX,
+				"pg_catalog".pg_class PGXC
+			where PGX.indrelid = T.tab_reloid
+				and PGX.indexrelid = PGXC.oid
+				and PGXC.relname = T.tab_idxname
+				and T.tab_id in (select L.log_tableid
+					from pg_temp.sl_log_compact L)
+				and exists (select 1 from @NAMESPACE@.sl_subscribe S
+					where S.sub_set = T.tab_set
+						and S.sub_receiver = ' || p_local_node || '
+						and not S.sub_forward)
+				and not exists (select 1 from "pg_catalog".pg_trigger TG
+					where TG.tgrelid = T.tab_reloid
+						and not TG.tgisinternal
+						and TG.tgenabled in (''R'', ''A''))
+				and not exists (select 1 from "pg_catalog".pg_index X
+					where X.indrelid = T.tab_reloid
+						and X.indexrelid <> PGX.indexrelid
+						and (X.indisunique or X.indisexclusion))
+				and not exists (select 1 from pg_temp.sl_log_compact L
+					where L.log_tableid = T.tab_id
+						and L.log_cmdtype not in (''I'', ''U'', ''D'', ''M''))
+	),
+	CT as (
+		-- ----
+		-- Updates of key columns move a row to another key, leave
+		-- those tables alone too.
+		-- ----
+		select CT0.* from CT0
+			where not exists (select 1 from pg_temp.sl_log_compact L
+				where L.log_tableid = CT0.ct_tab_id
+					and L.log_cmdtype = ''U''
+					and exists (select 1
+						from "pg_catalog".generate_series(1,
+							L.log_cmdupdncols) as i
+						where L.log_cmdargs[i * 2 - 1] = any (CT0.ct_keycols)))
+	),
+	R as (
+		-- ----
+		-- The log rows of these tables with their key values.
+		-- ----
+		select L.*, CT.ct_keycols as r_keycols,
+				array(select @NAMESPACE@.logCmdArg(L.log_cmdargs, K.k)
+					from "pg_catalog".unnest(CT.ct_keycols) as K(k))::text
+					as r_key
+			from pg_temp.sl_log_compact L, CT
+			where L.log_tableid = CT.ct_tab_id
+				and L.log_cmdtype in (''I'', ''U'', ''D'')
+	),
+	G as (
+		-- ----
+		-- One entry per changed row: the first and last change, and the
+		-- last INSERT.
+		-- ----
+		select R.log_tableid, R.r_key, "pg_catalog".count(*) as g_rows,
+				"pg_catalog".min(R.log_actionseq) as g_first,
+				"pg_catalog".max(R.log_actionseq) as g_last,
+				"pg_catalog".max(case when R.log_cmdtype = ''I''
+					then R.log_actionseq end) as g_last_ins
+			from R
+			group by R.log_tableid, R.r_key
+	),
+	V as (
+		-- ----
+		-- The final value of every column set from the last INSERT on,
+		-- or by all UPDATEs if there is no INSERT.
+		-- ----
+		select distinct on (R.log_tableid, R.r_key, C.col)
+				R.log_tableid, R.r_key, C.col, C.val
+			from R, G,
+				lateral (select R.log_cmdargs[i * 2 - 1] as col,
+						R.log_cmdargs[i * 2] as val
+					from "pg_catalog".generate_series(1,
+						case when R.log_cmdtype = ''I''
+							then "pg_catalog".array_upper(R.log_cmdargs, 1) / 2
+							else R.log_cmdupdncols end) as i) as C
+			where G.log_tableid = R.log_tableid
+				and G.r_key = R.r_key
+				and G.g_rows > 1
+				and R.log_cmdtype in (''I'', ''U'')
+				and R.log_actionseq >= coalesce(G.g_last_ins, G.g_first)
+			order by R.log_tableid, R.r_key, C.col, R.log_actionseq desc
+	),
+	N as (
+		-- ----
+		-- The net change of every row changed more than once. A row
+		-- inserted and deleted again vanishes, a DELETE followed by an
+		-- INSERT becomes an UPDATE of all columns.
+		-- ----
+		select LR.log_origin, LR.log_txid, LR.log_tableid,
+				LR.log_actionseq, LR.log_tablenspname, LR.log_tablerelname,
+				case when FR.log_cmdtype = ''I'' then ''I''::"char"
+					when LR.log_cmdtype = ''D'' then ''D''::"char"
+					else ''U''::"char" end as log_cmdtype,
+				case when FR.log_cmdtype = ''I'' then 0
+					when LR.log_cmdtype = ''D'' then LR.log_cmdupdncols
+					else coalesce("pg_catalog".array_upper(NV.nv_set, 1), 0) / 2
+					end as log_cmdupdncols,
+				case when FR.log_cmdtype = ''I'' then NV.nv_all
+					when LR.log_cmdtype = ''D'' then LR.log_cmdargs
+					else NV.nv_set || NV.nv_key end as log_cmdargs,
+				LR.log_setid,
+				(FR.log_cmdtype = ''I'' and LR.log_cmdtype = ''D'')
+					or (FR.log_cmdtype <> ''I'' and LR.log_cmdtype <> ''D''
+						and NV.nv_set is null) as n_drop
+			from G, R FR, R LR,
+				lateral (select
+					"pg_catalog".array_agg(E.e order by PGA.attnum, E.n)
+						as nv_all,
+					"pg_catalog".array_agg(E.e order by PGA.attnum, E.n)
+						filter (where not V.col = any (LR.r_keycols))
+						as nv_set,
+					array(select E2.e
+						from "pg_catalog".unnest(LR.r_keycols)
+							with ordinality as K(k, o),
+							lateral (values (K.k, 1),
+								(@NAMESPACE@.logCmdArg(LR.log_cmdargs, K.k), 2))
+								as E2(e, n)
+						order by K.o, E2.n) as nv_key
+					from V, @NAMESPACE@.sl_table T,
+						"pg_catalog".pg_attribute PGA,
+						lateral (values (V.col, 1), (V.val, 2)) as E(e, n)
+					where V.log_tableid = G.log_tableid
+						and V.r_key = G.r_key
+						and T.tab_id = G.log_tableid
+						and PGA.attrelid = T.tab_reloid
+						and PGA.attname = V.col) as NV
+			where G.g_rows > 1
+				and FR.log_tableid = G.log_tableid
+				and FR.log_actionseq = G.g_first
+				and LR.log_tableid = G.log_tableid
+				and LR.log_actionseq = G.g_last
+	)
+	select L.* from pg_temp.sl_log_compact L
+		where L.log_cmdtype not in (''I'', ''U'', ''D'')
+			or not exists (select 1 from CT
+				where CT.ct_tab_id = L.log_tableid)
+	union all
+	select R.log_origin, R.log_txid, R.log_tableid, R.log_actionseq,
+			R.log_tablenspname, R.log_tablerelname, R.log_cmdtype,
+			R.log_cmdupdncols, R.log_cmdargs, R.log_setid
+		from R, G
+		where G.log_tableid = R.log_tableid
+			and G.r_key = R.r_key
+			and G.g_rows = 1
+	union all
+	select N.log_origin, N.log_txid, N.log_tableid, N.log_actionseq,
+			N.log_tablenspname, N.log_tablerelname, N.log_cmdtype,
+			N.log_cmdupdncols, N.log_cmdargs, N.log_setid
+		from N
+		where not N.n_drop'
+	loop
+		return next v_row;
+	end loop;
+end;
+$$ language plpgsql;
+comment on function @NAMESPACE@.logCompactRows (p_local_node int4) is
+'logCompactRows (local_node)
+
+Returns the log rows copied into pg_temp.sl_log_compact, with all
+changes to the same row of a table, identified by its key, collapsed
+into one INSERT, UPDATE or DELETE.  Tables that are forwarded, have
+replica or always triggers, unique or exclusion constraints other than
+the key, or that were truncated, bulk loaded or had a key column
+updated in the group are returned unchanged, as are groups containing
+an EXECUTE SCRIPT.  Returns all rows unchanged before PostgreSQL 9.4.
+Used by logCompact().';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION logCompact (log_table)
+--
+--	Apply the log rows of a SYNC group staged in pg_temp.sl_log_compact
+--	by inserting their net changes into sl_log_1 or sl_log_2.
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.logCompact (p_log_table int4)
+returns int8
+as $$
+declare
+	v_local_node	int4;
+	v_in			int8;
+	v_out			int8;
+begin
+	v_local_node := @NAMESPACE@.getLocalNodeId('_@CLUSTERNAME@');
+	select "pg_catalog".count(*) into v_in from pg_temp.sl_log_compact;
+
+	if p_log_table = 1 then
+		insert into @NAMESPACE@.sl_log_1 (log_origin, log_txid,
+				log_tableid, log_actionseq, log_tablenspname,
+				log_tablerelname, log_cmdtype, log_cmdupdncols,
+				log_cmdargs, log_setid)
+			select log_origin, log_txid, log_tableid, log_actionseq,
+					log_tablenspname, log_tablerelname, log_cmdtype,
+					log_cmdupdncols, log_cmdargs, log_setid
+				from @NAMESPACE@.logCompactRows(v_local_node)
+				order by log_actionseq;
+	else
+		insert into @NAMESPACE@.sl_log_2 (log_origin, log_txid,
+				log_tableid, log_actionseq, log_tablenspname,
+				log_tablerelname, log_cmdtype, log_cmdupdncols,
+				log_cmdargs, log_setid)
+			select log_origin, log_txid, log_tableid, log_actionseq,
+					log_tablenspname, log_tablerelname, log_cmdtype,
+					log_cmdupdncols, log_cmdargs, log_setid
+				from @NAMESPACE@.logCompactRows(v_local_node)
+				order by log_actionseq;
+	end if;
+	get diagnostics v_out = row_count;
+
+	truncate pg_temp.sl_log_compact;
+	return v_in - v_out;
+end;
+$$ language plpgsql;
+comment on function @NAMESPACE@.logCompact (p_log_table int4) is
+'logCompact (log_table)
+
+Called by the remote worker for a group of several SYNCs when
+sync_group_compaction is on.  The log rows of the group have been
+copied into the temporary table sl_log_compact instead of the log
+table.  Inserts their net changes (see logCompactRows()) into
+sl_log_<log_table> in log_actionseq order, which applies them, and
+empties sl_log_compact.  Returns the number of log rows saved.';
+
+
+-- ----------------------------------------------------------------------
+-- FUNCTION enableLogicalCapture ()
+--
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.enableLogicalCapture ()
+returns int4
+as $$
+declare
+	v_no_id			int4;
+	v_slot			text;
+	v_tab_row		record;
+	v_n				int4 := 0;
+begin
+	if pg_catalog.current_setting('server_version_num')::int4 < 110000 then
+		raise exception 'Slony-I: enableLogicalCapture(): requires PostgreSQL 11 or later';
+	end if;
+	if pg_catalog.current_setting('wal_level') <> 'logical' then
+		raise exception 'Slony-I: enableLogicalCapture(): wal_level must be logical';
+	end if;
+
+	v_no_id := @NAMESPACE@.getLocalNodeId('_@CLUSTERNAME@');
+	v_slot := 'slony1_' ||
+			pg_catalog.regexp_replace(pg_catalog.lower('@CLUSTERNAME@'),
+					'[^a-z0-9_]', '_', 'g') || '_' || v_no_id;
+
+	-- ----
+	-- A subscriber copying a set right now builds its action list from
+	-- sl_log, see subscribeSet().
+	-- ----
+	if exists (select 1 from @NAMESPACE@.sl_set
+			where set_origin = v_no_id
+				and @NAMESPACE@.isSubscriptionInProgress(set_id)) then
+		raise exception 'Slony-I: enableLogicalCapture(): subscriptions in progress';
+	end if;
+
+	-- ----
+	-- The slot has to exist before the log trigger stops logging. Creating
+	-- it waits for all running transactions, and it must happen before
+	-- this transaction writes anything.
+	-- ----
+	if not exists (select 1 from "pg_catalog".pg_replication_slots
+			where slot_name = v_slot) then
+		perform "pg_catalog".pg_create_logical_replication_slot(v_slot,
+				'$libdir/slony1_funcs.@MODULEVERSION@');
+		perform @NAMESPACE@.registry_set_text('logical_capture_lsn', NULL);
+	end if;
+
+	-- ----
+	-- UPDATE and DELETE carry the old key in the WAL only for the
+	-- replica identity columns, so make that the Slony-I key index.
+	-- ----
+	for v_tab_row in select T.tab_idxname,
+			@NAMESPACE@.slon_quote_brute(T.tab_nspname) || '.' ||
+			@NAMESPACE@.slon_quote_brute(T.tab_relname) as tab_fqname
+			from @NAMESPACE@.sl_table T, @NAMESPACE@.sl_set S
+			where T.tab_set = S.set_id
+				and S.set_origin = v_no_id
+	loop
+		execute 'alter table ' || v_tab_row.tab_fqname ||
+				' replica identity using index ' ||
+				@NAMESPACE@.slon_quote_brute(v_tab_row.tab_idxname);
+		v_n := v_n + 1;
+	end loop;
+
+	perform @NAMESPACE@.registry_set_text('logical_capture_slot', v_slot);
+	perform @NAMESPACE@.registry_set_text('logical_capture_off_xmax', NULL);
+	perform @NAMESPACE@.registry_set_int4('logical_capture_drop', NULL);
+	perform @NAMESPACE@.registry_set_int4('logical_capture', 1);
+	return v_n;
+end;
+$$ language plpgsql;
+comment on function @NAMESPACE@.enableLogicalCapture () is 
+'enableLogicalCapture ()
+
+Run on an origin node to capture changes to replicated tables with
+logical decoding instead of the log trigger.  Creates the replication
+slot, sets the replica identity of all tables originating here to
+their key index and returns the number of tables.  Must be called in
+a transaction of its own.  The local slon moves the decoded changes
+into sl_log_1/sl_log_2 right before generating each SYNC.';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION disableLogicalCapture ()
+--
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.disableLogicalCapture ()
+returns int4
+as $$
+begin
+	perform @NAMESPACE@.registry_set_int4('logical_capture', NULL);
+	return 0;
+end;
+$$ language plpgsql;
+comment on function @NAMESPACE@.disableLogicalCapture () is 
+'disableLogicalCapture ()
+
+Switch an origin node back to trigger based capture.  The slon keeps
+draining the replication slot until all transactions that still
+started in logical capture mode have finished, then drops it.';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION logicalCaptureFlush ()
+--
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.logicalCaptureFlush ()
+returns text
+    as '$libdir/slony1_funcs.@MODULEVERSION@', '_Slony_I_@FUNCVERSION@_logicalCaptureFlush'
+	language C;
+comment on function @NAMESPACE@.logicalCaptureFlush () is 
+'Flush the WAL up to the current insert position and return it.';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION logicalCaptureDrain ()
+--
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.logicalCaptureDrain ()
+returns int8
+as $$
+declare
+	v_slot			text;
+	v_no_id			int4;
+	v_done_lsn		text;
+	v_upto_lsn		text;
+	v_off_xmax		int8;
+	v_log_table		text;
+	v_count			int8;
+	v_nokey			int8;
+begin
+	v_slot := @NAMESPACE@.registry_get_text('logical_capture_slot', NULL);
+	if v_slot is null then
+		return 0;
+	end if;
+
+	-- ----
+	-- A previous call switched capture off for good. Dropping the
+	-- slot is not transactional, so tolerate it being gone already.
+	-- ----
+	if @NAMESPACE@.registry_get_int4('logical_capture_drop', 0) = 1 then
+		if exists (select 1 from "pg_catalog".pg_replication_slots
+				where slot_name = v_slot) then
+			perform "pg_catalog".pg_drop_replication_slot(v_slot);
+		end if;
+		perform @NAMESPACE@.registry_set_text('logical_capture_slot', NULL);
+		perform @NAMESPACE@.registry_set_text('logical_capture_lsn', NULL);
+		perform @NAMESPACE@.registry_set_text('logical_capture_off_xmax', NULL);
+		perform @NAMESPACE@.registry_set_int4('logical_capture_drop', NULL);
+		return 0;
+	end if;
+
+	-- ----
+	-- Advancing the slot is not transactional either. Catch it up with
+	-- what the last committed call has moved into sl_log already.
+	-- ----
+	v_done_lsn := @NAMESPACE@.registry_get_text('logical_capture_lsn', NULL);
+	if v_done_lsn is not null and exists (select 1
+			from "pg_catalog".pg_replication_slots
+			where slot_name = v_slot
+				and confirmed_flush_lsn < v_done_lsn::pg_lsn) then
+		perform "pg_catalog".pg_replication_slot_advance(v_slot,
+				v_done_lsn::pg_lsn);
+	end if;
+
+	-- ----
+	-- The commit records of all transactions visible to our snapshot
+	-- are before the current WAL insert position. Decode everything
+	-- up to there. The resulting rows use the log trigger formatting.
+	-- ----
+	v_no_id := @NAMESPACE@.getLocalNodeId('_@CLUSTERNAME@');
+	v_upto_lsn := @NAMESPACE@.logicalCaptureFlush();
+	perform "pg_catalog".set_config('DateStyle', 'ISO', true);
+
+	if (select last_value from @NAMESPACE@.sl_log_status) in (0, 2) then
+		v_log_table := 'sl_log_1';
+	else
+		v_log_table := 'sl_log_2';
+	end if;
+
+	-- ----
+	-- Transactions that wrote to sl_log themselves were captured by the
+	-- log trigger. Decoded xids are extended to txids with the epoch
+	-- of our own txid, which is newer than all of them.
+	--
+	-- The decoder sees all columns. For tables replicating a subset of
+	-- their columns (tab_columns) the others are removed here the way
+	-- logTrigger() skips them, and an UPDATE left without any changed
+	-- column is not logged.
+	--
+	-- With latency tracing on, the decoder adds the trace markers.
+	-- ----
+	execute 'with C as (
+			select D.xid::text::int8 as xid, D.data, D.ord
+				from "pg_catalog".pg_logical_slot_peek_changes($1, $2::pg_lsn,
+					NULL, ''skip_namespace'', $3, ''trace_interval'', $6)
+					with ordinality as D (lsn, xid, data, ord)
+		), R as (
+			select C.xid, C.ord, C.data::text[] as rec
+				from C
+				where C.data <> ''L''
+					and C.xid not in (select xid from C where data = ''L'')
+		), K as (
+			select T.tab_id, T.tab_columns || array(
+					select PGA.attname::text
+						from "pg_catalog".pg_index PGX,
+							"pg_catalog".pg_class PGXC,
+							"pg_catalog".pg_attribute PGA
+						where PGX.indrelid = T.tab_reloid
+							and PGX.indexrelid = PGXC.oid
+							and PGXC.relname = T.tab_idxname
+							and PGA.attrelid = T.tab_reloid
+							and PGA.attnum = any (PGX.indkey)) as keep
+				from @NAMESPACE@.sl_table T
+				where T.tab_columns is not null
+		), I as (
+			insert into @NAMESPACE@.' || v_log_table || ' (
+					log_origin, log_txid, log_tableid, log_actionseq,
+					log_cmdtype, log_cmdupdncols, log_cmdargs, log_setid)
+			select $4, X.txid, X.tab_id,
+					nextval(''@NAMESPACE@.sl_action_seq''),
+					X.cmdtype, X.cmdupdncols, X.cmdargs, X.tab_set
+				from (select Y.* from (select P.ord, P.txid, P.tab_id,
+						P.tab_set, P.cmdtype,
+						case when P.keep is null then P.cmdupdncols
+							else (select count(*)
+								from "pg_catalog".generate_series(1,
+									P.cmdupdncols) as G (n)
+								where P.cmdargs[2 * G.n - 1] = any (P.keep))::int4
+						end as cmdupdncols,
+						case when P.keep is null then P.cmdargs
+							else array(select A.elem
+								from unnest(P.cmdargs) with ordinality
+									as A (elem, n)
+								where P.cmdtype not in (''I'', ''U'')
+									or (P.cmdtype = ''U''
+										and A.n > P.cmdupdncols * 2)
+									or P.cmdargs[A.n - 1 + A.n % 2] = any (P.keep)
+								order by A.n)
+						end as cmdargs,
+						P.keep is not null as projected
+					from (select R.ord, ((($5 >> 32) -
+								case when R.xid > ($5 & 4294967295) then 1
+									else 0 end) << 32) | R.xid as txid,
+							T.tab_id, T.tab_set, K.keep,
+							R.rec[1] as cmdtype, R.rec[4]::int4 as cmdupdncols,
+							R.rec[5:"pg_catalog".array_upper(R.rec, 1)] as cmdargs
+						from R
+							join @NAMESPACE@.sl_table T
+								on T.tab_nspname = R.rec[2]
+									and T.tab_relname = R.rec[3]
+							join @NAMESPACE@.sl_set S
+								on T.tab_set = S.set_id
+							left join K on K.tab_id = T.tab_id
+						where S.set_origin = $4) P) Y
+					where not (Y.projected and Y.cmdtype = ''U''
+						and Y.cmdupdncols = 0)
+					order by Y.ord) X
+			returning log_cmdtype, log_cmdupdncols, log_cmdargs
+		)
+		select count(*),
+			count(*) filter (where log_cmdtype in (''U'', ''D'')
+				and coalesce("pg_catalog".array_length(log_cmdargs, 1), 0) =
+					log_cmdupdncols * 2)
+			from I'
+		into v_count, v_nokey
+		using v_slot, v_upto_lsn, '_@CLUSTERNAME@', v_no_id,
+			"pg_catalog".txid_current(),
+			coalesce(@NAMESPACE@.registry_get_int4('latency_trace_interval',
+					0), 0)::text;
+
+	if v_nokey > 0 then
+		raise exception 'Slony-I: logicalCaptureDrain(): % decoded UPDATE/DELETE rows without key columns - check the replica identity of the replicated tables', v_nokey;
+	end if;
+
+	update @NAMESPACE@.sl_registry set reg_text = v_upto_lsn
+			where reg_key = 'logical_capture_lsn';
+	if not found then
+		insert into @NAMESPACE@.sl_registry (reg_key, reg_text)
+				values ('logical_capture_lsn', v_upto_lsn);
+	end if;
+
+	-- ----
+	-- After disableLogicalCapture() the slot is kept until no
+	-- transaction is left that may have seen logical capture on.
+	-- Those all have xids below the xmax of the first snapshot that
+	-- sees capture off.
+	-- ----
+	if @NAMESPACE@.registry_get_int4('logical_capture', 0) <> 1 then
+		v_off_xmax := @NAMESPACE@.registry_get_text('logical_capture_off_xmax', NULL)::int8;
+		if v_off_xmax is null then
+			perform @NAMESPACE@.registry_set_text('logical_capture_off_xmax',
+					"pg_catalog".txid_snapshot_xmax(
+						"pg_catalog".txid_current_snapshot())::text);
+		elsif "pg_catalog".txid_snapshot_xmin(
+				"pg_catalog".txid_current_snapshot()) >= v_off_xmax then
+			perform @NAMESPACE@.registry_set_int4('logical_capture_drop', 1);
+		end if;
+	end if;
+
+	return v_count;
+end;
+$$ language plpgsql;
+comment on function @NAMESPACE@.logicalCaptureDrain () is 
+'logicalCaptureDrain ()
+
+Called by the local slon in the transaction that generates a SYNC,
+after the SYNC snapshot was taken, and by ddlCapture().  Moves the
+changes decoded from the logical capture slot into the active sl_log
+table and returns their number.  Returns 0 immediately if logical capture was never enabled.';
+
 
 -- ----------------------------------------------------------------------
 -- FUNCTION determineIdxnameUnique (tab_fqname, indexname)
@@ -4888,6 +6337,27 @@ is no unique index, it raises an exception.';
 -- ----------------------------------------------------------------------
 create or replace function @NAMESPACE@.determineAttkindUnique(p_tab_fqname text, p_idx_name name) returns text
 as $$
+begin
+	return @NAMESPACE@.determineAttkindUnique(p_tab_fqname, p_idx_name, NULL);
+end;
+$$ language plpgsql called on null input;
+
+comment on function @NAMESPACE@.determineAttkindUnique(p_tab_fqname text, p_idx_name name) is
+'determineAttKindUnique (tab_fqname, indexname)
+
+Given a tablename, return the Slony-I specific attkind (used for the
+log trigger) of the table. Use the specified unique index or the
+primary key (if indexname is NULL).';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION determineAttKindUnique (tab_fqname, indexname, columns)
+--
+--	Same as above, but columns that are neither key columns nor listed
+--	in columns get an "i" and are not logged. A NULL column list
+--	replicates all columns.
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.determineAttkindUnique(p_tab_fqname text, p_idx_name name, p_columns text[]) returns text
+as $$
 declare
 	v_tab_fqname_quoted	text default '';
 	v_idx_name_quoted	text;
@@ -4940,7 +6410,7 @@ begin
 	--
 	-- Loop over the tables attributes and check if they are
 	-- index attributes. If so, add a "k" to the return value,
-	-- otherwise add a "v".
+	-- otherwise add a "v", or an "i" for columns not replicated.
 	--
 	for v_attrow in select PGA.attnum, PGA.attname
 			from "pg_catalog".pg_class PGC,
@@ -4972,8 +6442,10 @@ begin
 
 		if v_attfound then
 			v_attkind := v_attkind || 'k';
-		else
+		elsif p_columns is null or v_attrow.attname = any (p_columns) then
 			v_attkind := v_attkind || 'v';
+		else
+			v_attkind := v_attkind || 'i';
 		end if;
 	end loop;
 
@@ -4987,12 +6459,13 @@ begin
 end;
 $$ language plpgsql called on null input;
 
-comment on function @NAMESPACE@.determineAttkindUnique(p_tab_fqname text, p_idx_name name) is
-'determineAttKindUnique (tab_fqname, indexname)
+comment on function @NAMESPACE@.determineAttkindUnique(p_tab_fqname text, p_idx_name name, p_columns text[]) is
+'determineAttKindUnique (tab_fqname, indexname, columns)
 
 Given a tablename, return the Slony-I specific attkind (used for the
 log trigger) of the table. Use the specified unique index or the
-primary key (if indexname is NULL).';
+primary key (if indexname is NULL).  Columns that are neither part of
+the index nor listed in columns are marked "i" and not logged.';
 
 
 -- ----------------------------------------------------------------------
@@ -5005,138 +6478,191 @@ create or replace function @NAMESPACE@.RebuildListenEntries()
 returns int
 as $$
 declare
-	v_row	record;
-        v_cnt  integer;
+	v_depth		int4;
 begin
 	-- ----
 	-- Grab the central configuration lock
 	-- ----
 	lock table @NAMESPACE@.sl_config_lock;
 
-	-- First remove the entire configuration
-	delete from @NAMESPACE@.sl_listen;
-
-	-- Second populate the sl_listen configuration with a full
-	-- network of all possible paths.
-	insert into @NAMESPACE@.sl_listen
-				(li_origin, li_provider, li_receiver)
-			select pa_server, pa_server, pa_client from @NAMESPACE@.sl_path;
-	while true loop
-		insert into @NAMESPACE@.sl_listen
-					(li_origin, li_provider, li_receiver)
-			select distinct li_origin, pa_server, pa_client
-				from @NAMESPACE@.sl_listen, @NAMESPACE@.sl_path
-				where li_receiver = pa_server
-				  and li_origin <> pa_client
-				  and pa_conninfo<>'<event pending>'
-			except
-			select li_origin, li_provider, li_receiver
-				from @NAMESPACE@.sl_listen;
+	-- ----
+	-- The new listen network is computed in scratch tables that are
+	-- kept for the rest of the session, and only the difference to
+	-- the current sl_listen is applied at the end.
+	-- ----
+	if not exists (select true from "pg_catalog".pg_class
+			where relname = 'sl_listen_new'
+			  and relnamespace = "pg_catalog".pg_my_temp_schema())
+	then
+		create temp table sl_listen_reach (
+			lr_origin		int4,
+			lr_node			int4,
+			lr_depth		int4,
+			primary key (lr_origin, lr_node)
+		) on commit delete rows;
+		create temp table sl_listen_new (
+			li_origin		int4,
+			li_provider		int4,
+			li_receiver		int4,
+			primary key (li_origin, li_provider, li_receiver)
+		) on commit delete rows;
+	else
+		truncate pg_temp.sl_listen_reach, pg_temp.sl_listen_new;
+	end if;
 
+	-- First find every node that can receive events from each origin,
+	-- breadth first, only following the newly reached nodes of the
+	-- previous step.
+	insert into pg_temp.sl_listen_reach (lr_origin, lr_node, lr_depth)
+			select pa_server, pa_client, 1 from @NAMESPACE@.sl_path;
+	v_depth := 1;
+	loop
+		insert into pg_temp.sl_listen_reach (lr_origin, lr_node, lr_depth)
+			select distinct R.lr_origin, P.pa_client, v_depth + 1
+				from pg_temp.sl_listen_reach R, @NAMESPACE@.sl_path P
+				where R.lr_depth = v_depth
+				  and P.pa_server = R.lr_node
+				  and P.pa_client <> R.lr_origin
+				  and P.pa_conninfo <> '<event pending>'
+				  and not exists (select true from pg_temp.sl_listen_reach R2
+						where R2.lr_origin = R.lr_origin
+						  and R2.lr_node = P.pa_client);
 		if not found then
 			exit;
 		end if;
+		v_depth := v_depth + 1;
 	end loop;
 
+	-- Second populate the sl_listen configuration with a full
+	-- network of all possible paths.
+	insert into pg_temp.sl_listen_new (li_origin, li_provider, li_receiver)
+			select pa_server, pa_server, pa_client from @NAMESPACE@.sl_path;
+	insert into pg_temp.sl_listen_new (li_origin, li_provider, li_receiver)
+			select distinct R.lr_origin, P.pa_server, P.pa_client
+				from pg_temp.sl_listen_reach R, @NAMESPACE@.sl_path P
+				where P.pa_server = R.lr_node
+				  and P.pa_client <> R.lr_origin
+				  and P.pa_conninfo <> '<event pending>';
+
 	-- We now replace specific event-origin,receiver combinations
 	-- with a configuration that tries to avoid events arriving at
 	-- a node before the data provider actually has the data ready.
 
-	-- Loop over every possible pair of receiver and event origin
-	for v_row in select N1.no_id as receiver, N2.no_id as origin,
-			  N2.no_failed as failed
-			from @NAMESPACE@.sl_node as N1, @NAMESPACE@.sl_node as N2
-			where N1.no_id <> N2.no_id
-	loop
-		-- 1st choice:
-		-- If we use the event origin as a data provider for any
-		-- set that originates on that very node, we are a direct
-		-- subscriber to that origin and listen there only.
-		if exists (select true from @NAMESPACE@.sl_set, @NAMESPACE@.sl_subscribe				, @NAMESPACE@.sl_node p		   		
-				where set_origin = v_row.origin
-				  and sub_set = set_id
-				  and sub_provider = v_row.origin
-				  and sub_receiver = v_row.receiver
+	-- 1st choice:
+	-- If we use the event origin as a data provider for any
+	-- set that originates on that very node, we are a direct
+	-- subscriber to that origin and listen there only.
+	delete from pg_temp.sl_listen_new
+		where (li_origin, li_receiver) in
+			(select set_origin, sub_receiver
+				from @NAMESPACE@.sl_set, @NAMESPACE@.sl_subscribe,
+					@NAMESPACE@.sl_node p
+				where sub_set = set_id
+				  and sub_provider = set_origin
+				  and sub_receiver <> set_origin
 				  and sub_active
 				  and p.no_active
-				  and p.no_id=sub_provider
-				  )
-		then
-			delete from @NAMESPACE@.sl_listen
-				where li_origin = v_row.origin
-				  and li_receiver = v_row.receiver;
-			insert into @NAMESPACE@.sl_listen (li_origin, li_provider, li_receiver)
-				values (v_row.origin, v_row.origin, v_row.receiver);
-		
-		-- 2nd choice:
-		-- If we are subscribed to any set originating on this
-		-- event origin, we want to listen on all data providers
-		-- we use for this origin. We are a cascaded subscriber
-		-- for sets from this node.
-		else
-				if exists (select true from @NAMESPACE@.sl_set, @NAMESPACE@.sl_subscribe,
-				   	  	       @NAMESPACE@.sl_node provider
-						where set_origin = v_row.origin
-						  and sub_set = set_id
-						  and sub_provider=provider.no_id
-						  and provider.no_failed = false
-						  and sub_receiver = v_row.receiver
-						  and sub_active)
-				then
-						delete from @NAMESPACE@.sl_listen
-							   where li_origin = v_row.origin
-					  		   and li_receiver = v_row.receiver;
-						insert into @NAMESPACE@.sl_listen (li_origin, li_provider, li_receiver)
-						select distinct set_origin, sub_provider, v_row.receiver
-							   from @NAMESPACE@.sl_set, @NAMESPACE@.sl_subscribe
-						where set_origin = v_row.origin
-						  and sub_set = set_id
-						  and sub_receiver = v_row.receiver
-						  and sub_active;
-				end if;
-		end if;
-
-		if v_row.failed then		
-
-		--for every failed node we delete all sl_listen entries
-		--except via providers (listed in sl_subscribe)
-		--or failover candidates (sl_failover_targets)
-		--we do this to prevent a non-failover candidate
-		--that is more ahead of the failover candidate from
-		--sending events to the failover candidate that
-		--are 'too far ahead'
-
-		--if the failed node is not an origin for any
-                --node then we don't delete all listen paths
-		--for events from it.  Instead we leave
-                --the listen network alone.
-		
-		select count(*) into v_cnt from @NAMESPACE@.sl_subscribe sub,
-		       @NAMESPACE@.sl_set s
-                       where s.set_origin=v_row.origin and s.set_id=sub.sub_set;
-                if v_cnt > 0 then
-		    delete from @NAMESPACE@.sl_listen where
-			   li_origin=v_row.origin and
-			   li_receiver=v_row.receiver			
-			   and li_provider not in 
-			       (select sub_provider from
-			       @NAMESPACE@.sl_subscribe,
-			       @NAMESPACE@.sl_set where
-			       sub_set=set_id
-			       and set_origin=v_row.origin);
-		    end if;
-               end if;
---		   insert into @NAMESPACE@.sl_listen
---		   		  (li_origin,li_provider,li_receiver)
---				  SELECT v_row.origin, pa_server
---				  ,v_row.receiver
---				  FROM @NAMESPACE@.sl_path where
---				  	   pa_client=v_row.receiver
---				  and (v_row.origin,pa_server,v_row.receiver) not in
---				  	  		(select li_origin,li_provider,li_receiver
---					  		from @NAMESPACE@.sl_listen);
---		end if;
-	end loop ;
+				  and p.no_id = sub_provider);
+	insert into pg_temp.sl_listen_new (li_origin, li_provider, li_receiver)
+		select distinct set_origin, set_origin, sub_receiver
+			from @NAMESPACE@.sl_set, @NAMESPACE@.sl_subscribe,
+				@NAMESPACE@.sl_node p
+			where sub_set = set_id
+			  and sub_provider = set_origin
+			  and sub_receiver <> set_origin
+			  and sub_active
+			  and p.no_active
+			  and p.no_id = sub_provider;
+
+	-- 2nd choice:
+	-- If we are subscribed to any set originating on this
+	-- event origin, we want to listen on all data providers
+	-- we use for this origin. We are a cascaded subscriber
+	-- for sets from this node.
+	delete from pg_temp.sl_listen_new
+		where (li_origin, li_receiver) in
+			(select set_origin, sub_receiver
+				from @NAMESPACE@.sl_set, @NAMESPACE@.sl_subscribe,
+					@NAMESPACE@.sl_node provider
+				where sub_set = set_id
+				  and sub_provider = provider.no_id
+				  and provider.no_failed = false
+				  and sub_receiver <> set_origin
+				  and sub_active
+			except
+			select set_origin, sub_receiver
+				from @NAMESPACE@.sl_set, @NAMESPACE@.sl_subscribe,
+					@NAMESPACE@.sl_node p
+				where sub_set = set_id
+				  and sub_provider = set_origin
+				  and sub_active
+				  and p.no_active
+				  and p.no_id = sub_provider);
+	insert into pg_temp.sl_listen_new (li_origin, li_provider, li_receiver)
+		select distinct set_origin, sub_provider, sub_receiver
+			from @NAMESPACE@.sl_set, @NAMESPACE@.sl_subscribe
+			where sub_set = set_id
+			  and sub_active
+			  and (set_origin, sub_receiver) in
+				(select set_origin, sub_receiver
+					from @NAMESPACE@.sl_set, @NAMESPACE@.sl_subscribe,
+						@NAMESPACE@.sl_node provider
+					where sub_set = set_id
+					  and sub_provider = provider.no_id
+					  and provider.no_failed = false
+					  and sub_receiver <> set_origin
+					  and sub_active
+				except
+				select set_origin, sub_receiver
+					from @NAMESPACE@.sl_set, @NAMESPACE@.sl_subscribe,
+						@NAMESPACE@.sl_node p
+					where sub_set = set_id
+					  and sub_provider = set_origin
+					  and sub_active
+					  and p.no_active
+					  and p.no_id = sub_provider);
+
+	--for every failed node we delete all sl_listen entries
+	--except via providers (listed in sl_subscribe)
+	--or failover candidates (sl_failover_targets)
+	--we do this to prevent a non-failover candidate
+	--that is more ahead of the failover candidate from
+	--sending events to the failover candidate that
+	--are 'too far ahead'
+
+	--if the failed node is not an origin for any
+	--node then we don't delete all listen paths
+	--for events from it.  Instead we leave
+	--the listen network alone.
+	delete from pg_temp.sl_listen_new
+		where li_origin in (select no_id from @NAMESPACE@.sl_node
+				where no_failed)
+		  and li_receiver in (select no_id from @NAMESPACE@.sl_node)
+		  and li_provider not in
+			(select sub_provider from @NAMESPACE@.sl_subscribe,
+				@NAMESPACE@.sl_set
+				where sub_set = set_id
+				  and set_origin = li_origin)
+		  and exists (select true from @NAMESPACE@.sl_subscribe,
+				@NAMESPACE@.sl_set
+				where sub_set = set_id
+				  and set_origin = li_origin);
+
+	-- ----
+	-- Apply the difference, so that a change to a single path or
+	-- subscription only touches the affected sl_listen rows.
+	-- ----
+	delete from @NAMESPACE@.sl_listen
+		where not exists (select true from pg_temp.sl_listen_new N
+				where N.li_origin = sl_listen.li_origin
+				  and N.li_provider = sl_listen.li_provider
+				  and N.li_receiver = sl_listen.li_receiver);
+	insert into @NAMESPACE@.sl_listen (li_origin, li_provider, li_receiver)
+		select li_origin, li_provider, li_receiver from pg_temp.sl_listen_new N
+			where not exists (select true from @NAMESPACE@.sl_listen L
+					where L.li_origin = N.li_origin
+					  and L.li_provider = N.li_provider
+					  and L.li_receiver = N.li_receiver);
 
 	return null ;
 end ;
@@ -5703,6 +7229,36 @@ create table @NAMESPACE@.sl_components (
 			) WITHOUT OIDS;';
 		execute v_query;
 	end if;
+
+	if not exists (select 1 from information_schema.tables t 
+			where table_schema = '_@CLUSTERNAME@' 
+			and table_name = 'sl_sync_perf') then
+		v_query := '
+			create table @NAMESPACE@.sl_sync_perf (
+				sp_origin			int4,
+				sp_seqno_first		int8,
+				sp_seqno_last		int8,
+				sp_num_syncs		int4,
+				sp_apply_time		timestamptz,
+				sp_num_rows			int8,
+				sp_num_bytes		int8,
+				sp_num_insert		int8,
+				sp_num_update		int8,
+				sp_num_delete		int8,
+				sp_num_truncate		int8,
+				sp_num_script		int8,
+				sp_duration			interval,
+				sp_provider_time	interval,
+				sp_subscriber_time	interval,
+				sp_first_row_delay	interval,
+				sp_cache_prepare	int8,
+				sp_cache_hit		int8,
+				sp_cache_evict		int8
+			) WITHOUT OIDS;';
+		execute v_query;
+		v_query := 'create index sl_sync_perf_idx1 on @NAMESPACE@.sl_sync_perf (sp_origin, sp_seqno_last);';
+		execute v_query;
+	end if;
 	
 	--
 	-- On the upgrade to 2.2, we change the layout of sl_log_N by
@@ -5876,6 +7432,92 @@ create table @NAMESPACE@.sl_components (
 	   alter table @NAMESPACE@.sl_node add column no_failed bool;
 	   update @NAMESPACE@.sl_node set no_failed=false;
 	end if;
+
+	if not exists (select 1 from information_schema.tables t 
+			where table_schema = '_@CLUSTERNAME@' 
+			and table_name = 'sl_latency_sample') then
+		create table @NAMESPACE@.sl_latency_sample (
+			ls_origin			int4,
+			ls_tableid			int4,
+			ls_txid				bigint,
+			ls_origin_time		timestamptz,
+			ls_apply_time		timestamptz
+		) WITHOUT OIDS;
+		create index sl_latency_sample_idx1 on @NAMESPACE@.sl_latency_sample
+			(ls_origin);
+	end if;
+	if not exists (select 1 from information_schema.tables t 
+			where table_schema = '_@CLUSTERNAME@' 
+			and table_name = 'sl_latency_hist') then
+		create table @NAMESPACE@.sl_latency_hist (
+			lh_origin			int4,
+			lh_set				int4,
+			lh_stage			text,
+			lh_bucket			int4,
+			lh_count			int8,
+			lh_sum_ms			float8,
+			lh_last				timestamptz
+		) WITHOUT OIDS;
+		create unique index sl_latency_hist_idx1 on @NAMESPACE@.sl_latency_hist
+			(lh_origin, lh_set, lh_stage, lh_bucket);
+	end if;
+	if not exists (select 1 from information_schema.views where table_schema='_@CLUSTERNAME@' and table_name='sl_latency_stats') then
+		create view @NAMESPACE@.sl_latency_stats as
+			select lh_origin as lat_origin, lh_set as lat_set, lh_stage as lat_stage,
+					sum(lh_count) as lat_samples,
+					sum(lh_sum_ms) / sum(lh_count) as lat_avg_ms,
+					2 ^ max(lh_bucket) as lat_max_ms,
+					max(lh_last) as lat_last_sample
+				from @NAMESPACE@.sl_latency_hist
+				group by lh_origin, lh_set, lh_stage;
+	end if;
+
+	-- ----
+	-- Log rows carry the set of their table, which the log trigger
+	-- gets as its fourth argument.
+	-- ----
+	if not @NAMESPACE@.check_table_field_exists('_@CLUSTERNAME@', 'sl_log_1', 'log_setid') then
+		alter table @NAMESPACE@.sl_log_1 add column log_setid int4;
+		alter table @NAMESPACE@.sl_log_2 add column log_setid int4;
+		update @NAMESPACE@.sl_log_1 set log_setid = T.tab_set
+				from @NAMESPACE@.sl_table T
+				where T.tab_id = log_tableid;
+		update @NAMESPACE@.sl_log_2 set log_setid = T.tab_set
+				from @NAMESPACE@.sl_table T
+				where T.tab_id = log_tableid;
+		create index sl_log_1_idx3 on @NAMESPACE@.sl_log_1
+			(log_origin, log_setid, log_txid);
+		create index sl_log_2_idx3 on @NAMESPACE@.sl_log_2
+			(log_origin, log_setid, log_txid);
+	end if;
+
+	-- ----
+	-- Tables can replicate a subset of their columns.
+	-- ----
+	if not @NAMESPACE@.check_table_field_exists('_@CLUSTERNAME@', 'sl_table', 'tab_columns') then
+		alter table @NAMESPACE@.sl_table add column tab_columns text[];
+		comment on column @NAMESPACE@.sl_table.tab_columns is 'Names of the columns that are replicated in addition to the key columns, NULL to replicate all columns';
+	end if;
+
+	-- ----
+	-- Per subscriber row filters.
+	-- ----
+	if not exists (select 1 from information_schema.tables t 
+			where table_schema = '_@CLUSTERNAME@' 
+			and table_name = 'sl_table_filter') then
+		create table @NAMESPACE@.sl_table_filter (
+			tf_tab_id			int4,
+			tf_receiver			int4,
+			tf_set				int4 NOT NULL,
+			tf_filter			text NOT NULL,
+			tf_logfilter		text NOT NULL,
+
+			CONSTRAINT "sl_table_filter-pkey"
+				PRIMARY KEY (tf_tab_id, tf_receiver)
+		) WITHOUT OIDS;
+		comment on table @NAMESPACE@.sl_table_filter is 'Row filters of replicated tables, per subscriber.  Exists on all nodes, also those that do not replicate the table.';
+	end if;
+	perform @NAMESPACE@.repair_log_triggers(false);
 	return p_old;
 end;
 $$ language plpgsql;
@@ -6031,7 +7673,12 @@ begin
 	result := '';
 	prefix := '(';   -- Initially, prefix is the opening paren
 
-	for prec in select @NAMESPACE@.slon_quote_input(a.attname) as column from @NAMESPACE@.sl_table t, pg_catalog.pg_attribute a where t.tab_id = p_tab_id and t.tab_reloid = a.attrelid and a.attnum > 0 and a.attisdropped = false order by attnum
+	for prec in select @NAMESPACE@.slon_quote_input(a.attname) as column from @NAMESPACE@.sl_table t, pg_catalog.pg_attribute a where t.tab_id = p_tab_id and t.tab_reloid = a.attrelid and a.attnum > 0 and a.attisdropped = false
+			and (t.tab_columns is null or a.attname = any (t.tab_columns)
+				or exists (select 1 from pg_catalog.pg_index x, pg_catalog.pg_class xc
+					where x.indrelid = t.tab_reloid and x.indexrelid = xc.oid
+					and xc.relname = t.tab_idxname and a.attnum = any (x.indkey)))
+			order by attnum
 	loop
 		result := result || prefix || prec.column;
 		prefix := ',';   -- Subsequently, prepend columns with commas
@@ -6043,7 +7690,8 @@ $$ language plpgsql;
 
 comment on function @NAMESPACE@.copyFields(p_tab_id integer) is
 'Return a string consisting of what should be appended to a COPY statement
-to specify fields for the passed-in tab_id.  
+to specify fields for the passed-in tab_id.  Only the replicated columns
+(tab_columns and the key columns) are listed.  
 
 In PG versions > 7.3, this looks like (field1,field2,...fieldn)';
 
@@ -6201,6 +7849,16 @@ begin
 	if @NAMESPACE@.ShouldSlonyVacuumTable(prec.nspname, prec.relname) then
 		return next prec;
 	end if;
+	prec.nspname := '_@CLUSTERNAME@';
+	prec.relname := 'sl_latency_sample';
+	if @NAMESPACE@.ShouldSlonyVacuumTable(prec.nspname, prec.relname) then
+		return next prec;
+	end if;
+	prec.nspname := '_@CLUSTERNAME@';
+	prec.relname := 'sl_sync_perf';
+	if @NAMESPACE@.ShouldSlonyVacuumTable(prec.nspname, prec.relname) then
+		return next prec;
+	end if;
 	prec.nspname := 'pg_catalog';
 	prec.relname := 'pg_listener';
 	if @NAMESPACE@.ShouldSlonyVacuumTable(prec.nspname, prec.relname) then
@@ -6421,11 +8079,10 @@ create or replace function @NAMESPACE@.log_truncate () returns trigger as
 $$
 	declare
 		r_role text;
-		c_nspname text;
-		c_relname text;
 		c_log integer;
 		c_node integer;
 		c_tabid integer;
+		c_setid integer;
 	begin
 		-- Ignore this call if session_replication_role = 'local'
 		select into r_role setting
@@ -6436,29 +8093,44 @@ $$
 
         c_tabid := tg_argv[0];
 	    c_node := @NAMESPACE@.getLocalNodeId('_@CLUSTERNAME@');
-		select tab_nspname, tab_relname into c_nspname, c_relname
+		select tab_set into c_setid
 				  from @NAMESPACE@.sl_table where tab_id = c_tabid;
 		select last_value into c_log from @NAMESPACE@.sl_log_status;
+
+		-- With logical capture active the TRUNCATE is decoded from the
+		-- WAL, unless the log trigger already logged this transaction.
+		if @NAMESPACE@.registry_get_int4('logical_capture', 0) = 1 then
+			if c_log in (0, 2) then
+				perform 1 from @NAMESPACE@.sl_log_1
+					where log_origin = c_node
+					and log_txid = pg_catalog.txid_current() limit 1;
+			else
+				perform 1 from @NAMESPACE@.sl_log_2
+					where log_origin = c_node
+					and log_txid = pg_catalog.txid_current() limit 1;
+			end if;
+			if not found then
+				return NULL;
+			end if;
+		end if;
 		if c_log in (0, 2) then
 			insert into @NAMESPACE@.sl_log_1 (
 					log_origin, log_txid, log_tableid, 
-					log_actionseq, log_tablenspname, 
-					log_tablerelname, log_cmdtype, 
-					log_cmdupdncols, log_cmdargs
+					log_actionseq, log_cmdtype, 
+					log_cmdupdncols, log_cmdargs, log_setid
 				) values (
 					c_node, pg_catalog.txid_current(), c_tabid,
-					nextval('@NAMESPACE@.sl_action_seq'), c_nspname,
-					c_relname, 'T', 0, '{}'::text[]);
+					nextval('@NAMESPACE@.sl_action_seq'), 'T',
+					0, '{}'::text[], c_setid);
 		else   -- (1, 3) 
 			insert into @NAMESPACE@.sl_log_2 (
 					log_origin, log_txid, log_tableid, 
-					log_actionseq, log_tablenspname, 
-					log_tablerelname, log_cmdtype, 
-					log_cmdupdncols, log_cmdargs
+					log_actionseq, log_cmdtype, 
+					log_cmdupdncols, log_cmdargs, log_setid
 				) values (
 					c_node, pg_catalog.txid_current(), c_tabid,
-					nextval('@NAMESPACE@.sl_action_seq'), c_nspname,
-					c_relname, 'T', 0, '{}'::text[]);
+					nextval('@NAMESPACE@.sl_action_seq'), 'T',
+					0, '{}'::text[], c_setid);
 		end if;
 		return NULL;
     end
@@ -6487,6 +8159,176 @@ $$ language plpgsql;
 comment on function @NAMESPACE@.deny_truncate ()
 is 'trigger function run when a replicated table receives a TRUNCATE request';
 
+-- ----------------------------------------------------------------------
+-- FUNCTION copyTextOut (value)
+--
+--	Escape a column value for COPY text format.
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.copyTextOut(p_value text)
+returns text
+as $$
+	select coalesce(pg_catalog.replace(pg_catalog.replace(
+				pg_catalog.replace(pg_catalog.replace($1,
+				E'\\', E'\\\\'), E'\t', E'\\t'), E'\n', E'\\n'),
+				E'\r', E'\\r'), E'\\N');
+$$ language sql immutable;
+comment on function @NAMESPACE@.copyTextOut(p_value text) is
+'copyTextOut (value)
+
+Return the value escaped for a line of COPY text format, or \N if it
+is NULL.  Used by logBulkLoad().';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION logBulkLoad (tab_id, source, chunk_rows)
+--
+--	Insert the result of a query into a replicated table and log the
+--	new rows as COPY payload chunks instead of one sl_log row each.
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.logBulkLoad(p_tab_id int4, p_source text, p_chunk_rows int4)
+returns bigint
+as $$
+declare
+	v_tab_row		record;
+	v_local_node	int4;
+	v_log			int4;
+	v_colnames		text[] default '{}';
+	v_rowexpr		text default '';
+	v_col_row		record;
+	v_rows			bigint;
+begin
+	select T.tab_set, T.tab_reloid, T.tab_idxname, T.tab_columns,
+			S.set_origin, S.set_locked,
+			@NAMESPACE@.slon_quote_brute(T.tab_nspname) || '.' ||
+			@NAMESPACE@.slon_quote_brute(T.tab_relname) as tab_fqname
+			into v_tab_row
+			from @NAMESPACE@.sl_table T, @NAMESPACE@.sl_set S
+			where T.tab_id = p_tab_id
+				and S.set_id = T.tab_set;
+	if not found then
+		raise exception 'Slony-I: logBulkLoad(): table % not found', p_tab_id;
+	end if;
+	v_local_node := @NAMESPACE@.getLocalNodeId('_@CLUSTERNAME@');
+	if v_tab_row.set_origin <> v_local_node then
+		raise exception 'Slony-I: logBulkLoad(): set % has remote origin',
+				v_tab_row.tab_set;
+	end if;
+	-- ----
+	-- This only fails early. A lock committed after this transaction took
+	-- its snapshot is caught by the log trigger, which still runs for the
+	-- loaded rows and checks the set after the insert assigned the xid,
+	-- with the latest snapshot.
+	-- ----
+	if v_tab_row.set_locked is not null then
+		raise exception 'Slony-I: logBulkLoad(): set % is locked',
+				v_tab_row.tab_set;
+	end if;
+	if p_chunk_rows < 1 then
+		raise exception 'Slony-I: logBulkLoad(): chunk_rows must be positive';
+	end if;
+
+	-- ----
+	-- Without the log trigger's bulk load support, with logical capture
+	-- or with row filters on the table, the rows are logged one by one.
+	-- ----
+	if pg_catalog.current_setting('server_version_num')::int4 < 140000
+			or pg_catalog.current_setting('session_replication_role') <> 'origin'
+			or @NAMESPACE@.registry_get_int4('logical_capture', 0) = 1
+			or exists (select 1 from @NAMESPACE@.sl_table_filter
+					where tf_tab_id = p_tab_id) then
+		execute 'insert into ' || v_tab_row.tab_fqname ||
+				' select * from (' || p_source || ') as S';
+		get diagnostics v_rows = row_count;
+		return v_rows;
+	end if;
+
+	-- ----
+	-- The chunks carry the replicated columns, like the initial copy.
+	-- ----
+	for v_col_row in select PGA.attname
+			from "pg_catalog".pg_attribute PGA
+			where PGA.attrelid = v_tab_row.tab_reloid
+				and PGA.attnum > 0 and not PGA.attisdropped
+				and (v_tab_row.tab_columns is null
+					or PGA.attname = any (v_tab_row.tab_columns)
+					or exists (select 1 from "pg_catalog".pg_index PGX,
+							"pg_catalog".pg_class PGXC
+						where PGX.indrelid = v_tab_row.tab_reloid
+							and PGX.indexrelid = PGXC.oid
+							and PGXC.relname = v_tab_row.tab_idxname
+							and PGA.attnum = any (PGX.indkey)))
+			order by PGA.attnum
+	loop
+		if v_rowexpr <> '' then
+			v_rowexpr := v_rowexpr || ' || pg_catalog.chr(9) || ';
+		end if;
+		v_rowexpr := v_rowexpr || '@NAMESPACE@.copyTextOut(' ||
+				pg_catalog.quote_ident(v_col_row.attname) || '::text)';
+		v_colnames := v_colnames || v_col_row.attname::text;
+	end loop;
+
+	-- ----
+	-- Insert the rows and log them in the same statement, so that the
+	-- chunks get their log_actionseq between the surrounding changes.
+	-- The log trigger only checks the set lock for the rows of this
+	-- table meanwhile.
+	-- ----
+	select last_value into v_log from @NAMESPACE@.sl_log_status;
+	perform pg_catalog.set_config('slony1.bulk_load_table',
+			p_tab_id::text, true);
+	execute 'with L as (insert into ' || v_tab_row.tab_fqname ||
+			' select * from (' || p_source || ') as S' ||
+			' returning ' || v_rowexpr || ' as r),' ||
+			' C as (select (pg_catalog.row_number() over () - 1) / ' ||
+			p_chunk_rows || ' as n, r from L),' ||
+			' I as (insert into @NAMESPACE@.sl_log_' ||
+			case when v_log in (0, 2) then '1' else '2' end ||
+			' (log_origin, log_txid, log_tableid, log_actionseq,' ||
+			' log_cmdtype, log_cmdupdncols, log_cmdargs, log_setid)' ||
+			' select $1, pg_catalog.txid_current(), $2,' ||
+			' pg_catalog.nextval(''@NAMESPACE@.sl_action_seq''), ''B'',' ||
+			' pg_catalog.count(*), $3 || pg_catalog.string_agg(r, pg_catalog.chr(10)),' ||
+			' $4 from C group by n' ||
+			' returning log_cmdupdncols)' ||
+			' select coalesce(pg_catalog.sum(log_cmdupdncols), 0) from I'
+			into v_rows
+			using v_local_node, p_tab_id, v_colnames, v_tab_row.tab_set;
+	perform pg_catalog.set_config('slony1.bulk_load_table', '0', true);
+
+	return v_rows;
+end;
+$$ language plpgsql;
+comment on function @NAMESPACE@.logBulkLoad(p_tab_id int4, p_source text, p_chunk_rows int4) is
+'logBulkLoad (tab_id, source, chunk_rows)
+
+Insert the rows returned by the query source, which must return all
+columns of the table in order, into the replicated table tab_id on the
+origin of its set.  Instead of one sl_log row per row, the rows are
+logged as sl_log rows of type B holding up to chunk_rows rows each in
+COPY text format, which subscribers load with COPY FROM (a multi-row
+INSERT before PostgreSQL 14).  Returns the
+number of rows loaded.
+
+Must be called by a superuser.  Falls back to a plain INSERT, logged
+row by row, on PostgreSQL before 14, with logical capture enabled or
+when the table has row filters.';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION logBulkLoad (tab_id, source)
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.logBulkLoad(p_tab_id int4, p_source text)
+returns bigint
+as $$
+begin
+	return @NAMESPACE@.logBulkLoad(p_tab_id, p_source, 10000);
+end;
+$$ language plpgsql;
+comment on function @NAMESPACE@.logBulkLoad(p_tab_id int4, p_source text) is
+'logBulkLoad (tab_id, source)
+
+Bulk load the rows returned by the query source into table tab_id,
+logged in chunks of 10000 rows.  See logBulkLoad(tab_id, source,
+chunk_rows).';
+
 create or replace function @NAMESPACE@.store_application_name (i_name text) returns text as $$
 declare
 		p_command text;
@@ -6545,7 +8387,16 @@ comment on function @NAMESPACE@.component_state (i_actor text, i_pid integer, i_
 
 create or replace function @NAMESPACE@.recreate_log_trigger(p_fq_table_name text,
        p_tab_id oid, p_tab_attkind text) returns integer as $$
+declare
+	v_tab_set		int4;
+	v_tgenabled		"char";
 begin
+	select T.tab_set, PGT.tgenabled into v_tab_set, v_tgenabled
+		from @NAMESPACE@.sl_table T, "pg_catalog".pg_trigger PGT
+		where T.tab_id = p_tab_id
+			and PGT.tgrelid = T.tab_reloid
+			and PGT.tgname = '_@CLUSTERNAME@_logtrigger';
+
 	execute 'drop trigger "_@CLUSTERNAME@_logtrigger" on ' ||
 		p_fq_table_name	;
 		-- ----
@@ -6555,7 +8406,16 @@ begin
 			|| ' for each row execute procedure @NAMESPACE@.logTrigger (' ||
                                pg_catalog.quote_literal('_@CLUSTERNAME@') || ',' || 
 				pg_catalog.quote_literal(p_tab_id::text) || ',' || 
-				pg_catalog.quote_literal(p_tab_attkind) || ');';
+				pg_catalog.quote_literal(p_tab_attkind) || ',' ||
+				pg_catalog.quote_literal(v_tab_set::text) || ');';
+
+	-- ----
+	-- On a replica the log trigger stays disabled.
+	-- ----
+	if v_tgenabled = 'D' then
+		execute 'alter table ' || p_fq_table_name ||
+				' disable trigger "_@CLUSTERNAME@_logtrigger"';
+	end if;
 	return 0;
 end
 $$ language plpgsql;
@@ -6563,7 +8423,53 @@ $$ language plpgsql;
 comment on function  @NAMESPACE@.recreate_log_trigger(p_fq_table_name text,
        p_tab_id oid, p_tab_attkind text) is
 'A function that drops and recreates the log trigger on the specified table.
-It is intended to be used after the primary_key/unique index has changed.';
+It is intended to be used after the primary_key/unique index or the set
+of the table has changed.';
+
+-- ----------------------------------------------------------------------
+-- FUNCTION alterTableSetLogTrigger (tab_id)
+--
+--	Recreate the log trigger of a table after it was moved to another
+--	set, so that its log rows are tagged with the new set.
+-- ----------------------------------------------------------------------
+create or replace function @NAMESPACE@.alterTableSetLogTrigger (p_tab_id int4)
+returns int4
+as $$
+declare
+	v_tab_fqname		text;
+	v_tab_idxname		name;
+	v_tab_columns		text[];
+begin
+	select @NAMESPACE@.slon_quote_brute(PGN.nspname) || '.' ||
+			@NAMESPACE@.slon_quote_brute(PGC.relname), T.tab_idxname,
+			T.tab_columns
+			into v_tab_fqname, v_tab_idxname, v_tab_columns
+			from @NAMESPACE@.sl_table T,
+				"pg_catalog".pg_class PGC, "pg_catalog".pg_namespace PGN,
+				"pg_catalog".pg_trigger PGT
+			where T.tab_id = p_tab_id
+				and T.tab_reloid = PGC.oid
+				and PGC.relnamespace = PGN.oid
+				and PGT.tgrelid = T.tab_reloid
+				and PGT.tgname = '_@CLUSTERNAME@_logtrigger';
+
+	-- ----
+	-- Nothing to do on nodes that do not replicate the table.
+	-- ----
+	if not found then
+		return p_tab_id;
+	end if;
+
+	perform @NAMESPACE@.recreate_log_trigger(v_tab_fqname, p_tab_id,
+			@NAMESPACE@.determineAttKindUnique(v_tab_fqname, v_tab_idxname,
+				v_tab_columns));
+	return p_tab_id;
+end;
+$$ language plpgsql;
+comment on function @NAMESPACE@.alterTableSetLogTrigger (p_tab_id int4) is
+'alterTableSetLogTrigger (tab_id)
+
+Recreate the log trigger of a table with its current set id.';
 
 create or replace function @NAMESPACE@.repair_log_triggers(only_locked boolean)
 returns integer as $$
@@ -6576,7 +8482,7 @@ begin
 		select  tab_nspname,tab_relname,
 				tab_idxname, tab_id, mode,
 				@NAMESPACE@.determineAttKindUnique(tab_nspname||
-					'.'||tab_relname,tab_idxname) as attkind
+					'.'||tab_relname,tab_idxname,tab_columns) as attkind
 		from
 				@NAMESPACE@.sl_table
 				left join 
@@ -6584,9 +8490,11 @@ begin
 				and mode='AccessExclusiveLock')				
 				,pg_trigger
 		where tab_reloid=tgrelid and 
-		@NAMESPACE@.determineAttKindUnique(tab_nspname||'.'
-						||tab_relname,tab_idxname)
+		(@NAMESPACE@.determineAttKindUnique(tab_nspname||'.'
+						||tab_relname,tab_idxname,tab_columns)
 			!=(@NAMESPACE@.decode_tgargs(tgargs))[2]
+			or (@NAMESPACE@.decode_tgargs(tgargs))[3]
+				is distinct from tab_set::text)
 			and tgname =  '_@CLUSTERNAME@'
 			|| '_logtrigger'
 		LOOP
@@ -257,3 +257,64 @@ select * from _slony_regress1.sl_listen order by li_origin, li_receiver, li_prov
 select * from _slony_regress1.listener_orphans;
 select "_slony_regress1".are_all_nodes_audible();
 
+
+
+--Test7
+--Scaling benchmark: time rebuildlistenentries() for clusters of up to
+--200 nodes.  The nodes form a chain, are all connected to hub node 1,
+--and subscribe to a set originating on node 1 down a binary tree of
+--cascaded providers.  After the full rebuild one more path is added
+--and the rebuild timed again.
+
+create or replace function "_slony_regress1".listen_bench (p_nodes int4) returns text as $$
+declare
+	v_start		timestamptz;
+	v_full		interval;
+	v_incr		interval;
+	v_listen	int4;
+	v_orphans	int4;
+begin
+	truncate _slony_regress1.sl_set, _slony_regress1.sl_setsync, _slony_regress1.sl_table, _slony_regress1.sl_sequence, _slony_regress1.sl_subscribe, _slony_regress1.sl_listen, _slony_regress1.sl_path, _slony_regress1.sl_node;
+
+	insert into _slony_regress1.sl_node (no_id, no_active, no_failed)
+		select i, true, false from generate_series(1, p_nodes) i;
+
+	insert into _slony_regress1.sl_path (pa_server, pa_client, pa_conninfo)
+		select s, c, 'bench dsn' from (
+			select i as s, i + 1 as c from generate_series(1, p_nodes - 1) i
+			union select i + 1, i from generate_series(1, p_nodes - 1) i
+			union select 1, i from generate_series(2, p_nodes) i
+			union select i, 1 from generate_series(2, p_nodes) i
+			union select i / 2, i from generate_series(2, p_nodes) i
+			union select i, i / 2 from generate_series(2, p_nodes) i) p;
+
+	insert into _slony_regress1.sl_set (set_id, set_origin) values (1, 1);
+	insert into _slony_regress1.sl_subscribe (sub_set, sub_provider, sub_receiver, sub_forward, sub_active)
+		select 1, i / 2, i, true, true from generate_series(2, p_nodes) i;
+
+	v_start := clock_timestamp();
+	perform _slony_regress1.rebuildlistenentries();
+	v_full := clock_timestamp() - v_start;
+
+	insert into _slony_regress1.sl_path (pa_server, pa_client, pa_conninfo)
+		select p_nodes, 2, 'bench dsn'
+		where not exists (select true from _slony_regress1.sl_path
+				where pa_server = p_nodes and pa_client = 2);
+
+	v_start := clock_timestamp();
+	perform _slony_regress1.rebuildlistenentries();
+	v_incr := clock_timestamp() - v_start;
+
+	select count(*) into v_listen from _slony_regress1.sl_listen;
+	select count(*) into v_orphans from _slony_regress1.listener_orphans;
+
+	return p_nodes || ' nodes: ' || v_listen || ' listen entries, ' ||
+		v_orphans || ' orphans, rebuild ' || v_full ||
+		', rebuild after adding a path ' || v_incr;
+end;
+$$ language plpgsql;
+
+select "_slony_regress1".listen_bench(25);
+select "_slony_regress1".listen_bench(50);
+select "_slony_regress1".listen_bench(100);
+select "_slony_regress1".listen_bench(200);
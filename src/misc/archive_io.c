@@ -0,0 +1,793 @@
+/*-------------------------------------------------------------------------
+ * archive_io.c
+ *
+ *	Streaming, optionally compressed I/O on log shipping archives.
+ *
+ *	slon writes archives through archive_file_write() as the data
+ *	arrives, so a compressed archive is never held in memory as a whole.
+ *	slony_logshipper reads them back with archive_file_read(), which
+ *	recognizes gzip and zstd archives by their magic number and passes
+ *	anything else through unchanged.
+ *
+ *	A file being written can be cut into independently decodable pieces
+ *	with archive_file_sync_point(), and cut back to the end of such a
+ *	piece with archive_file_rewind(). gzip does this with multiple
+ *	members, zstd with multiple frames; both decoders read them as one
+ *	continuous stream.
+ *
+ *	Copyright (c) 2003-2009, PostgreSQL Global Development Group
+ *
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#ifndef WIN32
+#include <unistd.h>
+#else
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+#include "config.h"
+#include "../slonik/types.h"
+#ifdef HAVE_ARCHIVE_GZIP
+#include <zlib.h>
+#endif
+#ifdef HAVE_ARCHIVE_ZSTD
+#include <zstd.h>
+#endif
+#include "archive_io.h"
+
+#define ARCHIVE_IO_BUFSIZE	(128 * 1024)
+
+struct ArchiveFile
+{
+	FILE	   *fp;
+	int			method;
+	int			writing;
+	int			eof;
+
+	/*
+	 * File side buffer. When reading, in_pos/in_len is the part not yet
+	 * consumed.
+	 */
+	char	   *buf;
+	size_t		in_pos;
+	size_t		in_len;
+
+	ArchiveFileStats stats;
+
+#ifdef HAVE_ARCHIVE_GZIP
+	z_stream	zs;
+#endif
+#ifdef HAVE_ARCHIVE_ZSTD
+	ZSTD_CCtx  *zc;
+	ZSTD_DCtx  *zd;
+#endif
+};
+
+static double archive_cpu_time(void);
+static int	archive_flush_out(ArchiveFile * af, size_t len);
+static int	archive_fill_in(ArchiveFile * af);
+static int	archive_datasync(FILE *fp);
+
+
+/* ----------
+ * archive_method_parse
+ *
+ *	Map a compression method name to its ARCHIVE_COMPRESS_* code. Returns
+ *	-1 for unknown methods and for methods this build does not support.
+ * ----------
+ */
+int
+archive_method_parse(const char *name)
+{
+	if (name == NULL || *name == '\0' || strcmp(name, "none") == 0)
+		return ARCHIVE_COMPRESS_NONE;
+#ifdef HAVE_ARCHIVE_GZIP
+	if (strcmp(name, "gzip") == 0)
+		return ARCHIVE_COMPRESS_GZIP;
+#endif
+#ifdef HAVE_ARCHIVE_ZSTD
+	if (strcmp(name, "zstd") == 0)
+		return ARCHIVE_COMPRESS_ZSTD;
+#endif
+	return -1;
+}
+
+
+/* ----------
+ * archive_method_suffix
+ *
+ *	The file name suffix added after ".sql" for a method.
+ * ----------
+ */
+const char *
+archive_method_suffix(int method)
+{
+	switch (method)
+	{
+		case ARCHIVE_COMPRESS_GZIP:
+			return ".gz";
+		case ARCHIVE_COMPRESS_ZSTD:
+			return ".zst";
+		default:
+			return "";
+	}
+}
+
+
+/* ----------
+ * archive_name_is_archive
+ *
+ *	If fname ends in .sql, .sql.gz or .sql.zst, return the length of the
+ *	name up to and including ".sql", otherwise 0.
+ * ----------
+ */
+int
+archive_name_is_archive(const char *fname)
+{
+	static const char *suffixes[] = {".sql", ".sql.gz", ".sql.zst", NULL};
+	size_t		len = strlen(fname);
+	int			i;
+
+	for (i = 0; suffixes[i] != NULL; i++)
+	{
+		size_t		slen = strlen(suffixes[i]);
+
+		if (len > slen && strcmp(fname + len - slen, suffixes[i]) == 0)
+			return (int) (len - slen + 4);
+	}
+	return 0;
+}
+
+
+/* ----------
+ * archive_file_open_write
+ *
+ *	Create an archive file. A level of 0 selects the library default.
+ * ----------
+ */
+ArchiveFile *
+archive_file_open_write(const char *path, int method, int level)
+{
+	ArchiveFile *af;
+
+	af = (ArchiveFile *) calloc(1, sizeof(ArchiveFile));
+	if (af == NULL)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+	af->method = method;
+	af->writing = 1;
+
+	if (method != ARCHIVE_COMPRESS_NONE)
+	{
+		af->buf = malloc(ARCHIVE_IO_BUFSIZE);
+		if (af->buf == NULL)
+		{
+			free(af);
+			errno = ENOMEM;
+			return NULL;
+		}
+	}
+
+	switch (method)
+	{
+		case ARCHIVE_COMPRESS_NONE:
+			break;
+#ifdef HAVE_ARCHIVE_GZIP
+		case ARCHIVE_COMPRESS_GZIP:
+			/* windowBits + 16 writes a gzip header and trailer */
+			if (deflateInit2(&(af->zs),
+							 level > 0 ? level : Z_DEFAULT_COMPRESSION,
+							 Z_DEFLATED, 15 + 16, 8,
+							 Z_DEFAULT_STRATEGY) != Z_OK)
+			{
+				free(af->buf);
+				free(af);
+				errno = ENOMEM;
+				return NULL;
+			}
+			break;
+#endif
+#ifdef HAVE_ARCHIVE_ZSTD
+		case ARCHIVE_COMPRESS_ZSTD:
+			af->zc = ZSTD_createCCtx();
+			if (af->zc == NULL)
+			{
+				free(af->buf);
+				free(af);
+				errno = ENOMEM;
+				return NULL;
+			}
+			ZSTD_CCtx_setParameter(af->zc, ZSTD_c_compressionLevel,
+								   level > 0 ? level : ZSTD_CLEVEL_DEFAULT);
+			break;
+#endif
+		default:
+			free(af->buf);
+			free(af);
+			errno = EINVAL;
+			return NULL;
+	}
+
+	af->fp = fopen(path, "w");
+	if (af->fp == NULL)
+	{
+		int			save_errno = errno;
+
+		archive_file_abort(af);
+		errno = save_errno;
+		return NULL;
+	}
+
+	return af;
+}
+
+
+/* ----------
+ * archive_file_write
+ *
+ *	Append data to an archive. Returns 0 on success, -1 with errno set
+ *	on failure.
+ * ----------
+ */
+int
+archive_file_write(ArchiveFile * af, const char *data, size_t len)
+{
+	double		start;
+
+	af->stats.raw_bytes += len;
+
+	if (af->method == ARCHIVE_COMPRESS_NONE)
+	{
+		if (len > 0 && fwrite(data, 1, len, af->fp) != len)
+			return -1;
+		af->stats.file_bytes += len;
+		return 0;
+	}
+
+	start = archive_cpu_time();
+
+#ifdef HAVE_ARCHIVE_GZIP
+	if (af->method == ARCHIVE_COMPRESS_GZIP)
+	{
+		af->zs.next_in = (unsigned char *) data;
+		af->zs.avail_in = len;
+		while (af->zs.avail_in > 0)
+		{
+			af->zs.next_out = (unsigned char *) af->buf;
+			af->zs.avail_out = ARCHIVE_IO_BUFSIZE;
+			if (deflate(&(af->zs), Z_NO_FLUSH) == Z_STREAM_ERROR)
+			{
+				errno = EIO;
+				return -1;
+			}
+			if (archive_flush_out(af, ARCHIVE_IO_BUFSIZE -
+								  af->zs.avail_out) < 0)
+				return -1;
+		}
+	}
+#endif
+#ifdef HAVE_ARCHIVE_ZSTD
+	if (af->method == ARCHIVE_COMPRESS_ZSTD)
+	{
+		ZSTD_inBuffer in = {data, len, 0};
+
+		while (in.pos < in.size)
+		{
+			ZSTD_outBuffer out = {af->buf, ARCHIVE_IO_BUFSIZE, 0};
+
+			if (ZSTD_isError(ZSTD_compressStream2(af->zc, &out, &in,
+												  ZSTD_e_continue)))
+			{
+				errno = EIO;
+				return -1;
+			}
+			if (archive_flush_out(af, out.pos) < 0)
+				return -1;
+		}
+	}
+#endif
+
+	af->stats.cpu_time += archive_cpu_time() - start;
+	return 0;
+}
+
+
+/* ----------
+ * archive_file_close
+ *
+ *	Finish the compressed stream and close the file. The statistics of
+ *	the file are returned in *stats if not NULL. The ArchiveFile is
+ *	freed in any case.
+ * ----------
+ */
+int
+archive_file_close(ArchiveFile * af, ArchiveFileStats * stats)
+{
+	int			rc = 0;
+	double		start = archive_cpu_time();
+
+#ifdef HAVE_ARCHIVE_GZIP
+	if (af->writing && af->method == ARCHIVE_COMPRESS_GZIP)
+	{
+		int			zrc;
+
+		af->zs.next_in = NULL;
+		af->zs.avail_in = 0;
+		do
+		{
+			af->zs.next_out = (unsigned char *) af->buf;
+			af->zs.avail_out = ARCHIVE_IO_BUFSIZE;
+			zrc = deflate(&(af->zs), Z_FINISH);
+			if (zrc == Z_STREAM_ERROR ||
+				archive_flush_out(af, ARCHIVE_IO_BUFSIZE -
+								  af->zs.avail_out) < 0)
+			{
+				rc = -1;
+				break;
+			}
+		} while (zrc != Z_STREAM_END);
+	}
+#endif
+#ifdef HAVE_ARCHIVE_ZSTD
+	if (af->writing && af->method == ARCHIVE_COMPRESS_ZSTD)
+	{
+		ZSTD_inBuffer in = {NULL, 0, 0};
+		size_t		remaining;
+
+		do
+		{
+			ZSTD_outBuffer out = {af->buf, ARCHIVE_IO_BUFSIZE, 0};
+
+			remaining = ZSTD_compressStream2(af->zc, &out, &in, ZSTD_e_end);
+			if (ZSTD_isError(remaining) ||
+				archive_flush_out(af, out.pos) < 0)
+			{
+				rc = -1;
+				break;
+			}
+		} while (remaining != 0);
+	}
+#endif
+	af->stats.cpu_time += archive_cpu_time() - start;
+
+	/*
+	 * Make the archive durable before the caller renames it into place.
+	 */
+	if (af->writing && af->fp != NULL &&
+		(fflush(af->fp) != 0 || archive_datasync(af->fp) != 0))
+		rc = -1;
+	if (af->fp != NULL && fclose(af->fp) != 0)
+		rc = -1;
+	af->fp = NULL;
+
+	if (stats != NULL)
+		*stats = af->stats;
+
+	archive_file_abort(af);
+	return rc;
+}
+
+
+static int
+archive_datasync(FILE *fp)
+{
+#if defined(WIN32)
+	return _commit(_fileno(fp));
+#elif defined(HAVE_FDATASYNC)
+	return fdatasync(fileno(fp));
+#else
+	return fsync(fileno(fp));
+#endif
+}
+
+
+/* ----------
+ * archive_file_abort
+ *
+ *	Close the file without finishing it and free all resources.
+ * ----------
+ */
+void
+archive_file_abort(ArchiveFile * af)
+{
+	if (af->fp != NULL)
+		fclose(af->fp);
+#ifdef HAVE_ARCHIVE_GZIP
+	if (af->method == ARCHIVE_COMPRESS_GZIP)
+	{
+		if (af->writing)
+			deflateEnd(&(af->zs));
+		else
+			inflateEnd(&(af->zs));
+	}
+#endif
+#ifdef HAVE_ARCHIVE_ZSTD
+	if (af->zc != NULL)
+		ZSTD_freeCCtx(af->zc);
+	if (af->zd != NULL)
+		ZSTD_freeDCtx(af->zd);
+#endif
+	if (af->buf != NULL)
+		free(af->buf);
+	free(af);
+}
+
+
+/* ----------
+ * archive_file_sync_point
+ *
+ *	Finish the current gzip member or zstd frame and flush everything to
+ *	the file, so that the file could be truncated to its current size
+ *	and still be a complete archive. The statistics up to this point are
+ *	returned in *stats; stats->file_bytes is the file size.
+ * ----------
+ */
+int
+archive_file_sync_point(ArchiveFile * af, ArchiveFileStats * stats)
+{
+	double		start = archive_cpu_time();
+
+#ifdef HAVE_ARCHIVE_GZIP
+	if (af->method == ARCHIVE_COMPRESS_GZIP)
+	{
+		int			zrc;
+
+		af->zs.next_in = NULL;
+		af->zs.avail_in = 0;
+		do
+		{
+			af->zs.next_out = (unsigned char *) af->buf;
+			af->zs.avail_out = ARCHIVE_IO_BUFSIZE;
+			zrc = deflate(&(af->zs), Z_FINISH);
+			if (zrc == Z_STREAM_ERROR ||
+				archive_flush_out(af, ARCHIVE_IO_BUFSIZE -
+								  af->zs.avail_out) < 0)
+				return -1;
+		} while (zrc != Z_STREAM_END);
+
+		/* the next write starts a new member */
+		deflateReset(&(af->zs));
+	}
+#endif
+#ifdef HAVE_ARCHIVE_ZSTD
+	if (af->method == ARCHIVE_COMPRESS_ZSTD)
+	{
+		ZSTD_inBuffer in = {NULL, 0, 0};
+		size_t		remaining;
+
+		do
+		{
+			ZSTD_outBuffer out = {af->buf, ARCHIVE_IO_BUFSIZE, 0};
+
+			remaining = ZSTD_compressStream2(af->zc, &out, &in, ZSTD_e_end);
+			if (ZSTD_isError(remaining) ||
+				archive_flush_out(af, out.pos) < 0)
+				return -1;
+		} while (remaining != 0);
+	}
+#endif
+	af->stats.cpu_time += archive_cpu_time() - start;
+
+	if (fflush(af->fp) != 0)
+		return -1;
+
+	if (stats != NULL)
+		*stats = af->stats;
+	return 0;
+}
+
+
+/* ----------
+ * archive_file_rewind
+ *
+ *	Discard everything written after the sync point that returned stats.
+ * ----------
+ */
+int
+archive_file_rewind(ArchiveFile * af, const ArchiveFileStats * stats)
+{
+	if (fflush(af->fp) != 0)
+		return -1;
+#ifndef WIN32
+	if (ftruncate(fileno(af->fp), (off_t) stats->file_bytes) != 0)
+		return -1;
+#else
+	if (_chsize(_fileno(af->fp), (long) stats->file_bytes) != 0)
+		return -1;
+#endif
+	if (fseek(af->fp, 0, SEEK_END) != 0)
+		return -1;
+
+#ifdef HAVE_ARCHIVE_GZIP
+	if (af->method == ARCHIVE_COMPRESS_GZIP)
+		deflateReset(&(af->zs));
+#endif
+#ifdef HAVE_ARCHIVE_ZSTD
+	if (af->method == ARCHIVE_COMPRESS_ZSTD)
+		ZSTD_CCtx_reset(af->zc, ZSTD_reset_session_only);
+#endif
+
+	af->stats.raw_bytes = stats->raw_bytes;
+	af->stats.file_bytes = stats->file_bytes;
+	return 0;
+}
+
+
+/* ----------
+ * archive_file_truncate
+ *
+ *	Truncate a closed archive file to length bytes, which must be the
+ *	file_bytes of one of its sync points.
+ * ----------
+ */
+int
+archive_file_truncate(const char *path, int64 length)
+{
+#ifndef WIN32
+	return truncate(path, (off_t) length);
+#else
+	int			fd;
+	int			rc;
+
+	if ((fd = _open(path, _O_RDWR | _O_BINARY)) < 0)
+		return -1;
+	rc = _chsize(fd, (long) length);
+	_close(fd);
+	return rc;
+#endif
+}
+
+
+/* ----------
+ * archive_file_open_read
+ *
+ *	Open an archive for reading, detecting the compression method from
+ *	the first bytes of the file.
+ * ----------
+ */
+ArchiveFile *
+archive_file_open_read(const char *path)
+{
+	ArchiveFile *af;
+	unsigned char *magic;
+
+	af = (ArchiveFile *) calloc(1, sizeof(ArchiveFile));
+	if (af == NULL)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+	af->buf = malloc(ARCHIVE_IO_BUFSIZE);
+	if (af->buf == NULL)
+	{
+		free(af);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	af->fp = fopen(path, "r");
+	if (af->fp == NULL)
+	{
+		int			save_errno = errno;
+
+		archive_file_abort(af);
+		errno = save_errno;
+		return NULL;
+	}
+
+	if (archive_fill_in(af) < 0)
+	{
+		int			save_errno = errno;
+
+		archive_file_abort(af);
+		errno = save_errno;
+		return NULL;
+	}
+
+	magic = (unsigned char *) af->buf;
+	af->method = ARCHIVE_COMPRESS_NONE;
+	if (af->in_len >= 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+		af->method = ARCHIVE_COMPRESS_GZIP;
+	else if (af->in_len >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 &&
+			 magic[2] == 0x2f && magic[3] == 0xfd)
+		af->method = ARCHIVE_COMPRESS_ZSTD;
+
+	switch (af->method)
+	{
+		case ARCHIVE_COMPRESS_NONE:
+			return af;
+#ifdef HAVE_ARCHIVE_GZIP
+		case ARCHIVE_COMPRESS_GZIP:
+			if (inflateInit2(&(af->zs), 15 + 16) != Z_OK)
+			{
+				af->method = ARCHIVE_COMPRESS_NONE;
+				archive_file_abort(af);
+				errno = ENOMEM;
+				return NULL;
+			}
+			return af;
+#endif
+#ifdef HAVE_ARCHIVE_ZSTD
+		case ARCHIVE_COMPRESS_ZSTD:
+			af->zd = ZSTD_createDCtx();
+			if (af->zd == NULL)
+			{
+				archive_file_abort(af);
+				errno = ENOMEM;
+				return NULL;
+			}
+			return af;
+#endif
+		default:
+			/* compressed with a method this build does not support */
+			af->method = ARCHIVE_COMPRESS_NONE;
+			archive_file_abort(af);
+			errno = ENOTSUP;
+			return NULL;
+	}
+}
+
+
+/* ----------
+ * archive_file_read
+ *
+ *	Read up to len uncompressed bytes. Returns the number of bytes read,
+ *	0 at the end of the archive and -1 on error.
+ * ----------
+ */
+int
+archive_file_read(ArchiveFile * af, char *buf, size_t len)
+{
+	size_t		produced = 0;
+	double		start;
+
+	if (af->method == ARCHIVE_COMPRESS_NONE)
+	{
+		if (af->in_pos < af->in_len)
+		{
+			produced = af->in_len - af->in_pos;
+			if (produced > len)
+				produced = len;
+			memcpy(buf, af->buf + af->in_pos, produced);
+			af->in_pos += produced;
+		}
+		else
+		{
+			produced = fread(buf, 1, len, af->fp);
+			if (produced == 0 && ferror(af->fp))
+				return -1;
+			af->stats.file_bytes += produced;
+		}
+		af->stats.raw_bytes += produced;
+		return (int) produced;
+	}
+
+	start = archive_cpu_time();
+	while (produced == 0 && !af->eof)
+	{
+		if (af->in_pos == af->in_len)
+		{
+			if (archive_fill_in(af) < 0)
+				return -1;
+			if (af->in_len == 0)
+			{
+				/* truncated compressed stream */
+				errno = EIO;
+				return -1;
+			}
+		}
+
+#ifdef HAVE_ARCHIVE_GZIP
+		if (af->method == ARCHIVE_COMPRESS_GZIP)
+		{
+			int			zrc;
+
+			af->zs.next_in = (unsigned char *) af->buf + af->in_pos;
+			af->zs.avail_in = af->in_len - af->in_pos;
+			af->zs.next_out = (unsigned char *) buf;
+			af->zs.avail_out = len;
+			zrc = inflate(&(af->zs), Z_NO_FLUSH);
+			if (zrc != Z_OK && zrc != Z_STREAM_END && zrc != Z_BUF_ERROR)
+			{
+				errno = EIO;
+				return -1;
+			}
+			af->in_pos = af->in_len - af->zs.avail_in;
+			produced = len - af->zs.avail_out;
+			if (zrc == Z_STREAM_END)
+			{
+				/* A gzip file may consist of several members */
+				if (af->in_pos == af->in_len && archive_fill_in(af) < 0)
+					return -1;
+				if (af->in_len == 0)
+					af->eof = 1;
+				else
+					inflateReset(&(af->zs));
+			}
+		}
+#endif
+#ifdef HAVE_ARCHIVE_ZSTD
+		if (af->method == ARCHIVE_COMPRESS_ZSTD)
+		{
+			ZSTD_inBuffer in = {af->buf, af->in_len, af->in_pos};
+			ZSTD_outBuffer out = {buf, len, 0};
+			size_t		zrc;
+
+			zrc = ZSTD_decompressStream(af->zd, &out, &in);
+			if (ZSTD_isError(zrc))
+			{
+				errno = EIO;
+				return -1;
+			}
+			af->in_pos = in.pos;
+			produced = out.pos;
+			if (zrc == 0 && af->in_pos == af->in_len)
+			{
+				if (archive_fill_in(af) < 0)
+					return -1;
+				if (af->in_len == 0)
+					af->eof = 1;
+			}
+		}
+#endif
+	}
+	af->stats.cpu_time += archive_cpu_time() - start;
+	af->stats.raw_bytes += produced;
+
+	return (int) produced;
+}
+
+
+/*
+ * CPU time of the calling thread, where the platform can tell.
+ */
+static double
+archive_cpu_time(void)
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+		return (double) ts.tv_sec + (double) ts.tv_nsec / 1000000000.0;
+#endif
+	return (double) clock() / (double) CLOCKS_PER_SEC;
+}
+
+
+/*
+ * Write len bytes of compressed output from the buffer to the file.
+ */
+static int
+archive_flush_out(ArchiveFile * af, size_t len)
+{
+	if (len > 0 && fwrite(af->buf, 1, len, af->fp) != len)
+		return -1;
+	af->stats.file_bytes += len;
+	return 0;
+}
+
+
+/*
+ * Refill the input buffer from the file. in_len is 0 at end of file.
+ */
+static int
+archive_fill_in(ArchiveFile * af)
+{
+	af->in_pos = 0;
+	af->in_len = fread(af->buf, 1, ARCHIVE_IO_BUFSIZE, af->fp);
+	if (af->in_len == 0 && ferror(af->fp))
+		return -1;
+	af->stats.file_bytes += af->in_len;
+	return 0;
+}
@@ -0,0 +1,45 @@
+/*-------------------------------------------------------------------------
+ * archive_io.h
+ *
+ *	Streaming, optionally compressed I/O on log shipping archives.
+ *
+ *	The including file must have int64 defined (types.h).
+ *
+ *	Copyright (c) 2003-2009, PostgreSQL Global Development Group
+ *
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SLONY_ARCHIVE_IO_H
+#define SLONY_ARCHIVE_IO_H
+
+#define ARCHIVE_COMPRESS_NONE	0
+#define ARCHIVE_COMPRESS_GZIP	1
+#define ARCHIVE_COMPRESS_ZSTD	2
+
+typedef struct ArchiveFile ArchiveFile;
+
+typedef struct ArchiveFileStats
+{
+	int64		raw_bytes;		/* uncompressed archive bytes */
+	int64		file_bytes;		/* bytes in the file on disk */
+	double		cpu_time;		/* seconds spent (de)compressing */
+} ArchiveFileStats;
+
+extern int	archive_method_parse(const char *name);
+extern const char *archive_method_suffix(int method);
+extern int	archive_name_is_archive(const char *fname);
+
+extern ArchiveFile *archive_file_open_write(const char *path, int method,
+						int level);
+extern int	archive_file_write(ArchiveFile * af, const char *data, size_t len);
+extern int	archive_file_close(ArchiveFile * af, ArchiveFileStats * stats);
+extern void archive_file_abort(ArchiveFile * af);
+extern int	archive_file_sync_point(ArchiveFile * af, ArchiveFileStats * stats);
+extern int	archive_file_rewind(ArchiveFile * af, const ArchiveFileStats * stats);
+extern int	archive_file_truncate(const char *path, int64 length);
+
+extern ArchiveFile *archive_file_open_read(const char *path);
+extern int	archive_file_read(ArchiveFile * af, char *buf, size_t len);
+
+#endif   /* SLONY_ARCHIVE_IO_H */
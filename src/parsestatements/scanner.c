@@ -1,8 +1,35 @@
 /*	*/
 #include <stdio.h>
+#include <stdlib.h>
 #include "scanner.h"
 
-int			STMTS[MAXSTATEMENTS];
+int		   *STMTS = NULL;
+static int	stmts_alloc = 0;
+
+/*
+ * Record the end of statement number statements at pos, growing STMTS
+ * as needed.  Returns the new number of statements, or -1 when out of
+ * memory.
+ */
+static int
+add_statement(int statements, int pos)
+{
+	int		   *newstmts;
+	int			newalloc;
+
+	if (statements >= stmts_alloc)
+	{
+		newalloc = (stmts_alloc == 0) ? 1024 : stmts_alloc * 2;
+		newstmts = (int *) realloc(STMTS, newalloc * sizeof(int));
+		if (newstmts == NULL)
+			return -1;
+		STMTS = newstmts;
+		stmts_alloc = newalloc;
+	}
+	STMTS[statements] = pos;
+	return statements + 1;
+}
+
 int
 scan_for_statements(const char *extended_statement)
 {
@@ -40,7 +67,8 @@ scan_for_statements(const char *extended_statement)
 		switch (cchar)
 		{
 			case '\0':
-				STMTS[statements++] = cpos;
+				if ((statements = add_statement(statements, cpos)) < 0)
+					return -1;
 				state = Q_DONE;
 				break;
 
@@ -278,11 +306,8 @@ scan_for_statements(const char *extended_statement)
 			case ';':
 				if ((state == Q_NORMAL_STATE) && (nparens == 0) && (nbrokets == 0) && (nsquigb == 0))
 				{
-					STMTS[statements++] = cpos + 1;
-					if (statements >= MAXSTATEMENTS)
-					{
-						return statements;
-					}
+					if ((statements = add_statement(statements, cpos + 1)) < 0)
+						return -1;
 				}
 				if (state == Q_HOPE_CEND)
 					state = Q_CCOMMENT;
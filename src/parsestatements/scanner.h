@@ -1,5 +1,4 @@
 /*	*/
-#define MAXSTATEMENTS 1000
 enum quote_states
 {
 	Q_NORMAL_STATE,
@@ -21,4 +20,10 @@ enum quote_states
 	Q_DONE						/* NULL ends it all... */
 };
 
+/*
+ * End positions of the statements found by scan_for_statements(),
+ * grown as needed.
+ */
+extern int *STMTS;
+
 extern int	scan_for_statements(const char *extended_statement);
@@ -3,8 +3,6 @@
 #include "scanner.h"
 
 char		foo[65536];
-extern int	STMTS[1024];
-extern int	statements;
 
 int
 main(int argc, char *const argv[])
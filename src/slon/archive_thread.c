@@ -0,0 +1,418 @@
+/*-------------------------------------------------------------------------
+ * archive_thread.c
+ *
+ *	Writer thread for log shipping archives.
+ *
+ *	The remote workers hand archive data to this thread in large buffers
+ *	through a bounded queue, so that compressing the archive and a slow
+ *	archive directory do not hold up replication. A worker only waits
+ *	for its own buffers to be written before it finishes an archive or
+ *	SYNC group, see archive_queue_wait(). A write error is kept with the
+ *	archive file it happened on and reported to the worker writing it.
+ *
+ *	Copyright (c) 2003-2009, PostgreSQL Global Development Group
+ *
+ *
+ *-------------------------------------------------------------------------
+ */
+
+
+#include <pthread.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#ifndef WIN32
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+#include "slon.h"
+
+
+#define ARCHIVE_QUEUE_BUFSIZE	(256 * 1024)
+
+/*
+ * Writer state of one archive file. Exists from the first queued write
+ * until the worker collects it with archive_queue_wait().
+ */
+typedef struct ArchiveQueueFile
+{
+	ArchiveFile *af;
+	int			pending;		/* buffers not written yet */
+	bool		failed;
+	int			failed_errno;
+	struct ArchiveQueueFile *next;
+}	ArchiveQueueFile;
+
+typedef struct ArchiveQueueBuf
+{
+	ArchiveQueueFile *qf;
+	size_t		len;
+	struct ArchiveQueueBuf *next;
+	char		data[ARCHIVE_QUEUE_BUFSIZE];
+}	ArchiveQueueBuf;
+
+
+/* ----------
+ * Global data
+ * ----------
+ */
+int			archive_writer_queue;
+
+static pthread_once_t archive_thread_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t archive_queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t archive_queue_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t archive_queue_done = PTHREAD_COND_INITIALIZER;
+
+static ArchiveQueueBuf *queue_head = NULL;
+static ArchiveQueueBuf *queue_tail = NULL;
+static ArchiveQueueBuf *queue_free = NULL;
+static ArchiveQueueBuf *queue_fill = NULL;
+static ArchiveQueueFile *queue_files = NULL;
+static int	queue_allocated = 0;
+static int	queue_depth = 0;
+
+/*
+ * Statistics since the last archive_queue_report()
+ */
+static int	stat_buffers = 0;
+static int	stat_depth_max = 0;
+static double stat_write_time = 0.0;
+static double stat_write_max = 0.0;
+static double stat_wait_time = 0.0;
+
+static void archive_thread_start(void);
+static void *archive_thread_main(void *dummy);
+static void archive_queue_push(ArchiveQueueBuf * buf);
+static ArchiveQueueFile *archive_queue_file(ArchiveFile * af, bool create);
+static double archive_queue_now(void);
+
+
+/* ----------
+ * archive_queue_write
+ *
+ * Queues len bytes to be written to af. Only blocks if all buffers
+ * are in use. Returns -1 with errno set if an earlier write to af
+ * failed.
+ * ----------
+ */
+int
+archive_queue_write(ArchiveFile * af, const char *data, size_t len)
+{
+	ArchiveQueueFile *qf;
+	size_t		n;
+
+	if (archive_writer_queue <= 0)
+		return archive_file_write(af, data, len);
+
+	pthread_once(&archive_thread_once, archive_thread_start);
+	if (archive_writer_queue <= 0)
+		return archive_file_write(af, data, len);
+
+	pthread_mutex_lock(&archive_queue_lock);
+	qf = archive_queue_file(af, true);
+	if (qf == NULL)
+	{
+		pthread_mutex_unlock(&archive_queue_lock);
+		errno = ENOMEM;
+		return -1;
+	}
+	if (qf->failed)
+	{
+		pthread_mutex_unlock(&archive_queue_lock);
+		errno = qf->failed_errno;
+		return -1;
+	}
+
+	while (len > 0)
+	{
+		if (queue_fill != NULL && queue_fill->qf != qf)
+		{
+			archive_queue_push(queue_fill);
+			queue_fill = NULL;
+		}
+
+		if (queue_fill == NULL)
+		{
+			/*
+			 * Another worker may have started a buffer while we waited,
+			 * so look at queue_fill again after waking up.
+			 */
+			if (queue_free == NULL &&
+				queue_allocated >= archive_writer_queue)
+			{
+				pthread_cond_wait(&archive_queue_done, &archive_queue_lock);
+				continue;
+			}
+
+			if (queue_free != NULL)
+			{
+				queue_fill = queue_free;
+				queue_free = queue_free->next;
+			}
+			else
+			{
+				queue_fill = (ArchiveQueueBuf *) malloc(sizeof(ArchiveQueueBuf));
+				if (queue_fill == NULL)
+				{
+					pthread_mutex_unlock(&archive_queue_lock);
+					errno = ENOMEM;
+					return -1;
+				}
+				queue_allocated++;
+			}
+			queue_fill->qf = qf;
+			queue_fill->len = 0;
+			qf->pending++;
+		}
+
+		n = ARCHIVE_QUEUE_BUFSIZE - queue_fill->len;
+		if (n > len)
+			n = len;
+		memcpy(queue_fill->data + queue_fill->len, data, n);
+		queue_fill->len += n;
+		data += n;
+		len -= n;
+
+		if (queue_fill->len == ARCHIVE_QUEUE_BUFSIZE)
+		{
+			archive_queue_push(queue_fill);
+			queue_fill = NULL;
+		}
+	}
+
+	pthread_mutex_unlock(&archive_queue_lock);
+
+	return 0;
+}
+
+
+/* ----------
+ * archive_queue_wait
+ *
+ * Waits until everything queued so far for af has been written. Only
+ * after this may the caller operate on af directly. Returns -1 with
+ * errno set if any write to af failed since the last call.
+ * ----------
+ */
+int
+archive_queue_wait(ArchiveFile * af)
+{
+	ArchiveQueueFile *qf;
+	ArchiveQueueFile **qfp;
+	double		start;
+	int			rc = 0;
+
+	if (archive_writer_queue <= 0)
+		return 0;
+
+	pthread_mutex_lock(&archive_queue_lock);
+	qf = archive_queue_file(af, false);
+	if (qf == NULL)
+	{
+		pthread_mutex_unlock(&archive_queue_lock);
+		return 0;
+	}
+
+	if (queue_fill != NULL && queue_fill->qf == qf)
+	{
+		archive_queue_push(queue_fill);
+		queue_fill = NULL;
+	}
+
+	start = archive_queue_now();
+	while (qf->pending > 0)
+		pthread_cond_wait(&archive_queue_done, &archive_queue_lock);
+	stat_wait_time += archive_queue_now() - start;
+
+	if (qf->failed)
+	{
+		errno = qf->failed_errno;
+		rc = -1;
+	}
+
+	for (qfp = &queue_files; *qfp != qf; qfp = &((*qfp)->next))
+		;
+	*qfp = qf->next;
+	free(qf);
+	pthread_mutex_unlock(&archive_queue_lock);
+
+	return rc;
+}
+
+
+/* ----------
+ * archive_queue_report
+ *
+ * Logs the writer statistics for one archive file and resets them.
+ * ----------
+ */
+void
+archive_queue_report(int node_id, const char *name)
+{
+	if (archive_writer_queue <= 0)
+		return;
+
+	pthread_mutex_lock(&archive_queue_lock);
+	slon_log(SLON_DEBUG1, "remoteWorkerThread_%d: archive %s: "
+			 "%d buffers, max queue depth %d, "
+			 "write latency avg %.3f ms max %.3f ms, "
+			 "waited %.3f ms for the archive writer\n",
+			 node_id, name, stat_buffers, stat_depth_max,
+			 stat_buffers > 0 ? stat_write_time * 1000.0 / stat_buffers : 0.0,
+			 stat_write_max * 1000.0, stat_wait_time * 1000.0);
+	stat_buffers = 0;
+	stat_depth_max = 0;
+	stat_write_time = 0.0;
+	stat_write_max = 0.0;
+	stat_wait_time = 0.0;
+	pthread_mutex_unlock(&archive_queue_lock);
+}
+
+
+/* ----------
+ * archive_thread_start
+ * ----------
+ */
+static void
+archive_thread_start(void)
+{
+	pthread_t	thread;
+
+	if (pthread_create(&thread, NULL, archive_thread_main, NULL) != 0)
+	{
+		slon_log(SLON_ERROR, "archive writer: pthread_create() - %s - "
+				 "writing archives inline\n", strerror(errno));
+		archive_writer_queue = 0;
+		return;
+	}
+	pthread_detach(thread);
+}
+
+
+/* ----------
+ * archive_thread_main
+ * ----------
+ */
+static void *
+archive_thread_main( /* @unused@ */ void *dummy)
+{
+	ArchiveQueueBuf *buf;
+	ArchiveQueueFile *qf;
+	bool		skip;
+	double		start;
+	double		elapsed;
+	int			rc;
+
+	slon_log(SLON_CONFIG, "archive writer: thread starts\n");
+
+	pthread_mutex_lock(&archive_queue_lock);
+	for (;;)
+	{
+		while (queue_head == NULL)
+			pthread_cond_wait(&archive_queue_work, &archive_queue_lock);
+
+		buf = queue_head;
+		queue_head = buf->next;
+		if (queue_head == NULL)
+			queue_tail = NULL;
+		queue_depth--;
+		qf = buf->qf;
+
+		/*
+		 * After a failure the rest of that archive is discarded until
+		 * its worker has seen the error. Other archives go on.
+		 */
+		skip = qf->failed;
+		pthread_mutex_unlock(&archive_queue_lock);
+
+		rc = 0;
+		start = archive_queue_now();
+		if (!skip)
+			rc = archive_file_write(qf->af, buf->data, buf->len);
+		elapsed = archive_queue_now() - start;
+
+		pthread_mutex_lock(&archive_queue_lock);
+		if (rc < 0 && !qf->failed)
+		{
+			qf->failed = true;
+			qf->failed_errno = errno;
+		}
+		stat_buffers++;
+		stat_write_time += elapsed;
+		if (elapsed > stat_write_max)
+			stat_write_max = elapsed;
+
+		buf->next = queue_free;
+		queue_free = buf;
+		qf->pending--;
+		pthread_cond_broadcast(&archive_queue_done);
+	}
+
+	/* not reached */
+	return NULL;
+}
+
+
+/*
+ * Append a filled buffer to the queue. Called with the lock held.
+ */
+static void
+archive_queue_push(ArchiveQueueBuf * buf)
+{
+	buf->next = NULL;
+	if (queue_tail == NULL)
+		queue_head = buf;
+	else
+		queue_tail->next = buf;
+	queue_tail = buf;
+
+	queue_depth++;
+	if (queue_depth > stat_depth_max)
+		stat_depth_max = queue_depth;
+	pthread_cond_signal(&archive_queue_work);
+}
+
+
+/*
+ * Find the writer state of af, creating it if asked to. Called with the
+ * lock held. Returns NULL if not found or out of memory.
+ */
+static ArchiveQueueFile *
+archive_queue_file(ArchiveFile * af, bool create)
+{
+	ArchiveQueueFile *qf;
+
+	for (qf = queue_files; qf != NULL; qf = qf->next)
+	{
+		if (qf->af == af)
+			return qf;
+	}
+	if (!create)
+		return NULL;
+
+	qf = (ArchiveQueueFile *) malloc(sizeof(ArchiveQueueFile));
+	if (qf == NULL)
+		return NULL;
+	qf->af = af;
+	qf->pending = 0;
+	qf->failed = false;
+	qf->failed_errno = 0;
+	qf->next = queue_files;
+	queue_files = qf;
+
+	return qf;
+}
+
+
+static double
+archive_queue_now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (double) tv.tv_sec + (double) tv.tv_usec / 1000000.0;
+}
@@ -125,10 +125,13 @@ cleanupThread_main( /* @unused@ */ void *dummy)
 				 "begin;"
 				 "lock table %s.sl_config_lock;"
 				 "select %s.cleanupEvent('%s'::interval);"
+				 "select %s.cleanupSyncPerf(%d);"
 				 "commit;",
 				 rtcfg_namespace,
 				 rtcfg_namespace,
-				 cleanup_interval
+				 cleanup_interval,
+				 rtcfg_namespace,
+				 sync_perf_history
 		);
 	dstring_init(&query2);
 
@@ -224,6 +224,76 @@ static struct config_int ConfigureNamesInt[] =
 		10,
 		2000
 	},
+	{
+		{
+			(const char *) "sync_perf_history",
+			gettext_noop("Number of SYNC groups per origin to keep in sl_sync_perf"),
+			gettext_noop("If non-zero, the remote worker records timings, row and byte "
+						 "counts of every applied SYNC group in sl_sync_perf and the "
+						 "cleanup thread trims the table to this many rows per origin. "
+						 "Zero disables recording."),
+			SLON_C_INT
+		},
+		&sync_perf_history,
+		0,
+		0,
+		1000000
+	},
+	{
+		{
+			(const char *) "archive_compression_level",
+			gettext_noop("Compression level for log shipping archives"),
+			gettext_noop("Passed to the library selected by archive_compression. "
+						 "Zero uses the library's default level."),
+			SLON_C_INT
+		},
+		&archive_compression_level,
+		0,
+		0,
+		22
+	},
+	{
+		{
+			(const char *) "archive_segment_maxsize",
+			gettext_noop("Size in kB at which an archive segment is finished"),
+			gettext_noop("If this or archive_segment_maxage is non-zero, "
+						 "consecutive SYNC groups are appended to one archive "
+						 "file until it reaches this size. Zero means no size limit."),
+			SLON_C_INT
+		},
+		&archive_segment_maxsize,
+		0,
+		0,
+		2097152
+	},
+	{
+		{
+			(const char *) "archive_segment_maxage",
+			gettext_noop("Age in seconds at which an archive segment is finished"),
+			gettext_noop("If this or archive_segment_maxsize is non-zero, "
+						 "consecutive SYNC groups are appended to one archive "
+						 "file until it is this old. Zero means no age limit."),
+			SLON_C_INT
+		},
+		&archive_segment_maxage,
+		0,
+		0,
+		86400
+	},
+	{
+		{
+			(const char *) "archive_writer_queue",
+			gettext_noop("Number of 256 kB buffers queued to the archive writer thread"),
+			gettext_noop("Archive files are written by a separate thread that "
+						 "is fed through this many buffers. Zero writes archives "
+						 "directly from the remote worker threads."),
+			SLON_C_INT
+		},
+		&archive_writer_queue,
+		8,
+		0,
+		1024
+	},
 	{{0}}
 };
 
@@ -295,6 +365,28 @@ static struct config_bool ConfigureNamesBool[] =
 		&remote_listen_serializable_transactions,
 		true
 	},
+	{
+		{
+			(const char *) "remote_listen_multiplex",
+			gettext_noop("Listen for events on all remote nodes from a single "
+				"thread that queries a node when it signals a new event."),
+			NULL,
+			SLON_C_BOOL,
+		},
+		&remote_listen_multiplex,
+		false
+	},
+	{
+		{
+			(const char *) "sync_group_compaction",
+			gettext_noop("Apply only the net change of every row changed "
+				"more than once in a group of SYNCs."),
+			NULL,
+			SLON_C_BOOL,
+		},
+		&sync_group_compaction,
+		false
+	},
 	{{0}}
 };
 
@@ -409,6 +501,18 @@ static struct config_string ConfigureNamesString[] =
 		NULL
 	},
 
+	{
+		{
+			(const char *) "archive_compression",
+			gettext_noop("Compression method for log shipping archives: "
+						 "none, gzip or zstd"),
+			NULL,
+			SLON_C_STRING
+		},
+		&archive_compression,
+		"none"
+	},
+
 
 #ifdef HAVE_SYSLOG
 	{
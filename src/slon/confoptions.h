@@ -14,6 +14,11 @@ extern char *rtcfg_conninfo;
 
 extern char *pid_file;
 extern char *archive_dir;
+extern char *archive_compression;
+extern int	archive_compression_level;
+extern int	archive_segment_maxsize;
+extern int	archive_segment_maxage;
+extern int	archive_writer_queue;
 
 extern int	slon_log_level;
 extern int	sync_interval;
@@ -21,6 +26,8 @@ extern int	sync_interval_timeout;
 extern int	remote_listen_timeout;
 
 extern int	sync_group_maxsize;
+extern int	sync_perf_history;
+extern bool sync_group_compaction;
 extern int	desired_sync_time;
 
 extern int	quit_sync_provider;
@@ -28,6 +35,7 @@ extern int	quit_sync_finalsync;
 extern bool keep_alive;
 extern bool     enable_version_check;
 extern bool 	remote_listen_serializable_transactions;
+extern bool remote_listen_multiplex;
 extern int	keep_alive_idle;
 extern int	keep_alive_interval;
 extern int	keep_alive_count;
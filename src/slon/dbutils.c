@@ -92,55 +92,7 @@ slon_connectdb(char *conninfo, char *symname)
 		return NULL;
 	}
 
-	setsockopt(PQsocket(dbconn), SOL_SOCKET, SO_KEEPALIVE, &keep_alive,
-			   sizeof(int));
-#ifndef WIN32
-	if (keep_alive)
-	{
-
-		if (keep_alive_idle > 0)
-#ifdef TCP_KEEPIDLE
-			setsockopt(PQsocket(dbconn), IPPROTO_TCP, TCP_KEEPIDLE,
-					   &keep_alive_idle, sizeof(keep_alive_idle));
-#else
-			slon_log(SLON_WARN, "keep_alive_idle is not supported on this platform");
-#endif
-		if (keep_alive_interval > 0)
-#ifdef TCP_KEEPINTVL
-			setsockopt(PQsocket(dbconn), IPPROTO_TCP, TCP_KEEPINTVL,
-					   &keep_alive_interval, sizeof(keep_alive_interval));
-#else
-			slon_log(SLON_WARN, "keep_alive_interval is not supported on this platform");
-#endif
-		if (keep_alive_count > 0)
-#ifdef TCP_KEEPCNT
-			setsockopt(PQsocket(dbconn), IPPROTO_TCP, TCP_KEEPCNT,
-					   &keep_alive_count, sizeof(keep_alive_count));
-#else
-			slon_log(SLON_WARN, "keep_alive_count is not supported on this platform");
-#endif
-
-	}
-#else
-	/**
-	 * Win32 does not support the setsockopt calls for setting keep alive
-	 * parameters.	On Win32 this can be adjusted via the registry.
-	 * libpq 9.0 and above provide functions for doing this.
-	 * If we ever require libpq9.0 or above we could start to use them.
-	 * Alternativly someone could re-implement that functionality inside
-	 * of slony.
-	 */
-	if (keep_alive)
-	{
-		if (keep_alive_idle > 0)
-			slon_log(SLON_WARN, "keep_alive_idle is not supported by Slony on Win32");
-		if (keep_alive_interval > 0)
-			slon_log(SLON_WARN, "keep_alive_interval is not supported by Slony on Win32");
-		if (keep_alive_count > 0)
-			slon_log(SLON_WARN, "keep_alive_count is not supported by Slony Win32");
-
-	}
-#endif
+	slon_set_keepalive(dbconn);
 
 	dstring_init(&query);
 
@@ -252,6 +204,67 @@ slon_connectdb(char *conninfo, char *symname)
 }
 
 
+/* ----------
+ * slon_set_keepalive
+ *
+ * Apply the keep_alive settings to the socket of a new connection.
+ * ----------
+ */
+void
+slon_set_keepalive(PGconn *dbconn)
+{
+	setsockopt(PQsocket(dbconn), SOL_SOCKET, SO_KEEPALIVE, &keep_alive,
+			   sizeof(int));
+#ifndef WIN32
+	if (keep_alive)
+	{
+
+		if (keep_alive_idle > 0)
+#ifdef TCP_KEEPIDLE
+			setsockopt(PQsocket(dbconn), IPPROTO_TCP, TCP_KEEPIDLE,
+					   &keep_alive_idle, sizeof(keep_alive_idle));
+#else
+			slon_log(SLON_WARN, "keep_alive_idle is not supported on this platform");
+#endif
+		if (keep_alive_interval > 0)
+#ifdef TCP_KEEPINTVL
+			setsockopt(PQsocket(dbconn), IPPROTO_TCP, TCP_KEEPINTVL,
+					   &keep_alive_interval, sizeof(keep_alive_interval));
+#else
+			slon_log(SLON_WARN, "keep_alive_interval is not supported on this platform");
+#endif
+		if (keep_alive_count > 0)
+#ifdef TCP_KEEPCNT
+			setsockopt(PQsocket(dbconn), IPPROTO_TCP, TCP_KEEPCNT,
+					   &keep_alive_count, sizeof(keep_alive_count));
+#else
+			slon_log(SLON_WARN, "keep_alive_count is not supported on this platform");
+#endif
+
+	}
+#else
+	/**
+	 * Win32 does not support the setsockopt calls for setting keep alive
+	 * parameters.	On Win32 this can be adjusted via the registry.
+	 * libpq 9.0 and above provide functions for doing this.
+	 * If we ever require libpq9.0 or above we could start to use them.
+	 * Alternativly someone could re-implement that functionality inside
+	 * of slony.
+	 */
+	if (keep_alive)
+	{
+		if (keep_alive_idle > 0)
+			slon_log(SLON_WARN, "keep_alive_idle is not supported by Slony on Win32");
+		if (keep_alive_interval > 0)
+			slon_log(SLON_WARN, "keep_alive_interval is not supported by Slony on Win32");
+		if (keep_alive_count > 0)
+			slon_log(SLON_WARN, "keep_alive_count is not supported by Slony Win32");
+
+	}
+#endif
+}
+
+
 /* ----------
  * slon_disconnectdb
  * ----------
@@ -448,6 +448,16 @@ localListenThread_main( /* @unused@ */ void *dummy)
 				 * the runtime configuration.
 				 */
 			}
+			else if (strcmp(ev_type, "SET_ADD_TABLES") == 0)
+			{
+				/*
+				 * SET_ADD_TABLES
+				 */
+
+				/*
+				 * Nothing to do ATM, see SET_ADD_TABLE
+				 */
+			}
 			else if (strcmp(ev_type, "SET_ADD_SEQUENCE") == 0)
 			{
 				/*
@@ -493,6 +503,17 @@ localListenThread_main( /* @unused@ */ void *dummy)
 				 * in the runtime configuration.
 				 */
 			}
+			else if (strcmp(ev_type, "SET_TABLE_FILTER") == 0)
+			{
+				/*
+				 * SET_TABLE_FILTER
+				 */
+
+				/*
+				 * Nothing to do ATM ... sync_event() reads the filters from
+				 * sl_table_filter.
+				 */
+			}
 			else if (strcmp(ev_type, "SET_MOVE_SEQUENCE") == 0)
 			{
 				/*
@@ -52,10 +52,16 @@ static void remoteListen_adjust_listat(SlonNode * node,
 						   struct listat ** listat_tail);
 static void remoteListen_cleanup(struct listat ** listat_head,
 					 struct listat ** listat_tail);
+static int	remoteListen_init_conn(SlonNode * node, SlonConn * conn);
 static int remoteListen_forward_confirm(SlonNode * node,
 							 SlonConn * conn);
+static void remoteListen_confirm_query(SlonDString * query);
+static void remoteListen_queue_confirms(SlonNode * node, PGresult *res);
 static int remoteListen_receive_events(SlonNode * node,
 							SlonConn * conn, struct listat * listat);
+static int remoteListen_event_query(SlonNode * node, SlonDString * query,
+						 struct listat * listat);
+static int	remoteListen_queue_events(SlonNode * node, PGresult *res);
 
 static int	poll_sleep;
 
@@ -81,9 +87,6 @@ remoteListenThread_main(void *cdata)
 	char		conn_symname[64];
 	ScheduleStatus rc;
 	int			retVal;
-	SlonDString query1;
-	PGconn	   *dbconn = NULL;
-	PGresult   *res;
 
 	struct listat *listat_head;
 	struct listat *listat_tail;
@@ -99,7 +102,6 @@ remoteListenThread_main(void *cdata)
 	 */
 	listat_head = NULL;
 	listat_tail = NULL;
-	dstring_init(&query1);
 
 	poll_sleep = 0;
 
@@ -226,63 +228,10 @@ remoteListenThread_main(void *cdata)
 
 				continue;
 			}
-			dbconn = conn->dbconn;
 			monitor_state("remote listener", node->no_id, conn->conn_pid, "thread main loop", 0, "n/a");
 
-			/*
-			 * Listen on the connection for events and confirmations and
-			 * register the node connection.
-			 */
-			(void) slon_mkquery(&query1,
-								"select %s.registerNodeConnection(%d); ",
-								rtcfg_namespace, rtcfg_nodeid);
-
-			res = PQexec(dbconn, dstring_data(&query1));
-			if (PQresultStatus(res) != PGRES_TUPLES_OK)
-			{
-				slon_log(SLON_ERROR,
-						 "remoteListenThread_%d: \"%s\" - %s",
-						 node->no_id,
-						 dstring_data(&query1), PQresultErrorMessage(res));
-				PQclear(res);
-				slon_disconnectdb(conn);
-				free(conn_conninfo);
-				conn = NULL;
-				conn_conninfo = NULL;
-
-				rc = sched_msleep(node, pa_connretry * 1000);
-				if (rc != SCHED_STATUS_OK && rc != SCHED_STATUS_CANCEL)
-					break;
-
-				continue;
-			}
-			PQclear(res);
-			retVal = db_getLocalNodeId(dbconn);
-			if (retVal != node->no_id)
-			{
-				slon_log(SLON_ERROR,
-						 "remoteListenThread_%d: db_getLocalNodeId() "
-						 "returned %d - wrong database?\n",
-						 node->no_id, retVal);
-
-				slon_disconnectdb(conn);
-				free(conn_conninfo);
-				conn = NULL;
-				conn_conninfo = NULL;
-
-				rc = sched_msleep(node, pa_connretry * 1000);
-				if (rc != SCHED_STATUS_OK && rc != SCHED_STATUS_CANCEL)
-					break;
-
-				continue;
-			}
-			if (db_checkSchemaVersion(dbconn) < 0)
+			if (remoteListen_init_conn(node, conn) < 0)
 			{
-				slon_log(SLON_ERROR,
-						 "remoteListenThread_%d: db_checkSchemaVersion() "
-						 "failed\n",
-						 node->no_id);
-
 				slon_disconnectdb(conn);
 				free(conn_conninfo);
 				conn = NULL;
@@ -294,32 +243,6 @@ remoteListenThread_main(void *cdata)
 
 				continue;
 			}
-			if (PQserverVersion(dbconn) >= 90100)
-			{
-				char buf[200];
-				sprintf(buf, "SET SESSION CHARACTERISTICS AS TRANSACTION read only isolation level %s",
-				remote_listen_serializable_transactions ? "serializable deferrable" : "repeatable read");
-				slon_mkquery(&query1, buf);
-				res = PQexec(dbconn, dstring_data(&query1));
-				if (PQresultStatus(res) != PGRES_COMMAND_OK)
-				{
-					slon_log(SLON_ERROR,
-							 "remoteListenThread_%d: \"%s\" - %s",
-							 node->no_id,
-						   dstring_data(&query1), PQresultErrorMessage(res));
-					PQclear(res);
-					slon_disconnectdb(conn);
-					free(conn_conninfo);
-					conn = NULL;
-					conn_conninfo = NULL;
-					rc = sched_msleep(node, pa_connretry * 1000);
-					if (rc != SCHED_STATUS_OK && rc != SCHED_STATUS_CANCEL)
-						break;
-
-					continue;
-				}
-
-			}
 			slon_log(SLON_DEBUG1,
 					 "remoteListenThread_%d: connected to '%s'\n",
 					 node->no_id, conn_conninfo);
@@ -400,11 +323,93 @@ remoteListenThread_main(void *cdata)
 	slon_log(SLON_DEBUG1,
 			 "remoteListenThread_%d: thread done\n",
 			 node->no_id);
-	dstring_free(&query1);
 	pthread_exit(NULL);
 }
 
 
+/* ----------
+ * remoteListen_init_conn
+ *
+ * Register a new listen connection with the remote node, check that it
+ * leads to the right database and set up its transaction mode. Returns
+ * -1 on failure.
+ * ----------
+ */
+static int
+remoteListen_init_conn(SlonNode * node, SlonConn * conn)
+{
+	PGconn	   *dbconn = conn->dbconn;
+	SlonDString query1;
+	PGresult   *res;
+	int			retVal;
+
+	dstring_init(&query1);
+
+	/*
+	 * Listen on the connection for events and confirmations and register
+	 * the node connection.
+	 */
+	(void) slon_mkquery(&query1,
+						"select %s.registerNodeConnection(%d); ",
+						rtcfg_namespace, rtcfg_nodeid);
+
+	res = PQexec(dbconn, dstring_data(&query1));
+	if (PQresultStatus(res) != PGRES_TUPLES_OK)
+	{
+		slon_log(SLON_ERROR,
+				 "remoteListenThread_%d: \"%s\" - %s",
+				 node->no_id,
+				 dstring_data(&query1), PQresultErrorMessage(res));
+		PQclear(res);
+		dstring_free(&query1);
+		return -1;
+	}
+	PQclear(res);
+	retVal = db_getLocalNodeId(dbconn);
+	if (retVal != node->no_id)
+	{
+		slon_log(SLON_ERROR,
+				 "remoteListenThread_%d: db_getLocalNodeId() "
+				 "returned %d - wrong database?\n",
+				 node->no_id, retVal);
+		dstring_free(&query1);
+		return -1;
+	}
+	if (db_checkSchemaVersion(dbconn) < 0)
+	{
+		slon_log(SLON_ERROR,
+				 "remoteListenThread_%d: db_checkSchemaVersion() "
+				 "failed\n",
+				 node->no_id);
+		dstring_free(&query1);
+		return -1;
+	}
+	if (PQserverVersion(dbconn) >= 90100)
+	{
+		char		buf[200];
+
+		sprintf(buf, "SET SESSION CHARACTERISTICS AS TRANSACTION read only isolation level %s",
+				remote_listen_serializable_transactions ? "serializable deferrable" : "repeatable read");
+		slon_mkquery(&query1, buf);
+		res = PQexec(dbconn, dstring_data(&query1));
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		{
+			slon_log(SLON_ERROR,
+					 "remoteListenThread_%d: \"%s\" - %s",
+					 node->no_id,
+					 dstring_data(&query1), PQresultErrorMessage(res));
+			PQclear(res);
+			dstring_free(&query1);
+			return -1;
+		}
+		PQclear(res);
+	}
+
+	dstring_free(&query1);
+	return 0;
+}
+
+
 /* ----------
  * remoteListen_adjust_listat
  *
@@ -545,24 +550,11 @@ remoteListen_forward_confirm(SlonNode * node, SlonConn * conn)
 {
 	SlonDString query;
 	PGresult   *res;
-	int			ntuples;
-	int			tupno;
 
 	dstring_init(&query);
 	monitor_state("remote listener", node->no_id, conn->conn_pid, "forwarding confirmations", 0, "n/a");
 
-	/*
-	 * Select the max(con_seqno) grouped by con_origin and con_received from
-	 * the sl_confirm table.
-	 */
-	(void) slon_mkquery(&query,
-						"select con_origin, con_received, "
-						"    max(con_seqno) as con_seqno, "
-						"    max(con_timestamp) as con_timestamp "
-						"from %s.sl_confirm "
-						"where con_received <> %d "
-						"group by con_origin, con_received",
-						rtcfg_namespace, rtcfg_nodeid);
+	remoteListen_confirm_query(&query);
 	res = PQexec(conn->dbconn, dstring_data(&query));
 	if (PQresultStatus(res) != PGRES_TUPLES_OK)
 	{
@@ -575,6 +567,52 @@ remoteListen_forward_confirm(SlonNode * node, SlonConn * conn)
 		return -1;
 	}
 
+	remoteListen_queue_confirms(node, res);
+
+	PQclear(res);
+	dstring_free(&query);
+	monitor_state("remote listener", node->no_id, conn->conn_pid, "thread main loop", 0, "n/a");
+
+	return 0;
+}
+
+
+/* ----------
+ * remoteListen_confirm_query
+ *
+ * Append the query for the last confirmed event sequences to query.
+ * ----------
+ */
+static void
+remoteListen_confirm_query(SlonDString * query)
+{
+	/*
+	 * Select the max(con_seqno) grouped by con_origin and con_received from
+	 * the sl_confirm table.
+	 */
+	(void) slon_appendquery(query,
+							"select con_origin, con_received, "
+							"    max(con_seqno) as con_seqno, "
+							"    max(con_timestamp) as con_timestamp "
+							"from %s.sl_confirm "
+							"where con_received <> %d "
+							"group by con_origin, con_received",
+							rtcfg_namespace, rtcfg_nodeid);
+}
+
+
+/* ----------
+ * remoteListen_queue_confirms
+ *
+ * Hand the result of remoteListen_confirm_query() to the remote worker.
+ * ----------
+ */
+static void
+remoteListen_queue_confirms(SlonNode * node, PGresult *res)
+{
+	int			ntuples;
+	int			tupno;
+
 	/*
 	 * We actually do not do the forwarding ourself here. We send a special
 	 * message to the remote worker for that node.
@@ -589,12 +627,6 @@ remoteListen_forward_confirm(SlonNode * node, SlonConn * conn)
 							 PQgetvalue(res, tupno, 2),
 							 PQgetvalue(res, tupno, 3));
 	}
-
-	PQclear(res);
-	dstring_free(&query);
-	monitor_state("remote listener", node->no_id, conn->conn_pid, "thread main loop", 0, "n/a");
-
-	return 0;
 }
 
 
@@ -609,85 +641,21 @@ static int
 remoteListen_receive_events(SlonNode * node, SlonConn * conn,
 							struct listat * listat)
 {
-	SlonNode   *origin;
 	SlonDString query;
-	SlonDString q2;
-	char	   *where_or_or;
-	char		seqno_buf[64];
 	PGresult   *res;
 	int			ntuples;
-	int			tupno;
 	time_t		timeout;
 	time_t		now;
 
 	dstring_init(&query);
 
-	/*
-	 * In the runtime configuration info for the node, we remember the last
-	 * event sequence that we actually have received. If the remote worker
-	 * thread has processed it yet or it isn't important, we have it in the
-	 * message queue at least and don't need to select it again.
-	 *
-	 * So the query we construct contains a qualification (ev_origin =
-	 * <remote_node> and ev_seqno > <last_seqno>) per remote node we're listen
-	 * for here.
-	 */
 	monitor_state("remote listener", node->no_id, conn->conn_pid, "receiving events", 0, "n/a");
-	(void) slon_mkquery(&query,
-						"select ev_origin, ev_seqno, ev_timestamp, "
-						"       ev_snapshot, "
-					"       \"pg_catalog\".txid_snapshot_xmin(ev_snapshot), "
-					"       \"pg_catalog\".txid_snapshot_xmax(ev_snapshot), "
-						"       ev_type, "
-						"       ev_data1, ev_data2, "
-						"       ev_data3, ev_data4, "
-						"       ev_data5, ev_data6, "
-						"       ev_data7, ev_data8 "
-						"from %s.sl_event e",
-						rtcfg_namespace);
-
-	rtcfg_lock();
-
-	where_or_or = "where";
-	if (lag_interval)
-	{
-		dstring_init(&q2);
-		(void) slon_mkquery(&q2, "where ev_timestamp < now() - '%s'::interval and (", lag_interval);
-		where_or_or = dstring_data(&q2);
-	}
-	while (listat)
-	{
-		if ((origin = rtcfg_findNode(listat->li_origin)) == NULL)
-		{
-			rtcfg_unlock();
-			slon_log(SLON_ERROR,
-					 "remoteListenThread_%d: unknown node %d\n",
-					 node->no_id, listat->li_origin);
-			dstring_free(&query);
-			return -1;
-		}
-		sprintf(seqno_buf, INT64_FORMAT, origin->last_event);
-		slon_appendquery(&query,
-						 " %s (e.ev_origin = '%d' and e.ev_seqno > '%s')",
-						 where_or_or, listat->li_origin, seqno_buf);
-
-		where_or_or = "or";
-		listat = listat->next;
-	}
-	if (lag_interval)
+	if (remoteListen_event_query(node, &query, listat) < 0)
 	{
-		slon_appendquery(&query, ")");
+		dstring_free(&query);
+		return -1;
 	}
 
-	/*
-	 * Limit the result set size to: sync_group_maxsize * 2, if it's set 100,
-	 * if sync_group_maxsize isn't set
-	 */
-	slon_appendquery(&query, " order by e.ev_origin, e.ev_seqno limit %d",
-					 (sync_group_maxsize > 0) ? sync_group_maxsize * 2 : 100);
-
-	rtcfg_unlock();
-
 	if (PQsendQuery(conn->dbconn, dstring_data(&query)) == 0)
 	{
 		slon_log(SLON_ERROR,
@@ -740,7 +708,7 @@ remoteListen_receive_events(SlonNode * node, SlonConn * conn,
 	/*
 	 * Add all events found to the remote worker message queue.
 	 */
-	ntuples = PQntuples(res);
+	ntuples = remoteListen_queue_events(node, res);
 
 	/* If we drew in the maximum number of events */
 	if (ntuples == ((sync_group_maxsize > 0) ? sync_group_maxsize * 2 : 100))
@@ -748,36 +716,6 @@ remoteListen_receive_events(SlonNode * node, SlonConn * conn,
 	else
 		sel_max_events = 0;		/* reset the count */
 
-	for (tupno = 0; tupno < ntuples; tupno++)
-	{
-		int			ev_origin;
-		int64		ev_seqno;
-
-		ev_origin = (int) strtol(PQgetvalue(res, tupno, 0), NULL, 10);
-		(void) slon_scanint64(PQgetvalue(res, tupno, 1), &ev_seqno);
-
-		slon_log(SLON_DEBUG2, "remoteListenThread_%d: "
-				 "queue event %d,%s %s\n",
-				 node->no_id, ev_origin, PQgetvalue(res, tupno, 1),
-				 PQgetvalue(res, tupno, 6));
-
-		remoteWorker_event(node->no_id,
-						   ev_origin, ev_seqno,
-						   PQgetvalue(res, tupno, 2),	/* ev_timestamp */
-						   PQgetvalue(res, tupno, 3),	/* ev_snapshot */
-						   PQgetvalue(res, tupno, 4),	/* mintxid */
-						   PQgetvalue(res, tupno, 5),	/* maxtxid */
-						   PQgetvalue(res, tupno, 6),	/* ev_type */
-			 (PQgetisnull(res, tupno, 7)) ? NULL : PQgetvalue(res, tupno, 7),
-			 (PQgetisnull(res, tupno, 8)) ? NULL : PQgetvalue(res, tupno, 8),
-			 (PQgetisnull(res, tupno, 9)) ? NULL : PQgetvalue(res, tupno, 9),
-		   (PQgetisnull(res, tupno, 10)) ? NULL : PQgetvalue(res, tupno, 10),
-		   (PQgetisnull(res, tupno, 11)) ? NULL : PQgetvalue(res, tupno, 11),
-		   (PQgetisnull(res, tupno, 12)) ? NULL : PQgetvalue(res, tupno, 12),
-		   (PQgetisnull(res, tupno, 13)) ? NULL : PQgetvalue(res, tupno, 13),
-		  (PQgetisnull(res, tupno, 14)) ? NULL : PQgetvalue(res, tupno, 14));
-	}
-
 	if (ntuples > 0)
 	{
 		if ((sel_max_events > 2) && (sync_group_maxsize > 100))
@@ -803,3 +741,1042 @@ remoteListen_receive_events(SlonNode * node, SlonConn * conn,
 	monitor_state("remote listener", node->no_id, conn->conn_pid, "thread main loop", 0, "n/a");
 	return 0;
 }
+
+
+/* ----------
+ * remoteListen_event_query
+ *
+ * Build the query selecting the new events of all origins in listat into
+ * query. Returns -1 if one of them is unknown.
+ * ----------
+ */
+static int
+remoteListen_event_query(SlonNode * node, SlonDString * query,
+						 struct listat * listat)
+{
+	SlonNode   *origin;
+	SlonDString q2;
+	char	   *where_or_or;
+	char		seqno_buf[64];
+
+	/*
+	 * In the runtime configuration info for the node, we remember the last
+	 * event sequence that we actually have received. If the remote worker
+	 * thread has processed it yet or it isn't important, we have it in the
+	 * message queue at least and don't need to select it again.
+	 *
+	 * So the query we construct contains a qualification (ev_origin =
+	 * <remote_node> and ev_seqno > <last_seqno>) per remote node we're listen
+	 * for here.
+	 */
+	(void) slon_mkquery(query,
+						"select ev_origin, ev_seqno, ev_timestamp, "
+						"       ev_snapshot, "
+					"       \"pg_catalog\".txid_snapshot_xmin(ev_snapshot), "
+					"       \"pg_catalog\".txid_snapshot_xmax(ev_snapshot), "
+						"       ev_type, "
+						"       ev_data1, ev_data2, "
+						"       ev_data3, ev_data4, "
+						"       ev_data5, ev_data6, "
+						"       ev_data7, ev_data8 "
+						"from %s.sl_event e",
+						rtcfg_namespace);
+
+	rtcfg_lock();
+
+	where_or_or = "where";
+	if (lag_interval)
+	{
+		dstring_init(&q2);
+		(void) slon_mkquery(&q2, "where ev_timestamp < now() - '%s'::interval and (", lag_interval);
+		where_or_or = dstring_data(&q2);
+	}
+	while (listat)
+	{
+		if ((origin = rtcfg_findNode(listat->li_origin)) == NULL)
+		{
+			rtcfg_unlock();
+			slon_log(SLON_ERROR,
+					 "remoteListenThread_%d: unknown node %d\n",
+					 node->no_id, listat->li_origin);
+			if (lag_interval)
+				dstring_free(&q2);
+			return -1;
+		}
+		sprintf(seqno_buf, INT64_FORMAT, origin->last_event);
+		slon_appendquery(query,
+						 " %s (e.ev_origin = '%d' and e.ev_seqno > '%s')",
+						 where_or_or, listat->li_origin, seqno_buf);
+
+		where_or_or = "or";
+		listat = listat->next;
+	}
+	if (lag_interval)
+	{
+		slon_appendquery(query, ")");
+		dstring_free(&q2);
+	}
+
+	/*
+	 * Limit the result set size to: sync_group_maxsize * 2, if it's set 100,
+	 * if sync_group_maxsize isn't set
+	 */
+	slon_appendquery(query, " order by e.ev_origin, e.ev_seqno limit %d",
+					 (sync_group_maxsize > 0) ? sync_group_maxsize * 2 : 100);
+
+	rtcfg_unlock();
+
+	return 0;
+}
+
+
+/* ----------
+ * remoteListen_queue_events
+ *
+ * Add the events in the result of remoteListen_event_query() to the remote
+ * worker message queue. Returns the number of events.
+ * ----------
+ */
+static int
+remoteListen_queue_events(SlonNode * node, PGresult *res)
+{
+	int			ntuples;
+	int			tupno;
+
+	ntuples = PQntuples(res);
+	for (tupno = 0; tupno < ntuples; tupno++)
+	{
+		int			ev_origin;
+		int64		ev_seqno;
+
+		ev_origin = (int) strtol(PQgetvalue(res, tupno, 0), NULL, 10);
+		(void) slon_scanint64(PQgetvalue(res, tupno, 1), &ev_seqno);
+
+		slon_log(SLON_DEBUG2, "remoteListenThread_%d: "
+				 "queue event %d,%s %s\n",
+				 node->no_id, ev_origin, PQgetvalue(res, tupno, 1),
+				 PQgetvalue(res, tupno, 6));
+
+		remoteWorker_event(node->no_id,
+						   ev_origin, ev_seqno,
+						   PQgetvalue(res, tupno, 2),	/* ev_timestamp */
+						   PQgetvalue(res, tupno, 3),	/* ev_snapshot */
+						   PQgetvalue(res, tupno, 4),	/* mintxid */
+						   PQgetvalue(res, tupno, 5),	/* maxtxid */
+						   PQgetvalue(res, tupno, 6),	/* ev_type */
+			 (PQgetisnull(res, tupno, 7)) ? NULL : PQgetvalue(res, tupno, 7),
+			 (PQgetisnull(res, tupno, 8)) ? NULL : PQgetvalue(res, tupno, 8),
+			 (PQgetisnull(res, tupno, 9)) ? NULL : PQgetvalue(res, tupno, 9),
+		   (PQgetisnull(res, tupno, 10)) ? NULL : PQgetvalue(res, tupno, 10),
+		   (PQgetisnull(res, tupno, 11)) ? NULL : PQgetvalue(res, tupno, 11),
+		   (PQgetisnull(res, tupno, 12)) ? NULL : PQgetvalue(res, tupno, 12),
+		   (PQgetisnull(res, tupno, 13)) ? NULL : PQgetvalue(res, tupno, 13),
+		  (PQgetisnull(res, tupno, 14)) ? NULL : PQgetvalue(res, tupno, 14));
+	}
+
+	return ntuples;
+}
+
+
+/* ----------
+ * struct listenmux
+ *
+ * Per node state of the multiplexed remote listener. While a connection
+ * is being established, it is in pending and conn is NULL.
+ * ----------
+ */
+#define LISTENMUX_CONNECTING	0	/* PQconnectPoll() in progress */
+#define LISTENMUX_SQL_ON_CONN	1	/* sql_on_connection sent */
+#define LISTENMUX_SETUP			2	/* session setup query sent */
+
+struct listenmux
+{
+	SlonNode   *node;
+	SlonConn   *conn;
+	char	   *conn_conninfo;
+	struct listat *listat_head;
+	struct listat *listat_tail;
+
+	PGconn	   *pending;		/* connection not set up yet */
+	PostgresPollingStatusType pending_poll;
+	int			setup_step;
+	int			setup_pid;		/* backend PID of pending */
+	bool		setup_failed;
+	int			connretry;
+	int64		connect_timeout;
+
+	bool		busy;			/* event and confirm query outstanding */
+	bool		notified;		/* NOTIFY received since the last query */
+	bool		throttled;		/* ignore notifications until next_poll */
+	int			nresults;		/* results of the current query */
+	int			ntuples;		/* events of the current query */
+	int			poll_sleep;
+	int			sel_max_events;
+	int64		next_poll;		/* all times in msec since the epoch */
+	int64		query_timeout;
+	int64		retry_at;
+
+	struct listenmux *prev;
+	struct listenmux *next;
+};
+
+static struct listenmux *mux_head = NULL;
+static struct listenmux *mux_tail = NULL;
+
+static pthread_t mux_thread;
+static bool mux_running = false;
+static bool mux_shutdown = false;
+static int	mux_wakeuppipe[2];
+
+bool		remote_listen_multiplex;
+
+static void *remoteListenMux_main(void *dummy);
+static void remoteListenMux_adjust(void);
+static void remoteListenMux_connect(struct listenmux * lm, int64 now);
+static int	remoteListenMux_connect_input(struct listenmux * lm, int64 now);
+static int	remoteListenMux_setup_send(struct listenmux * lm);
+static int	remoteListenMux_setup_result(struct listenmux * lm, PGresult *res);
+static void remoteListenMux_setup_done(struct listenmux * lm, int64 now);
+static void remoteListenMux_disconnect(struct listenmux * lm, int64 retry_at);
+static int	remoteListenMux_poll(struct listenmux * lm, int64 now);
+static int	remoteListenMux_input(struct listenmux * lm, int64 now);
+static void remoteListenMux_done(struct listenmux * lm, int64 now);
+static int64 remoteListenMux_now(void);
+
+
+/* ----------
+ * remoteListenMux_start
+ *
+ * Start the multiplexed remote listener if it isn't running yet. Called
+ * with the runtime configuration locked.
+ * ----------
+ */
+int
+remoteListenMux_start(void)
+{
+	if (mux_running)
+		return 0;
+
+	if (pgpipe(mux_wakeuppipe) < 0)
+	{
+		slon_log(SLON_FATAL,
+				 "remoteListenMux: wakeup pipe create failed - %s\n",
+				 strerror(errno));
+		return -1;
+	}
+	mux_shutdown = false;
+	if (pthread_create(&mux_thread, NULL, remoteListenMux_main, NULL) < 0)
+	{
+		slon_log(SLON_FATAL,
+				 "remoteListenMux: cannot create thread - %s\n",
+				 strerror(errno));
+		return -1;
+	}
+	mux_running = true;
+
+	return 0;
+}
+
+
+/* ----------
+ * remoteListenMux_wakeup
+ *
+ * Cause the multiplexed remote listener to recheck the configuration.
+ * ----------
+ */
+void
+remoteListenMux_wakeup(void)
+{
+	if (!mux_running)
+		return;
+
+	if (pipewrite(mux_wakeuppipe[1], "x", 1) < 0)
+	{
+		slon_log(SLON_FATAL,
+				 "remoteListenMux: write() to wakeup pipe - %s\n",
+				 strerror(errno));
+		slon_restart();
+	}
+}
+
+
+/* ----------
+ * remoteListenMux_join
+ *
+ * Stop the multiplexed remote listener and wait for it to finish.
+ * ----------
+ */
+void
+remoteListenMux_join(void)
+{
+	if (!mux_running)
+		return;
+
+	mux_shutdown = true;
+	remoteListenMux_wakeup();
+	pthread_join(mux_thread, NULL);
+	mux_running = false;
+
+	close(mux_wakeuppipe[0]);
+	close(mux_wakeuppipe[1]);
+}
+
+
+/* ----------
+ * remoteListenMux_main
+ *
+ * Listen for events on all remote nodes from one thread. Every node gets
+ * its own connection as usual, but the queries are sent asynchronously and
+ * all sockets are watched by a single select(2). A node is queried again
+ * as soon as it sends a NOTIFY for a new event, otherwise on the same
+ * backoff schedule the per node listener uses.
+ * ----------
+ */
+static void *
+remoteListenMux_main(void *dummy)
+{
+	struct listenmux *lm;
+	int64		last_config_seq = -1;
+	int64		new_config_seq;
+	int64		now;
+	int64		wait_ms;
+	fd_set		rfds;
+	fd_set		wfds;
+	int			max_fd;
+	int			sock;
+	struct timeval tv;
+	char		buf[64];
+
+	slon_log(SLON_INFO, "remoteListenMux: thread starts\n");
+
+	while (sched_get_status() == SCHED_STATUS_OK && !mux_shutdown)
+	{
+		if (last_config_seq != (new_config_seq = rtcfg_seq_get()))
+		{
+			last_config_seq = new_config_seq;
+			remoteListenMux_adjust();
+		}
+
+		/*
+		 * Start the queries and connection attempts that are due and
+		 * collect the sockets to wait for. Connections are established
+		 * without blocking too, so an unreachable node does not hold up the
+		 * others. The timeout is capped so that a scheduler shutdown is
+		 * noticed within a second.
+		 */
+		FD_ZERO(&rfds);
+		FD_ZERO(&wfds);
+		FD_SET(mux_wakeuppipe[0], &rfds);
+		max_fd = mux_wakeuppipe[0];
+		wait_ms = 1000;
+
+		now = remoteListenMux_now();
+		for (lm = mux_head; lm; lm = lm->next)
+		{
+			if (lm->listat_head == NULL)
+				continue;
+
+			if (lm->conn == NULL)
+			{
+				if (lm->pending == NULL && now >= lm->retry_at)
+					remoteListenMux_connect(lm, now);
+				if (lm->pending == NULL)
+				{
+					if (lm->retry_at - now < wait_ms)
+						wait_ms = lm->retry_at - now;
+					continue;
+				}
+				if (now >= lm->connect_timeout)
+				{
+					slon_log(SLON_WARN,
+							 "remoteListenThread_%d: timeout (%d s) "
+							 "connecting to '%s' - retry in %d seconds\n",
+							 lm->node->no_id, remote_listen_timeout,
+							 lm->conn_conninfo, lm->connretry);
+					remoteListenMux_disconnect(lm, now + lm->connretry * 1000);
+					continue;
+				}
+				if (lm->connect_timeout - now < wait_ms)
+					wait_ms = lm->connect_timeout - now;
+
+				sock = PQsocket(lm->pending);
+				if (lm->setup_step == LISTENMUX_CONNECTING &&
+					lm->pending_poll == PGRES_POLLING_WRITING)
+					FD_SET(sock, &wfds);
+				else
+					FD_SET(sock, &rfds);
+				if (sock > max_fd)
+					max_fd = sock;
+				continue;
+			}
+
+			if (!lm->busy &&
+				(now >= lm->next_poll || (lm->notified && !lm->throttled)))
+			{
+				if (remoteListenMux_poll(lm, now) < 0)
+				{
+					remoteListenMux_disconnect(lm, now + 10000);
+					continue;
+				}
+			}
+
+			if (lm->busy)
+			{
+				if (lm->query_timeout - now < wait_ms)
+					wait_ms = lm->query_timeout - now;
+			}
+			else if (lm->next_poll - now < wait_ms)
+				wait_ms = lm->next_poll - now;
+
+			sock = PQsocket(lm->conn->dbconn);
+			FD_SET(sock, &rfds);
+			if (sock > max_fd)
+				max_fd = sock;
+		}
+
+		if (wait_ms < 0)
+			wait_ms = 0;
+		tv.tv_sec = wait_ms / 1000;
+		tv.tv_usec = (wait_ms % 1000) * 1000;
+		if (select(max_fd + 1, &rfds, &wfds, NULL, &tv) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			slon_log(SLON_FATAL,
+					 "remoteListenMux: select() - %s\n", strerror(errno));
+			slon_retry();
+		}
+		if (FD_ISSET(mux_wakeuppipe[0], &rfds))
+			(void) piperead(mux_wakeuppipe[0], buf, sizeof(buf));
+
+		/*
+		 * Collect notifications and results
+		 */
+		now = remoteListenMux_now();
+		for (lm = mux_head; lm; lm = lm->next)
+		{
+			if (lm->conn == NULL)
+			{
+				if (lm->pending == NULL)
+					continue;
+
+				sock = PQsocket(lm->pending);
+				if ((FD_ISSET(sock, &rfds) || FD_ISSET(sock, &wfds)) &&
+					remoteListenMux_connect_input(lm, now) < 0)
+					remoteListenMux_disconnect(lm, now + lm->connretry * 1000);
+				continue;
+			}
+
+			if (FD_ISSET(PQsocket(lm->conn->dbconn), &rfds) &&
+				remoteListenMux_input(lm, now) < 0)
+			{
+				remoteListenMux_disconnect(lm, now + 10000);
+				continue;
+			}
+			if (lm->busy && now >= lm->query_timeout)
+			{
+				slon_log(SLON_ERROR,
+						 "remoteListenThread_%d: timeout (%d s) for event selection\n",
+						 lm->node->no_id, remote_listen_timeout);
+				remoteListenMux_disconnect(lm, now + 10000);
+			}
+		}
+	}
+
+	/*
+	 * Doomsday!
+	 */
+	rtcfg_lock();
+	while ((lm = mux_head) != NULL)
+	{
+		if (lm->conn_conninfo != NULL)
+		{
+			slon_log(SLON_INFO,
+					 "remoteListenThread_%d: "
+					 "disconnecting from '%s'\n",
+					 lm->node->no_id, lm->conn_conninfo);
+			remoteListenMux_disconnect(lm, 0);
+		}
+		remoteListen_cleanup(&lm->listat_head, &lm->listat_tail);
+		lm->node->listen_status = SLON_TSTAT_DONE;
+
+		DLLIST_REMOVE(mux_head, mux_tail, lm);
+		free(lm);
+	}
+	rtcfg_unlock();
+
+	slon_log(SLON_DEBUG1, "remoteListenMux: thread done\n");
+	pthread_exit(NULL);
+}
+
+
+/* ----------
+ * remoteListenMux_adjust
+ *
+ * Bring the list of nodes we listen on in line with the node listen_status
+ * maintained by rtcfg_startStopNodeThread().
+ * ----------
+ */
+static void
+remoteListenMux_adjust(void)
+{
+	SlonNode   *node;
+	struct listenmux *lm;
+	struct listenmux *next;
+	int64		now = remoteListenMux_now();
+
+	rtcfg_lock();
+
+	/*
+	 * Forget the nodes we are no longer supposed to listen on
+	 */
+	for (lm = mux_head; lm; lm = next)
+	{
+		next = lm->next;
+		node = lm->node;
+
+		if (node->listen_status != SLON_TSTAT_NONE &&
+			node->listen_status != SLON_TSTAT_SHUTDOWN &&
+			(bool) node->no_active)
+			continue;
+
+		if (lm->conn_conninfo != NULL)
+		{
+			slon_log(SLON_CONFIG,
+					 "remoteListenThread_%d: "
+					 "disconnecting from '%s'\n",
+					 node->no_id, lm->conn_conninfo);
+			remoteListenMux_disconnect(lm, 0);
+		}
+		remoteListen_cleanup(&lm->listat_head, &lm->listat_tail);
+		node->listen_status = SLON_TSTAT_DONE;
+
+		DLLIST_REMOVE(mux_head, mux_tail, lm);
+		free(lm);
+	}
+
+	/*
+	 * Add new nodes and adjust what we listen for on the others
+	 */
+	for (node = rtcfg_node_list_head; node; node = node->next)
+	{
+		if (node->listen_status == SLON_TSTAT_RESTART)
+			node->listen_status = SLON_TSTAT_RUNNING;
+		if (node->listen_status != SLON_TSTAT_RUNNING ||
+			!((bool) node->no_active))
+			continue;
+
+		for (lm = mux_head; lm; lm = lm->next)
+			if (lm->node == node)
+				break;
+		if (lm == NULL)
+		{
+			lm = (struct listenmux *) malloc(sizeof(struct listenmux));
+			if (lm == NULL)
+			{
+				rtcfg_unlock();
+				perror("remoteListenMux_adjust: malloc()");
+				slon_retry();
+			}
+			memset(lm, 0, sizeof(struct listenmux));
+			lm->node = node;
+			DLLIST_ADD_TAIL(mux_head, mux_tail, lm);
+		}
+
+		/*
+		 * If there was a change in the connection information, reconnect.
+		 */
+		if (lm->conn_conninfo != NULL &&
+			(node->pa_conninfo == NULL ||
+			 strcmp(lm->conn_conninfo, node->pa_conninfo) != 0))
+		{
+			slon_log(SLON_CONFIG,
+					 "remoteListenThread_%d: "
+					 "disconnecting from '%s'\n",
+					 node->no_id, lm->conn_conninfo);
+			remoteListenMux_disconnect(lm, now);
+		}
+
+		remoteListen_adjust_listat(node, &lm->listat_head, &lm->listat_tail);
+		if (lm->listat_head == NULL)
+			slon_log(SLON_DEBUG2,
+					 "remoteListenThread_%d: nothing to listen for\n",
+					 node->no_id);
+		lm->next_poll = now;
+	}
+
+	rtcfg_unlock();
+}
+
+
+/* ----------
+ * remoteListenMux_connect
+ *
+ * Start opening the listen connection to one node. The rest is done by
+ * remoteListenMux_connect_input() as the socket becomes ready. On failure
+ * the next attempt is scheduled after the path's connect retry interval.
+ * ----------
+ */
+static void
+remoteListenMux_connect(struct listenmux * lm, int64 now)
+{
+	SlonNode   *node = lm->node;
+	PGconn	   *dbconn;
+
+	rtcfg_lock();
+	if (node->pa_conninfo == NULL)
+	{
+		rtcfg_unlock();
+		slon_log(SLON_WARN,
+				 "remoteListenThread_%d: no conninfo - "
+				 "retry in 10 seconds\n",
+				 node->no_id);
+		lm->retry_at = now + 10000;
+		return;
+	}
+	lm->conn_conninfo = strdup(node->pa_conninfo);
+	lm->connretry = node->pa_connretry;
+	rtcfg_unlock();
+
+	dbconn = PQconnectStart(lm->conn_conninfo);
+	if (dbconn == NULL || PQstatus(dbconn) == CONNECTION_BAD)
+	{
+		slon_log(SLON_WARN,
+				 "remoteListenThread_%d: DB connection failed - "
+				 "retry in %d seconds - %s",
+				 node->no_id, lm->connretry,
+				 dbconn == NULL ? "out of memory\n" : PQerrorMessage(dbconn));
+		if (dbconn != NULL)
+			PQfinish(dbconn);
+		free(lm->conn_conninfo);
+		lm->conn_conninfo = NULL;
+		lm->retry_at = now + lm->connretry * 1000;
+		return;
+	}
+
+	lm->pending = dbconn;
+	lm->pending_poll = PGRES_POLLING_WRITING;
+	lm->setup_step = LISTENMUX_CONNECTING;
+	lm->setup_pid = -1;
+	lm->setup_failed = false;
+	lm->connect_timeout = now + (int64) remote_listen_timeout * 1000;
+}
+
+
+/* ----------
+ * remoteListenMux_connect_input
+ *
+ * Advance a pending connection: continue the libpq connection handshake,
+ * then set up the session like slon_connectdb() and remoteListen_init_conn()
+ * do, with queries sent asynchronously.
+ * ----------
+ */
+static int
+remoteListenMux_connect_input(struct listenmux * lm, int64 now)
+{
+	PGconn	   *dbconn = lm->pending;
+	PGresult   *res;
+
+	if (lm->setup_step == LISTENMUX_CONNECTING)
+	{
+		lm->pending_poll = PQconnectPoll(dbconn);
+		if (lm->pending_poll == PGRES_POLLING_FAILED)
+		{
+			slon_log(SLON_WARN,
+					 "remoteListenThread_%d: DB connection failed - "
+					 "retry in %d seconds - %s",
+					 lm->node->no_id, lm->connretry, PQerrorMessage(dbconn));
+			return -1;
+		}
+		if (lm->pending_poll != PGRES_POLLING_OK)
+			return 0;
+
+		if (PQserverVersion(dbconn) < 80300)
+		{
+			slon_log(SLON_ERROR,
+					 "remoteListenThread_%d: PostgreSQL version %d "
+					 "of '%s' not supported\n",
+					 lm->node->no_id, PQserverVersion(dbconn),
+					 lm->conn_conninfo);
+			return -1;
+		}
+		slon_set_keepalive(dbconn);
+		return remoteListenMux_setup_send(lm);
+	}
+
+	if (PQconsumeInput(dbconn) == 0)
+	{
+		slon_log(SLON_ERROR,
+				 "remoteListenThread_%d: PQconsumeInput() - %s",
+				 lm->node->no_id, PQerrorMessage(dbconn));
+		return -1;
+	}
+	while (PQisBusy(dbconn) == 0)
+	{
+		res = PQgetResult(dbconn);
+		if (res == NULL)
+		{
+			if (lm->setup_failed)
+				return -1;
+			if (lm->setup_step == LISTENMUX_SQL_ON_CONN)
+				return remoteListenMux_setup_send(lm);
+			remoteListenMux_setup_done(lm, now);
+			return 0;
+		}
+		if (remoteListenMux_setup_result(lm, res) < 0)
+			lm->setup_failed = true;
+		PQclear(res);
+	}
+
+	return 0;
+}
+
+
+/* ----------
+ * remoteListenMux_setup_send
+ *
+ * Send the next session setup query of a pending connection. The user's
+ * sql_on_connection goes first and on its own, since its failure is not
+ * fatal. Everything else is one multi-statement query.
+ * ----------
+ */
+static int
+remoteListenMux_setup_send(struct listenmux * lm)
+{
+	SlonNode   *node = lm->node;
+	SlonDString query;
+
+	dstring_init(&query);
+	if (lm->setup_step == LISTENMUX_CONNECTING && sql_on_connection != NULL)
+	{
+		lm->setup_step = LISTENMUX_SQL_ON_CONN;
+		slon_mkquery(&query, "%s", sql_on_connection);
+	}
+	else
+	{
+		lm->setup_step = LISTENMUX_SETUP;
+		slon_mkquery(&query,
+					 "set datestyle to 'ISO'; "
+					 "set escape_string_warning to 'off'; "
+					 "set standard_conforming_strings to 'off'; "
+					 "select pg_catalog.pg_backend_pid() as backend_pid; "
+					 "select %s.store_application_name('slon.node_%d_listen'); "
+					 "select %s.registerNodeConnection(%d); "
+					 "select last_value::int4 as local_node_id "
+					 "from %s.sl_local_node_id; ",
+					 rtcfg_namespace, node->no_id,
+					 rtcfg_namespace, rtcfg_nodeid,
+					 rtcfg_namespace);
+		if (enable_version_check)
+			slon_appendquery(&query,
+							 "select %s.slonyVersion() as schema_version; "
+							 "select %s.getModuleVersion() as module_version; ",
+							 rtcfg_namespace, rtcfg_namespace);
+		if (PQserverVersion(lm->pending) >= 90100)
+			slon_appendquery(&query,
+							 "set session characteristics as transaction "
+							 "read only isolation level %s; ",
+							 remote_listen_serializable_transactions ?
+							 "serializable deferrable" : "repeatable read");
+
+		/*
+		 * createEvent() notifies this channel for every new event.
+		 */
+		slon_appendquery(&query, "listen \"_%s_Event\"; ",
+						 rtcfg_cluster_name);
+	}
+
+	if (PQsendQuery(lm->pending, dstring_data(&query)) == 0)
+	{
+		slon_log(SLON_ERROR,
+				 "remoteListenThread_%d: \"%s\" - %s",
+				 node->no_id,
+				 dstring_data(&query), PQerrorMessage(lm->pending));
+		dstring_free(&query);
+		return -1;
+	}
+	dstring_free(&query);
+
+	return 0;
+}
+
+
+/* ----------
+ * remoteListenMux_setup_result
+ *
+ * Check one result of the session setup. Returns -1 if the connection
+ * cannot be used.
+ * ----------
+ */
+static int
+remoteListenMux_setup_result(struct listenmux * lm, PGresult *res)
+{
+	int			node_id = lm->node->no_id;
+	const char *name;
+	const char *value;
+
+	if (PQresultStatus(res) != PGRES_TUPLES_OK &&
+		PQresultStatus(res) != PGRES_COMMAND_OK)
+	{
+		if (lm->setup_step == LISTENMUX_SQL_ON_CONN)
+		{
+			slon_log(SLON_ERROR,
+					 "query %s failed\n", sql_on_connection);
+			return 0;
+		}
+		slon_log(SLON_ERROR,
+				 "remoteListenThread_%d: connection setup - %s",
+				 node_id, PQresultErrorMessage(res));
+		return -1;
+	}
+	if (lm->setup_step != LISTENMUX_SETUP ||
+		PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) != 1)
+		return 0;
+
+	name = PQfname(res, 0);
+	value = PQgetvalue(res, 0, 0);
+	if (strcmp(name, "backend_pid") == 0)
+		lm->setup_pid = strtol(value, NULL, 10);
+	else if (strcmp(name, "local_node_id") == 0)
+	{
+		if (strtol(value, NULL, 10) != node_id)
+		{
+			slon_log(SLON_ERROR,
+					 "remoteListenThread_%d: db_getLocalNodeId() "
+					 "returned %s - wrong database?\n",
+					 node_id, value);
+			return -1;
+		}
+	}
+	else if (strcmp(name, "schema_version") == 0 ||
+			 strcmp(name, "module_version") == 0)
+	{
+		if (strcmp(value, SLONY_I_VERSION_STRING) != 0)
+		{
+			slon_log(SLON_ERROR,
+					 "remoteListenThread_%d: Slony-I %s version is %s\n",
+					 node_id, name[0] == 's' ? "schema" : "module", value);
+			slon_log(SLON_ERROR,
+					 "please upgrade Slony-I to version %s\n",
+					 SLONY_I_VERSION_STRING);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+
+/* ----------
+ * remoteListenMux_setup_done
+ *
+ * The pending connection is ready, start listening on it.
+ * ----------
+ */
+static void
+remoteListenMux_setup_done(struct listenmux * lm, int64 now)
+{
+	SlonNode   *node = lm->node;
+	SlonConn   *conn;
+	char		conn_symname[64];
+
+	sprintf(conn_symname, "node_%d_listen", node->no_id);
+	conn = slon_make_dummyconn(conn_symname);
+	conn->dbconn = lm->pending;
+	conn->pg_version = PQserverVersion(lm->pending);
+	conn->conn_pid = lm->setup_pid;
+	lm->pending = NULL;
+
+	monitor_state("remote listener", node->no_id, conn->conn_pid, "thread main loop", 0, "n/a");
+	slon_log(SLON_DEBUG1,
+			 "remoteListenThread_%d: connected to '%s'\n",
+			 node->no_id, lm->conn_conninfo);
+
+	lm->conn = conn;
+	lm->busy = false;
+	lm->notified = false;
+	lm->throttled = false;
+	lm->poll_sleep = 0;
+	lm->sel_max_events = 0;
+	lm->next_poll = now;
+}
+
+
+/* ----------
+ * remoteListenMux_disconnect
+ * ----------
+ */
+static void
+remoteListenMux_disconnect(struct listenmux * lm, int64 retry_at)
+{
+	if (lm->conn != NULL)
+		slon_disconnectdb(lm->conn);
+	else if (lm->pending != NULL)
+		PQfinish(lm->pending);
+	free(lm->conn_conninfo);
+	lm->conn = NULL;
+	lm->pending = NULL;
+	lm->conn_conninfo = NULL;
+	lm->busy = false;
+	lm->notified = false;
+	lm->retry_at = retry_at;
+}
+
+
+/* ----------
+ * remoteListenMux_poll
+ *
+ * Send the event and the confirm query to one node without waiting for
+ * the result.
+ * ----------
+ */
+static int
+remoteListenMux_poll(struct listenmux * lm, int64 now)
+{
+	SlonDString query;
+
+	dstring_init(&query);
+	if (remoteListen_event_query(lm->node, &query, lm->listat_head) < 0)
+	{
+		dstring_free(&query);
+		return -1;
+	}
+	slon_appendquery(&query, "; ");
+	remoteListen_confirm_query(&query);
+
+	if (PQsendQuery(lm->conn->dbconn, dstring_data(&query)) == 0)
+	{
+		slon_log(SLON_ERROR,
+				 "remoteListenThread_%d: \"%s\" - %s",
+				 lm->node->no_id,
+				 dstring_data(&query), PQerrorMessage(lm->conn->dbconn));
+		dstring_free(&query);
+		return -1;
+	}
+	dstring_free(&query);
+
+	/*
+	 * A NOTIFY arriving from now on may be for an event this query does not
+	 * see yet, so it has to trigger another one.
+	 */
+	lm->busy = true;
+	lm->notified = false;
+	lm->throttled = false;
+	lm->nresults = 0;
+	lm->ntuples = 0;
+	lm->query_timeout = now + (int64) remote_listen_timeout * 1000;
+
+	monitor_state("remote listener", lm->node->no_id, lm->conn->conn_pid, "receiving events", 0, "n/a");
+	return 0;
+}
+
+
+/* ----------
+ * remoteListenMux_input
+ *
+ * Consume what arrived on one node's connection.
+ * ----------
+ */
+static int
+remoteListenMux_input(struct listenmux * lm, int64 now)
+{
+	PGconn	   *dbconn = lm->conn->dbconn;
+	PGnotify   *notification;
+	PGresult   *res;
+
+	if (PQconsumeInput(dbconn) == 0)
+	{
+		slon_log(SLON_ERROR,
+				 "remoteListenThread_%d: PQconsumeInput() - %s",
+				 lm->node->no_id, PQerrorMessage(dbconn));
+		return -1;
+	}
+	while ((notification = PQnotifies(dbconn)) != NULL)
+	{
+		lm->notified = true;
+		PQfreemem(notification);
+	}
+
+	while (lm->busy && PQisBusy(dbconn) == 0)
+	{
+		res = PQgetResult(dbconn);
+		if (res == NULL)
+		{
+			remoteListenMux_done(lm, now);
+			break;
+		}
+		if (PQresultStatus(res) != PGRES_TUPLES_OK)
+		{
+			slon_log(SLON_ERROR,
+					 "remoteListenThread_%d: event selection - %s",
+					 lm->node->no_id, PQresultErrorMessage(res));
+			PQclear(res);
+			return -1;
+		}
+		if (lm->nresults++ == 0)
+			lm->ntuples = remoteListen_queue_events(lm->node, res);
+		else
+			remoteListen_queue_confirms(lm->node, res);
+		PQclear(res);
+	}
+
+	return 0;
+}
+
+
+/* ----------
+ * remoteListenMux_done
+ *
+ * Schedule the next query of a node after the current one completed.
+ * ----------
+ */
+static void
+remoteListenMux_done(struct listenmux * lm, int64 now)
+{
+	lm->busy = false;
+
+	/* If we drew in the maximum number of events */
+	if (lm->ntuples == ((sync_group_maxsize > 0) ? sync_group_maxsize * 2 : 100))
+		lm->sel_max_events++;
+	else
+		lm->sel_max_events = 0;
+
+	if (lm->ntuples > 0)
+	{
+		if ((lm->sel_max_events > 2) && (sync_group_maxsize > 100))
+		{
+			slon_log(SLON_INFO, "remoteListenThread_%d: drew maximum # of events for %d iterations\n",
+					 lm->node->no_id, lm->sel_max_events);
+			lm->throttled = true;
+			lm->next_poll = now + 10000 + (1000 * lm->sel_max_events);
+		}
+		else
+		{
+			lm->poll_sleep = 0;
+			lm->next_poll = now;
+		}
+	}
+	else
+	{
+		lm->poll_sleep = lm->poll_sleep * 2 + sync_interval;
+		if (lm->poll_sleep > sync_interval_timeout)
+			lm->poll_sleep = sync_interval_timeout;
+		lm->next_poll = now + lm->poll_sleep;
+	}
+
+	monitor_state("remote listener", lm->node->no_id, lm->conn->conn_pid, "thread main loop", 0, "n/a");
+}
+
+
+/* ----------
+ * remoteListenMux_now
+ * ----------
+ */
+static int64
+remoteListenMux_now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (int64) tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
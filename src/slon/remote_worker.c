@@ -18,6 +18,8 @@
 #include <string.h>
 #include <errno.h>
 #include <signal.h>
+#include <dirent.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #ifndef WIN32
 #include <unistd.h>
@@ -27,7 +29,6 @@
 
 #include "slon.h"
 #include "../parsestatements/scanner.h"
-extern int	STMTS[MAXSTATEMENTS];
 
 #define MAXGROUPSIZE 10000		/* What is the largest number of SYNCs we'd
 								 * want to group together??? */
@@ -163,6 +164,10 @@ struct PerfMon_s
 	int			num_updates;
 	int			num_deletes;
 	int			num_truncates;
+	int64		num_rows;		/* Number of sl_log rows copied */
+	int64		num_bytes;		/* Number of bytes of COPY data received */
+	double		first_row_t;	/* Delay until the first log row arrived */
+	int			num_markers;	/* Number of latency trace markers copied */
 };
 
 struct ProviderInfo_s
@@ -195,6 +200,8 @@ struct WorkerGroupData_s
 	ProviderInfo *provider_tail;
 
 	char		duration_buf[64];
+	PerfMon		sync_perf;		/* Totals of the current SYNC group */
+	int			sync_group_size;	/* Number of SYNCs in the current group */
 };
 
 
@@ -217,10 +224,40 @@ static struct node_confirm_status *node_confirm_tail = NULL;
 static pthread_mutex_t node_confirm_lock = PTHREAD_MUTEX_INITIALIZER;
 
 int			sync_group_maxsize;
+int			sync_perf_history;
+bool		sync_group_compaction;
 int			explain_interval;
+char	   *archive_compression;
+int			archive_compression_level;
+int			archive_segment_maxsize;
+int			archive_segment_maxage;
 time_t		explain_lastsec;
 int			explain_thistime;
 
+#define archive_coalescing \
+	(archive_segment_maxsize > 0 || archive_segment_maxage > 0)
+
+/*
+ * The archive segment that SYNC groups are coalesced into, see
+ * archive_segment_open_group().
+ */
+typedef struct
+{
+	ArchiveFile *af;			/* NULL if no segment is open */
+	FILE	   *idx_fp;			/* counter and end offset of each group */
+	int			method;
+	char		temp[SLON_MAX_PATH];
+	char		idx[SLON_MAX_PATH];
+	char		last_counter[64];	/* counter of the last complete group */
+	ArchiveFileStats last_stats;	/* file state after that group */
+	int			groups;
+	time_t		opened;
+}	ArchiveSegment;
+
+static ArchiveSegment archive_segment;
+static pthread_mutex_t archive_segment_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool archive_segment_recovered = false;
+
 typedef enum
 {
 	SYNC_INITIAL = 1,
@@ -244,6 +281,7 @@ static void start_monitored_event(PerfMon * pm);
 static void monitor_provider_query(PerfMon * pm);
 static void monitor_subscriber_query(PerfMon * pm);
 static void monitor_subscriber_iud(PerfMon * pm);
+static void add_perfmon(PerfMon * dst, PerfMon * src);
 
 static void adjust_provider_info(SlonNode * node,
 					 WorkerGroupData * wd, int cleanup, int event_provider);
@@ -259,6 +297,8 @@ static int copy_set(SlonNode * node, SlonConn * local_conn, int set_id,
 static int sync_event(SlonNode * node, SlonConn * local_conn,
 		   WorkerGroupData * wd, SlonWorkMsg_event * event);
 static int	sync_helper(void *cdata, PGconn *local_dbconn);
+static char copy_row_cmdtype(const char *row, int len);
+static int	copy_row_archive_len(const char *row, int len);
 
 
 static int archive_open(SlonNode * node, char *seqbuf,
@@ -269,8 +309,24 @@ static void archive_terminate(SlonNode * node);
 static int	archive_append_ds(SlonNode * node, SlonDString * ds);
 static int	archive_append_str(SlonNode * node, const char *s);
 static int	archive_append_data(SlonNode * node, const char *s, int len);
-
-
+static int	archive_write(SlonNode * node, const char *data, size_t len);
+static int	archive_wait(SlonNode * node);
+static void archive_make_name(char *buf, const char *counter,
+				  const char *suffix);
+static void archive_header(SlonDString * ds, SlonNode * node, char *seqbuf);
+static void archive_trailer(SlonDString * ds);
+static int archive_publish(int node_id, char *temp, char *name,
+				ArchiveFileStats * stats, int groups);
+static int archive_segment_open_group(SlonNode * node, int method,
+						   char *seqbuf);
+static int	archive_segment_close_group(SlonNode * node);
+static void archive_segment_abort_group(SlonNode * node);
+static int	archive_segment_finish(int node_id);
+static void archive_segment_discard(void);
+static void archive_segment_recover(int node_id, int64 committed);
+
+
+static void append_log_tabname_cols(SlonDString * dsp);
 static void compress_actionseq(const char *ssy_actionseq, SlonDString * action_subquery);
 
 #ifdef UNUSED
@@ -540,6 +596,7 @@ remoteWorkerThread_main(void *cdata)
 		if (strcmp(event->ev_type, "SYNC") == 0)
 		{
 			SlonWorkMsg_event *sync_group[MAXGROUPSIZE + 1];
+			int64		sync_first_seqno;
 			int			seconds;
 			ScheduleStatus rc;
 			int			i;
@@ -627,6 +684,7 @@ remoteWorkerThread_main(void *cdata)
 				 * Process the sync and apply the replication data. If
 				 * successful, exit this loop and commit the transaction.
 				 */
+				wd->sync_group_size = sync_group_size;
 				seconds = sync_event(node, local_conn, wd, event);
 				if (seconds == 0)
 				{
@@ -658,6 +716,34 @@ remoteWorkerThread_main(void *cdata)
 			 * events, the call to logApplySaveStats()	and a commit.
 			 */
 			dstring_reset(&query1);
+			sync_first_seqno = sync_group[0]->ev_seqno;
+
+			/*
+			 * Record this SYNC group in sl_sync_perf. This must come
+			 * before logApplySaveStats(), which resets the apply counters.
+			 */
+			if (sync_perf_history > 0)
+			{
+				PerfMon    *sp = &(wd->sync_perf);
+				char		prov_buf[64];
+				char		subscr_buf[64];
+				char		first_row_buf[64];
+
+				sprintf(prov_buf, "%.3f s", sp->prov_query_t);
+				sprintf(subscr_buf, "%.3f s", sp->subscr_query_t);
+				sprintf(first_row_buf, "%.3f s", sp->first_row_t);
+				slon_appendquery(&query1, "select %s.logApplySyncPerf("
+								 "'_%s', %d, %L, %L, %d, %L, %L, "
+								 "'%s'::interval, '%s'::interval, "
+								 "'%s'::interval, '%s'::interval); ",
+								 rtcfg_namespace, rtcfg_cluster_name,
+								 node->no_id, sync_first_seqno,
+								 event->ev_seqno, sync_group_size,
+								 sp->num_rows, sp->num_bytes,
+								 wd->duration_buf, prov_buf,
+								 subscr_buf, first_row_buf);
+			}
+
 			sg_last_grouping = 0;
 			for (i = 0; i < sync_group_size; i++)
 			{
@@ -669,6 +755,18 @@ remoteWorkerThread_main(void *cdata)
 				sg_last_grouping++;
 			}
 
+			/*
+			 * Turn the latency trace markers applied in this group into
+			 * histogram entries. This needs the SYNC events forwarded
+			 * above to find the SYNC that first covered each traced
+			 * transaction. Without latency tracing on the origin there
+			 * are no markers and nothing to do.
+			 */
+			if (wd->sync_perf.num_markers > 0)
+				slon_appendquery(&query1, "select %s.logApplyLatency(%d, %L, %L); ",
+								 rtcfg_namespace, node->no_id,
+								 sync_first_seqno, event->ev_seqno);
+
 			if (monitor_threads)
 			{
 				slon_appendquery(&query1, "select %s.logApplySaveStats("
@@ -967,6 +1065,12 @@ remoteWorkerThread_main(void *cdata)
 				 * in the runtime configuration.
 				 */
 			}
+			else if (strcmp(event->ev_type, "SET_ADD_TABLES") == 0)
+			{
+				/*
+				 * Same as SET_ADD_TABLE, for many tables at once.
+				 */
+			}
 			else if (strcmp(event->ev_type, "SET_ADD_SEQUENCE") == 0)
 			{
 				/*
@@ -1009,6 +1113,24 @@ remoteWorkerThread_main(void *cdata)
 								 rtcfg_namespace,
 								 tab_id, new_set_id);
 			}
+			else if (strcmp(event->ev_type, "SET_TABLE_FILTER") == 0)
+			{
+				int			tab_id = (int) strtol(event->ev_data1, NULL, 10);
+				int			receiver = (int) strtol(event->ev_data2, NULL, 10);
+				int			set_id = (int) strtol(event->ev_data3, NULL, 10);
+
+				slon_appendquery(&query1,
+								 "lock table %s.sl_config_lock;"
+								 "select %s.setTableFilter_int(%d, %d, %d, ",
+								 rtcfg_namespace,
+								 rtcfg_namespace,
+								 tab_id, receiver, set_id);
+				if (event->ev_data4 != NULL)
+					slon_appendquery(&query1, "'%q', '%q');",
+									 event->ev_data4, event->ev_data5);
+				else
+					slon_appendquery(&query1, "NULL, NULL);");
+			}
 			else if (strcmp(event->ev_type, "SET_MOVE_SEQUENCE") == 0)
 			{
 				int			seq_id = (int) strtol(event->ev_data1, NULL, 10);
@@ -2842,7 +2964,10 @@ copy_set(SlonNode * node, SlonConn * local_conn, int set_id,
 						"select T.tab_id, "
 						"    %s.slon_quote_brute(PGN.nspname) || '.' || "
 						"    %s.slon_quote_brute(PGC.relname) as tab_fqname, "
-						"    T.tab_idxname, T.tab_comment "
+						"    T.tab_idxname, T.tab_comment, T.tab_columns, "
+						"    (select F.tf_filter from %s.sl_table_filter F "
+						"        where F.tf_tab_id = T.tab_id "
+						"        and F.tf_receiver = %d) "
 						"from %s.sl_table T, "
 						"    \"pg_catalog\".pg_class PGC, "
 						"    \"pg_catalog\".pg_namespace PGN "
@@ -2853,6 +2978,8 @@ copy_set(SlonNode * node, SlonConn * local_conn, int set_id,
 						rtcfg_namespace,
 						rtcfg_namespace,
 						rtcfg_namespace,
+						rtcfg_nodeid,
+						rtcfg_namespace,
 						set_id);
 	res1 = PQexec(pro_dbconn, dstring_data(&query1));
 	if (PQresultStatus(res1) != PGRES_TUPLES_OK)
@@ -2881,6 +3008,10 @@ copy_set(SlonNode * node, SlonConn * local_conn, int set_id,
 		char	   *tab_fqname = PQgetvalue(res1, tupno1, 1);
 		char	   *tab_idxname = PQgetvalue(res1, tupno1, 2);
 		char	   *tab_comment = PQgetvalue(res1, tupno1, 3);
+		char	   *tab_columns = PQgetisnull(res1, tupno1, 4) ? NULL :
+		PQgetvalue(res1, tupno1, 4);
+		char	   *tab_filter = PQgetisnull(res1, tupno1, 5) ? NULL :
+		PQgetvalue(res1, tupno1, 5);
 		int64		copysize = 0;
 
 		gettimeofday(&tv_start2, NULL);
@@ -2895,10 +3026,14 @@ copy_set(SlonNode * node, SlonConn * local_conn, int set_id,
 		 */
 		(void) slon_mkquery(&query1,
 							"lock table %s.sl_config_lock;"
-					 "select %s.setAddTable_int(%d, %d, '%q', '%q', '%q'); ",
+					 "select %s.setAddTable_int(%d, %d, '%q', '%q', '%q', ",
 							rtcfg_namespace,
 							rtcfg_namespace,
 					   set_id, tab_id, tab_fqname, tab_idxname, tab_comment);
+		if (tab_columns != NULL)
+			slon_appendquery(&query1, "'%q'::text[]); ", tab_columns);
+		else
+			slon_appendquery(&query1, "NULL::text[]); ");
 		if (query_execute(node, loc_dbconn, &query1) < 0)
 		{
 			PQclear(res1);
@@ -2998,10 +3133,24 @@ copy_set(SlonNode * node, SlonConn * local_conn, int set_id,
 			}
 
 			/*
-			 * Begin a COPY to stdout for the table on the provider DB
+			 * Begin a COPY to stdout for the table on the provider DB. With
+			 * a row filter for this node, copy only the matching rows.
 			 */
-			(void) slon_mkquery(&query1,
-			   "copy %s %s to stdout; ", tab_fqname, PQgetvalue(res3, 0, 0));
+			if (tab_filter != NULL)
+			{
+				char	   *fields = PQgetvalue(res3, 0, 0);
+
+				slon_mkquery(&query1, "copy (select ");
+				dstring_nappend(&query1, fields + 1, strlen(fields) - 2);
+				slon_appendquery(&query1, " from %s where (%s)) to stdout; ",
+								 tab_fqname, tab_filter);
+				slon_log(SLON_CONFIG, "remoteWorkerThread_%d: "
+						 "copy of table %s filtered by %s\n",
+						 node->no_id, tab_fqname, tab_filter);
+			}
+			else
+				(void) slon_mkquery(&query1,
+				   "copy %s %s to stdout; ", tab_fqname, PQgetvalue(res3, 0, 0));
 			PQclear(res3);
 			res3 = PQexec(pro_dbconn, dstring_data(&query1));
 			if (PQresultStatus(res3) != PGRES_COPY_OUT)
@@ -3669,6 +3818,7 @@ sync_event(SlonNode * node, SlonConn * local_conn,
 	dstring_init(&lsquery);
 
 	init_perfmon(&pm);
+	init_perfmon(&(wd->sync_perf));
 
 	/*
 	 * If this slon is running in log archiving mode, open a temporary file
@@ -3826,9 +3976,7 @@ sync_event(SlonNode * node, SlonConn * local_conn,
 	{
 		int			ntuples1;
 		int			tupno1;
-		PGresult   *res2;
 		int			ntuples2;
-		int			tupno2;
 		int			ntables_total = 0;
 		int			rc;
 		int			need_union;
@@ -3915,7 +4063,7 @@ sync_event(SlonNode * node, SlonConn * local_conn,
 							 "select log_origin, log_txid, "
 							 "NULL::integer, log_actionseq, "
 							 "NULL::text, NULL::text, log_cmdtype, "
-							 "NULL::integer, log_cmdargs "
+							 "NULL::integer, log_cmdargs, NULL::integer "
 							 "from %s.sl_log_script "
 							 "where log_origin = %d ",
 							 rtcfg_namespace, node->no_id);
@@ -3932,7 +4080,7 @@ sync_event(SlonNode * node, SlonConn * local_conn,
 							 "select log_origin, log_txid, "
 							 "NULL::integer, log_actionseq, "
 							 "NULL::text, NULL::text, log_cmdtype, "
-							 "NULL::integer, log_cmdargs "
+							 "NULL::integer, log_cmdargs, NULL::integer "
 							 "from %s.sl_log_script "
 							 "where log_origin = %d ",
 							 rtcfg_namespace, node->no_id);
@@ -3956,17 +4104,31 @@ sync_event(SlonNode * node, SlonConn * local_conn,
 		{
 			/*
 			 * Select all sets we receive from this provider and which are not
-			 * synced better than this SYNC already.
+			 * synced better than this SYNC already, together with the number
+			 * of tables in them and the condition for the row filters of
+			 * their tables for this node. TRUNCATE and latency marker rows
+			 * pass all filters.
 			 */
 			(void) slon_mkquery(&query,
 								"select SSY.ssy_setid, SSY.ssy_seqno, "
 				  "    \"pg_catalog\".txid_snapshot_xmax(SSY.ssy_snapshot), "
 								"    SSY.ssy_snapshot, "
-								"    SSY.ssy_action_list "
+								"    SSY.ssy_action_list, "
+								"    (select count(*) from %s.sl_table T "
+								"        where T.tab_set = SSY.ssy_setid), "
+								"    \"pg_catalog\".nullif("
+								"    \"pg_catalog\".array_to_string(array("
+								"        select '(log_tableid <> ' || F.tf_tab_id || "
+								"        ' or log_cmdtype in (''T'', ''M'') or ' || "
+								"        F.tf_logfilter || ')' "
+								"        from %s.sl_table_filter F "
+								"        where F.tf_set = SSY.ssy_setid "
+								"        and F.tf_receiver = %d), ' and '), '') "
 								"from %s.sl_setsync SSY "
 								"where SSY.ssy_seqno < '%s' "
 								"    and SSY.ssy_setid in (",
-								rtcfg_namespace, seqbuf);
+								rtcfg_namespace, rtcfg_namespace,
+								rtcfg_nodeid, rtcfg_namespace, seqbuf);
 			for (pset = provider->set_head; pset; pset = pset->next)
 				slon_appendquery(&query, "%s%d",
 								 (pset->prev == NULL) ? "" : ",",
@@ -4011,7 +4173,7 @@ sync_event(SlonNode * node, SlonConn * local_conn,
 								 "select log_origin, log_txid, log_tableid, "
 								 "log_actionseq, log_tablenspname, "
 								 "log_tablerelname, log_cmdtype, "
-								 "log_cmdupdncols, log_cmdargs "
+								 "log_cmdupdncols, log_cmdargs, log_setid "
 								 "from %s.sl_log_1 "
 								 "where false) TO STDOUT",
 								 rtcfg_namespace);
@@ -4030,6 +4192,8 @@ sync_event(SlonNode * node, SlonConn * local_conn,
 				char	   *ssy_maxxid = PQgetvalue(res1, tupno1, 2);
 				char	   *ssy_snapshot = PQgetvalue(res1, tupno1, 3);
 				char	   *ssy_action_list = PQgetvalue(res1, tupno1, 4);
+				char	   *row_filter = PQgetisnull(res1, tupno1, 6) ? NULL :
+				PQgetvalue(res1, tupno1, 6);
 				int64		ssy_seqno;
 
 				if (strcmp(ssy_snapshot,"1:1:")==0 &&
@@ -4050,54 +4214,21 @@ sync_event(SlonNode * node, SlonConn * local_conn,
 					min_ssy_seqno = ssy_seqno;
 
 				/*
-				 * Select the tables in that set ...
+				 * Skip sets without tables, the log rows of the others are
+				 * selected by their log_setid.
 				 */
-				(void) slon_mkquery(&query,
-									"select T.tab_id, T.tab_set, "
-							"    %s.slon_quote_brute(PGN.nspname) || '.' || "
-						"    %s.slon_quote_brute(PGC.relname) as tab_fqname "
-									"from %s.sl_table T, "
-									"    \"pg_catalog\".pg_class PGC, "
-									"    \"pg_catalog\".pg_namespace PGN "
-									"where T.tab_set = %d "
-									"    and PGC.oid = T.tab_reloid "
-									"    and PGC.relnamespace = PGN.oid; ",
-									rtcfg_namespace,
-									rtcfg_namespace,
-									rtcfg_namespace,
-									sub_set);
-
-				start_monitored_event(&pm);
-				res2 = PQexec(local_dbconn, dstring_data(&query));
-				monitor_subscriber_query(&pm);
-
-				if (PQresultStatus(res2) != PGRES_TUPLES_OK)
-				{
-					slon_log(SLON_ERROR, "remoteWorkerThread_%d: \"%s\" %s",
-							 node->no_id, dstring_data(&query),
-							 PQresultErrorMessage(res2));
-					PQclear(res2);
-					PQclear(res1);
-					dstring_free(&query);
-					dstring_free(&lsquery);
-					archive_terminate(node);
-					return 60;
-				}
-				ntuples2 = PQntuples(res2);
+				ntuples2 = strtol(PQgetvalue(res1, tupno1, 5), NULL, 10);
 				slon_log(SLON_INFO, "remoteWorkerThread_%d: "
 						 "syncing set %d with %d table(s) from provider %d\n",
 						 node->no_id, sub_set, ntuples2,
 						 provider->no_id);
 
 				if (ntuples2 == 0)
-				{
-					PQclear(res2);
 					continue;
-				}
 				ntables_total += ntuples2;
 
 				/*
-				 * ... and build up the log selection query
+				 * Build up the log selection query
 				 */
 				for (sl_log_no = 1; sl_log_no <= 2; sl_log_no++)
 				{
@@ -4126,26 +4257,23 @@ sync_event(SlonNode * node, SlonConn * local_conn,
 					 * upper and lower bounds:
 					 *
 					 * select ... from sl_log_N where log_origin = X and
-					 * log_tableid in (<this set's tables>)
+					 * log_setid = <this set>
 					 */
 					slon_appendquery(provider_query,
 								 "select log_origin, log_txid, log_tableid, "
-									 "log_actionseq, log_tablenspname, "
-									 "log_tablerelname, log_cmdtype, "
-									 "log_cmdupdncols, log_cmdargs "
+									 "log_actionseq, ");
+					append_log_tabname_cols(provider_query);
+					slon_appendquery(provider_query,
+									 "log_cmdtype, "
+									 "log_cmdupdncols, log_cmdargs, log_setid "
 									 "from %s.sl_log_%d "
 									 "where log_origin = %d "
-									 "and log_tableid in (",
+									 "and log_setid = %d ",
 									 rtcfg_namespace, sl_log_no,
-									 node->no_id);
-					for (tupno2 = 0; tupno2 < ntuples2; tupno2++)
-					{
-						if (tupno2 > 0)
-							dstring_addchar(provider_query, ',');
-						dstring_append(provider_query,
-									   PQgetvalue(res2, tupno2, 0));
-					}
-					dstring_append(provider_query, ") ");
+									 node->no_id, sub_set);
+					if (row_filter != NULL)
+						slon_appendquery(provider_query, "and %s ",
+										 row_filter);
 
 					/*
 					 * and log_txid >= '<maxxid_last_snapshot>' and log_txid <
@@ -4188,28 +4316,25 @@ sync_event(SlonNode * node, SlonConn * local_conn,
 					 * committed by the time of snapshot two. again, we do:
 					 *
 					 * select ... from sl_log_N where log_origin = X and
-					 * log_tableid in (<this set's tables>)
+					 * log_setid = <this set>
 					 */
 
 					slon_appendquery(provider_query,
 									 "union all "
 								 "select log_origin, log_txid, log_tableid, "
-									 "log_actionseq, log_tablenspname, "
-									 "log_tablerelname, log_cmdtype, "
-									 "log_cmdupdncols, log_cmdargs "
+									 "log_actionseq, ");
+					append_log_tabname_cols(provider_query);
+					slon_appendquery(provider_query,
+									 "log_cmdtype, "
+									 "log_cmdupdncols, log_cmdargs, log_setid "
 									 "from %s.sl_log_%d "
 									 "where log_origin = %d "
-									 "and log_tableid in (",
+									 "and log_setid = %d ",
 									 rtcfg_namespace, sl_log_no,
-									 node->no_id);
-					for (tupno2 = 0; tupno2 < ntuples2; tupno2++)
-					{
-						if (tupno2 > 0)
-							dstring_addchar(provider_query, ',');
-						dstring_append(provider_query,
-									   PQgetvalue(res2, tupno2, 0));
-					}
-					dstring_append(provider_query, ") ");
+									 node->no_id, sub_set);
+					if (row_filter != NULL)
+						slon_appendquery(provider_query, "and %s ",
+										 row_filter);
 
 					/*
 					 * and log_txid in (select
@@ -4239,7 +4364,6 @@ sync_event(SlonNode * node, SlonConn * local_conn,
 						dstring_free(&actionseq_subquery);
 					}
 				}
-				PQclear(res2);
 			}
 			PQclear(res1);
 		}
@@ -4264,7 +4388,7 @@ sync_event(SlonNode * node, SlonConn * local_conn,
 						 "select log_origin, log_txid, log_tableid, "
 						 "log_actionseq, log_tablenspname, "
 						 "log_tablerelname, log_cmdtype, "
-						 "log_cmdupdncols, log_cmdargs "
+						 "log_cmdupdncols, log_cmdargs, log_setid "
 						 "from %s.sl_log_1 "
 						 "where false) TO STDOUT",
 						 rtcfg_namespace);
@@ -4526,6 +4650,7 @@ sync_event(SlonNode * node, SlonConn * local_conn,
 			 node->no_id, event->ev_seqno,
 			 TIMEVAL_DIFF(&tv_start, &tv_now));
 	sprintf(wd->duration_buf, "%.3f s", TIMEVAL_DIFF(&tv_start, &tv_now));
+	add_perfmon(&(wd->sync_perf), &pm);
 
 	slon_log(SLON_DEBUG1,
 		   "remoteWorkerThread_%d: SYNC " INT64_FORMAT " sync_event timing: "
@@ -4567,6 +4692,7 @@ sync_helper(void *cdata, PGconn *local_conn)
 	PGresult   *res = NULL;
 	PGresult   *res2 = NULL;
 	char	   *buffer;
+	bool		compact;
 
 	PerfMon		pm;
 
@@ -4694,6 +4820,37 @@ sync_helper(void *cdata, PGconn *local_conn)
 		dstring_free(&explain_query);
 	}
 
+	/*
+	 * With sync_group_compaction, the log rows of a group of SYNCs are
+	 * staged in a temporary table and logCompact() applies their net
+	 * changes afterwards. logCompactRows() cannot compact anything
+	 * before 9.4, so don't bother there.
+	 */
+	compact = (sync_group_compaction && wd->sync_group_size > 1 &&
+			   PQserverVersion(local_conn) >= 90400);
+	if (compact)
+	{
+		slon_mkquery(&query,
+					 "create temp table if not exists sl_log_compact "
+					 "(like %s.sl_log_1) on commit delete rows; ",
+					 rtcfg_namespace);
+		start_monitored_event(&pm);
+		res = PQexec(local_conn, dstring_data(&query));
+		monitor_subscriber_query(&pm);
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		{
+			slon_log(SLON_ERROR, "remoteWorkerThread_%d_%d: \"%s\" %s",
+					 node->no_id, provider->no_id,
+					 dstring_data(&query),
+					 PQresultErrorMessage(res));
+			PQclear(res);
+			errors++;
+			dstring_free(&query);
+			return errors;
+		}
+		PQclear(res);
+	}
+
 	gettimeofday(&tv_start, NULL);
 	first_fetch = true;
 	res = NULL;
@@ -4720,11 +4877,17 @@ sync_helper(void *cdata, PGconn *local_conn)
 	 *
 	 */
 	dstring_init(&copy_in);
-	slon_mkquery(&copy_in, "COPY %s.\"sl_log_%d\" ( log_origin, " \
-				 "log_txid,log_tableid,log_actionseq,log_tablenspname, " \
-				 "log_tablerelname, log_cmdtype, log_cmdupdncols," \
-				 "log_cmdargs) FROM STDIN",
-				 rtcfg_namespace, wd->active_log_table);
+	if (compact)
+		slon_mkquery(&copy_in, "COPY pg_temp.\"sl_log_compact\" ( log_origin, " \
+					 "log_txid,log_tableid,log_actionseq,log_tablenspname, " \
+					 "log_tablerelname, log_cmdtype, log_cmdupdncols," \
+					 "log_cmdargs, log_setid) FROM STDIN");
+	else
+		slon_mkquery(&copy_in, "COPY %s.\"sl_log_%d\" ( log_origin, " \
+					 "log_txid,log_tableid,log_actionseq,log_tablenspname, " \
+					 "log_tablerelname, log_cmdtype, log_cmdupdncols," \
+					 "log_cmdargs, log_setid) FROM STDIN",
+					 rtcfg_namespace, wd->active_log_table);
 
 	res2 = PQexec(local_conn, dstring_data(&copy_in));
 	\
@@ -4772,13 +4935,18 @@ sync_helper(void *cdata, PGconn *local_conn)
 			break;
 		}
 		tupno++;
+		pm.num_rows++;
+		pm.num_bytes += rc;
+		if (copy_row_cmdtype(buffer, rc) == 'M')
+			pm.num_markers++;
 		if (first_fetch)
 		{
 			gettimeofday(&tv_now, NULL);
+			pm.first_row_t = TIMEVAL_DIFF(&tv_start, &tv_now);
 			slon_log(SLON_DEBUG1,
 			  "remoteWorkerThread_%d_%d: %.3f seconds delay for first row\n",
 					 node->no_id, provider->no_id,
-					 TIMEVAL_DIFF(&tv_start, &tv_now));
+					 pm.first_row_t);
 
 			first_fetch = false;
 		}
@@ -4796,7 +4964,15 @@ sync_helper(void *cdata, PGconn *local_conn)
 		}
 
 		if (archive_dir)
-			archive_append_data(node, buffer, rc);
+		{
+			/*
+			 * Archives keep the old sl_log_archive format without the
+			 * log_setid column.
+			 */
+			archive_append_data(node, buffer,
+								copy_row_archive_len(buffer, rc));
+			archive_append_data(node, "\n", 1);
+		}
 		if (buffer)
 			PQfreemem(buffer);
 
@@ -4847,6 +5023,33 @@ sync_helper(void *cdata, PGconn *local_conn)
 	PQclear(res);
 	res = NULL;
 
+	/*
+	 * Apply the net changes of the staged log rows.
+	 */
+	if (compact && !errors)
+	{
+		slon_mkquery(&query, "select %s.logCompact(%d); ",
+					 rtcfg_namespace, wd->active_log_table);
+		start_monitored_event(&pm);
+		res = PQexec(local_conn, dstring_data(&query));
+		monitor_subscriber_iud(&pm);
+		if (PQresultStatus(res) != PGRES_TUPLES_OK)
+		{
+			slon_log(SLON_ERROR, "remoteWorkerThread_%d_%d: \"%s\" %s",
+					 node->no_id, provider->no_id,
+					 dstring_data(&query),
+					 PQresultErrorMessage(res));
+			errors++;
+		}
+		else
+			slon_log(SLON_DEBUG1, "remoteWorkerThread_%d_%d: "
+					 "compaction of %d SYNCs saved %s of %d log rows\n",
+					 node->no_id, provider->no_id, wd->sync_group_size,
+					 PQgetvalue(res, 0, 0), tupno);
+		PQclear(res);
+		res = NULL;
+	}
+
 	if (errors)
 		slon_log(SLON_ERROR,
 				 "remoteWorkerThread_%d_%d: failed SYNC's log selection query was '%s'\n",
@@ -4880,10 +5083,54 @@ sync_helper(void *cdata, PGconn *local_conn)
 	slon_log(SLON_DEBUG4,
 			 "remoteWorkerThread_%d_%d: sync_helper done\n",
 			 node->no_id, provider->no_id);
+	add_perfmon(&(wd->sync_perf), &pm);
 	dstring_free(&query);
 	return errors;
 }
 
+/* ----------
+ * copy_row_cmdtype
+ *
+ *	Return the log_cmdtype, the seventh column, of a row of the log
+ *	selection COPY data, or '\0' if the row is too short.
+ * ----------
+ */
+static char
+copy_row_cmdtype(const char *row, int len)
+{
+	int			col = 0;
+	int			i;
+
+	for (i = 0; i < len; i++)
+	{
+		if (col == 6)
+			return row[i];
+		if (row[i] == '\t')
+			col++;
+	}
+	return '\0';
+}
+
+/* ----------
+ * copy_row_archive_len
+ *
+ *	Return the length of a row of the log selection COPY data without
+ *	its last column, log_setid, and the line end.
+ * ----------
+ */
+static int
+copy_row_archive_len(const char *row, int len)
+{
+	int			i;
+
+	for (i = len - 1; i >= 0; i--)
+	{
+		if (row[i] == '\t')
+			return i;
+	}
+	return len;
+}
+
 /* ----------
  * Functions for processing log archives...
  *
@@ -4918,12 +5165,21 @@ archive_open(SlonNode * node, char *seqbuf, PGconn *dbconn)
 {
 	SlonDString query;
 	PGresult   *res;
-	int			i;
 	int			rc;
+	int			method;
 
 	if (!archive_dir)
 		return 0;
 
+	method = archive_method_parse(archive_compression);
+	if (method < 0)
+	{
+		slon_log(SLON_ERROR, "remoteWorkerThread_%d: "
+				 "archive_compression \"%s\" is not supported by this slon\n",
+				 node->no_id, archive_compression);
+		return -1;
+	}
+
 	if (node->archive_name == NULL)
 	{
 		node->archive_name = malloc(SLON_MAX_PATH);
@@ -4994,64 +5250,78 @@ archive_open(SlonNode * node, char *seqbuf, PGconn *dbconn)
 	strcpy(node->archive_counter, PQgetvalue(res, 0, 0));
 	strcpy(node->archive_timestamp, PQgetvalue(res, 0, 1));
 	PQclear(res);
-	dstring_free(&query);
 
-	sprintf(node->archive_name, "%s/slony1_log_%d_", archive_dir,
-			rtcfg_nodeid);
-	for (i = strlen(node->archive_counter); i < 20; i++)
-		strcat(node->archive_name, "0");
-	strcat(node->archive_name, node->archive_counter);
-	strcat(node->archive_name, ".sql");
-	strcpy(node->archive_temp, node->archive_name);
-	strcat(node->archive_temp, ".tmp");
-	node->archive_fp = fopen(node->archive_temp, "w");
-	if (node->archive_fp == NULL)
+	/*
+	 * Publish what an earlier slon left behind in unfinished segments.
+	 */
+	pthread_mutex_lock(&archive_segment_lock);
+	if (!archive_segment_recovered && archive_segment.af == NULL)
 	{
-		slon_log(SLON_ERROR, "remoteWorkerThread_%d: "
-				 "Cannot open archive file %s - %s\n",
-				 node->no_id, node->archive_temp, strerror(errno));
-		return -1;
+		archive_segment_recover(node->no_id,
+							strtoll(node->archive_counter, NULL, 10) - 1);
+		archive_segment_recovered = true;
 	}
-	rc = fprintf(node->archive_fp,
-	   "------------------------------------------------------------------\n"
-				 "-- Slony-I log shipping archive\n"
-				 "-- Node %d, Event %s\n"
-	   "------------------------------------------------------------------\n"
-				 "set session_replication_role to replica;\n"
-				 "start transaction;\n",
-				 node->no_id, seqbuf);
-	if (rc < 0)
+	pthread_mutex_unlock(&archive_segment_lock);
+
+	archive_make_name(node->archive_name, node->archive_counter,
+					  archive_method_suffix(method));
+
+	if (archive_coalescing)
 	{
-		slon_log(SLON_ERROR, "remoteWorkerThread_%d: "
-				 "Cannot write to archive file %s - %s\n",
-				 node->no_id, node->archive_temp, strerror(errno));
-		return -1;
+		/*
+		 * Append this SYNC group to the shared archive segment.
+		 */
+		if (archive_segment_open_group(node, method, seqbuf) < 0)
+		{
+			dstring_free(&query);
+			return -1;
+		}
+		slon_mkquery(&query, "\n-- Node %d, Event %s\n", node->no_id, seqbuf);
 	}
-	rc = fprintf(node->archive_fp,
+	else
+	{
+		strcpy(node->archive_temp, node->archive_name);
+		strcat(node->archive_temp, ".tmp");
+		node->archive_fp = archive_file_open_write(node->archive_temp, method,
+												archive_compression_level);
+		if (node->archive_fp == NULL)
+		{
+			slon_log(SLON_ERROR, "remoteWorkerThread_%d: "
+					 "Cannot open archive file %s - %s\n",
+					 node->no_id, node->archive_temp, strerror(errno));
+			dstring_free(&query);
+			return -1;
+		}
+		archive_header(&query, node, seqbuf);
+	}
+
+	slon_appendquery(&query,
+				 "start transaction;\n"
 				 "select %s.archiveTracking_offline('%s', '%s');\n"
 				 "-- end of log archiving header\n"
 	   "------------------------------------------------------------------\n"
 				 "-- start of Slony-I data\n"
 	  "------------------------------------------------------------------\n",
 			rtcfg_namespace, node->archive_counter, node->archive_timestamp);
-	if (rc < 0)
-	{
-		slon_log(SLON_ERROR, "remoteWorkerThread_%d: "
-				 "Cannot write to archive file %s - %s\n",
-				 node->no_id, node->archive_temp, strerror(errno));
-		return -1;
-	}
+	rc = archive_write(node, dstring_data(&query), query.n_used);
+	dstring_free(&query);
 
-	return 0;
+	return rc;
 }
 
 /* ----------
  * archive_close
+ *
+ * Finishes the archive, reports how well it compressed and moves it
+ * to its final name. When coalescing, only the SYNC group is finished
+ * and the segment stays open.
  * ----------
  */
 static int
 archive_close(SlonNode * node)
 {
+	SlonDString trailer;
+	ArchiveFileStats stats;
 	int			rc = 0;
 
 	if (!archive_dir)
@@ -5065,23 +5335,20 @@ archive_close(SlonNode * node)
 		return -1;
 	}
 
-	rc = fprintf(node->archive_fp,
-	 "\n------------------------------------------------------------------\n"
-				 "-- End Of Archive Log\n"
-	   "------------------------------------------------------------------\n"
-				 "commit;\n"
-				 "vacuum analyze %s.sl_archive_tracking;\n",
-				 rtcfg_namespace);
-	if (rc < 0)
+	if (archive_coalescing)
+		return archive_segment_close_group(node);
+
+	dstring_init(&trailer);
+	archive_trailer(&trailer);
+	rc = archive_write(node, dstring_data(&trailer), trailer.n_used);
+	dstring_free(&trailer);
+	if (rc < 0 || archive_wait(node) < 0)
 	{
 		archive_terminate(node);
-		slon_log(SLON_ERROR, "remoteWorkerThread_%d: "
-				 "Cannot write to archive file %s - %s\n",
-				 node->no_id, node->archive_temp, strerror(errno));
 		return -1;
 	}
 
-	rc = fclose(node->archive_fp);
+	rc = archive_file_close(node->archive_fp, &stats);
 	node->archive_fp = NULL;
 	if (rc != 0)
 	{
@@ -5091,13 +5358,109 @@ archive_close(SlonNode * node)
 		return -1;
 	}
 
-	rc = rename(node->archive_temp, node->archive_name);
-	if (rc != 0)
+	return archive_publish(node->no_id, node->archive_temp,
+						   node->archive_name, &stats, 1);
+}
+
+/* ----------
+ * archive_terminate
+ * ----------
+ */
+static void
+archive_terminate(SlonNode * node)
+{
+	if (node->archive_fp != NULL)
+	{
+		(void) archive_queue_wait(node->archive_fp);
+		if (archive_coalescing)
+			archive_segment_abort_group(node);
+		else
+			archive_file_abort(node->archive_fp);
+		node->archive_fp = NULL;
+	}
+}
+
+/* ----------
+ * archive_make_name
+ *
+ * Builds the final file name of the archive ending with counter.
+ * ----------
+ */
+static void
+archive_make_name(char *buf, const char *counter, const char *suffix)
+{
+	int			i;
+
+	sprintf(buf, "%s/slony1_log_%d_", archive_dir, rtcfg_nodeid);
+	for (i = strlen(counter); i < 20; i++)
+		strcat(buf, "0");
+	strcat(buf, counter);
+	strcat(buf, ".sql");
+	strcat(buf, suffix);
+}
+
+/* ----------
+ * archive_header
+ *
+ * The part of the archive header that comes once per file.
+ * ----------
+ */
+static void
+archive_header(SlonDString * ds, SlonNode * node, char *seqbuf)
+{
+	slon_mkquery(ds,
+	   "------------------------------------------------------------------\n"
+				 "-- Slony-I log shipping archive\n"
+				 "-- Node %d, Event %s\n"
+	   "------------------------------------------------------------------\n"
+				 "set session_replication_role to replica;\n",
+				 node->no_id, seqbuf);
+}
+
+/* ----------
+ * archive_trailer
+ * ----------
+ */
+static void
+archive_trailer(SlonDString * ds)
+{
+	slon_mkquery(ds,
+	 "\n------------------------------------------------------------------\n"
+				 "-- End Of Archive Log\n"
+	   "------------------------------------------------------------------\n"
+				 "%s"
+				 "vacuum analyze %s.sl_archive_tracking;\n",
+				 archive_coalescing ? "" : "commit;\n",
+				 rtcfg_namespace);
+}
+
+/* ----------
+ * archive_publish
+ *
+ * Renames a finished archive to its final name and runs
+ * command_on_logarchive for it.
+ * ----------
+ */
+static int
+archive_publish(int node_id, char *temp, char *name,
+				ArchiveFileStats * stats, int groups)
+{
+	slon_log(SLON_DEBUG1, "remoteWorkerThread_%d: archive %s: "
+			 "%d SYNC group(s), "
+			 INT64_FORMAT " bytes written as " INT64_FORMAT
+			 " (ratio %.2f, %.3f s compression CPU)\n",
+			 node_id, name, groups,
+			 stats->raw_bytes, stats->file_bytes,
+			 stats->file_bytes > 0 ?
+			 (double) stats->raw_bytes / (double) stats->file_bytes : 0.0,
+			 stats->cpu_time);
+	archive_queue_report(node_id, name);
+
+	if (rename(temp, name) != 0)
 	{
 		slon_log(SLON_ERROR, "remoteWorkerThread_%d: "
 				 "Cannot rename archive file %s to %s - %s\n",
-				 node->no_id, node->archive_temp, node->archive_name,
-				 strerror(errno));
+				 node_id, temp, name, strerror(errno));
 		return -1;
 	}
 
@@ -5105,9 +5468,9 @@ archive_close(SlonNode * node)
 	{
 		char		command[1024];
 
-		sprintf(command, "%s %s", command_on_logarchive, node->archive_name);
+		sprintf(command, "%s %s", command_on_logarchive, name);
 		slon_log(SLON_DEBUG1, "remoteWorkerThread_%d: Run Archive Command %s\n",
-				 node->no_id, command);
+				 node_id, command);
 		system(command);
 	}
 
@@ -5115,17 +5478,397 @@ archive_close(SlonNode * node)
 }
 
 /* ----------
- * archive_terminate
+ * Archive segment coalescing
+ *
+ * With archive_segment_maxsize or archive_segment_maxage set, SYNC groups
+ * are appended to one segment file, each in its own transaction, until
+ * the segment is big or old enough. The finished segment is named after
+ * its last archive counter, so that slony_logshipper's file name checks
+ * keep working, and command_on_logarchive runs once per segment.
+ *
+ * The segment is shared by all remote workers. They cannot interleave:
+ * the update of sl_archive_counter in archive_open() holds a row lock
+ * until the worker's local transaction ends. Whether the last group in
+ * the segment committed is therefore only known once the next group has
+ * been numbered, which is why segments are only finished when the next
+ * group is opened.
+ *
+ * After every group the segment is flushed and the group's counter and
+ * end offset appended to a .idx file next to it. A slon starting up
+ * uses these to cut leftover segments back to their last committed
+ * group and publish them.
+ * ----------
+ */
+
+/* ----------
+ * archive_segment_open_group
+ * ----------
+ */
+static int
+archive_segment_open_group(SlonNode * node, int method, char *seqbuf)
+{
+	int64		committed;
+	int			rc = 0;
+
+	committed = strtoll(node->archive_counter, NULL, 10) - 1;
+
+	pthread_mutex_lock(&archive_segment_lock);
+
+	if (archive_segment.af != NULL)
+	{
+		if (strtoll(archive_segment.last_counter, NULL, 10) != committed)
+		{
+			/*
+			 * The commit of the last group failed after it was closed.
+			 * Cut the segment back to what did commit and publish that,
+			 * the way a restarting slon would.
+			 */
+			slon_log(SLON_WARN, "remoteWorkerThread_%d: "
+					 "archive segment %s ends with counter %s but "
+					 "counter " INT64_FORMAT " is committed - recovering\n",
+					 node->no_id, archive_segment.temp,
+					 archive_segment.last_counter, committed);
+			archive_file_abort(archive_segment.af);
+			fclose(archive_segment.idx_fp);
+			archive_segment.af = NULL;
+			archive_segment.idx_fp = NULL;
+			archive_segment_recover(node->no_id, committed);
+		}
+		else if ((archive_segment_maxsize > 0 &&
+			 archive_segment.last_stats.file_bytes >=
+			 (int64) archive_segment_maxsize * 1024) ||
+			(archive_segment_maxage > 0 &&
+			 time(NULL) - archive_segment.opened >= archive_segment_maxage))
+			rc = archive_segment_finish(node->no_id);
+	}
+
+	if (rc == 0 && archive_segment.af == NULL)
+	{
+		SlonDString header;
+
+		archive_segment.method = method;
+		strcpy(archive_segment.temp, node->archive_name);
+		strcat(archive_segment.temp, ".tmp");
+		strcpy(archive_segment.idx, archive_segment.temp);
+		strcat(archive_segment.idx, ".idx");
+
+		archive_segment.af = archive_file_open_write(archive_segment.temp,
+							method, archive_compression_level);
+		if (archive_segment.af == NULL)
+		{
+			slon_log(SLON_ERROR, "remoteWorkerThread_%d: "
+					 "Cannot open archive file %s - %s\n",
+					 node->no_id, archive_segment.temp, strerror(errno));
+			pthread_mutex_unlock(&archive_segment_lock);
+			return -1;
+		}
+		archive_segment.idx_fp = fopen(archive_segment.idx, "w");
+		if (archive_segment.idx_fp == NULL)
+		{
+			slon_log(SLON_ERROR, "remoteWorkerThread_%d: "
+					 "Cannot open archive index %s - %s\n",
+					 node->no_id, archive_segment.idx, strerror(errno));
+			archive_segment_discard();
+			pthread_mutex_unlock(&archive_segment_lock);
+			return -1;
+		}
+		archive_segment.groups = 0;
+		archive_segment.opened = time(NULL);
+		memset(&archive_segment.last_stats, 0, sizeof(ArchiveFileStats));
+
+		dstring_init(&header);
+		archive_header(&header, node, seqbuf);
+		if (archive_file_write(archive_segment.af, dstring_data(&header),
+							   header.n_used) < 0 ||
+			archive_file_sync_point(archive_segment.af,
+									&archive_segment.last_stats) < 0)
+		{
+			slon_log(SLON_ERROR, "remoteWorkerThread_%d: "
+					 "Cannot write to archive file %s - %s\n",
+					 node->no_id, archive_segment.temp, strerror(errno));
+			archive_segment_discard();
+			rc = -1;
+		}
+		dstring_free(&header);
+	}
+
+	if (rc == 0)
+	{
+		node->archive_fp = archive_segment.af;
+		strcpy(node->archive_temp, archive_segment.temp);
+	}
+
+	pthread_mutex_unlock(&archive_segment_lock);
+
+	return rc;
+}
+
+/* ----------
+ * archive_segment_close_group
+ *
+ * Ends the current SYNC group and records it in the index.
+ * ----------
+ */
+static int
+archive_segment_close_group(SlonNode * node)
+{
+	ArchiveFileStats stats;
+	int			rc;
+
+	rc = archive_append_str(node, "commit;");
+	if (rc < 0 || archive_wait(node) < 0)
+	{
+		archive_terminate(node);
+		return -1;
+	}
+
+	pthread_mutex_lock(&archive_segment_lock);
+
+	if (archive_file_sync_point(archive_segment.af, &stats) < 0 ||
+		fprintf(archive_segment.idx_fp, "%s " INT64_FORMAT " " INT64_FORMAT "\n",
+				node->archive_counter, stats.file_bytes,
+				stats.raw_bytes) < 0 ||
+		fflush(archive_segment.idx_fp) != 0)
+	{
+		slon_log(SLON_ERROR, "remoteWorkerThread_%d: "
+				 "Cannot write to archive file %s - %s\n",
+				 node->no_id, archive_segment.temp, strerror(errno));
+		pthread_mutex_unlock(&archive_segment_lock);
+		archive_terminate(node);
+		return -1;
+	}
+	strcpy(archive_segment.last_counter, node->archive_counter);
+	archive_segment.last_stats = stats;
+	archive_segment.groups++;
+	node->archive_fp = NULL;
+
+	pthread_mutex_unlock(&archive_segment_lock);
+
+	slon_log(SLON_DEBUG2, "remoteWorkerThread_%d: archive counter %s "
+			 "appended to %s (" INT64_FORMAT " bytes)\n",
+			 node->no_id, node->archive_counter, node->archive_temp,
+			 stats.file_bytes);
+
+	return 0;
+}
+
+/* ----------
+ * archive_segment_abort_group
+ *
+ * Cuts the segment back to the end of the previous SYNC group.
  * ----------
  */
 static void
-archive_terminate(SlonNode * node)
+archive_segment_abort_group(SlonNode * node)
 {
-	if (node->archive_fp != NULL)
+	pthread_mutex_lock(&archive_segment_lock);
+
+	if (archive_segment.af != NULL)
 	{
-		fclose(node->archive_fp);
-		node->archive_fp = NULL;
+		if (archive_segment.groups == 0)
+			archive_segment_discard();
+		else if (archive_file_rewind(archive_segment.af,
+									 &archive_segment.last_stats) < 0)
+		{
+			/*
+			 * Leave the file and its index for the recovery at the next
+			 * slon start.
+			 */
+			slon_log(SLON_ERROR, "remoteWorkerThread_%d: "
+					 "Cannot truncate archive file %s - %s\n",
+					 node->no_id, archive_segment.temp, strerror(errno));
+			archive_file_abort(archive_segment.af);
+			fclose(archive_segment.idx_fp);
+			archive_segment.af = NULL;
+			archive_segment.idx_fp = NULL;
+			archive_segment_recovered = false;
+		}
+	}
+
+	pthread_mutex_unlock(&archive_segment_lock);
+}
+
+/* ----------
+ * archive_segment_finish
+ *
+ * Writes the trailer of the segment and publishes it.
+ * ----------
+ */
+static int
+archive_segment_finish(int node_id)
+{
+	SlonDString trailer;
+	ArchiveFileStats stats;
+	char		name[SLON_MAX_PATH];
+	int			rc;
+
+	dstring_init(&trailer);
+	archive_trailer(&trailer);
+	rc = archive_file_write(archive_segment.af, dstring_data(&trailer),
+							trailer.n_used);
+	dstring_free(&trailer);
+	if (rc == 0)
+		rc = archive_file_close(archive_segment.af, &stats);
+	else
+		archive_file_abort(archive_segment.af);
+	archive_segment.af = NULL;
+	fclose(archive_segment.idx_fp);
+	archive_segment.idx_fp = NULL;
+	if (rc != 0)
+	{
+		slon_log(SLON_ERROR, "remoteWorkerThread_%d: "
+				 "Cannot close archive file %s - %s\n",
+				 node_id, archive_segment.temp, strerror(errno));
+		archive_segment_recovered = false;
+		return -1;
+	}
+
+	archive_make_name(name, archive_segment.last_counter,
+					  archive_method_suffix(archive_segment.method));
+	if (archive_publish(node_id, archive_segment.temp, name, &stats,
+						archive_segment.groups) < 0)
+	{
+		archive_segment_recovered = false;
+		return -1;
 	}
+	unlink(archive_segment.idx);
+
+	return 0;
+}
+
+/* ----------
+ * archive_segment_discard
+ *
+ * Removes a segment that holds no complete SYNC group.
+ * ----------
+ */
+static void
+archive_segment_discard(void)
+{
+	archive_file_abort(archive_segment.af);
+	archive_segment.af = NULL;
+	if (archive_segment.idx_fp != NULL)
+		fclose(archive_segment.idx_fp);
+	archive_segment.idx_fp = NULL;
+	unlink(archive_segment.temp);
+	unlink(archive_segment.idx);
+}
+
+/* ----------
+ * archive_segment_recover
+ *
+ * Publishes segments left behind by an earlier slon, cut back to the
+ * last SYNC group that committed.
+ * ----------
+ */
+static void
+archive_segment_recover(int node_id, int64 committed)
+{
+	DIR		   *dirp;
+	struct dirent *dp;
+	char		prefix[64];
+	char		idx[SLON_MAX_PATH];
+	char		temp[SLON_MAX_PATH];
+	char		name[SLON_MAX_PATH];
+	char		suffix[SLON_MAX_PATH];
+	char		line[256];
+	char		counter[64];
+	char		last_counter[64];
+	ArchiveFileStats stats;
+	struct stat st;
+	FILE	   *fp;
+	int			len;
+	int			groups;
+	int64		group_counter;
+
+	if ((dirp = opendir(archive_dir)) == NULL)
+	{
+		slon_log(SLON_WARN, "remoteWorkerThread_%d: "
+				 "cannot open directory %s: %s\n",
+				 node_id, archive_dir, strerror(errno));
+		return;
+	}
+
+	sprintf(prefix, "slony1_log_%d_", rtcfg_nodeid);
+	while ((dp = readdir(dirp)) != NULL)
+	{
+		len = strlen(dp->d_name);
+		if (strncmp(dp->d_name, prefix, strlen(prefix)) != 0 ||
+			len < 8 || strcmp(dp->d_name + len - 8, ".tmp.idx") != 0)
+			continue;
+
+		snprintf(idx, sizeof(idx), "%s/%s", archive_dir, dp->d_name);
+		strcpy(temp, idx);
+		temp[strlen(temp) - 4] = '\0';
+
+		if ((fp = fopen(idx, "r")) == NULL)
+		{
+			slon_log(SLON_WARN, "remoteWorkerThread_%d: "
+					 "cannot open %s: %s\n", node_id, idx, strerror(errno));
+			continue;
+		}
+		if (stat(temp, &st) != 0)
+			st.st_size = 0;
+
+		/*
+		 * The end of a group is not synced to disk, so after a crash the
+		 * segment may be shorter than the index claims.
+		 */
+		groups = 0;
+		memset(&stats, 0, sizeof(stats));
+		while (fgets(line, sizeof(line), fp) != NULL)
+		{
+			ArchiveFileStats s;
+			long long	file_bytes;
+			long long	raw_bytes;
+
+			if (sscanf(line, "%63s %lld %lld", counter,
+					   &file_bytes, &raw_bytes) != 3)
+				break;
+			group_counter = strtoll(counter, NULL, 10);
+			if (group_counter > committed || file_bytes > (long long) st.st_size)
+				break;
+			memset(&s, 0, sizeof(s));
+			s.file_bytes = file_bytes;
+			s.raw_bytes = raw_bytes;
+			stats = s;
+			strcpy(last_counter, counter);
+			groups++;
+		}
+		fclose(fp);
+
+		if (groups == 0)
+		{
+			slon_log(SLON_INFO, "remoteWorkerThread_%d: "
+					 "removing archive segment %s without committed "
+					 "SYNC groups\n", node_id, temp);
+			unlink(temp);
+			unlink(idx);
+			continue;
+		}
+
+		/*
+		 * Keep the compression suffix that follows ".sql".
+		 */
+		strcpy(suffix, temp);
+		suffix[strlen(suffix) - 4] = '\0';
+		len = archive_name_is_archive(suffix);
+		archive_make_name(name, last_counter, suffix + len);
+
+		slon_log(SLON_INFO, "remoteWorkerThread_%d: "
+				 "recovering %d SYNC group(s) from archive segment %s\n",
+				 node_id, groups, temp);
+		if (archive_file_truncate(temp, stats.file_bytes) != 0)
+		{
+			slon_log(SLON_ERROR, "remoteWorkerThread_%d: "
+					 "Cannot truncate archive file %s - %s\n",
+					 node_id, temp, strerror(errno));
+			continue;
+		}
+		if (archive_publish(node_id, temp, name, &stats, groups) == 0)
+			unlink(idx);
+	}
+	closedir(dirp);
 }
 
 /* ----------
@@ -5148,16 +5891,11 @@ archive_append_ds(SlonNode * node, SlonDString * ds)
 		return -1;
 	}
 
-	rc = fprintf(node->archive_fp, "%s\n", dstring_data(ds));
+	rc = archive_write(node, dstring_data(ds), ds->n_used);
 	if (rc < 0)
-	{
-		slon_log(SLON_ERROR, "remoteWorkerThread_%d: "
-				 "Cannot write to archive file %s - %s\n",
-				 node->no_id, node->archive_temp, strerror(errno));
-		return -1;
-	}
+		return rc;
 
-	return 0;
+	return archive_write(node, "\n", 1);
 }
 
 /* ----------
@@ -5180,16 +5918,11 @@ archive_append_str(SlonNode * node, const char *s)
 		return -1;
 	}
 
-	rc = fprintf(node->archive_fp, "%s\n", s);
+	rc = archive_write(node, s, strlen(s));
 	if (rc < 0)
-	{
-		slon_log(SLON_ERROR, "remoteWorkerThread_%d: "
-				 "Cannot write to archive file %s - %s\n",
-				 node->no_id, node->archive_temp, strerror(errno));
-		return -1;
-	}
+		return rc;
 
-	return 0;
+	return archive_write(node, "\n", 1);
 }
 
 /* ----------
@@ -5201,8 +5934,6 @@ archive_append_str(SlonNode * node, const char *s)
 static int
 archive_append_data(SlonNode * node, const char *s, int len)
 {
-	int			rc;
-
 	if (!archive_dir)
 		return 0;
 
@@ -5214,8 +5945,19 @@ archive_append_data(SlonNode * node, const char *s, int len)
 		return -1;
 	}
 
-	rc = fwrite(s, len, 1, node->archive_fp);
-	if (rc != 1)
+	return archive_write(node, s, len);
+}
+
+/* ----------
+ * archive_write
+ *
+ * Common write path of the archive functions above
+ * ----------
+ */
+static int
+archive_write(SlonNode * node, const char *data, size_t len)
+{
+	if (archive_queue_write(node->archive_fp, data, len) < 0)
 	{
 		slon_log(SLON_ERROR, "remoteWorkerThread_%d: "
 				 "Cannot write to archive file %s - %s\n",
@@ -5226,6 +5968,50 @@ archive_append_data(SlonNode * node, const char *s, int len)
 	return 0;
 }
 
+/* ----------
+ * archive_wait
+ *
+ * Waits for the archive writer thread to write everything queued for
+ * the archive, before the caller finishes it.
+ * ----------
+ */
+static int
+archive_wait(SlonNode * node)
+{
+	if (archive_queue_wait(node->archive_fp) < 0)
+	{
+		slon_log(SLON_ERROR, "remoteWorkerThread_%d: "
+				 "Cannot write to archive file %s - %s\n",
+				 node->no_id, node->archive_temp, strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+/* ----------
+ * append_log_tabname_cols
+ *
+ * Appends the log_tablenspname and log_tablerelname columns of the log
+ * selection. The log trigger identifies the table by log_tableid only
+ * and leaves them NULL. Log shipping archives are applied without
+ * sl_table, so while archiving the provider fills in the names.
+ * ----------
+ */
+static void
+append_log_tabname_cols(SlonDString * dsp)
+{
+	if (archive_dir)
+		slon_appendquery(dsp,
+						 "(select tab_nspname from %s.sl_table "
+						 " where tab_id = log_tableid), "
+						 "(select tab_relname from %s.sl_table "
+						 " where tab_id = log_tableid), ",
+						 rtcfg_namespace, rtcfg_namespace);
+	else
+		dstring_append(dsp, "log_tablenspname, log_tablerelname, ");
+}
+
 /* ----------
  * given a string consisting of a list of actionseq values, return a
  * string that compresses this into a set of log_actionseq ranges
@@ -5563,6 +6349,10 @@ init_perfmon(PerfMon * perf_info)
 	perf_info->num_updates = 0;
 	perf_info->num_deletes = 0;
 	perf_info->num_truncates = 0;
+	perf_info->num_rows = 0;
+	perf_info->num_bytes = 0;
+	perf_info->first_row_t = 0.0;
+	perf_info->num_markers = 0;
 }
 static void
 start_monitored_event(PerfMon * perf_info)
@@ -5599,3 +6389,20 @@ monitor_subscriber_iud(PerfMon * perf_info)
 	(perf_info->subscr_iud__t) += diff;
 	(perf_info->subscr_iud__c)++;
 }
+static void
+add_perfmon(PerfMon * dst, PerfMon * src)
+{
+	dst->prov_query_t += src->prov_query_t;
+	dst->prov_query_c += src->prov_query_c;
+	dst->subscr_query_t += src->subscr_query_t;
+	dst->subscr_query_c += src->subscr_query_c;
+	dst->subscr_iud__t += src->subscr_iud__t;
+	dst->subscr_iud__c += src->subscr_iud__c;
+	dst->large_tuples_t += src->large_tuples_t;
+	dst->large_tuples_c += src->large_tuples_c;
+	dst->num_rows += src->num_rows;
+	dst->num_bytes += src->num_bytes;
+	if (src->first_row_t > dst->first_row_t)
+		dst->first_row_t = src->first_row_t;
+	dst->num_markers += src->num_markers;
+}
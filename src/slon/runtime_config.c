@@ -1076,9 +1076,35 @@ rtcfg_startStopNodeThread(SlonNode * node)
 		need_listen = false;
 
 	/*
-	 * Start or stop the remoteListenThread
+	 * Start or stop the remoteListenThread. With remote_listen_multiplex
+	 * the listen_status is only a request to the multiplexed listener.
 	 */
-	if (need_listen)
+	if (need_listen && remote_listen_multiplex)
+	{
+		switch (node->listen_status)
+		{
+			case SLON_TSTAT_NONE:
+			case SLON_TSTAT_DONE:
+				node->listen_status = SLON_TSTAT_RUNNING;
+				if (remoteListenMux_start() < 0)
+				{
+					rtcfg_unlock();
+					slon_retry();
+				}
+				need_wakeup = true;
+				break;
+
+			case SLON_TSTAT_SHUTDOWN:
+				node->listen_status = SLON_TSTAT_RESTART;
+				need_wakeup = true;
+				break;
+
+			default:
+				need_wakeup = true;
+				break;
+		}
+	}
+	else if (need_listen)
 	{
 		/*
 		 * Node specific listen thread is required
@@ -1143,7 +1169,8 @@ rtcfg_startStopNodeThread(SlonNode * node)
 				break;
 
 			case SLON_TSTAT_DONE:
-				pthread_join(node->listen_thread, NULL);
+				if (!remote_listen_multiplex)
+					pthread_join(node->listen_thread, NULL);
 				node->listen_status = SLON_TSTAT_NONE;
 				break;
 		}
@@ -1206,6 +1233,11 @@ rtcfg_joinAllRemoteThreads(void)
 {
 	SlonNode   *node;
 
+	/*
+	 * The multiplexed listener sets all its nodes to DONE when it exits.
+	 */
+	remoteListenMux_join();
+
 	rtcfg_lock();
 
 	for (node = rtcfg_node_list_head; node; node = node->next)
@@ -1224,7 +1256,8 @@ rtcfg_joinAllRemoteThreads(void)
 			case SLON_TSTAT_DONE:
 				rtcfg_unlock();
 				sched_wakeup_node(node->no_id);
-				pthread_join(node->listen_thread, NULL);
+				if (!remote_listen_multiplex)
+					pthread_join(node->listen_thread, NULL);
 				rtcfg_lock();
 				node->listen_status = SLON_TSTAT_NONE;
 				break;
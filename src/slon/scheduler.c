@@ -378,6 +378,7 @@ sched_wakeup_node(int no_id)
 	pthread_mutex_unlock(&sched_master_lock);
 
 	remoteWorker_wakeup(no_id);
+	remoteListenMux_wakeup();
 
 	slon_log(SLON_DEBUG2, "sched_wakeup_node(): no_id=%d "
 			 "(%d threads + worker signaled)\n", no_id, num_wakeup);
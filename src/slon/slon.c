@@ -261,6 +261,16 @@ main(int argc, char *const argv[])
 	if (sync_interval_timeout != 0 && sync_interval_timeout <= sync_interval)
 		sync_interval_timeout = sync_interval * 2;
 
+	/*
+	 * Reject an archive compression method this binary was built without.
+	 */
+	if (archive_method_parse(archive_compression) < 0)
+	{
+		slon_log(SLON_FATAL, "main: archive_compression \"%s\" is not "
+				 "supported by this slon\n", archive_compression);
+		exit(-1);
+	}
+
 	/*
 	 * Remember the cluster name and build the properly quoted namespace
 	 * identifier
@@ -20,6 +20,7 @@
 #include "types.h"
 #include "libpq-fe.h"
 #include "misc.h"
+#include "../misc/archive_io.h"
 #include "conf-file.h"
 #include "confoptions.h"
 #include <pg_config.h>
@@ -140,7 +141,7 @@ struct SlonNode_s
 	char	   *archive_temp;
 	char	   *archive_counter;
 	char	   *archive_timestamp;
-	FILE	   *archive_fp;
+	ArchiveFile *archive_fp;
 
 	SlonNode   *prev;
 	SlonNode   *next;
@@ -515,6 +516,20 @@ extern char *cleanup_interval;
  */
 extern void *cleanupThread_main(void *dummy);
 
+/* ----------
+ * Global variables in archive_thread.c
+ * ----------
+ */
+extern int	archive_writer_queue;
+
+/* ----------
+ * Functions in archive_thread.c
+ * ----------
+ */
+extern int	archive_queue_write(ArchiveFile * af, const char *data, size_t len);
+extern int	archive_queue_wait(ArchiveFile * af);
+extern void archive_queue_report(int node_id, const char *name);
+
 /* ----------
  * Global variables in sync_thread.c
  * ----------
@@ -556,6 +571,9 @@ extern void *localListenThread_main(void *dummy);
  * ----------
  */
 extern void *remoteListenThread_main(void *cdata);
+extern int	remoteListenMux_start(void);
+extern void remoteListenMux_wakeup(void);
+extern void remoteListenMux_join(void);
 
 
 /* ----------
@@ -563,7 +581,13 @@ extern void *remoteListenThread_main(void *cdata);
  * ----------
  */
 extern int	sync_group_maxsize;
+extern int	sync_perf_history;
+extern bool sync_group_compaction;
 extern int	explain_interval;
+extern char *archive_compression;
+extern int	archive_compression_level;
+extern int	archive_segment_maxsize;
+extern int	archive_segment_maxage;
 
 
 /* ----------
@@ -605,6 +629,7 @@ extern int	sched_wakeup_node(int no_id);
  */
 extern SlonConn *slon_connectdb(char *conninfo, char *symname);
 extern void slon_disconnectdb(SlonConn * conn);
+extern void slon_set_keepalive(PGconn *dbconn);
 extern SlonConn *slon_make_dummyconn(char *symname);
 extern void slon_free_dummyconn(SlonConn * conn);
 
@@ -64,6 +64,29 @@ syncThread_main(void *dummy)
 	dbconn = conn->dbconn;
 	monitor_state("local_sync", 0, conn->conn_pid, "thread main loop", 0, "n/a");
 
+	/*
+	 * With the multiplexed remote listener, have our SYNC events wake up
+	 * the listeners of the other nodes.
+	 */
+	if (remote_listen_multiplex)
+	{
+		dstring_init(&query1);
+		slon_mkquery(&query1, "select %s.createEventNotify(true);",
+					 rtcfg_namespace);
+		res = PQexec(dbconn, dstring_data(&query1));
+		if (PQresultStatus(res) != PGRES_TUPLES_OK)
+		{
+			slon_log(SLON_FATAL,
+					 "syncThread: \"%s\" - %s",
+					 dstring_data(&query1), PQresultErrorMessage(res));
+			PQclear(res);
+			dstring_free(&query1);
+			slon_retry();
+		}
+		PQclear(res);
+		dstring_free(&query1);
+	}
+
 	/*
 	 * We don't initialize the last known action sequence to the actual value.
 	 * This causes that we create a SYNC event allways on startup, just in
@@ -73,15 +96,18 @@ syncThread_main(void *dummy)
 
 	/*
 	 * Build the query that starts a transaction and retrieves the last value
-	 * from the action sequence.
+	 * from the action sequence. With logical capture enabled, this also
+	 * moves the changes decoded so far into sl_log. The drain runs after
+	 * the transaction snapshot, which the SYNC will use, has been taken.
 	 */
 	dstring_init(&query1);
 	slon_mkquery(&query1,
 				 "start transaction;"
 				 "set transaction isolation level serializable;"
 				 "lock table %s.sl_event_lock;"
-				 "select last_value from %s.sl_action_seq;",
-				 rtcfg_namespace, rtcfg_namespace);
+				 "select last_value, %s.logicalCaptureDrain() "
+				 "from %s.sl_action_seq;",
+				 rtcfg_namespace, rtcfg_namespace, rtcfg_namespace);
 
 	/*
 	 * Build the query that calls createEvent() for the SYNC
@@ -111,13 +137,14 @@ syncThread_main(void *dummy)
 		}
 
 		/*
-		 * Check if it's identical to the last known seq or if the sync
-		 * interval timeout has arrived.
+		 * Check if it's identical to the last known seq, if logical capture
+		 * found changes or if the sync interval timeout has arrived.
 		 */
 		if (sync_interval_timeout != 0)
 			timeout_count -= sync_interval;
 
 		if (strcmp(last_actseq_buf, PQgetvalue(res, 0, 0)) != 0 ||
+			strtoll(PQgetvalue(res, 0, 1), NULL, 10) > 0 ||
 			timeout_count < 0)
 		{
 			/*
@@ -16,8 +16,12 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/time.h>
+#else
+#include <winsock2.h>
 #endif
 
+#include <errno.h>
 #include <stdarg.h>
 #include <string.h>
 #include <stdio.h>
@@ -44,6 +48,8 @@ extern int	current_try_level;
  * Local functions
  */
 static int	slon_appendquery_int(SlonDString * dsp, char *fmt, va_list ap);
+static int	db_connect_init(SlonikStmt * stmt, SlonikAdmInfo * adminfo,
+				PGconn *dbconn);
 
 #ifdef HAVE_PQSETNOTICERECEIVER
 
@@ -119,8 +125,6 @@ int
 db_connect(SlonikStmt * stmt, SlonikAdmInfo * adminfo)
 {
 	PGconn	   *dbconn;
-	SlonDString query;
-	PGresult   *res;
 
 	db_notice_stmt = stmt;
 
@@ -145,6 +149,155 @@ db_connect(SlonikStmt * stmt, SlonikAdmInfo * adminfo)
 		return -1;
 	}
 
+	return db_connect_init(stmt, adminfo, dbconn);
+}
+
+
+/* ----------
+ * db_connect_all
+ *
+ *	Connect to several databases at once. The connection attempts are
+ *	started together and driven with PQconnectPoll(), so the time spent
+ *	is that of the slowest node instead of the sum of all. Returns -1 if
+ *	any of the connections failed; the others are established anyway.
+ * ----------
+ */
+int
+db_connect_all(SlonikStmt * stmt, SlonikAdmInfo ** adminfo, int nconns)
+{
+	PGconn	  **dbconn;
+	PostgresPollingStatusType *pstat;
+	fd_set		rfds;
+	fd_set		wfds;
+	int			max_fd;
+	int			sock;
+	int			pending = 0;
+	int			rc = 0;
+	int			i;
+
+	db_notice_stmt = stmt;
+
+	dbconn = (PGconn **) malloc(sizeof(PGconn *) * nconns);
+	pstat = (PostgresPollingStatusType *) malloc(sizeof(PostgresPollingStatusType) * nconns);
+	if (dbconn == NULL || pstat == NULL)
+	{
+		printf("%s:%d: FATAL: out of memory\n",
+			   stmt->stmt_filename, stmt->stmt_lno);
+		free(dbconn);
+		free(pstat);
+		return -1;
+	}
+
+	for (i = 0; i < nconns; i++)
+	{
+		dbconn[i] = PQconnectStart(adminfo[i]->conninfo);
+		if (dbconn[i] == NULL)
+		{
+			printf("%s:%d: FATAL: PQconnectStart() failed\n",
+				   stmt->stmt_filename, stmt->stmt_lno);
+			rc = -1;
+			continue;
+		}
+		if (PQstatus(dbconn[i]) == CONNECTION_BAD)
+		{
+			printf("%s:%d: %s",
+				   stmt->stmt_filename, stmt->stmt_lno,
+				   PQerrorMessage(dbconn[i]));
+			PQfinish(dbconn[i]);
+			dbconn[i] = NULL;
+			rc = -1;
+			continue;
+		}
+		pstat[i] = PGRES_POLLING_WRITING;
+		pending++;
+	}
+
+	while (pending > 0)
+	{
+		FD_ZERO(&rfds);
+		FD_ZERO(&wfds);
+		max_fd = -1;
+		for (i = 0; i < nconns; i++)
+		{
+			if (dbconn[i] == NULL || pstat[i] == PGRES_POLLING_OK)
+				continue;
+			sock = PQsocket(dbconn[i]);
+			if (pstat[i] == PGRES_POLLING_READING)
+				FD_SET(sock, &rfds);
+			else
+				FD_SET(sock, &wfds);
+			if (sock > max_fd)
+				max_fd = sock;
+		}
+		if (select(max_fd + 1, &rfds, &wfds, NULL, NULL) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			printf("%s:%d: select() failed - %s\n",
+				   stmt->stmt_filename, stmt->stmt_lno, strerror(errno));
+			rc = -1;
+			break;
+		}
+
+		for (i = 0; i < nconns; i++)
+		{
+			if (dbconn[i] == NULL || pstat[i] == PGRES_POLLING_OK)
+				continue;
+			sock = PQsocket(dbconn[i]);
+			if (!FD_ISSET(sock, &rfds) && !FD_ISSET(sock, &wfds))
+				continue;
+
+			pstat[i] = PQconnectPoll(dbconn[i]);
+			if (pstat[i] == PGRES_POLLING_OK)
+				pending--;
+			else if (pstat[i] == PGRES_POLLING_FAILED)
+			{
+				printf("%s:%d: %s",
+					   stmt->stmt_filename, stmt->stmt_lno,
+					   PQerrorMessage(dbconn[i]));
+				PQfinish(dbconn[i]);
+				dbconn[i] = NULL;
+				pending--;
+				rc = -1;
+			}
+		}
+	}
+
+	/*
+	 * Set up the sessions of all connections that made it
+	 */
+	for (i = 0; i < nconns; i++)
+	{
+		if (dbconn[i] == NULL)
+			continue;
+		if (pstat[i] != PGRES_POLLING_OK)
+		{
+			PQfinish(dbconn[i]);
+			continue;
+		}
+		if (db_connect_init(stmt, adminfo[i], dbconn[i]) < 0)
+			rc = -1;
+	}
+
+	free(dbconn);
+	free(pstat);
+	return rc;
+}
+
+
+/* ----------
+ * db_connect_init
+ *
+ *	Set up the session of a new connection and make it the connection of
+ *	adminfo.
+ * ----------
+ */
+static int
+db_connect_init(SlonikStmt * stmt, SlonikAdmInfo * adminfo, PGconn *dbconn)
+{
+	SlonDString query;
+	PGresult   *res;
+
 	/* ----
 	 * Catch NOTICE messages from the backend.
 	 * ----
@@ -392,6 +545,162 @@ db_exec_select(SlonikStmt * stmt, SlonikAdmInfo * adminfo, SlonDString * query)
 }
 
 
+/* ----------
+ * db_exec_select_all
+ *
+ *	Execute one select query on each of several connections concurrently.
+ *	A NULL query skips that connection. The results are returned in res,
+ *	which the caller must clear. Returns -1 if any of the queries failed,
+ *	in which case its res entry is NULL.
+ * ----------
+ */
+int
+db_exec_select_all(SlonikStmt * stmt, SlonikAdmInfo ** adminfo,
+				   SlonDString ** query, PGresult ** res, int nconns)
+{
+	SlonDString sendquery;
+	PGresult   *r;
+	bool	   *busy;
+	fd_set		rfds;
+	int			max_fd;
+	int			sock;
+	int			pending = 0;
+	int			rc = 0;
+	int			i;
+
+	db_notice_stmt = stmt;
+
+	busy = (bool *) malloc(sizeof(bool) * nconns);
+	if (busy == NULL)
+	{
+		printf("%s:%d: FATAL: out of memory\n",
+			   stmt->stmt_filename, stmt->stmt_lno);
+		return -1;
+	}
+
+	/*
+	 * Send all queries. The transaction is started in the same round trip
+	 * as the query, the way db_begin_xact() would start it.
+	 */
+	dstring_init(&sendquery);
+	for (i = 0; i < nconns; i++)
+	{
+		res[i] = NULL;
+		busy[i] = false;
+		if (query[i] == NULL)
+			continue;
+
+		dstring_reset(&sendquery);
+		if (!adminfo[i]->have_xact)
+		{
+			slon_appendquery(&sendquery, "begin transaction; ");
+			if (current_try_level > 0)
+				slon_appendquery(&sendquery,
+								 "lock table \"_%s\".sl_event_lock; ",
+								 stmt->script->clustername);
+		}
+		dstring_append(&sendquery, dstring_data(query[i]));
+		dstring_terminate(&sendquery);
+
+		if (PQsendQuery(adminfo[i]->dbconn, dstring_data(&sendquery)) == 0)
+		{
+			fprintf(stderr, "%s:%d: %s - %s",
+					stmt->stmt_filename, stmt->stmt_lno,
+					dstring_data(query[i]),
+					PQerrorMessage(adminfo[i]->dbconn));
+			rc = -1;
+			continue;
+		}
+		adminfo[i]->have_xact = true;
+		busy[i] = true;
+		pending++;
+	}
+	dstring_free(&sendquery);
+
+	/*
+	 * Collect the results as they arrive, keeping the last one of each
+	 * connection.
+	 */
+	while (pending > 0)
+	{
+		FD_ZERO(&rfds);
+		max_fd = -1;
+		for (i = 0; i < nconns; i++)
+		{
+			if (!busy[i])
+				continue;
+			sock = PQsocket(adminfo[i]->dbconn);
+			FD_SET(sock, &rfds);
+			if (sock > max_fd)
+				max_fd = sock;
+		}
+		if (select(max_fd + 1, &rfds, NULL, NULL, NULL) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			printf("%s:%d: select() failed - %s\n",
+				   stmt->stmt_filename, stmt->stmt_lno, strerror(errno));
+			rc = -1;
+			break;
+		}
+
+		for (i = 0; i < nconns; i++)
+		{
+			if (!busy[i] || !FD_ISSET(PQsocket(adminfo[i]->dbconn), &rfds))
+				continue;
+
+			if (PQconsumeInput(adminfo[i]->dbconn) == 0)
+			{
+				fprintf(stderr, "%s:%d: %s - %s",
+						stmt->stmt_filename, stmt->stmt_lno,
+						dstring_data(query[i]),
+						PQerrorMessage(adminfo[i]->dbconn));
+				busy[i] = false;
+				pending--;
+				continue;
+			}
+			while (PQisBusy(adminfo[i]->dbconn) == 0)
+			{
+				r = PQgetResult(adminfo[i]->dbconn);
+				if (r == NULL)
+				{
+					busy[i] = false;
+					pending--;
+					break;
+				}
+				if (res[i] != NULL)
+					PQclear(res[i]);
+				res[i] = r;
+			}
+		}
+	}
+	free(busy);
+
+	for (i = 0; i < nconns; i++)
+	{
+		if (query[i] == NULL)
+			continue;
+		if (res[i] == NULL)
+		{
+			rc = -1;
+			continue;
+		}
+		if (PQresultStatus(res[i]) != PGRES_TUPLES_OK)
+		{
+			fprintf(stderr, "%s:%d: %s %s - %s",
+					stmt->stmt_filename, stmt->stmt_lno,
+					PQresStatus(PQresultStatus(res[i])),
+					dstring_data(query[i]), PQresultErrorMessage(res[i]));
+			PQclear(res[i]);
+			res[i] = NULL;
+			rc = -1;
+		}
+	}
+
+	return rc;
+}
+
+
 /* ----------
  * db_get_nodeid
  *
@@ -102,6 +102,7 @@ static int	assign_options(statement_option *so, option_list *ol);
 %type <statement>	stmt_set_drop_sequence
 %type <statement>	stmt_set_move_table
 %type <statement>	stmt_set_move_sequence
+%type <statement>	stmt_set_table_filter
 %type <statement>	stmt_subscribe_set
 %type <statement>	stmt_unsubscribe_set
 %type <statement>	stmt_lock_set
@@ -135,6 +136,7 @@ static int	assign_options(statement_option *so, option_list *ol);
 %token	K_CLONE
 %token	K_CLUSTER
 %token	K_CLUSTERNAME
+%token	K_COLUMNS
 %token	K_COMMENT
 %token	K_CONFIG
 %token	K_CONFIRMED
@@ -153,6 +155,7 @@ static int	assign_options(statement_option *so, option_list *ol);
 %token	K_FAILOVER
 %token	K_FALSE
 %token	K_FILENAME
+%token	K_FILTER
 %token	K_FINISH
 %token	K_FOR
 %token	K_FORWARD
@@ -426,6 +429,7 @@ normal_stmt			: stmt_echo
 					| stmt_set_drop_sequence
 						{ $$ = $1; }
 					| stmt_set_move_table
+					| stmt_set_table_filter
 						{ $$ = $1; }
 					| stmt_set_move_sequence
 						{ $$ = $1; }
@@ -1104,6 +1108,7 @@ stmt_set_add_table	: lno K_SET K_ADD K_TABLE option_list
 							STMT_OPTION_STR( O_COMMENT, NULL ),
 							STMT_OPTION_STR( O_TABLES,NULL),
 							STMT_OPTION_YN(O_ADD_SEQUENCES,0),
+							STMT_OPTION_STR( O_COLUMNS, NULL ),
 							STMT_OPTION_END
 						};
 
@@ -1124,6 +1129,7 @@ stmt_set_add_table	: lno K_SET K_ADD K_TABLE option_list
 							new->tab_comment	= opt[5].str;
 							new->tables			= opt[6].str;
 							new->add_sequences  = opt[7].ival;
+							new->tab_columns	= opt[8].str;
 						}
 						else
 							parser_errors++;
@@ -1250,6 +1256,36 @@ stmt_set_move_table	: lno K_SET K_MOVE K_TABLE option_list
 					}
 					;
 
+stmt_set_table_filter : lno K_SET K_TABLE K_FILTER option_list
+					{
+						SlonikStmt_set_table_filter *new;
+						statement_option opt[] = {
+							STMT_OPTION_INT( O_ORIGIN, -1 ),
+							STMT_OPTION_INT( O_ID, -1 ),
+							STMT_OPTION_INT( O_RECEIVER, -1 ),
+							STMT_OPTION_STR( O_FILTER, NULL ),
+							STMT_OPTION_END
+						};
+						new = (SlonikStmt_set_table_filter *)
+							malloc(sizeof(SlonikStmt_set_table_filter));
+						memset(new, 0, sizeof(SlonikStmt_set_table_filter));
+						new->hdr.stmt_type		= STMT_SET_TABLE_FILTER;
+						new->hdr.stmt_filename	= current_file;
+						new->hdr.stmt_lno		= $1;
+
+						if (assign_options(opt, $5) == 0) {
+							new->set_origin		= opt[0].ival;
+							new->tab_id			= opt[1].ival;
+							new->receiver		= opt[2].ival;
+							new->filter			= opt[3].str;
+						}
+						else
+							parser_errors++;
+
+						$$ = (SlonikStmt *)new;
+					}
+					;
+
 stmt_set_move_sequence : lno K_SET K_MOVE K_SEQUENCE option_list
 					{
 						SlonikStmt_set_move_sequence *new;
@@ -1735,6 +1771,11 @@ option_list_item	: K_ID '=' option_item_id
 						$3->opt_code	= O_COMMENT;
 						$$ = $3;
 					}
+					| K_COLUMNS '=' option_item_literal
+					{
+						$3->opt_code	= O_COLUMNS;
+						$$ = $3;
+					}
 					| K_CONNINFO '=' option_item_literal
 					{
 						$3->opt_code	= O_CONNINFO;
@@ -1785,6 +1826,11 @@ option_list_item	: K_ID '=' option_item_id
 						$3->opt_code	= O_FILENAME;
 						$$ = $3;
 					}
+					| K_FILTER '=' option_item_literal
+					{
+						$3->opt_code	= O_FILTER;
+						$$ = $3;
+					}
 					| K_ORIGIN '=' K_ALL
 					{
 						option_list *new;
@@ -1980,6 +2026,7 @@ option_str(option_code opt_code)
 		case O_ADD_SEQUENCES:	return "add sequences"; 
 		case O_BACKUP_NODE:		return "backup node";
 		case O_CLIENT:			return "client";
+		case O_COLUMNS:			return "columns";
 		case O_COMMENT:			return "comment";
 		case O_CONNINFO:		return "conninfo";
 		case O_CONNRETRY:		return "connretry";
@@ -1988,6 +2035,7 @@ option_str(option_code opt_code)
 		case O_EXECUTE_ONLY_ON:	return "execute only on";
 		case O_EXECUTE_ONLY_LIST:	return "execute only on";
 		case O_FILENAME:		return "filename";
+		case O_FILTER:			return "filter";
 		case O_FORWARD:			return "forward";
 		case O_FQNAME:			return "full qualified name";
 		case O_ID:				return "id";
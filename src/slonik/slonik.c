@@ -22,6 +22,7 @@
 #include <ctype.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/time.h>
 #include <alloca.h>
 #else
 #include <winsock2.h>
@@ -43,7 +44,6 @@
 #include "config.h"
 #endif
 #include "../parsestatements/scanner.h"
-extern int	STMTS[MAXSTATEMENTS];
 
 
 #ifdef HAVE_PGPORT
@@ -127,6 +127,9 @@ static void script_rollback_all(SlonikStmt * stmt,
 static void script_disconnect_all(SlonikScript * script);
 static void replace_tokens(SlonDString *dest, SlonDString *src, 
 					replacement_token *replacements);
+static int slonik_set_add_tables(SlonikStmt_set_add_table * stmt,
+					  SlonikAdmInfo * adminfo1,
+					  PGresult *tables);
 static int slonik_set_add_single_table(SlonikStmt_set_add_table * stmt,
 							SlonikAdmInfo * adminfo1,
 							const char *fqname);
@@ -166,6 +169,14 @@ static int64 get_last_escaped_event_id(SlonikStmt * stmt,
 static int fail_node_restart(SlonikStmt_failed_node * stmt,
 				  failed_node_entry * node_entry,
 				  failnode_node * nodeinfo);
+static int fail_node_connect(SlonikStmt_failed_node * stmt,
+				  failnode_node * nodeinfo, int num_nodes);
+static int fail_node_select_all(SlonikStmt_failed_node * stmt,
+					 failnode_node * nodeinfo, int num_nodes,
+					 SlonDString * query, bool *skip, PGresult ** res);
+static void wait_poll_sleep(int *delay_ms);
+static int ddl_script_exec_batch(PGconn *conn, const char *equery,
+					  const char *script, int first, int last);
 
 
 static int
@@ -785,6 +796,15 @@ script_check_stmts(SlonikScript * script, SlonikStmt * hdr)
 							   hdr->stmt_lno);
 						errors++;
 					}
+					if (stmt->tables != NULL &&
+						stmt->tab_columns != NULL)
+					{
+						printf("%s:%d: ERROR: "
+							   "'columns' can not be used with the 'tables' "
+							   "option.\n", hdr->stmt_filename,
+							   hdr->stmt_lno);
+						errors++;
+					}
 
 					if (stmt->tab_comment == NULL && stmt->tab_fqname != NULL)
 						stmt->tab_comment = strdup(stmt->tab_fqname);
@@ -955,6 +975,49 @@ script_check_stmts(SlonikScript * script, SlonikStmt * hdr)
 				}
 				break;
 
+			case STMT_SET_TABLE_FILTER:
+				{
+					SlonikStmt_set_table_filter *stmt =
+					(SlonikStmt_set_table_filter *) hdr;
+
+					/*
+					 * Check that we have the set_origin and that we can
+					 * reach the origin.
+					 */
+					if (stmt->set_origin < 0)
+					{
+						printf("%s:%d: Error: "
+							   "origin must be specified\n",
+							   hdr->stmt_filename, hdr->stmt_lno);
+						errors++;
+					}
+					else
+					{
+						if (script_check_adminfo(hdr, stmt->set_origin) < 0)
+							errors++;
+					}
+
+					/*
+					 * Check that we have the table id and the receiver. A
+					 * missing filter removes an existing one.
+					 */
+					if (stmt->tab_id < 0)
+					{
+						printf("%s:%d: Error: "
+							   "table id must be specified\n",
+							   hdr->stmt_filename, hdr->stmt_lno);
+						errors++;
+					}
+					if (stmt->receiver < 0)
+					{
+						printf("%s:%d: Error: "
+							   "receiver must be specified\n",
+							   hdr->stmt_filename, hdr->stmt_lno);
+						errors++;
+					}
+				}
+				break;
+
 			case STMT_SET_MOVE_SEQUENCE:
 				{
 					SlonikStmt_set_move_sequence *stmt =
@@ -1643,6 +1706,16 @@ script_exec_stmts(SlonikScript * script, SlonikStmt * hdr)
 				}
 				break;
 
+			case STMT_SET_TABLE_FILTER:
+				{
+					SlonikStmt_set_table_filter *stmt =
+					(SlonikStmt_set_table_filter *) hdr;
+
+					if (slonik_set_table_filter(stmt) < 0)
+						errors++;
+				}
+				break;
+
 			case STMT_SET_MOVE_SEQUENCE:
 				{
 					SlonikStmt_set_move_sequence *stmt =
@@ -2798,13 +2871,19 @@ slonik_failed_node(SlonikStmt_failed_node * stmt)
 	int		  **set_list = 0;
 	PGresult   *res1;
 	PGresult   *res2;
-	PGresult   *res3;
 	int64	   *max_seqno_total = 0;
 	failnode_node **max_node_total = NULL;
 	failed_node_entry *node_entry = stmt->nodes;
 	int		   *fail_node_ids = NULL;
 	bool         missing_paths=false;
 	int			rc = 0;
+	SlonDString *node_query = NULL;
+	PGresult  **node_res = NULL;
+	int			num_node_query = 0;
+	struct timeval tv_start;
+	struct timeval tv_now;
+
+	gettimeofday(&tv_start, NULL);
 
 
 	/**
@@ -3011,6 +3090,20 @@ slonik_failed_node(SlonikStmt_failed_node * stmt)
 		}
 		node_entry->num_nodes = PQntuples(res1);
 
+		/*
+		 * Room for one query and result per candidate
+		 */
+		if (node_entry->num_nodes > num_node_query)
+		{
+			node_query = realloc(node_query, sizeof(SlonDString) *
+								 node_entry->num_nodes);
+			node_res = realloc(node_res, sizeof(PGresult *) *
+							   node_entry->num_nodes);
+			for (i = num_node_query; i < node_entry->num_nodes; i++)
+				dstring_init(&node_query[i]);
+			num_node_query = node_entry->num_nodes;
+		}
+
 
 		/*
 		 * Get a list of all sets that are subscribed more than once directly
@@ -3059,38 +3152,36 @@ slonik_failed_node(SlonikStmt_failed_node * stmt)
 
 		/*
 		 * Connect to all these nodes and determine if there is a node daemon
-		 * running on that node.
+		 * running on that node. All candidates are contacted concurrently.
 		 */
-
 		for (i = 0; i < node_entry->num_nodes; i++)
 		{
-			const char * pidcolumn;
 			has_candidate = true;
 			nodeinfo[i].no_id = (int) strtol(PQgetvalue(res1, i, 0), NULL, 10);
-			nodeinfo[i].adminfo = get_active_adminfo((SlonikStmt *) stmt,
-													 nodeinfo[i].no_id);
-			if (nodeinfo[i].adminfo == NULL)
-			{
-				printf("%s:%d error no conninfo for candidate for %d\n",
-					   stmt->hdr.stmt_filename, stmt->hdr.stmt_lno
-					   ,nodeinfo[i].no_id);
-				PQclear(res1);
-				rc = -1;
-				goto cleanup;
-			}
-
 			if (! PQgetisnull(res1, i, 1) )
 			{
 				nodeinfo[i].failover_candidate = true;
 			}
 			else
 				nodeinfo[i].failover_candidate = false;
-			
+		}
+		PQclear(res1);
+		PQclear(res2);
+		if (fail_node_connect(stmt, nodeinfo, node_entry->num_nodes) < 0)
+		{
+			rc = -1;
+			goto cleanup;
+		}
+
+		for (i = 0; i < node_entry->num_nodes; i++)
+		{
+			const char * pidcolumn;
+
 			if (nodeinfo[i].adminfo->pg_version >= 90200)  
 				pidcolumn="pid";
 			else 
 				pidcolumn="procpid";
-			slon_mkquery(&query,
+			slon_mkquery(&node_query[i],
 						 "lock table \"_%s\".sl_config_lock; "
 						 "select nl_backendpid from \"_%s\".sl_nodelock "
 				   "    where nl_nodeid = \"_%s\".getLocalNodeId('_%s') and "
@@ -3101,15 +3192,16 @@ slonik_failed_node(SlonikStmt_failed_node * stmt)
 						 stmt->hdr.script->clustername,
 						 stmt->hdr.script->clustername,
 						 pidcolumn);
-			res3 = db_exec_select((SlonikStmt *) stmt, nodeinfo[i].adminfo, &query);
-			if (res3 == NULL)
-			{
-				PQclear(res1);
-				PQclear(res2);
-				rc = -1;
-				goto cleanup;
-			}
-			if (PQntuples(res3) == 0)
+		}
+		if (fail_node_select_all(stmt, nodeinfo, node_entry->num_nodes,
+								 node_query, NULL, node_res) < 0)
+		{
+			rc = -1;
+			goto cleanup;
+		}
+		for (i = 0; i < node_entry->num_nodes; i++)
+		{
+			if (PQntuples(node_res[i]) == 0)
 			{
 				nodeinfo[i].has_slon = false;
 				nodeinfo[i].slon_pid = 0;
@@ -3117,12 +3209,10 @@ slonik_failed_node(SlonikStmt_failed_node * stmt)
 			else
 			{
 				nodeinfo[i].has_slon = true;
-				nodeinfo[i].slon_pid = (int) strtol(PQgetvalue(res3, 0, 0), NULL, 10);
+				nodeinfo[i].slon_pid = (int) strtol(PQgetvalue(node_res[i], 0, 0), NULL, 10);
 			}
-			PQclear(res3);
+			PQclear(node_res[i]);
 		}
-		PQclear(res1);
-		PQclear(res2);
 		if (!has_candidate && node_entry->num_sets > 0 )
 		{
 			printf("%s:%d error no failover candidates for %d\n",
@@ -3144,17 +3234,22 @@ slonik_failed_node(SlonikStmt_failed_node * stmt)
 				   node_entry->no_id,
 				   nodeinfo[i].failover_candidate,
 				   nodeinfo[i].no_id);
-			slon_mkquery(&query,
+			slon_mkquery(&node_query[i],
 						 "lock table \"_%s\".sl_config_lock; "
 						 "select \"_%s\".preFailover(%d,%s); ",
 						 stmt->hdr.script->clustername,
 						 stmt->hdr.script->clustername,
 						 node_entry->no_id, nodeinfo[i].failover_candidate ? "true" : "false");
-			if (db_exec_command((SlonikStmt *) stmt, nodeinfo[i].adminfo, &query) < 0)
-			{
-				rc = -1;
-				goto cleanup;
-			}
+		}
+		if (fail_node_select_all(stmt, nodeinfo, node_entry->num_nodes,
+								 node_query, NULL, node_res) < 0)
+		{
+			rc = -1;
+			goto cleanup;
+		}
+		for (i = 0; i < node_entry->num_nodes; i++)
+		{
+			PQclear(node_res[i]);
 			if (db_commit_xact((SlonikStmt *) stmt, nodeinfo[i].adminfo) < 0)
 			{
 				rc = -1;
@@ -3304,7 +3399,19 @@ cleanup:
 	free(max_seqno_total);
 	free(max_node_total);
 	free(fail_node_ids);
+	for (i = 0; i < num_node_query; i++)
+		dstring_free(&node_query[i]);
+	free(node_query);
+	free(node_res);
 	dstring_free(&query);
+
+	gettimeofday(&tv_now, NULL);
+	printf("NOTICE: failover of node(s) %s %s after %.3f seconds\n",
+		   dstring_data(&failed_node_list),
+		   rc < 0 ? "failed" : "completed",
+		   (double) (tv_now.tv_sec - tv_start.tv_sec) +
+		   (double) (tv_now.tv_usec - tv_start.tv_usec) / 1000000.0);
+	dstring_free(&failed_node_list);
 	return rc;
 }
 
@@ -3320,24 +3427,35 @@ fail_node_restart(SlonikStmt_failed_node * stmt,
 {
 	int			n = 0;
 	int			i = 0;
-	SlonDString query;
-	PGresult   *res1;
+	int			delay_ms = 0;
+	int			rc = 0;
+	SlonDString *query;
+	PGresult  **res;
+	bool	   *skip;
 
-	dstring_init(&query);
+	if (node_entry->num_nodes == 0)
+		return 0;
+
+	query = (SlonDString *) malloc(sizeof(SlonDString) * node_entry->num_nodes);
+	res = (PGresult **) malloc(sizeof(PGresult *) * node_entry->num_nodes);
+	skip = (bool *) malloc(sizeof(bool) * node_entry->num_nodes);
+	for (i = 0; i < node_entry->num_nodes; i++)
+		dstring_init(&query[i]);
 
 	while (n < node_entry->num_nodes)
 	{
-		sleep(1);
+		wait_poll_sleep(&delay_ms);
 		n = 0;
 		for (i = 0; i < node_entry->num_nodes; i++)
 		{
-			if (!nodeinfo[i].has_slon)
+			skip[i] = !nodeinfo[i].has_slon;
+			if (skip[i])
 			{
 				n++;
 				continue;
 			}
 
-			slon_mkquery(&query,
+			slon_mkquery(&query[i],
 						 "select nl_backendpid from \"_%s\".sl_nodelock "
 						 "    where nl_backendpid <> %d "
 						 "    and nl_nodeid = \"_%s\".getLocalNodeId('_%s');",
@@ -3346,28 +3464,156 @@ fail_node_restart(SlonikStmt_failed_node * stmt,
 						 stmt->hdr.script->clustername,
 						 stmt->hdr.script->clustername
 				);
-			res1 = db_exec_select((SlonikStmt *) stmt, nodeinfo[i].adminfo, &query);
-			if (res1 == NULL)
-			{
-				dstring_free(&query);
-				return -1;
-			}
-			if (PQntuples(res1) == 1)
+		}
+		if (n == node_entry->num_nodes)
+			break;
+
+		/*
+		 * Ask all nodes that still run their old slon at once
+		 */
+		if (fail_node_select_all(stmt, nodeinfo, node_entry->num_nodes,
+								 query, skip, res) < 0)
+		{
+			rc = -1;
+			break;
+		}
+		for (i = 0; i < node_entry->num_nodes; i++)
+		{
+			if (skip[i])
+				continue;
+			if (PQntuples(res[i]) == 1)
 			{
 				nodeinfo[i].has_slon = false;
 				n++;
 			}
 
-			PQclear(res1);
+			PQclear(res[i]);
 			if (db_rollback_xact((SlonikStmt *) stmt, nodeinfo[i].adminfo) < 0)
-			{
-				dstring_free(&query);
-				return -1;
-			}
+				rc = -1;
 		}
+		if (rc < 0)
+			break;
 	}
-	dstring_free(&query);
-	return 0;
+
+	for (i = 0; i < node_entry->num_nodes; i++)
+		dstring_free(&query[i]);
+	free(query);
+	free(res);
+	free(skip);
+	return rc;
+}
+
+
+/**
+ * A helper function used during the failover process.
+ * Connect to all failover candidates of a failed node concurrently.
+ */
+static int
+fail_node_connect(SlonikStmt_failed_node * stmt,
+				  failnode_node * nodeinfo, int num_nodes)
+{
+	SlonikAdmInfo **connect;
+	int			num_connect = 0;
+	int			version;
+	int			rc = 0;
+	int			i;
+
+	if (num_nodes == 0)
+		return 0;
+
+	connect = (SlonikAdmInfo **) malloc(sizeof(SlonikAdmInfo *) * num_nodes);
+	for (i = 0; i < num_nodes; i++)
+	{
+		nodeinfo[i].adminfo = get_adminfo((SlonikStmt *) stmt,
+										  nodeinfo[i].no_id);
+		if (nodeinfo[i].adminfo == NULL)
+		{
+			printf("%s:%d error no conninfo for candidate for %d\n",
+				   stmt->hdr.stmt_filename, stmt->hdr.stmt_lno
+				   ,nodeinfo[i].no_id);
+			free(connect);
+			return -1;
+		}
+		if (nodeinfo[i].adminfo->dbconn == NULL)
+			connect[num_connect++] = nodeinfo[i].adminfo;
+	}
+
+	if (num_connect > 0 &&
+		db_connect_all((SlonikStmt *) stmt, connect, num_connect) < 0)
+		rc = -1;
+
+	/*
+	 * Finish what get_active_adminfo() does for a new connection
+	 */
+	for (i = 0; i < num_connect; i++)
+	{
+		if (connect[i]->dbconn == NULL)
+			continue;
+
+		version = db_get_version((SlonikStmt *) stmt, connect[i]);
+		if (version < 0)
+		{
+			PQfinish(connect[i]->dbconn);
+			connect[i]->dbconn = NULL;
+			rc = -1;
+			continue;
+		}
+		connect[i]->pg_version = version;
+
+		if (db_rollback_xact((SlonikStmt *) stmt, connect[i]) < 0)
+		{
+			PQfinish(connect[i]->dbconn);
+			connect[i]->dbconn = NULL;
+			rc = -1;
+		}
+	}
+
+	free(connect);
+	return rc;
+}
+
+
+/**
+ * A helper function used during the failover process.
+ * Run one select per failover candidate, all of them concurrently.
+ * Candidates with skip[i] set are left alone; skip may be NULL.
+ */
+static int
+fail_node_select_all(SlonikStmt_failed_node * stmt,
+					 failnode_node * nodeinfo, int num_nodes,
+					 SlonDString * query, bool *skip, PGresult ** res)
+{
+	SlonikAdmInfo **adminfo;
+	SlonDString **queries;
+	int			rc;
+	int			i;
+
+	if (num_nodes == 0)
+		return 0;
+
+	adminfo = (SlonikAdmInfo **) malloc(sizeof(SlonikAdmInfo *) * num_nodes);
+	queries = (SlonDString **) malloc(sizeof(SlonDString *) * num_nodes);
+	for (i = 0; i < num_nodes; i++)
+	{
+		adminfo[i] = nodeinfo[i].adminfo;
+		queries[i] = (skip != NULL && skip[i]) ? NULL : &query[i];
+	}
+
+	rc = db_exec_select_all((SlonikStmt *) stmt, adminfo, queries, res,
+							num_nodes);
+	if (rc < 0)
+	{
+		for (i = 0; i < num_nodes; i++)
+		{
+			if (res[i] != NULL)
+				PQclear(res[i]);
+			res[i] = NULL;
+		}
+	}
+
+	free(adminfo);
+	free(queries);
+	return rc;
 }
 
 
@@ -3394,14 +3640,34 @@ fail_node_promote(SlonikStmt_failed_node * stmt,
 	SlonikAdmInfo *adminfo1;
 	SlonikStmt_wait_event wait_event;
 	int64 backup_node_seqno = 0;
+	SlonDString *query_all = NULL;
+	PGresult  **res_all = NULL;
 	
 	dstring_init(&query);
 	
 
 	/*
 	 * For every node determine the one with the event , preferring the backup
-	 * node.
+	 * node. All candidates are asked at once; the answers are evaluated in
+	 * node order so the choice does not depend on who answers first.
 	 */
+	query_all = (SlonDString *) malloc(sizeof(SlonDString) * node_entry->num_nodes);
+	res_all = (PGresult **) malloc(sizeof(PGresult *) * node_entry->num_nodes);
+	slon_mkquery(&query,
+				 "select max(ev_seqno) "
+				 "	from \"_%s\".sl_event "
+				 "	where ev_origin = %d; ",
+				 stmt->hdr.script->clustername,
+				 node_entry->no_id);
+	for (i = 0; i < node_entry->num_nodes; i++)
+		query_all[i] = query;
+	if (fail_node_select_all(stmt, nodeinfo, node_entry->num_nodes,
+							 query_all, NULL, res_all) < 0)
+	{
+		rc=-1;
+		goto cleanup;
+	}
+
 	for (i = 0; i < node_entry->num_nodes; i++)
 	{
 
@@ -3410,19 +3676,7 @@ fail_node_promote(SlonikStmt_failed_node * stmt,
 		//if (!nodeinfo[i].failover_candidate)
 		//	continue;
 		
-		slon_mkquery(&query,
-					 "select max(ev_seqno) "
-					 "	from \"_%s\".sl_event "
-					 "	where ev_origin = %d; ",
-					 stmt->hdr.script->clustername,
-					 node_entry->no_id);
-		res1 = db_exec_select((SlonikStmt *) stmt,
-							  nodeinfo[i].adminfo, &query);
-		if (res1 == NULL)
-		{
-			rc=-1;
-			goto cleanup;
-		}
+		res1 = res_all[i];
 		slon_scanint64(PQgetvalue(res1, 0, 0), &ev_seqno);
 		if (nodeinfo[i].no_id == node_entry->backup_node) 
 		{
@@ -3565,6 +3819,8 @@ cleanup:
 			rc = -1;
 	}
 
+	free(query_all);
+	free(res_all);
 	dstring_free(&query);
 	return rc;
 }
@@ -4088,8 +4344,6 @@ slonik_set_add_table(SlonikStmt_set_add_table * stmt)
 	int			origin = stmt->set_origin;
 	SlonDString query;
 	PGresult   *result;
-	int			idx;
-	char	   *table_name;
 	int			rc;
 
 	if (stmt->set_origin < 0)
@@ -4188,20 +4442,7 @@ slonik_set_add_table(SlonikStmt_set_add_table * stmt)
 			return -1;
 
 		}
-		rc = 0;
-		for (idx = 0; idx < PQntuples(result); idx++)
-		{
-
-			table_name = PQgetvalue(result, idx, 0);
-			rc = slonik_set_add_single_table(stmt, adminfo1,
-											 table_name);
-			if (rc < 0)
-			{
-				PQclear(result);
-				dstring_terminate(&query);
-				return rc;
-			}
-		}
+		rc = slonik_set_add_tables(stmt, adminfo1, result);
 		PQclear(result);
 	}
 	else
@@ -4209,6 +4450,70 @@ slonik_set_add_table(SlonikStmt_set_add_table * stmt)
 	dstring_terminate(&query);
 	return rc;
 }
+
+
+/*
+ * Add all tables matched by a 'tables' pattern with a single call of
+ * setAddTables(), which looks them up in one pass over the catalog and
+ * generates one SET_ADD_TABLES event. The table ids are assigned
+ * consecutively.
+ */
+static int
+slonik_set_add_tables(SlonikStmt_set_add_table * stmt,
+					  SlonikAdmInfo * adminfo1,
+					  PGresult *tables)
+{
+	SlonDString query;
+	int			ntables = PQntuples(tables);
+	int			tab_id;
+	int			idx;
+	int			rc = 0;
+
+	if (ntables == 0)
+		return 0;
+
+	if (stmt->tab_id < 0)
+	{
+		tab_id = slonik_get_next_tab_id((SlonikStmt *) stmt);
+		if (tab_id < 0)
+			return -1;
+	}
+	else
+		tab_id = stmt->tab_id;
+
+	dstring_init(&query);
+	slon_mkquery(&query,
+				 "lock table \"_%s\".sl_config_lock;"
+				 "select \"_%s\".setAddTables(%d, array[",
+				 stmt->hdr.script->clustername,
+				 stmt->hdr.script->clustername,
+				 stmt->set_id);
+	for (idx = 0; idx < ntables; idx++)
+		slon_appendquery(&query, "%s%d", (idx == 0) ? "" : ",",
+						 tab_id + idx);
+	slon_appendquery(&query, "]::int4[], array[");
+	for (idx = 0; idx < ntables; idx++)
+		slon_appendquery(&query, "%s'%q'", (idx == 0) ? "" : ",",
+						 PQgetvalue(tables, idx, 0));
+	slon_appendquery(&query, "]::text[], '%q'); ", stmt->tab_comment);
+
+	if (slonik_submitEvent((SlonikStmt *) stmt, adminfo1, &query,
+						   stmt->hdr.script, auto_wait_disabled) < 0)
+	{
+		dstring_free(&query);
+		return -1;
+	}
+
+	if (stmt->add_sequences)
+	{
+		for (idx = 0; idx < ntables && rc >= 0; idx++)
+			rc = slonik_add_dependent_sequences(stmt, adminfo1,
+												PQgetvalue(tables, idx, 0));
+	}
+
+	dstring_free(&query);
+	return rc;
+}
 int
 slonik_set_add_single_table(SlonikStmt_set_add_table * stmt,
 							SlonikAdmInfo * adminfo1,
@@ -4261,11 +4566,17 @@ slonik_set_add_single_table(SlonikStmt_set_add_table * stmt,
 
 	slon_mkquery(&query,
 				 "lock table \"_%s\".sl_config_lock;"
-				 "select \"_%s\".setAddTable(%d, %d, '%q', '%q', '%q'); ",
+				 "select \"_%s\".setAddTable(%d, %d, '%q', '%q', '%q', ",
 				 stmt->hdr.script->clustername,
 				 stmt->hdr.script->clustername,
 				 stmt->set_id, tab_id,
 				 fqname, idxname, stmt->tab_comment);
+	if (stmt->tab_columns != NULL)
+		slon_appendquery(&query,
+						 "pg_catalog.string_to_array('%q', ',')); ",
+						 stmt->tab_columns);
+	else
+		slon_appendquery(&query, "NULL::text[]); ");
 	if (slonik_submitEvent((SlonikStmt *) stmt, adminfo1, &query,
 						   stmt->hdr.script, auto_wait_disabled) < 0)
 	{
@@ -4598,6 +4909,40 @@ slonik_set_move_sequence(SlonikStmt_set_move_sequence * stmt)
 	return 0;
 }
 
+int
+slonik_set_table_filter(SlonikStmt_set_table_filter * stmt)
+{
+	SlonikAdmInfo *adminfo1;
+	SlonDString query;
+
+	adminfo1 = get_active_adminfo((SlonikStmt *) stmt, stmt->set_origin);
+	if (adminfo1 == NULL)
+		return -1;
+
+	if (db_begin_xact((SlonikStmt *) stmt, adminfo1, false) < 0)
+		return -1;
+
+	dstring_init(&query);
+
+	slon_mkquery(&query,
+				 "lock table \"_%s\".sl_event_lock, \"_%s\".sl_config_lock;"
+				 "select \"_%s\".setTableFilter(%d, %d, '%q'); ",
+				 stmt->hdr.script->clustername,
+				 stmt->hdr.script->clustername,
+				 stmt->hdr.script->clustername,
+				 stmt->tab_id, stmt->receiver,
+				 (stmt->filter == NULL) ? "" : stmt->filter);
+	if (slonik_submitEvent((SlonikStmt *) stmt, adminfo1, &query,
+						   stmt->hdr.script, auto_wait_disabled) < 0)
+	{
+		dstring_free(&query);
+		return -1;
+	}
+	dstring_free(&query);
+	return 0;
+}
+
+
 int
 slonik_subscribe_set(SlonikStmt_subscribe_set * stmt)
 {
@@ -4780,6 +5125,7 @@ slonik_lock_set(SlonikStmt_lock_set * stmt)
 	PGresult   *res1;
 	PGresult   *res2;
 	char	   *maxxid_lock;
+	int			delay_ms = 0;
 
 	adminfo1 = get_active_adminfo((SlonikStmt *) stmt, stmt->set_origin);
 	if (adminfo1 == NULL)
@@ -4793,27 +5139,37 @@ slonik_lock_set(SlonikStmt_lock_set * stmt)
 	}
 
 	/*
-	 * We issue the lockSet() and get the current xmax
+	 * We issue the lockSet() and commit it, so that the log trigger sees
+	 * the set as locked.
 	 */
 	dstring_init(&query);
 	slon_mkquery(&query,
 				 "lock table \"_%s\".sl_config_lock;"
-				 "select \"_%s\".lockSet(%d); "
-				 "select pg_catalog.txid_snapshot_xmax(pg_catalog.txid_current_snapshot());",
+				 "select \"_%s\".lockSet(%d); ",
 				 stmt->hdr.script->clustername,
 				 stmt->hdr.script->clustername,
 				 stmt->set_id);
-	res1 = db_exec_select((SlonikStmt *) stmt, adminfo1, &query);
-	if (res1 == NULL)
+	if (db_exec_command((SlonikStmt *) stmt, adminfo1, &query) < 0 ||
+		db_commit_xact((SlonikStmt *) stmt, adminfo1) < 0)
 	{
 		dstring_free(&query);
 		return -1;
 	}
-	maxxid_lock = PQgetvalue(res1, 0, 0);
 
 	/*
-	 * Now we need to commit this already and wait until xmin is >= that xmax
+	 * The log trigger checks the lock once per transaction, after that
+	 * transaction got its xid. So every transaction that missed the lock
+	 * has an xid below one assigned after the commit, and we wait until
+	 * xmin is >= that.
 	 */
+	slon_mkquery(&query, "select pg_catalog.txid_current(); ");
+	res1 = db_exec_select((SlonikStmt *) stmt, adminfo1, &query);
+	if (res1 == NULL)
+	{
+		dstring_free(&query);
+		return -1;
+	}
+	maxxid_lock = PQgetvalue(res1, 0, 0);
 	if (db_commit_xact((SlonikStmt *) stmt, adminfo1) < 0)
 	{
 		dstring_free(&query);
@@ -4846,7 +5202,7 @@ slonik_lock_set(SlonikStmt_lock_set * stmt)
 			return -1;
 		}
 
-		sleep(1);
+		wait_poll_sleep(&delay_ms);
 	}
 
 	PQclear(res1);
@@ -4923,6 +5279,11 @@ slonik_move_set(SlonikStmt_move_set * stmt)
 }
 
 
+/*
+ * Number of script statements sent to the origin per round trip
+ */
+#define DDL_SCRIPT_BATCH 100
+
 int
 slonik_ddl_script(SlonikStmt_ddl_script * stmt)
 {
@@ -4934,14 +5295,11 @@ slonik_ddl_script(SlonikStmt_ddl_script * stmt)
 	PGresult   *res1;
 	size_t		num_read;
 	int			num_statements = -1,
-				stmtno;
+				stmtno,
+				last;
 	char		buf[4096];
 	replacement_token	replacements[4];
 
-#define PARMCOUNT 1
-
-	const char *params[PARMCOUNT];
-
 	adminfo1 = get_active_adminfo((SlonikStmt *) stmt, stmt->ev_origin);
 	if (adminfo1 == NULL)
 		return -1;
@@ -5028,48 +5386,29 @@ slonik_ddl_script(SlonikStmt_ddl_script * stmt)
 	num_statements = scan_for_statements(dstring_data(&script_rewritten));
 
 	/* OOPS!  Something went wrong !!! */
-	if ((num_statements < 0) || (num_statements >= MAXSTATEMENTS))
+	if (num_statements < 0)
 	{
-		printf("DDL - number of statements invalid - %d not between 0 and %d\n", num_statements, MAXSTATEMENTS);
+		printf("DDL - could not allocate memory to split the script into statements\n");
+		dstring_free(&equery);
 		dstring_free(&script_rewritten);
 		return -1;
 	}
-	dstring_init(&query);
-	for (stmtno = 0; stmtno < num_statements; stmtno++)
+	for (stmtno = 0; stmtno < num_statements; stmtno = last)
 	{
-		int			startpos,
-					endpos;
-		char	   *dest;
-
-		if (stmtno == 0)
-			startpos = 0;
-		else
-			startpos = STMTS[stmtno - 1];
-		endpos = STMTS[stmtno];
-		dest = (char *) malloc(endpos - startpos + 1);
-		if (dest == 0)
-		{
-			printf("DDL Failure - could not allocate %d bytes of memory\n", endpos - startpos + 1);
-			return -1;
-		}
-		strncpy(dest, dstring_data(&script_rewritten) + startpos, endpos - startpos);
-		dest[STMTS[stmtno] - startpos] = '\0';
-		slon_mkquery(&query, "%s", dest);
-		free(dest);
-
-		params[PARMCOUNT - 1] = dstring_data(&query);
+		last = stmtno + DDL_SCRIPT_BATCH;
+		if (last > num_statements)
+			last = num_statements;
 
-		res1 = PQexecParams(adminfo1->dbconn, dstring_data(&equery), 1, NULL, params, NULL, NULL, 0);
-		if (PQresultStatus(res1) != PGRES_TUPLES_OK)
+		if (ddl_script_exec_batch(adminfo1->dbconn, dstring_data(&equery),
+								  dstring_data(&script_rewritten),
+								  stmtno, last) < 0)
 		{
-			fprintf(stderr, "%s [%s] - %s",
-					PQresStatus(PQresultStatus(res1)),
-					dstring_data(&query), PQresultErrorMessage(res1));
-			PQclear(res1);
+			dstring_free(&equery);
+			dstring_free(&script_rewritten);
 			return -1;
 		}
-		PQclear(res1);
 	}
+	dstring_init(&query);
 
 	/*
 	 * Finally call ddlScript_complete()
@@ -5116,6 +5455,124 @@ slonik_ddl_script(SlonikStmt_ddl_script * stmt)
 }
 
 
+/*
+ * Copy statement stmtno of a script split by scan_for_statements()
+ * into query.
+ */
+static void
+ddl_script_statement(SlonDString * query, const char *script, int stmtno)
+{
+	int			startpos;
+
+	startpos = (stmtno == 0) ? 0 : STMTS[stmtno - 1];
+	dstring_reset(query);
+	dstring_nappend(query, script + startpos, STMTS[stmtno] - startpos);
+	dstring_terminate(query);
+}
+
+
+/*
+ * Run the statements first .. last - 1 of a DDL script through
+ * ddlCapture().  With libpq pipeline mode the whole batch is sent before
+ * reading any result, so it costs one round trip instead of one per
+ * statement while sl_config_lock is held.
+ */
+static int
+ddl_script_exec_batch(PGconn *conn, const char *equery,
+					  const char *script, int first, int last)
+{
+	SlonDString query;
+	const char *params[1];
+	PGresult   *res;
+	int			stmtno;
+	int			rc = 0;
+
+	dstring_init(&query);
+
+#ifdef HAVE_PQENTERPIPELINEMODE
+	if (PQenterPipelineMode(conn) == 1)
+	{
+		for (stmtno = first; stmtno < last; stmtno++)
+		{
+			ddl_script_statement(&query, script, stmtno);
+			params[0] = dstring_data(&query);
+			if (PQsendQueryParams(conn, equery, 1, NULL, params,
+								  NULL, NULL, 0) != 1)
+			{
+				fprintf(stderr, "DDL Failure - cannot send [%s] - %s",
+						dstring_data(&query), PQerrorMessage(conn));
+				rc = -1;
+				last = stmtno;
+				break;
+			}
+		}
+		if (PQpipelineSync(conn) != 1)
+		{
+			fprintf(stderr, "DDL Failure - cannot sync pipeline - %s",
+					PQerrorMessage(conn));
+			rc = -1;
+		}
+
+		for (stmtno = first; stmtno < last; stmtno++)
+		{
+			while ((res = PQgetResult(conn)) != NULL)
+			{
+				if (PQresultStatus(res) != PGRES_TUPLES_OK &&
+					PQresultStatus(res) != PGRES_PIPELINE_ABORTED)
+				{
+					ddl_script_statement(&query, script, stmtno);
+					fprintf(stderr, "%s [%s] - %s",
+							PQresStatus(PQresultStatus(res)),
+							dstring_data(&query), PQresultErrorMessage(res));
+					rc = -1;
+				}
+				PQclear(res);
+			}
+		}
+
+		while ((res = PQgetResult(conn)) != NULL &&
+			   PQresultStatus(res) != PGRES_PIPELINE_SYNC)
+		{
+			PQclear(res);
+			rc = -1;
+		}
+		PQclear(res);
+
+		if (PQexitPipelineMode(conn) != 1)
+		{
+			fprintf(stderr, "DDL Failure - cannot exit pipeline mode - %s",
+					PQerrorMessage(conn));
+			rc = -1;
+		}
+
+		dstring_free(&query);
+		return rc;
+	}
+#endif
+
+	for (stmtno = first; stmtno < last; stmtno++)
+	{
+		ddl_script_statement(&query, script, stmtno);
+		params[0] = dstring_data(&query);
+
+		res = PQexecParams(conn, equery, 1, NULL, params, NULL, NULL, 0);
+		if (PQresultStatus(res) != PGRES_TUPLES_OK)
+		{
+			fprintf(stderr, "%s [%s] - %s",
+					PQresStatus(PQresultStatus(res)),
+					dstring_data(&query), PQresultErrorMessage(res));
+			PQclear(res);
+			rc = -1;
+			break;
+		}
+		PQclear(res);
+	}
+
+	dstring_free(&query);
+	return rc;
+}
+
+
 int
 slonik_update_functions(SlonikStmt_update_functions * stmt)
 {
@@ -5227,7 +5684,8 @@ slonik_wait_event(SlonikStmt_wait_event * stmt)
 	time_t		now;
 	int			all_confirmed = 0;
 	char		seqbuf[NAMEDATALEN];
-	int			loop_count = 0;
+	time_t		next_report;
+	int			delay_ms = 0;
 	SlonDString outstanding_nodes;
 	int			tupindex;
 
@@ -5236,6 +5694,7 @@ slonik_wait_event(SlonikStmt_wait_event * stmt)
 		return -1;
 
 	time(&timeout);
+	next_report = timeout + 10;
 	timeout += stmt->wait_timeout;
 	dstring_init(&query);
 	dstring_init(&outstanding_nodes);
@@ -5372,8 +5831,7 @@ slonik_wait_event(SlonikStmt_wait_event * stmt)
 			return -1;
 		}
 
-		loop_count++;
-		if (loop_count % 10 == 0 && stmt->wait_confirmed >= 0)
+		if (now >= next_report && stmt->wait_confirmed >= 0)
 		{
 			sprintf(seqbuf, INT64_FORMAT, adminfo->last_event);
 			printf("%s:%d: waiting for event (%d,%s) to be confirmed on node %d\n"
@@ -5382,7 +5840,7 @@ slonik_wait_event(SlonikStmt_wait_event * stmt)
 				   stmt->wait_confirmed);
 			fflush(stdout);
 		}
-		else if (loop_count % 10 == 0)
+		else if (now >= next_report)
 		{
 			sprintf(seqbuf, INT64_FORMAT, adminfo->last_event);
 			printf("%s:%d: waiting for event (%d,%s).  %s\n",
@@ -5392,7 +5850,9 @@ slonik_wait_event(SlonikStmt_wait_event * stmt)
 			fflush(stdout);
 
 		}
-		sleep(1);
+		if (now >= next_report)
+			next_report = now + 10;
+		wait_poll_sleep(&delay_ms);
 	}
 	dstring_free(&outstanding_nodes);
 	dstring_free(&query);
@@ -5473,6 +5933,39 @@ slonik_sleep(SlonikStmt_sleep * stmt)
 }
 
 
+/*
+ * Pause between two polls of a wait loop. The pause starts short and
+ * doubles with every poll up to WAIT_POLL_MAX_MS, so that a wait ends
+ * right after what it waits for has happened, without flooding the
+ * node with queries during long waits.
+ */
+#define WAIT_POLL_MIN_MS	10
+#define WAIT_POLL_MAX_MS	100
+
+static void
+wait_poll_sleep(int *delay_ms)
+{
+	if (*delay_ms < WAIT_POLL_MIN_MS)
+		*delay_ms = WAIT_POLL_MIN_MS;
+
+#ifdef WIN32
+	Sleep(*delay_ms);
+#else
+	{
+		struct timespec ts;
+
+		ts.tv_sec = *delay_ms / 1000;
+		ts.tv_nsec = (long) (*delay_ms % 1000) * 1000000L;
+		nanosleep(&ts, NULL);
+	}
+#endif
+
+	*delay_ms *= 2;
+	if (*delay_ms > WAIT_POLL_MAX_MS)
+		*delay_ms = WAIT_POLL_MAX_MS;
+}
+
+
 /*
  * scanint8 --- try to parse a string into an int8.
  *
@@ -6097,7 +6590,8 @@ slonik_wait_config_caughtup(SlonikAdmInfo * adminfo1,
 	SlonDString node_list;
 	int			wait_count = 0;
 	int			node_list_size = 0;
-	int			sleep_count = 0;
+	int			delay_ms = 0;
+	time_t		next_report = time(NULL) + 10;
 	int64	   *behind_nodes = NULL;
 	int			idx;
 	int			cur_array_idx;
@@ -6250,8 +6744,7 @@ slonik_wait_config_caughtup(SlonikAdmInfo * adminfo1,
 		}						/* for .. PQntuples */
 		if (confirm_count < wait_count)
 		{
-			sleep_count++;
-			if (sleep_count % 10 == 0)
+			if (time(NULL) >= next_report)
 			{
 				/**
 				 * any elements in caught_up_nodes with a value 0
@@ -6288,9 +6781,10 @@ slonik_wait_config_caughtup(SlonikAdmInfo * adminfo1,
 				printf("waiting for events %s to be confirmed on node %d\n",
 					   dstring_data(&outstanding), adminfo1->no_id);
 				fflush(stdout);
+				next_report = time(NULL) + 10;
 
-			}					/* every 10 iterations */
-			sleep(1);
+			}					/* every 10 seconds */
+			wait_poll_sleep(&delay_ms);
 		}
 		free(behind_nodes);
 
@@ -42,6 +42,7 @@ typedef struct SlonikStmt_set_drop_table_s SlonikStmt_set_drop_table;
 typedef struct SlonikStmt_set_drop_sequence_s SlonikStmt_set_drop_sequence;
 typedef struct SlonikStmt_set_move_table_s SlonikStmt_set_move_table;
 typedef struct SlonikStmt_set_move_sequence_s SlonikStmt_set_move_sequence;
+typedef struct SlonikStmt_set_table_filter_s SlonikStmt_set_table_filter;
 typedef struct SlonikStmt_subscribe_set_s SlonikStmt_subscribe_set;
 typedef struct SlonikStmt_unsubscribe_set_s SlonikStmt_unsubscribe_set;
 typedef struct SlonikStmt_lock_set_s SlonikStmt_lock_set;
@@ -84,6 +85,7 @@ typedef enum
 	STMT_SET_DROP_TABLE,
 	STMT_SET_MOVE_SEQUENCE,
 	STMT_SET_MOVE_TABLE,
+	STMT_SET_TABLE_FILTER,
 	STMT_SLEEP,
 	STMT_STORE_LISTEN,
 	STMT_STORE_NODE,
@@ -320,6 +322,7 @@ struct SlonikStmt_set_add_table_s
 	char	   *tab_comment;
 	char	   *tables;
 	int			add_sequences;
+	char	   *tab_columns;
 };
 
 
@@ -369,6 +372,16 @@ struct SlonikStmt_set_move_sequence_s
 };
 
 
+struct SlonikStmt_set_table_filter_s
+{
+	SlonikStmt	hdr;
+	int			set_origin;
+	int			tab_id;
+	int			receiver;
+	char	   *filter;
+};
+
+
 struct SlonikStmt_subscribe_set_s
 {
 	SlonikStmt	hdr;
@@ -582,6 +595,7 @@ extern int	slonik_set_drop_table(SlonikStmt_set_drop_table * stmt);
 extern int	slonik_set_drop_sequence(SlonikStmt_set_drop_sequence * stmt);
 extern int	slonik_set_move_table(SlonikStmt_set_move_table * stmt);
 extern int	slonik_set_move_sequence(SlonikStmt_set_move_sequence * stmt);
+extern int	slonik_set_table_filter(SlonikStmt_set_table_filter * stmt);
 extern int	slonik_subscribe_set(SlonikStmt_subscribe_set * stmt);
 extern int	slonik_unsubscribe_set(SlonikStmt_unsubscribe_set * stmt);
 extern int	slonik_lock_set(SlonikStmt_lock_set * stmt);
@@ -609,6 +623,8 @@ void		db_notice_recv(void *arg, const PGresult *res);
 void		db_notice_recv(void *arg, const char *msg);
 #endif
 int			db_connect(SlonikStmt * stmt, SlonikAdmInfo * adminfo);
+int			db_connect_all(SlonikStmt * stmt, SlonikAdmInfo ** adminfo,
+			   int nconns);
 int			db_disconnect(SlonikStmt * stmt, SlonikAdmInfo * adminfo);
 
 int db_exec_command(SlonikStmt * stmt, SlonikAdmInfo * adminfo,
@@ -621,6 +637,8 @@ int db_exec_evcommand_p(SlonikStmt * stmt, SlonikAdmInfo * adminfo,
 					const int *paramFormats, int resultFormat);
 PGresult *db_exec_select(SlonikStmt * stmt, SlonikAdmInfo * adminfo,
 			   SlonDString * query);
+int db_exec_select_all(SlonikStmt * stmt, SlonikAdmInfo ** adminfo,
+				   SlonDString ** query, PGresult ** res, int nconns);
 int			db_get_version(SlonikStmt * stmt, SlonikAdmInfo * adminfo);
 int db_check_namespace(SlonikStmt * stmt, SlonikAdmInfo * adminfo,
 				   char *clustername);
@@ -660,6 +678,7 @@ typedef enum
 	O_ADD_SEQUENCES,
 	O_BACKUP_NODE,
 	O_CLIENT,
+	O_COLUMNS,
 	O_COMMENT,
 	O_CONNINFO,
 	O_CONNRETRY,
@@ -668,6 +687,7 @@ typedef enum
 	O_EXECUTE_ONLY_ON,
 	O_EXECUTE_ONLY_LIST,
 	O_FILENAME,
+	O_FILTER,
 	O_FORWARD,
 	O_FQNAME,
 	O_ID,
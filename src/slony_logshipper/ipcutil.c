@@ -310,6 +310,17 @@ ipc_add_path(char *path)
 	}
 	elem->next = NULL;
 
+	/*
+	 * Archives mostly arrive in order, so try appending first.
+	 */
+	if (archive_queue_tail != NULL &&
+		strcmp(elem->archive_path, archive_queue_tail->archive_path) >= 0)
+	{
+		archive_queue_tail->next = elem;
+		archive_queue_tail = elem;
+		return 0;
+	}
+
 	/*
 	 * See if we have to insert it in front of something else
 	 */
@@ -18,7 +18,6 @@
 
 #include "scan.h"
 
-extern int STMTS[MAXSTATEMENTS];
 
 
 /*
@@ -60,9 +59,6 @@ int yydebug=1;
 %type <dstring>			literal_parts
 %type <str>				literal_part
 %type <str>				literal_final
-%type <dstring>			arch_copydata_parts
-%type <str>				arch_copydata_part
-%type <str>				arch_copydata_fin
 
 /*
  * Keyword tokens
@@ -81,6 +77,7 @@ int yydebug=1;
 %token	K_CONF_COMMENT
 %token	K_COPY
 %token	K_DATABASE
+%token	K_DEPTH
 %token	K_DELETE
 %token	K_DESTINATION
 %token	K_DIR
@@ -94,6 +91,7 @@ int yydebug=1;
 %token	K_NAMESPACE
 %token	K_NULL
 %token	K_ONLY
+%token	K_PIPELINE
 %token	K_POST
 %token	K_PRE
 %token	K_PROCESSING
@@ -118,7 +116,6 @@ int yydebug=1;
  * Other scanner tokens
  */
 %token	T_COPYDATA
-%token	T_COPYDATA_PART
 %token	T_COPYEND
 %token	T_IDENT
 %token	T_LITERAL
@@ -153,6 +150,7 @@ conf_stmt			: K_CONF_COMMENT
 					| conf_dest_database
 					| conf_logfile
 					| conf_maxarchives
+					| conf_pipelinedepth
 					| conf_clustername
 					| conf_rename_object
 					| conf_preprocess
@@ -202,6 +200,12 @@ conf_maxarchives	: K_MAX K_ARCHIVES '=' num ';'
 					}
 					;
 
+conf_pipelinedepth	: K_PIPELINE K_DEPTH '=' num ';'
+					{
+						pipeline_depth = $4;
+					}
+					;
+
 conf_clustername	: K_CLUSTER K_NAME '=' literal ';'
 					{
 						if (cluster_name != NULL)
@@ -357,11 +361,14 @@ arch_tracking		: K_SELECT ident '.' arch_tracking_func '(' literal ',' literal '
 						}
 						if (rc == 1)
 						{
+							/*
+							 * Already applied. An archive segment may hold
+							 * more SYNC groups, so only skip this one.
+							 */
 							dstring_free(&ds);
-							YYACCEPT;
+							process_skip_group();
 						}
-						
-						if (process_simple_sql(dstring_data(&ds)) < 0)
+						else if (process_simple_sql(dstring_data(&ds)) < 0)
 						{
 							dstring_free(&ds);
 							YYABORT;
@@ -387,6 +394,7 @@ arch_stmts			: arch_stmt
 					;
 
 arch_stmt			: arch_comment
+					| arch_group_hdr
 					| arch_commit
 					| arch_insert
 					| arch_update
@@ -403,6 +411,10 @@ arch_stmt			: arch_comment
 					| arch_truncate
 					;
 
+arch_group_hdr		: arch_start_trans
+					  arch_tracking
+					;
+
 arch_commit			: K_COMMIT ';'
 					{
 						if (process_end_transaction("commit;") < 0)
@@ -634,63 +646,17 @@ arch_copy			: K_COPY ident '.' ident '(' arch_attr_list ')' K_FROM ident ';'
 					}
 					;
 
-arch_copydata		: arch_copydata_fin
+arch_copydata		: T_COPYDATA
 					{
-						int rc;
-
-						rc = process_copydata($1);
-						free($1);
-
-						if (rc < 0)
-							YYABORT;
-					}
-					| arch_copydata_parts arch_copydata_fin
-					{
-						int rc;
-
-						dstring_append($1, $2);
-						dstring_terminate($1);
-						free($2);
-						rc = process_copydata(dstring_data($1));
-						dstring_free($1);
-
-						if (rc < 0)
+						/*
+						 * A block of raw COPY data, which does not
+						 * necessarily end at a line boundary.
+						 */
+						if (process_copydata(yycopybuf, yycopylen) < 0)
 							YYABORT;
 					}
 					;
 
-arch_copydata_parts	: arch_copydata_part
-					{
-						SlonDString	*new;
-
-						new = (SlonDString *)malloc(sizeof(SlonDString));
-						dstring_init(new);
-						dstring_append(new, $1);
-						free($1);
-
-						$$ = new;
-					}
-					| arch_copydata_parts arch_copydata_part
-					{
-						dstring_append($1, $2);
-						free($2);
-
-						$$ = $1;
-					}
-					;
-
-arch_copydata_fin	: T_COPYDATA
-					{
-						$$ = strdup(yychunk);
-					}
-					;
-
-arch_copydata_part	: T_COPYDATA_PART
-					{
-						$$ = strdup(yychunk);
-					}
-					;
-
 arch_copyend		: T_COPYEND
 					{
 						if (process_copyend() < 0)
@@ -1013,6 +979,7 @@ ident_keywords		: K_START_CONFIG | K_START_ARCHIVE
 					| K_COPY
 					| K_DATABASE
 					| K_DELETE
+					| K_DEPTH
 					| K_DESTINATION
 					| K_DIR
 					| K_ERROR
@@ -1022,6 +989,7 @@ ident_keywords		: K_START_CONFIG | K_START_ARCHIVE
 					| K_MAX
 					| K_NAME
 					| K_NAMESPACE
+					| K_PIPELINE
 					| K_POST
 					| K_PRE
 					| K_PROCESSING
@@ -27,6 +27,7 @@
 #include <signal.h>
 #include <dirent.h>
 #include <string.h>
+#include <poll.h>
 #else
 #define sleep(x) Sleep(x*1000)
 #define vsnprintf _vsnprintf
@@ -37,14 +38,30 @@
 #include "../slonik/types.h"
 #include "slony_logshipper.h"
 #include "config.h"
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
 
 
-typedef struct archscan_entry_s
+/*
+ * Hash tables for the rename rules and the per table results
+ */
+typedef struct RenameHashEntry_s
 {
-	char	   *fname;
-	struct archscan_entry_s *left;
-	struct archscan_entry_s *right;
-}	archscan_entry;
+	char	   *namespace;
+	char	   *name;
+	uint32		hash;
+	char	   *use_namespace;
+	char	   *use_name;
+	struct RenameHashEntry_s *next;
+}	RenameHashEntry;
+
+typedef struct
+{
+	RenameHashEntry **buckets;
+	int			nbuckets;
+	int			nentries;
+}	RenameHash;
 
 /*
  * Global data
@@ -57,6 +74,7 @@ FILE	   *destinationfp = NULL;
 char	   *logfile_path = NULL;
 FILE	   *logfile_fp = NULL;
 int			max_archives = 1000;
+int			pipeline_depth = 100;
 PGconn	   *dbconn = NULL;
 bool		logfile_switch_requested = false;
 bool		wait_for_resume = false;
@@ -91,13 +109,30 @@ static int	opt_nowait = 0;
 /*
  * Local data
  */
-static archscan_entry *archscan_sort = NULL;
+static char **archscan_names = NULL;
+static int	archscan_count = 0;
+static int	archscan_alloc = 0;
+static char archscan_last[64];
+static time_t archscan_time = 0;
+#ifdef HAVE_SYS_INOTIFY_H
+static int	archwatch_fd = -1;
+#endif
 static char current_at_counter[64];
+static bool current_at_counter_valid = false;
+static char group_at_counter[64];
 static bool process_in_transaction = false;
+static bool process_skipping = false;
 static char *current_archive_path = NULL;
 static bool suppress_copy = false;
 static SlonDString errlog_messages;
 static int	archive_count = 0;
+static RenameHash rename_tables = {NULL, 0, 0};
+static RenameHash rename_namespaces = {NULL, 0, 0};
+static RenameHash rename_cache = {NULL, 0, 0};
+#ifdef HAVE_PQENTERPIPELINEMODE
+static char **pipeline_queries = NULL;
+static int	pipeline_count = 0;
+#endif
 
 
 /*
@@ -106,12 +141,23 @@ static int	archive_count = 0;
 static void usage(void);
 static int	process_archive(char *fname);
 static int	process_exec_sql(char *sql);
+static int	process_exec_db(char *sql);
+static int	process_pipeline_send(char *sql);
+static int	process_pipeline_sync(void);
 static int	archscan(int optind, int argc, char **argv);
-static int archscan_sort_in(archscan_entry ** entpm, char *fname,
-				 int optind, int argc, char **argv);
-static int	archscan_sort_out(archscan_entry * ent);
+static int archscan_sort_in(char *fname, int optind, int argc, char **argv);
+static int	archscan_sort_out(void);
+static int	archscan_compare(const void *a, const void *b);
+static bool archscan_counter(char *fname, char *counter);
+static void archwatch_init(void);
+static int	archwatch_wait(void);
 static int	get_current_at_counter(void);
-static int	idents_are_distinct(char *id1, char *id2);
+static char *ident_canonical(char *ident);
+static uint32 rename_hash_key(char *namespace, char *name);
+static RenameHashEntry *rename_hash_find(RenameHash * table, char *namespace,
+				 char *name, uint32 hash);
+static RenameHashEntry *rename_hash_add(RenameHash * table, char *namespace,
+				char *name, uint32 hash);
 static int	process_command(char *command, char *inarchive, char *outarchive);
 static void notice_processor(void *arg, const char *msg);
 
@@ -265,6 +311,7 @@ main(int argc, const char *argv[])
 	 */
 	if (init_rc == 1)
 	{
+		archwatch_init();
 		if (archscan(optind, argc, (char **) argv) < 0)
 			return -0;
 	}
@@ -373,14 +420,17 @@ main(int argc, const char *argv[])
 
 		if (rc == -2)
 		{
-			archscan_sort = NULL;
-			errlog(LOG_INFO, "Queue is empty.  Going to rescan in %d seconds\n", rescan_interval);
-			sleep(rescan_interval);
-			if (archscan(optind, argc, (char **) argv) < 0)
-			{
+			rc = archwatch_wait();
+			if (rc < 0)
 				return -1;
+			if (rc == 0)
+			{
+				if (archscan(optind, argc, (char **) argv) < 0)
+				{
+					return -1;
+				}
+				errlog(LOG_INFO, "Archive dir scanned\n");
 			}
-			errlog(LOG_INFO, "Archive dir scanned\n");
 			continue;
 		}
 
@@ -476,7 +526,9 @@ process_archive(char *fname)
 {
 	SlonDString destfname;
 	char	   *cp;
-	FILE	   *fp;
+	ArchiveFile *af;
+	ArchiveFileStats stats;
+	int			namelen;
 	ProcessingCommand *cmd;
 
 	errlog(LOG_INFO, "Processing archive file %s\n", fname);
@@ -485,8 +537,8 @@ process_archive(char *fname)
 	if (archive_count >= max_archives)
 		ipc_set_shutdown_smart();
 
-	fp = fopen(fname, "r");
-	if (fp == NULL)
+	af = archive_file_open_read(fname);
+	if (af == NULL)
 	{
 		errlog(LOG_ERROR, "cannot open %s - %s\n", fname, strerror(errno));
 		return -1;
@@ -502,7 +554,16 @@ process_archive(char *fname)
 		dstring_init(&destfname);
 		dstring_append(&destfname, destination_dir);
 		dstring_addchar(&destfname, '/');
-		dstring_append(&destfname, cp);
+
+		/*
+		 * The destination file is written uncompressed, so drop any
+		 * compression suffix from its name.
+		 */
+		namelen = archive_name_is_archive(cp);
+		if (namelen > 0)
+			dstring_nappend(&destfname, cp, namelen);
+		else
+			dstring_append(&destfname, cp);
 		dstring_terminate(&destfname);
 
 		destinationfname = dstring_data(&destfname);
@@ -519,7 +580,7 @@ process_archive(char *fname)
 	{
 		if (process_command(cmd->command, fname, destinationfname) < 0)
 		{
-			fclose(fp);
+			archive_file_abort(af);
 			if (destinationfname != NULL)
 			{
 				destinationfname = NULL;
@@ -536,19 +597,36 @@ process_archive(char *fname)
 		{
 			errlog(LOG_ERROR, "cannot open %s - %s\n",
 				   dstring_data(&destfname), strerror(errno));
-			fclose(fp);
+			archive_file_abort(af);
 			destinationfname = NULL;
 			dstring_free(&destfname);
 			return 1;
 		}
 	}
 
-	scan_new_input_file(fp);
+	process_skipping = false;
+	scan_new_input_archive(af);
 	current_file = fname;
 	scan_push_string("start_archive;");
 	parse_errors = 0;
 	parse_errors += yyparse();
-	fclose(fp);
+
+	/*
+	 * Collect the results of everything still in the pipeline before the
+	 * archive counts as applied.
+	 */
+	if (process_pipeline_sync() < 0 && parse_errors == 0)
+		parse_errors++;
+	if (parse_errors != 0)
+		current_at_counter_valid = false;
+
+	archive_file_close(af, &stats);
+	errlog(LOG_INFO, "archive %s: " INT64_FORMAT " bytes read from "
+		   INT64_FORMAT " (ratio %.2f, %.3f s decompression CPU)\n",
+		   fname, stats.raw_bytes, stats.file_bytes,
+		   stats.file_bytes > 0 ?
+		   (double) stats.raw_bytes / (double) stats.file_bytes : 0.0,
+		   stats.cpu_time);
 
 	if (destinationfname != NULL)
 	{
@@ -584,27 +662,28 @@ process_archive(char *fname)
 static int
 process_exec_sql(char *sql)
 {
+	if (process_skipping)
+		return 0;
+
 	/*
 	 * If we have a database connection, throw the query over to there.
+	 * Inside of a transaction the query is pipelined, anything else waits
+	 * for the pipeline to drain first.
 	 */
 	if (dbconn != NULL)
 	{
-		PGresult   *res;
-
-		res = PQexec(dbconn, sql);
-		if (PQresultStatus(res) != PGRES_COMMAND_OK &&
-			PQresultStatus(res) != PGRES_TUPLES_OK &&
-			PQresultStatus(res) != PGRES_EMPTY_QUERY)
+		if (process_in_transaction && pipeline_depth > 0)
 		{
-			errlog(LOG_ERROR, "%s: %sQuery was: %s\n",
-				   PQresStatus(PQresultStatus(res)),
-				   PQresultErrorMessage(res), sql);
-			PQclear(res);
-
-			return -1;
+			if (process_pipeline_send(sql) < 0)
+				return -1;
+		}
+		else
+		{
+			if (process_pipeline_sync() < 0)
+				return -1;
+			if (process_exec_db(sql) < 0)
+				return -1;
 		}
-
-		PQclear(res);
 	}
 
 	if (destinationfp != NULL)
@@ -625,6 +704,182 @@ process_exec_sql(char *sql)
 }
 
 
+static int
+process_exec_db(char *sql)
+{
+	PGresult   *res;
+
+	res = PQexec(dbconn, sql);
+	if (PQresultStatus(res) != PGRES_COMMAND_OK &&
+		PQresultStatus(res) != PGRES_TUPLES_OK &&
+		PQresultStatus(res) != PGRES_EMPTY_QUERY)
+	{
+		errlog(LOG_ERROR, "%s: %sQuery was: %s\n",
+			   PQresStatus(PQresultStatus(res)),
+			   PQresultErrorMessage(res), sql);
+		PQclear(res);
+
+		return -1;
+	}
+
+	PQclear(res);
+
+	return 0;
+}
+
+
+/* ----------
+ * process_pipeline_send
+ *
+ *	Send a query in libpq pipeline mode without waiting for its result.
+ *	The results are collected by process_pipeline_sync(), which is done
+ *	every pipeline_depth queries. Without pipeline support in libpq the
+ *	query is executed right away.
+ * ----------
+ */
+static int
+process_pipeline_send(char *sql)
+{
+#ifdef HAVE_PQENTERPIPELINEMODE
+	if (pipeline_queries == NULL)
+	{
+		pipeline_queries = (char **) malloc(sizeof(char *) * pipeline_depth);
+		if (pipeline_queries == NULL)
+		{
+			errlog(LOG_ERROR, "out of memory in process_pipeline_send()\n");
+			return -1;
+		}
+	}
+
+	if (PQpipelineStatus(dbconn) == PQ_PIPELINE_OFF &&
+		PQenterPipelineMode(dbconn) != 1)
+	{
+		errlog(LOG_ERROR, "cannot enter pipeline mode: %s",
+			   PQerrorMessage(dbconn));
+		return -1;
+	}
+
+	if (PQsendQueryParams(dbconn, sql, 0, NULL, NULL, NULL, NULL, 0) != 1)
+	{
+		errlog(LOG_ERROR, "%sQuery was: %s\n", PQerrorMessage(dbconn), sql);
+		process_pipeline_sync();
+		return -1;
+	}
+	if ((pipeline_queries[pipeline_count++] = strdup(sql)) == NULL)
+	{
+		errlog(LOG_ERROR, "out of memory in process_pipeline_send()\n");
+		process_pipeline_sync();
+		return -1;
+	}
+
+	if (pipeline_count >= pipeline_depth)
+		return process_pipeline_sync();
+
+	return 0;
+#else
+	return process_exec_db(sql);
+#endif
+}
+
+
+/* ----------
+ * process_pipeline_sync
+ *
+ *	Wait for the results of all pipelined queries and leave pipeline
+ *	mode. If one of them failed, the transaction it was part of is
+ *	rolled back.
+ * ----------
+ */
+static int
+process_pipeline_sync(void)
+{
+#ifdef HAVE_PQENTERPIPELINEMODE
+	PGresult   *res;
+	int			rc = 0;
+	int			i;
+
+	if (dbconn == NULL)
+		return 0;
+
+	/*
+	 * A connection reset leaves pipeline mode without telling us.
+	 */
+	if (PQpipelineStatus(dbconn) == PQ_PIPELINE_OFF)
+	{
+		for (i = 0; i < pipeline_count; i++)
+			free(pipeline_queries[i]);
+		pipeline_count = 0;
+		return 0;
+	}
+
+	if (PQpipelineSync(dbconn) != 1)
+	{
+		errlog(LOG_ERROR, "cannot sync pipeline: %s", PQerrorMessage(dbconn));
+		rc = -1;
+	}
+
+	for (i = 0; i < pipeline_count; i++)
+	{
+		while ((res = PQgetResult(dbconn)) != NULL)
+		{
+			switch (PQresultStatus(res))
+			{
+				case PGRES_COMMAND_OK:
+				case PGRES_TUPLES_OK:
+				case PGRES_EMPTY_QUERY:
+				case PGRES_PIPELINE_ABORTED:
+					break;
+
+				default:
+					errlog(LOG_ERROR, "%s: %sQuery was: %s\n",
+						   PQresStatus(PQresultStatus(res)),
+						   PQresultErrorMessage(res), pipeline_queries[i]);
+					rc = -1;
+					break;
+			}
+			PQclear(res);
+		}
+		free(pipeline_queries[i]);
+	}
+	pipeline_count = 0;
+
+	while ((res = PQgetResult(dbconn)) != NULL &&
+		   PQresultStatus(res) != PGRES_PIPELINE_SYNC)
+	{
+		if (rc == 0)
+			errlog(LOG_ERROR, "lost pipeline synchronization: %s",
+				   PQerrorMessage(dbconn));
+		PQclear(res);
+		rc = -1;
+	}
+	PQclear(res);
+
+	if (PQexitPipelineMode(dbconn) != 1)
+	{
+		errlog(LOG_ERROR, "cannot exit pipeline mode: %s",
+			   PQerrorMessage(dbconn));
+		rc = -1;
+	}
+
+	/*
+	 * The failed query left its transaction aborted, and the queries
+	 * sent after it were skipped.
+	 */
+	if (rc < 0 && PQstatus(dbconn) == CONNECTION_OK &&
+		PQpipelineStatus(dbconn) == PQ_PIPELINE_OFF)
+	{
+		res = PQexec(dbconn, "rollback;");
+		PQclear(res);
+		process_in_transaction = false;
+	}
+
+	return rc;
+#else
+	return 0;
+#endif
+}
+
+
 int
 process_check_at_counter(char *at_counter)
 {
@@ -642,8 +897,17 @@ process_check_at_counter(char *at_counter)
 		return -1;
 	}
 
-	if (get_current_at_counter() < 0)
-		return -1;
+	/*
+	 * The counter is only read from the database once. After that we keep
+	 * track of it ourselves, so that SYNC groups can be pipelined. The
+	 * archive tracking function still checks every group for being the
+	 * next one.
+	 */
+	if (!current_at_counter_valid)
+	{
+		if (process_pipeline_sync() < 0 || get_current_at_counter() < 0)
+			return -1;
+	}
 
 	for (i = 0; i < (20 - strlen(current_at_counter)); i++)
 		buf1[i] = '0';
@@ -654,17 +918,28 @@ process_check_at_counter(char *at_counter)
 
 	if (strcmp(buf2, buf1) <= 0)
 	{
-		errlog(LOG_WARN, "skip archive with counter %s - already applied\n",
+		errlog(LOG_WARN, "skip archive group with counter %s - already applied\n",
 			   at_counter);
 		if (process_in_transaction)
 			process_end_transaction("rollback;");
 		return 1;
 	}
+	strcpy(group_at_counter, at_counter);
 
 	return 0;
 }
 
 
+/*
+ * Ignore the rest of the current SYNC group up to its commit.
+ */
+void
+process_skip_group(void)
+{
+	process_skipping = true;
+}
+
+
 int
 process_simple_sql(char *sql)
 {
@@ -837,7 +1112,8 @@ process_copy(CopyStmt *stmt)
 	char	   *namespace;
 	char	   *tablename;
 
-	if (lookup_rename(stmt->namespace, stmt->tablename,
+	if (process_skipping ||
+		lookup_rename(stmt->namespace, stmt->tablename,
 					  &namespace, &tablename) == 0)
 	{
 		suppress_copy = true;
@@ -858,6 +1134,14 @@ process_copy(CopyStmt *stmt)
 
 	if (dbconn != NULL)
 	{
+		/*
+		 * COPY is not possible in pipeline mode.
+		 */
+		if (process_pipeline_sync() < 0)
+		{
+			dstring_free(&ds);
+			return -1;
+		}
 		res = PQexec(dbconn, dstring_data(&ds));
 		if (PQresultStatus(res) != PGRES_COPY_IN)
 		{
@@ -893,8 +1177,12 @@ process_copy(CopyStmt *stmt)
 }
 
 
+/*
+ * Forward a block of COPY data. The block comes straight from the
+ * archive and can start or end in the middle of a line.
+ */
 int
-process_copydata(char *line)
+process_copydata(char *data, size_t len)
 {
 	PGresult   *res;
 
@@ -904,7 +1192,7 @@ process_copydata(char *line)
 	if (dbconn != NULL)
 	{
 #ifdef HAVE_PQPUTCOPYDATA
-		if (PQputCopyData(dbconn, line, strlen(line)) != 1)
+		if (PQputCopyData(dbconn, data, len) != 1)
 		{
 			errlog(LOG_ERROR, "%s", PQerrorMessage(dbconn));
 			PQputCopyEnd(dbconn, "Offline copy_set failed");
@@ -914,7 +1202,7 @@ process_copydata(char *line)
 			return -1;
 		}
 #else
-		if (PQputline(dbconn, line) != 0)
+		if (PQputnbytes(dbconn, data, len) != 0)
 		{
 			errlog(LOG_ERROR, "%s", PQerrorMessage(dbconn));
 			PQendcopy(dbconn);
@@ -925,7 +1213,7 @@ process_copydata(char *line)
 
 	if (destinationfp != NULL)
 	{
-		if (fputs(line, destinationfp) == EOF)
+		if (fwrite(data, 1, len, destinationfp) != len)
 		{
 			errlog(LOG_ERROR, "%s: %s\n", destinationfname, strerror(errno));
 			return -1;
@@ -1007,14 +1295,32 @@ process_start_transaction(char *sql)
 int
 process_end_transaction(char *sql)
 {
+	int			rc;
+
+	if (process_skipping)
+	{
+		process_skipping = false;
+		return 0;
+	}
+
 	if (!process_in_transaction)
 	{
 		errlog(LOG_ERROR, "not inside a transaction\n");
 		return -1;
 	}
+
+	/*
+	 * Send the commit or rollback while still marked as in transaction,
+	 * so it goes down the same pipeline as the rest of the group.
+	 */
+	rc = process_exec_sql(sql);
 	process_in_transaction = false;
 
-	return process_exec_sql(sql);
+	if (strcmp(sql, "commit;") == 0 && group_at_counter[0] != '\0')
+		strcpy(current_at_counter, group_at_counter);
+	group_at_counter[0] = '\0';
+
+	return rc;
 }
 
 
@@ -1101,104 +1407,252 @@ errlog(log_level level, char *fmt,...)
 }
 
 
-static int
-idents_are_distinct(char *id1, char *id2)
+/* ----------
+ * ident_canonical
+ *
+ *	Return a malloc()'d copy of an identifier in the form used as hash
+ *	key. A quoted identifier is kept as is, anything else is folded to
+ *	lower case, so that two identifiers have the same canonical form
+ *	exactly when a rename rule written as the first one applies to the
+ *	second.
+ * ----------
+ */
+static char *
+ident_canonical(char *ident)
 {
-	if (id1 == NULL && id2 == NULL)
-		return 0;
-	if (id1 == NULL || id2 == NULL)
-		return 1;
+	char	   *ret;
+	char	   *cp;
 
-	if (*id1 == '"')
+	if ((ret = strdup(ident)) == NULL)
 	{
-		if (strcmp(id1, id2) == 0)
-			return 0;
-		return 1;
+		errlog(LOG_ERROR, "out of memory in ident_canonical()\n");
+		exit(-1);
 	}
-	if (strcasecmp(id1, id2) == 0)
-		return 0;
-	return 1;
+	if (*ret != '"')
+	{
+		for (cp = ret; *cp != '\0'; cp++)
+			*cp = tolower((unsigned char) *cp);
+	}
+
+	return ret;
 }
 
 
-void
-config_add_rename(RenameObject * entry)
+static uint32
+rename_hash_key(char *namespace, char *name)
 {
-	RenameObject **ep;
+	uint32		hash = 2166136261U;
+	char	   *cp;
 
-	for (ep = &rename_list; *ep != NULL; ep = &((*ep)->next))
+	for (cp = namespace; *cp != '\0'; cp++)
+		hash = (hash ^ (unsigned char) *cp) * 16777619U;
+	if (name != NULL)
 	{
-		if (idents_are_distinct((*ep)->old_namespace, entry->old_namespace))
-			continue;
-		if (idents_are_distinct((*ep)->new_namespace, entry->new_namespace))
-			continue;
-		if (idents_are_distinct((*ep)->old_name, entry->old_name))
-			continue;
-		if (idents_are_distinct((*ep)->new_name, entry->new_name))
-			continue;
+		hash = (hash ^ '.') * 16777619U;
+		for (cp = name; *cp != '\0'; cp++)
+			hash = (hash ^ (unsigned char) *cp) * 16777619U;
 	}
 
-	*ep = entry;
+	return hash;
 }
 
 
-int
-lookup_rename(char *namespace, char *name,
-			  char **use_namespace, char **use_name)
+static RenameHashEntry *
+rename_hash_find(RenameHash * table, char *namespace, char *name,
+				 uint32 hash)
 {
-	RenameObject *entry;
+	RenameHashEntry *entry;
 
-	/*
-	 * first we look for a table specific entry
-	 */
-	for (entry = rename_list; entry != NULL; entry = entry->next)
+	if (table->nbuckets == 0)
+		return NULL;
+
+	for (entry = table->buckets[hash & (table->nbuckets - 1)];
+		 entry != NULL; entry = entry->next)
 	{
-		if (entry->old_name == NULL)
+		if (entry->hash != hash || strcmp(entry->namespace, namespace) != 0)
 			continue;
+		if (entry->name == NULL && name == NULL)
+			return entry;
+		if (entry->name != NULL && name != NULL &&
+			strcmp(entry->name, name) == 0)
+			return entry;
+	}
 
-		if (idents_are_distinct(entry->old_namespace, namespace) ||
-			idents_are_distinct(entry->old_name, name))
-			continue;
+	return NULL;
+}
 
-		/*
-		 * This is a match.
-		 */
-		*use_namespace = entry->new_namespace;
-		*use_name = entry->new_name;
-		if (*use_namespace == NULL)
-			return 0;
-		else
-			return 1;
+
+/*
+ * Add an entry for the given key, which must not be in the table yet.
+ * The table takes ownership of the key strings.
+ */
+static RenameHashEntry *
+rename_hash_add(RenameHash * table, char *namespace, char *name,
+				uint32 hash)
+{
+	RenameHashEntry *entry;
+
+	if (table->nentries >= table->nbuckets)
+	{
+		RenameHashEntry **buckets;
+		RenameHashEntry *next;
+		int			nbuckets;
+		int			i;
+
+		nbuckets = (table->nbuckets == 0) ? 256 : table->nbuckets * 2;
+		buckets = (RenameHashEntry **) calloc(nbuckets,
+											  sizeof(RenameHashEntry *));
+		if (buckets == NULL)
+		{
+			errlog(LOG_ERROR, "out of memory in rename_hash_add()\n");
+			exit(-1);
+		}
+		for (i = 0; i < table->nbuckets; i++)
+		{
+			for (entry = table->buckets[i]; entry != NULL; entry = next)
+			{
+				next = entry->next;
+				entry->next = buckets[entry->hash & (nbuckets - 1)];
+				buckets[entry->hash & (nbuckets - 1)] = entry;
+			}
+		}
+		free(table->buckets);
+		table->buckets = buckets;
+		table->nbuckets = nbuckets;
 	}
 
-	/*
-	 * second we look for a whole namespace
-	 */
-	for (entry = rename_list; entry != NULL; entry = entry->next)
+	entry = (RenameHashEntry *) malloc(sizeof(RenameHashEntry));
+	if (entry == NULL)
 	{
-		if (entry->old_name != NULL)
-			continue;
+		errlog(LOG_ERROR, "out of memory in rename_hash_add()\n");
+		exit(-1);
+	}
+	entry->namespace = namespace;
+	entry->name = name;
+	entry->hash = hash;
+	entry->use_namespace = NULL;
+	entry->use_name = NULL;
+	entry->next = table->buckets[hash & (table->nbuckets - 1)];
+	table->buckets[hash & (table->nbuckets - 1)] = entry;
+	table->nentries++;
+
+	return entry;
+}
 
-		if (idents_are_distinct(entry->old_namespace, namespace))
-			continue;
+
+/* ----------
+ * config_add_rename
+ *
+ *	Add a rename or ignore rule from the config file. The rules are
+ *	hashed by their canonical old namespace and name. If several rules
+ *	exist for the same object, the first one wins.
+ * ----------
+ */
+void
+config_add_rename(RenameObject * entry)
+{
+	static RenameObject *rename_tail = NULL;
+	RenameHash *table;
+	RenameHashEntry *hentry;
+	char	   *namespace;
+	char	   *name;
+	uint32		hash;
+
+	entry->next = NULL;
+	if (rename_tail == NULL)
+		rename_list = entry;
+	else
+		rename_tail->next = entry;
+	rename_tail = entry;
+
+	namespace = ident_canonical(entry->old_namespace);
+	name = (entry->old_name == NULL) ? NULL : ident_canonical(entry->old_name);
+	table = (name == NULL) ? &rename_namespaces : &rename_tables;
+	hash = rename_hash_key(namespace, name);
+
+	if (rename_hash_find(table, namespace, name, hash) != NULL)
+	{
+		free(namespace);
+		if (name != NULL)
+			free(name);
+		return;
+	}
+
+	hentry = rename_hash_add(table, namespace, name, hash);
+	hentry->use_namespace = entry->new_namespace;
+	hentry->use_name = entry->new_name;
+}
+
+
+/* ----------
+ * lookup_rename
+ *
+ *	Find out what a table from the archive is called at the destination.
+ *	Returns 0 if the table is to be ignored, 1 otherwise. The result is
+ *	cached per table, so the rules are only looked at the first time a
+ *	table is seen.
+ * ----------
+ */
+int
+lookup_rename(char *namespace, char *name,
+			  char **use_namespace, char **use_name)
+{
+	RenameHashEntry *cached;
+	RenameHashEntry *entry;
+	char	   *cnamespace;
+	char	   *cname;
+	uint32		hash;
+
+	hash = rename_hash_key(namespace, name);
+	cached = rename_hash_find(&rename_cache, namespace, name, hash);
+	if (cached == NULL)
+	{
+		char	   *namespace_copy;
+		char	   *name_copy;
+
+		if ((namespace_copy = strdup(namespace)) == NULL ||
+			(name_copy = strdup(name)) == NULL)
+		{
+			errlog(LOG_ERROR, "out of memory in lookup_rename()\n");
+			exit(-1);
+		}
+		cached = rename_hash_add(&rename_cache, namespace_copy, name_copy,
+								 hash);
 
 		/*
-		 * This is a match.
+		 * first we look for a table specific entry, second for a whole
+		 * namespace. If there is none, keep the item as it is.
 		 */
-		*use_namespace = entry->new_namespace;
-		*use_name = name;
-		if (*use_namespace == NULL)
-			return 0;
+		cnamespace = ident_canonical(namespace);
+		cname = ident_canonical(name);
+		entry = rename_hash_find(&rename_tables, cnamespace, cname,
+								 rename_hash_key(cnamespace, cname));
+		if (entry != NULL)
+		{
+			cached->use_namespace = entry->use_namespace;
+			cached->use_name = entry->use_name;
+		}
+		else if ((entry = rename_hash_find(&rename_namespaces, cnamespace, NULL,
+							 rename_hash_key(cnamespace, NULL))) != NULL)
+		{
+			cached->use_namespace = entry->use_namespace;
+			cached->use_name = name_copy;
+		}
 		else
-			return 1;
+		{
+			cached->use_namespace = namespace_copy;
+			cached->use_name = name_copy;
+		}
+		free(cnamespace);
+		free(cname);
 	}
 
-	/*
-	 * No match found - just keep the item as it is
-	 */
-	*use_namespace = namespace;
-	*use_name = name;
-	return 1;
+	*use_namespace = cached->use_namespace;
+	*use_name = cached->use_name;
+	if (*use_namespace == NULL)
+		return 0;
+	else
+		return 1;
 }
 
 
@@ -1312,6 +1766,7 @@ get_current_at_counter(void)
 	}
 
 	strcpy(current_at_counter, s);
+	current_at_counter_valid = true;
 	PQclear(res);
 	dstring_free(&ds);
 
@@ -1325,6 +1780,7 @@ archscan(int optind, int argc, char **argv)
 	DIR		   *dirp;
 	struct dirent *dp;
 	char		counter_done_buf[64];
+	int			namelen;
 
 	if (destination_conninfo != NULL)
 	{
@@ -1336,6 +1792,9 @@ archscan(int optind, int argc, char **argv)
 			strcat(counter_done_buf, "0");
 		strcat(counter_done_buf, current_at_counter);
 		strcat(counter_done_buf, ".sql");
+
+		if (strcmp(counter_done_buf, archscan_last) > 0)
+			strcpy(archscan_last, counter_done_buf);
 	}
 	else
 	{
@@ -1356,19 +1815,21 @@ archscan(int optind, int argc, char **argv)
 	}
 	while ((dp = readdir(dirp)) != NULL)
 	{
-		if (strlen(dp->d_name) > 24 &&
-			strcmp(dp->d_name + strlen(dp->d_name) - 24,
-				   counter_done_buf) <= 0)
+		/*
+		 * Archives may carry a compression suffix after ".sql", so compare
+		 * the counter part of the name only.
+		 */
+		namelen = archive_name_is_archive(dp->d_name);
+		if (namelen > 24 &&
+			strncmp(dp->d_name + namelen - 24, counter_done_buf, 24) <= 0)
 		{
 			continue;
 		}
 
-		if (strlen(dp->d_name) > 15 &&
-			strncmp(dp->d_name, "slony1_log_", 11) == 0 &&
-			strcmp(dp->d_name + strlen(dp->d_name) - 4, ".sql") == 0)
+		if (namelen > 15 &&
+			strncmp(dp->d_name, "slony1_log_", 11) == 0)
 		{
-			if (archscan_sort_in(&archscan_sort, dp->d_name, optind,
-								 argc, argv) < 0)
+			if (archscan_sort_in(dp->d_name, optind, argc, argv) < 0)
 			{
 				PQfinish(dbconn);
 				ipc_finish(true);
@@ -1377,8 +1838,9 @@ archscan(int optind, int argc, char **argv)
 		}
 	}
 	closedir(dirp);
+	archscan_time = time(NULL);
 
-	if (archscan_sort_out(archscan_sort) < 0)
+	if (archscan_sort_out() < 0)
 	{
 		PQfinish(dbconn);
 		ipc_finish(true);
@@ -1390,10 +1852,8 @@ archscan(int optind, int argc, char **argv)
 
 
 static int
-archscan_sort_in(archscan_entry ** entp, char *fname, int optind,
-				 int argc, char **argv)
+archscan_sort_in(char *fname, int optind, int argc, char **argv)
 {
-	archscan_entry *ent;
 	char	   *cp1;
 
 	/*
@@ -1413,64 +1873,236 @@ archscan_sort_in(archscan_entry ** entp, char *fname, int optind,
 		optind++;
 	}
 
-	if (*entp == NULL)
+	if (archscan_count >= archscan_alloc)
 	{
-		ent = (archscan_entry *) malloc(sizeof(archscan_entry));
-		if (ent == NULL)
+		char	  **names;
+
+		archscan_alloc = (archscan_alloc == 0) ? 1024 : archscan_alloc * 2;
+		names = (char **) realloc(archscan_names,
+								  sizeof(char *) * archscan_alloc);
+		if (names == NULL)
 		{
 			errlog(LOG_ERROR, "out of memory in archscan_sort_in()\n");
 			return -1;
 		}
-		if ((ent->fname = strdup(fname)) == NULL)
+		archscan_names = names;
+	}
+	if ((archscan_names[archscan_count] = strdup(fname)) == NULL)
+	{
+		errlog(LOG_ERROR, "out of memory in archscan_sort_in()\n");
+		return -1;
+	}
+	archscan_count++;
+
+	return 0;
+}
+
+
+/* ----------
+ * archscan_sort_out
+ *
+ *	Sort the collected file names and put them onto the queue.
+ * ----------
+ */
+static int
+archscan_sort_out(void)
+{
+	char	   *buf;
+	char		counter[64];
+	int			rc = 0;
+	int			i;
+
+	qsort(archscan_names, archscan_count, sizeof(char *), archscan_compare);
+
+	for (i = 0; i < archscan_count; i++)
+	{
+		if (rc == 0)
 		{
-			errlog(LOG_ERROR, "out of memory in archscan_sort_in()\n");
-			return -1;
-		}
-		ent->left = ent->right = NULL;
+			buf = (char *) malloc(strlen(archive_dir) +
+								  strlen(archscan_names[i]) + 2);
+			if (buf == NULL)
+			{
+				errlog(LOG_ERROR, "out of memory in archscan_sort_out()\n");
+				rc = -1;
+			}
+			else
+			{
+				strcpy(buf, archive_dir);
+				strcat(buf, "/");
+				strcat(buf, archscan_names[i]);
+				if (ipc_send_path(buf) < 0)
+					rc = -1;
+				free(buf);
+			}
 
-		*entp = ent;
-		return 0;
+			if (rc == 0 && archscan_counter(archscan_names[i], counter) &&
+				strcmp(counter, archscan_last) > 0)
+				strcpy(archscan_last, counter);
+		}
+		free(archscan_names[i]);
 	}
+	archscan_count = 0;
 
-	if (strcmp(fname, (*entp)->fname) < 0)
-		return archscan_sort_in(&((*entp)->left), fname, optind, argc, argv);
-	else
-		return archscan_sort_in(&((*entp)->right), fname, optind, argc, argv);
+	return rc;
 }
 
 
 static int
-archscan_sort_out(archscan_entry * ent)
+archscan_compare(const void *a, const void *b)
 {
-	char	   *buf;
+	return strcmp(*(char *const *) a, *(char *const *) b);
+}
 
-	if (ent == NULL)
-		return 0;
 
-	if (archscan_sort_out(ent->left) < 0)
-		return -1;
+/*
+ * Extract the fixed width "<counter>.sql" part of an archive file name,
+ * which sorts the same way as the archives have to be applied. Returns
+ * false for names that are not archives.
+ */
+static bool
+archscan_counter(char *fname, char *counter)
+{
+	int			namelen;
+
+	namelen = archive_name_is_archive(fname);
+	if (namelen <= 24 || strncmp(fname, "slony1_log_", 11) != 0)
+		return false;
+
+	memcpy(counter, fname + namelen - 24, 24);
+	counter[24] = '\0';
 
-	buf = (char *) malloc(strlen(archive_dir) + strlen(ent->fname) + 2);
-	if (buf == NULL)
+	return true;
+}
+
+
+/* ----------
+ * archwatch_init
+ *
+ *	Start watching the archive directory with inotify, so that new
+ *	archives are queued as soon as slon renames them into place instead
+ *	of at the next rescan. Must be called before the initial archscan().
+ * ----------
+ */
+static void
+archwatch_init(void)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+	archwatch_fd = inotify_init();
+	if (archwatch_fd < 0)
 	{
-		errlog(LOG_ERROR, "out of memory in archscan_sort_out()\n");
-		return -1;
+		errlog(LOG_WARN, "inotify_init() failed: %s - "
+			   "falling back to rescanning %s\n",
+			   strerror(errno), archive_dir);
+		return;
 	}
-	strcpy(buf, archive_dir);
-	strcat(buf, "/");
-	strcat(buf, ent->fname);
-	if (ipc_send_path(buf) < 0)
+	if (inotify_add_watch(archwatch_fd, archive_dir,
+						  IN_MOVED_TO | IN_CLOSE_WRITE) < 0)
 	{
-		free(buf);
-		return -1;
+		errlog(LOG_WARN, "cannot watch %s: %s - falling back to rescanning\n",
+			   archive_dir, strerror(errno));
+		close(archwatch_fd);
+		archwatch_fd = -1;
 	}
-	free(buf);
+#endif
+}
 
-	if (archscan_sort_out(ent->right) < 0)
-		return -1;
 
-	free(ent->fname);
-	free(ent);
+/* ----------
+ * archwatch_wait
+ *
+ *	Called when the queue is empty. Waits for new archives and queues
+ *	them. Returns 1 to check the queue again, 0 if the archive directory
+ *	must be rescanned and -1 on error.
+ *
+ *	Without inotify this just sleeps rescan_interval seconds. With it,
+ *	the wait is cut into one second slices so that IPC requests are
+ *	still noticed, and the directory is only rescanned every
+ *	rescan_interval seconds (never if that is 0) or after the kernel
+ *	dropped events.
+ * ----------
+ */
+static int
+archwatch_wait(void)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+	if (archwatch_fd >= 0)
+	{
+		char		buf[64 * 1024]
+					__attribute__((aligned(__alignof__(struct inotify_event))));
+		struct inotify_event *ev;
+		struct pollfd pfd;
+		char		counter[64];
+		char	   *path;
+		char	   *cp;
+		ssize_t		len;
+		int			rc;
+
+		if (rescan_interval > 0 &&
+			time(NULL) >= archscan_time + rescan_interval)
+			return 0;
+
+		pfd.fd = archwatch_fd;
+		pfd.events = POLLIN;
+		rc = poll(&pfd, 1, 1000);
+		if (rc < 0 && errno != EINTR)
+		{
+			errlog(LOG_ERROR, "poll() failed: %s\n", strerror(errno));
+			return -1;
+		}
+		if (rc <= 0)
+			return 1;
+
+		len = read(archwatch_fd, buf, sizeof(buf));
+		if (len < 0)
+		{
+			if (errno == EINTR || errno == EAGAIN)
+				return 1;
+			errlog(LOG_ERROR, "cannot read inotify events: %s\n",
+				   strerror(errno));
+			return -1;
+		}
+
+		for (cp = buf; cp < buf + len;
+			 cp += sizeof(struct inotify_event) + ev->len)
+		{
+			ev = (struct inotify_event *) cp;
+
+			if (ev->mask & IN_Q_OVERFLOW)
+				return 0;
+			if (ev->len == 0 || !archscan_counter(ev->name, counter))
+				continue;
+
+			/*
+			 * Skip the archive queued last, IN_CLOSE_WRITE and IN_MOVED_TO
+			 * can both be reported for the same file. An older one was
+			 * renamed into place out of order and still goes onto the
+			 * queue, which keeps it sorted. If it was applied already,
+			 * the archive tracking skips it.
+			 */
+			if (strcmp(counter, archscan_last) == 0)
+				continue;
+
+			path = (char *) malloc(strlen(archive_dir) + strlen(ev->name) + 2);
+			if (path == NULL)
+			{
+				errlog(LOG_ERROR, "out of memory in archwatch_wait()\n");
+				return -1;
+			}
+			sprintf(path, "%s/%s", archive_dir, ev->name);
+			rc = ipc_send_path(path);
+			free(path);
+			if (rc < 0)
+				return -1;
+			if (strcmp(counter, archscan_last) > 0)
+				strcpy(archscan_last, counter);
+		}
+
+		return 1;
+	}
+#endif
+
+	errlog(LOG_INFO, "Queue is empty.  Going to rescan in %d seconds\n", rescan_interval);
+	sleep(rescan_interval);
 
 	return 0;
 }
@@ -10,6 +10,8 @@
  *-------------------------------------------------------------------------
  */
 
+#include "../misc/archive_io.h"
+
 
 /* ----------
  * SlonDString
@@ -188,6 +190,7 @@ extern char *destination_dir;
 extern char *destination_conninfo;
 extern char *logfile_path;
 extern int	max_archives;
+extern int	pipeline_depth;
 extern char *cluster_name;
 extern char *namespace;
 
@@ -200,6 +203,7 @@ extern ProcessingCommand *error_commands;
  * Functions in slony_logshipper.c
  */
 extern int	process_check_at_counter(char *at_counter);
+extern void process_skip_group(void);
 extern int	process_simple_sql(char *sql);
 extern int	process_start_transaction(char *sql);
 extern int	process_end_transaction(char *sql);
@@ -208,7 +212,7 @@ extern int	process_update(UpdateStmt *stmt);
 extern int	process_delete(DeleteStmt *stmt);
 extern int	process_truncate(TruncateStmt *stmt);
 extern int	process_copy(CopyStmt *stmt);
-extern int	process_copydata(char *line);
+extern int	process_copydata(char *data, size_t len);
 extern int	process_copyend(void);
 extern void config_add_rename(RenameObject * entry);
 extern int lookup_rename(char *namespace, char *name,
@@ -249,7 +253,12 @@ extern char *yytext;
 extern FILE *yyin;
 extern char yychunk[];
 
+#define SCAN_COPY_BUFSIZE	(256 * 1024)
+extern char yycopybuf[];
+extern size_t yycopylen;
+
 extern void scan_new_input_file(FILE *in);
+extern void scan_new_input_archive(ArchiveFile * af);
 extern void scan_push_string(char *str);
 extern int	scan_yyinput(void);
 extern void scan_copy_start(void);
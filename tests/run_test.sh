@@ -509,6 +509,10 @@ build_slonconf()
 	echo "archive_dir='${mktmp}/archive_logs_${node}'" >> ${CONFFILE}
 	eval pgbindir=\$PGBINDIR${node}
     fi
+    if [ -f ${testname}/slon.conf ]; then
+	status "slonconf adds ${testname}/slon.conf for node ${node}"
+	cat ${testname}/slon.conf >> ${CONFFILE}
+    fi
 }
 
 launch_slon()
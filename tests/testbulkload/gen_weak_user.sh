@@ -0,0 +1,6 @@
+weakuser=$1;
+
+for i in items plain; do
+   echo "grant select on table public.${i} to ${weakuser};"
+   echo "grant select on table public.${i}_id_seq to ${weakuser};"
+done
@@ -0,0 +1,92 @@
+. support_funcs.sh
+
+init_dml()
+{
+  echo "init_dml()"
+}
+
+begin()
+{
+  echo "begin()"
+}
+
+rollback()
+{
+  echo "rollback()"
+}
+
+commit()
+{
+  echo "commit()"
+}
+
+bulk_load()
+{
+  chunk=$1
+  numrows=$(random_number 500 5000)
+  echo "select \"_${CLUSTER1}\".logBulkLoad(1, 'select nextval(''items_id_seq''), ''bulk '' || i, i % 1000 from generate_series(1, ${numrows}) as i', ${chunk});" >> $GENDATA
+}
+
+generate_initdata()
+{
+  numrows=$(random_number 20 100)
+  i=0;
+  status "generating ${numrows} transactions of random data"
+  GENDATA="$mktmp/generate.data"
+  echo "" > ${GENDATA}
+  while : ; do
+    txtalen=$(random_number 1 50)
+    txta=$(random_string ${txtalen})
+    txta=`echo ${txta} | sed -e "s/\\\\\\\/\\\\\\\\\\\\\\/g" -e "s/'/''/g"`
+    ra=$(random_number 1 100)
+    echo "INSERT INTO items(data, amount) VALUES ('${txta}', ${ra});" >> $GENDATA
+    echo "UPDATE items SET amount = amount + ${ra} WHERE id % 10 = ${ra} % 10;" >> $GENDATA
+    echo "INSERT INTO plain(data) VALUES ('${txta}');" >> $GENDATA
+    case $((${ra} % 5)) in
+      0)
+        bulk_load 10000
+        ;;
+      1)
+        echo "begin;" >> $GENDATA
+        echo "INSERT INTO items(data, amount) VALUES ('before ${txta}', ${ra});" >> $GENDATA
+        echo "UPDATE items SET data = 'updated before' WHERE id = (SELECT max(id) FROM items);" >> $GENDATA
+        bulk_load 100
+        echo "UPDATE items SET data = 'updated after' WHERE id = (SELECT max(id) FROM items);" >> $GENDATA
+        echo "DELETE FROM items WHERE id = (SELECT max(id) - 1 FROM items);" >> $GENDATA
+        echo "commit;" >> $GENDATA
+        ;;
+      2)
+        echo "DELETE FROM items WHERE id % 17 = ${ra} % 17;" >> $GENDATA
+        ;;
+    esac
+    if [ ${i} -ge ${numrows} ]; then
+      break;
+    else
+      i=$((${i} +1))
+    fi
+  done
+  status "done"
+}
+
+do_initdata()
+{
+  originnode=${ORIGINNODE:-"1"}
+  eval db=\$DB${originnode}
+  eval host=\$HOST${originnode}
+  eval user=\$USER${originnode}
+  eval port=\$PORT${originnode}
+  generate_initdata
+  launch_poll
+  status "loading data"
+  $pgbindir/psql -h $host -p $port -d $db -U $user < $mktmp/generate.data 1> $mktmp/initdata.log 2> $mktmp/initdata.log
+  if [ $? -ne 0 ]; then
+    warn 3 "do_initdata failed, see $mktmp/initdata.log for details"
+  fi
+  status "data load complete"
+
+  chunks=`$pgbindir/psql -h $host -p $port -d $db -U $user -t -A -c "select count(*) from (select log_cmdtype from \"_${CLUSTER1}\".sl_log_1 union all select log_cmdtype from \"_${CLUSTER1}\".sl_log_2) as L where log_cmdtype = 'B';" 2> $mktmp/chunks.log`
+  status "${chunks} bulk load chunks logged"
+
+  wait_for_catchup
+  status "done"
+}
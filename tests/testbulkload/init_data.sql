@@ -0,0 +1,5 @@
+insert into items (data, amount)
+select 'initial ' || i, i from generate_series(1, 100) as i;
+
+insert into plain (data)
+values ('one'), ('two'), ('three');
@@ -0,0 +1,10 @@
+create table items (
+   id serial primary key,
+   data text,
+   amount numeric(12,2)
+);
+
+create table plain (
+   id serial primary key,
+   data text
+);
@@ -0,0 +1,75 @@
+. support_funcs.sh
+
+init_dml()
+{
+  echo "init_dml()"
+}
+
+begin()
+{
+  echo "begin()"
+}
+
+rollback()
+{
+  echo "rollback()"
+}
+
+commit()
+{
+  echo "commit()"
+}
+
+generate_initdata()
+{
+  numrows=$(random_number 50 500)
+  i=0;
+  status "generating ${numrows} transactions of random data"
+  GENDATA="$mktmp/generate.data"
+  echo "" > ${GENDATA}
+  while : ; do
+    txtalen=$(random_number 1 50)
+    txta=$(random_string ${txtalen})
+    txta=`echo ${txta} | sed -e "s/\\\\\\\/\\\\\\\\\\\\\\/g" -e "s/'/''/g"`
+    ra=$(random_number 1 100)
+    echo "INSERT INTO accounts(name, balance, notes) VALUES ('${txta}', ${ra}, 'note ${txta}');" >> $GENDATA
+    echo "UPDATE accounts SET balance = balance + ${ra}, notes = 'changed ${ra}' WHERE id = (SELECT max(id) FROM accounts) - ${ra} % 5;" >> $GENDATA
+    echo "UPDATE accounts SET notes = 'only notes ${ra}' WHERE id % 7 = ${ra} % 7;" >> $GENDATA
+    echo "INSERT INTO plain(data) VALUES ('${txta}');" >> $GENDATA
+    if [ $((${ra} % 10)) -eq 0 ]; then
+      echo "DELETE FROM accounts WHERE id = (SELECT min(id) FROM accounts);" >> $GENDATA
+    fi
+    if [ ${i} -ge ${numrows} ]; then
+      break;
+    else
+      i=$((${i} +1))
+    fi
+  done
+  status "done"
+}
+
+do_initdata()
+{
+  originnode=${ORIGINNODE:-"1"}
+  eval db=\$DB${originnode}
+  eval host=\$HOST${originnode}
+  eval user=\$USER${originnode}
+  eval port=\$PORT${originnode}
+  generate_initdata
+  launch_poll
+  status "loading data"
+  $pgbindir/psql -h $host -p $port -d $db -U $user < $mktmp/generate.data 1> $mktmp/initdata.log 2> $mktmp/initdata.log
+  if [ $? -ne 0 ]; then
+    warn 3 "do_initdata failed, see $mktmp/initdata.log for details"
+  fi
+  status "data load complete"
+
+  wait_for_catchup
+
+  status "checking that notes were not replicated"
+  notes=`$pgbindir/psql -h $HOST2 -p $PORT2 -d $DB2 -U $USER2 -t -A -c "select count(*) from accounts where notes is not null;" 2> $mktmp/notes.log`
+  if [ "x${notes}" != "x0" ]; then
+    warn 3 "subscriber has ${notes} accounts rows with notes, see $mktmp/notes.log for details"
+  fi
+  status "done"
+}
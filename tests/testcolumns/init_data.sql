@@ -0,0 +1,9 @@
+insert into accounts (name, balance, notes)
+values
+('alpha', 10, 'not replicated 1'),
+('beta', 20, 'not replicated 2'),
+('gamma', 30, 'not replicated 3'),
+('delta', 40, NULL);
+
+insert into plain (data)
+values ('one'), ('two'), ('three');
@@ -0,0 +1,11 @@
+create table accounts (
+   id serial primary key,
+   name text not null,
+   balance numeric(12,2) not null default 0,
+   notes text
+);
+
+create table plain (
+   id serial primary key,
+   data text
+);
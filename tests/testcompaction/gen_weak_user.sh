@@ -0,0 +1,4 @@
+weakuser=$1;
+
+echo "grant select on table public.items to ${weakuser};"
+echo "grant select on table public.pairs to ${weakuser};"
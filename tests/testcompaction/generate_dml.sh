@@ -0,0 +1,83 @@
+. support_funcs.sh
+
+init_dml()
+{
+  echo "init_dml()"
+}
+
+begin()
+{
+  echo "begin()"
+}
+
+rollback()
+{
+  echo "rollback()"
+}
+
+commit()
+{
+  echo "commit()"
+}
+
+generate_initdata()
+{
+  numrows=$(random_number 200 500)
+  i=0;
+  status "generating ${numrows} rounds of changes"
+  GENDATA="$mktmp/generate.data"
+  echo "" > ${GENDATA}
+  while : ; do
+    k=$((1000 + ${i}))
+    txtalen=$(random_number 1 50)
+    txta=$(random_string ${txtalen})
+    txta=`echo ${txta} | sed -e "s/\\\\\\\/\\\\\\\\\\\\\\/g" -e "s/'/''/g"`
+    ra=$(random_number 1 100)
+    echo "INSERT INTO items(id, data, amount) VALUES (${k}, '${txta}', ${ra});" >> $GENDATA
+    echo "UPDATE items SET amount = amount + 1 WHERE id = ${k};" >> $GENDATA
+    echo "UPDATE items SET data = 'merged ${ra}' WHERE id = ${k};" >> $GENDATA
+    echo "UPDATE items SET amount = amount * 2 WHERE id = ${k} - 1;" >> $GENDATA
+    echo "INSERT INTO items(id, data, amount) VALUES (${k} + 100000, 'transient', 0);" >> $GENDATA
+    echo "DELETE FROM items WHERE id = ${k} + 100000;" >> $GENDATA
+    echo "DELETE FROM items WHERE id = ${k} - 5;" >> $GENDATA
+    echo "INSERT INTO items(id, data, amount) VALUES (${k} - 5, 'reinserted ${txta}', ${ra});" >> $GENDATA
+    echo "INSERT INTO pairs(a, b, v) VALUES (${k}, 'b${k}', '${txta}');" >> $GENDATA
+    echo "UPDATE pairs SET v = 'changed ${ra}' WHERE a = ${k} AND b = 'b${k}';" >> $GENDATA
+    echo "INSERT INTO pairs(a, b, v) VALUES (${k}, 'c${k}', 'same a');" >> $GENDATA
+    echo "DELETE FROM pairs WHERE a = ${k} - 3 AND b = 'b'||(${k} - 3);" >> $GENDATA
+    echo "UPDATE pairs SET v = 'kept' WHERE a = ${k} - 3;" >> $GENDATA
+    echo "select \"_${CLUSTER1}\".createEvent('_${CLUSTER1}', 'SYNC');" >> $GENDATA
+    if [ ${i} -ge ${numrows} ]; then
+      break;
+    else
+      i=$((${i} +1))
+    fi
+  done
+  status "done"
+}
+
+do_initdata()
+{
+  originnode=${ORIGINNODE:-"1"}
+  eval db=\$DB${originnode}
+  eval host=\$HOST${originnode}
+  eval user=\$USER${originnode}
+  eval port=\$PORT${originnode}
+  generate_initdata
+  launch_poll
+  status "loading data"
+  $pgbindir/psql -h $host -p $port -d $db -U $user < $mktmp/generate.data 1> $mktmp/initdata.log 2> $mktmp/initdata.log
+  if [ $? -ne 0 ]; then
+    warn 3 "do_initdata failed, see $mktmp/initdata.log for details"
+  fi
+  status "data load complete"
+
+  wait_for_catchup
+
+  if grep "compaction of [0-9]* SYNCs saved" $mktmp/slon_log.2 > $mktmp/compaction.log; then
+    status "`wc -l < $mktmp/compaction.log` SYNC groups were compacted"
+  else
+    warn 3 "no SYNC group was compacted, see $mktmp/slon_log.2 for details"
+  fi
+  status "done"
+}
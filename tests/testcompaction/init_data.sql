@@ -0,0 +1,5 @@
+insert into items (id, data, amount)
+select i, 'initial ' || i, i from generate_series(1, 100) as i;
+
+insert into pairs (a, b, v)
+select i, 'b' || i, 'initial' from generate_series(1, 100) as i;
@@ -0,0 +1,12 @@
+create table items (
+   id integer primary key,
+   data text,
+   amount integer
+);
+
+create table pairs (
+   a integer not null,
+   b text not null,
+   v text,
+   primary key (a, b)
+);
@@ -0,0 +1,86 @@
+. support_funcs.sh
+
+init_dml()
+{
+  echo "init_dml()"
+}
+
+begin()
+{
+  echo "begin()"
+}
+
+rollback()
+{
+  echo "rollback()"
+}
+
+commit()
+{
+  echo "commit()"
+}
+
+generate_initdata()
+{
+  numrows=$(random_number 50 500)
+  i=0;
+  status "generating ${numrows} transactions of random data"
+  GENDATA="$mktmp/generate.data"
+  echo "" > ${GENDATA}
+  while : ; do
+    txtalen=$(random_number 1 50)
+    txta=$(random_string ${txtalen})
+    txta=`echo ${txta} | sed -e "s/\\\\\\\/\\\\\\\\\\\\\\/g" -e "s/'/''/g"`
+    ra=$(random_number 1 100)
+    echo "INSERT INTO items(data) VALUES ('${txta}');" >> $GENDATA
+    echo "UPDATE items SET data = 'changed ${ra}' WHERE id % 10 = ${ra} % 10;" >> $GENDATA
+    echo "INSERT INTO plain(data) VALUES ('${txta}');" >> $GENDATA
+    if [ $((${ra} % 10)) -eq 0 ]; then
+      echo "DELETE FROM items WHERE id = (SELECT min(id) FROM items);" >> $GENDATA
+    fi
+    if [ ${i} -ge ${numrows} ]; then
+      break;
+    else
+      i=$((${i} +1))
+    fi
+  done
+  status "done"
+}
+
+do_initdata()
+{
+  originnode=${ORIGINNODE:-"1"}
+  eval db=\$DB${originnode}
+  eval host=\$HOST${originnode}
+  eval user=\$USER${originnode}
+  eval port=\$PORT${originnode}
+  generate_initdata
+  launch_poll
+  status "loading data"
+  $pgbindir/psql -h $host -p $port -d $db -U $user < $mktmp/generate.data 1> $mktmp/initdata.log 2> $mktmp/initdata.log
+  if [ $? -ne 0 ]; then
+    warn 3 "do_initdata failed, see $mktmp/initdata.log for details"
+  fi
+  status "data load complete"
+
+  status "moving keys within the filter"
+  $pgbindir/psql -h $host -p $port -d $db -U $user -c "update items set id = id + 1000000 where id % 4 = 0;" 1> $mktmp/keymove.log 2> $mktmp/keymove.log
+  if [ $? -ne 0 ]; then
+    warn 3 "key update within the filter failed, see $mktmp/keymove.log for details"
+  fi
+
+  status "moving a key across the filter, which must fail"
+  $pgbindir/psql -h $host -p $port -d $db -U $user -c "update items set id = id + 1 where id = (select max(id) from items where id % 2 = 0);" 1> $mktmp/keycross.log 2> $mktmp/keycross.log
+  if [ $? -eq 0 ]; then
+    warn 3 "key update across the filter was not rejected, see $mktmp/keycross.log for details"
+  fi
+
+  wait_for_catchup
+
+  status "checking that node 2 only has rows matching the filter"
+  extra=`$pgbindir/psql -h $HOST2 -p $PORT2 -d $DB2 -U $USER2 -t -A -c "select count(*) from items where id % 2 <> 0;" 2> $mktmp/filter.log`
+  if [ "x${extra}" != "x0" ]; then
+    warn 3 "node 2 has ${extra} items rows outside the filter, see $mktmp/filter.log for details"
+  fi
+  status "done"
+}
@@ -0,0 +1,9 @@
+create table items (
+   id serial primary key,
+   data text
+);
+
+create table plain (
+   id serial primary key,
+   data text
+);
@@ -77,5 +77,16 @@ do_initdata()
     warn 3 "do_initdata failed, see $mktmp/initdata.log for details"
   fi
   status "data load complete"
+  status "waiting for subscribers to catch up"
+  wait ${poll_pid}
+  poll_pid=""
+
+  status "moving set 1 to node 2 and back"
+  init_preamble
+  cat ${testname}/move_set.ik >> $mktmp/slonik.script
+  move_start=`date +%s`
+  do_ik
+  move_end=`date +%s`
+  status "lock set and move set there and back took `expr ${move_end} - ${move_start}` seconds"
   status "done"
 }
@@ -46,4 +46,12 @@ create table table5 (
   d10 text,
   d11 text,
   primary key(id, id2, id3)
-);
\ No newline at end of file
+);
+-- Many small tables, to time LOCK SET and MOVE SET (see move_set.ik)
+DO $$
+BEGIN
+  FOR i IN 1..200 LOOP
+    EXECUTE 'CREATE TABLE manytable_' || i || ' (id serial primary key, data text)';
+  END LOOP;
+END
+$$;
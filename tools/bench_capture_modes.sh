@@ -0,0 +1,53 @@
+#!/bin/sh
+
+# For the Slony-I project
+
+# Compare origin throughput of trigger based change capture through SPI,
+# trigger based capture with slony1.direct_log_insert and logical
+# decoding based capture under pgbench.
+#
+# The pgbench tables must be replicated in a set whose origin is the
+# node in the given database, as set up in the pgbench tutorial in the
+# admin guide, with a slon running for that node (and ideally for a
+# subscriber as well, so that the provider side work is included).
+# The node needs wal_level = logical and a free replication slot.
+#
+# Usage: bench_capture_modes.sh cluster host port database [seconds [clients]]
+
+CLUSTER=$1
+export PGHOST=$2
+export PGPORT=$3
+DATABASE=$4
+DURATION=${5:-60}
+CLIENTS=${6:-8}
+NAMESPACE="\"_${CLUSTER}\""
+PSQL=`which psql`
+PGBENCH=`which pgbench`
+
+if [ -z "$DATABASE" ]; then
+	echo "usage: $0 cluster host port database [seconds [clients]]"
+	exit 1
+fi
+
+run_bench()
+{
+	# Let the slon catch up so every run starts with an empty backlog
+	sleep 10
+	PGOPTIONS="$1" ${PGBENCH} -n -c ${CLIENTS} -j ${CLIENTS} -T ${DURATION} ${DATABASE} |
+		awk '/^tps/ { print $3; exit }'
+}
+
+${PSQL} -q -d ${DATABASE} -c "select ${NAMESPACE}.disableLogicalCapture();" > /dev/null || exit 1
+TPS_TRIGGER=`run_bench`
+TPS_DIRECT=`run_bench "-c slony1.direct_log_insert=on"`
+
+${PSQL} -q -d ${DATABASE} -c "select ${NAMESPACE}.enableLogicalCapture();" > /dev/null || exit 1
+TPS_LOGICAL=`run_bench`
+
+${PSQL} -q -d ${DATABASE} -c "select ${NAMESPACE}.disableLogicalCapture();" > /dev/null
+
+echo "clients:          ${CLIENTS}"
+echo "duration:         ${DURATION} s"
+echo "trigger capture:  ${TPS_TRIGGER} tps"
+echo "direct insert:    ${TPS_DIRECT} tps"
+echo "logical capture:  ${TPS_LOGICAL} tps"
@@ -0,0 +1,80 @@
+#!/bin/sh
+
+# For the Slony-I project
+
+# Measure how fast slony_logshipper gets through the COPY data of a log
+# shipping archive.  A synthetic archive of the given size in MB (default
+# 1024) is generated with sl_log_archive rows like slon writes them and
+# then processed once.  Without a destination database the archive is
+# only parsed and written to a destination directory; with one, the
+# database must have been prepared with slony1_dump.sh for the cluster.
+#
+# Usage: bench_logshipper_copy.sh [size_mb [cluster [conninfo]]]
+
+SIZE_MB=${1:-1024}
+CLUSTER=${2:-T1}
+CONNINFO=$3
+LOGSHIPPER=${LOGSHIPPER:-`which slony_logshipper`}
+WORKDIR=${TMPDIR:-/tmp}/bench_logshipper.$$
+
+if [ -z "${LOGSHIPPER}" ]; then
+	echo "slony_logshipper not found - set LOGSHIPPER"
+	exit 1
+fi
+
+mkdir -p ${WORKDIR}/archives ${WORKDIR}/result || exit 1
+trap "rm -rf ${WORKDIR}" 0 1 2 15
+
+ARCHIVE=${WORKDIR}/slony1_log_1_00000000000000000001.sql
+
+# Generate the archive
+{
+	echo "-- Slony-I log shipping archive"
+	echo "-- Node 1, Event 1"
+	echo "set session_replication_role to replica;"
+	echo "start transaction;"
+	echo "select \"_${CLUSTER}\".archiveTracking_offline('1', '2000-01-01 00:00:00');"
+	echo "-- end of log archiving header"
+	echo "COPY \"_${CLUSTER}\".\"sl_log_archive\" ( log_origin, log_txid,log_tableid,log_actionseq,log_tablenspname, log_tablerelname, log_cmdtype, log_cmdupdncols,log_cmdargs) FROM STDIN;"
+	awk -v limit=`expr ${SIZE_MB} \* 1048576` 'BEGIN {
+		filler = sprintf("%84s", "");
+		while (bytes < limit) {
+			line = sprintf("1\t%d\t1\t%d\tpublic\tpgbench_accounts\tU\t1\t{abalance,%d,aid,%d,filler,\"%s\"}",
+				1000 + int(n / 100), n, n % 10000, n, filler);
+			print line;
+			bytes += length(line) + 1;
+			n++;
+		}
+	}'
+	echo "\\."
+	echo "commit;"
+} > ${ARCHIVE} || exit 1
+
+BYTES=`wc -c < ${ARCHIVE}`
+
+{
+	echo "logfile = '${WORKDIR}/logshipper.log';"
+	echo "cluster name = '${CLUSTER}';"
+	echo "archive dir = '${WORKDIR}/archives';"
+	if [ -n "${CONNINFO}" ]; then
+		echo "destination database = '${CONNINFO}';"
+	else
+		echo "destination dir = '${WORKDIR}/result';"
+	fi
+} > ${WORKDIR}/bench.conf
+
+START=`date +%s.%N`
+${LOGSHIPPER} -f -w ${WORKDIR}/bench.conf ${ARCHIVE} || exit 1
+END=`date +%s.%N`
+
+if grep -qs ERROR ${WORKDIR}/logshipper.log; then
+	cat ${WORKDIR}/logshipper.log
+	exit 1
+fi
+
+echo "${BYTES} ${START} ${END}" | awk '{
+	secs = $3 - $2;
+	printf("archive size:     %.1f MB\n", $1 / 1048576);
+	printf("elapsed:          %.2f s\n", secs);
+	printf("throughput:       %.1f MB/s\n", $1 / 1048576 / secs);
+}'
@@ -286,6 +286,30 @@ begin
           execute 'set session_replication_role to replica;';
 
     end if;
+	if NEW.log_cmdtype = 'B' then
+		while v_idx < v_nargs loop
+			v_list1 = v_list1 || v_comma ||
+				$clname.slon_quote_brute(NEW.log_cmdargs[v_idx]);
+			v_idx = v_idx + 1;
+			v_comma = ',';
+		end loop;
+		select pg_catalog.string_agg('(' || coalesce((select
+				pg_catalog.string_agg(case
+					when F.f = pg_catalog.chr(92) || 'N' then 'null'
+					else 'E''' || pg_catalog.replace(F.f, '''', '''''') || ''''
+					end, ',' order by F.i)
+				from pg_catalog.unnest(pg_catalog.string_to_array(R.r,
+					pg_catalog.chr(9))) with ordinality as F(f, i)),
+				'''''') || ')', ',')
+			into v_list2
+			from pg_catalog.unnest(pg_catalog.string_to_array(
+				NEW.log_cmdargs[v_nargs], pg_catalog.chr(10))) as R(r);
+
+		execute 'INSERT INTO ' ||
+			$clname.slon_quote_brute(NEW.log_tablenspname) || '.' ||
+			$clname.slon_quote_brute(NEW.log_tablerelname) || ' (' ||
+			v_list1 || ') VALUES ' || v_list2;
+	end if;
 	if NEW.log_cmdtype = 'T' then
 		execute 'TRUNCATE TABLE ONLY ' ||
 			$clname.slon_quote_brute(NEW.log_tablenspname) || '.' ||